@@ -58,6 +58,15 @@ if (SQLITE3_FOUND)
 	set (HAVE_SQLITE3 1)
 endif ()
 
+# Only used by the opt-in multi-threaded codec paths, Windows uses its own threads.
+if (NOT WIN32)
+	set (THREADS_PREFER_PTHREAD_FLAG ON)
+	find_package (Threads)
+	if (CMAKE_USE_PTHREADS_INIT)
+		set (HAVE_PTHREAD 1)
+	endif ()
+endif ()
+
 check_include_file(byteswap.h       HAVE_BYTESWAP_H)
 check_include_file(dlfcn.h          HAVE_DLFCN_H)
 check_include_file(direct.h         HAVE_DIRECT_H)
@@ -143,6 +152,7 @@ check_function_exists(malloc		HAVE_MALLOC)
 check_function_exists(mmap			HAVE_MMAP)
 check_function_exists(open			HAVE_OPEN)
 check_function_exists(pipe			HAVE_PIPE)
+check_function_exists(posix_fallocate	HAVE_POSIX_FALLOCATE)
 check_function_exists(read			HAVE_READ)
 check_function_exists(realloc		HAVE_REALLOC)
 check_function_exists(setlocale		HAVE_SETLOCALE)
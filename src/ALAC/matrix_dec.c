@@ -57,6 +57,79 @@
     R = L - v ;
 */
 
+/*
+    Stereo (stride == 2) versions of the loops below.  The decoder always
+    hands us a two channel interleaved output buffer for plain stereo files,
+    and writing to fixed offsets lets the compiler vectorise these loops.
+    The arithmetic is identical to the general stride versions.
+*/
+
+static void
+unmix_stereo (const int32_t * u, const int32_t * v, int32_t * out, int32_t numSamples,
+				int32_t mixbits, int32_t mixres, int32_t outshift)
+{
+	int32_t		j ;
+
+	if (mixres != 0)
+	{
+		for (j = 0 ; j < numSamples ; j++)
+		{
+			int32_t		l, r ;
+
+			l = u [j] + v [j] - ((mixres * v [j]) >> mixbits) ;
+			r = l - v [j] ;
+
+			out [2 * j + 0] = arith_shift_left (l, outshift) ;
+			out [2 * j + 1] = arith_shift_left (r, outshift) ;
+		}
+	}
+	else
+	{
+		for (j = 0 ; j < numSamples ; j++)
+		{
+			out [2 * j + 0] = arith_shift_left (u [j], outshift) ;
+			out [2 * j + 1] = arith_shift_left (v [j], outshift) ;
+		}
+	}
+}
+
+static void
+unmix_stereo_shift (const int32_t * u, const int32_t * v, int32_t * out, int32_t numSamples,
+				int32_t mixbits, int32_t mixres, const uint16_t * shiftUV, int32_t shift, int32_t outshift)
+{
+	int32_t		j ;
+
+	if (mixres != 0)
+	{
+		for (j = 0 ; j < numSamples ; j++)
+		{
+			int32_t		l, r ;
+
+			l = u [j] + v [j] - ((mixres * v [j]) >> mixbits) ;
+			r = l - v [j] ;
+
+			l = arith_shift_left (l, shift) | (uint32_t) shiftUV [2 * j + 0] ;
+			r = arith_shift_left (r, shift) | (uint32_t) shiftUV [2 * j + 1] ;
+
+			out [2 * j + 0] = arith_shift_left (l, outshift) ;
+			out [2 * j + 1] = arith_shift_left (r, outshift) ;
+		}
+	}
+	else
+	{
+		for (j = 0 ; j < numSamples ; j++)
+		{
+			int32_t		l, r ;
+
+			l = arith_shift_left (u [j], shift) | (uint32_t) shiftUV [2 * j + 0] ;
+			r = arith_shift_left (v [j], shift) | (uint32_t) shiftUV [2 * j + 1] ;
+
+			out [2 * j + 0] = arith_shift_left (l, outshift) ;
+			out [2 * j + 1] = arith_shift_left (r, outshift) ;
+		}
+	}
+}
+
 // 16-bit routines
 
 void
@@ -64,6 +137,12 @@ unmix16 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 {
 	int32_t 	j ;
 
+	if (stride == 2)
+	{
+		unmix_stereo (u, v, out, numSamples, mixbits, mixres, 16) ;
+		return ;
+	}
+
 	if (mixres != 0)
 	{
 		/* matrixed stereo */
@@ -99,6 +178,12 @@ unmix20 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 {
 	int32_t 	j ;
 
+	if (stride == 2)
+	{
+		unmix_stereo (u, v, out, numSamples, mixbits, mixres, 12) ;
+		return ;
+	}
+
 	if (mixres != 0)
 	{
 		/* matrixed stereo */
@@ -137,6 +222,15 @@ unmix24 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 	int32_t		l, r ;
 	int32_t 		j, k ;
 
+	if (stride == 2)
+	{
+		if (bytesShifted != 0)
+			unmix_stereo_shift (u, v, out, numSamples, mixbits, mixres, shiftUV, shift, 8) ;
+		else
+			unmix_stereo (u, v, out, numSamples, mixbits, mixres, 8) ;
+		return ;
+	}
+
 	if (mixres != 0)
 	{
 		/* matrixed stereo */
@@ -211,6 +305,15 @@ unmix32 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 	int32_t		l, r ;
 	int32_t 	j, k ;
 
+	if (stride == 2)
+	{
+		if (mixres == 0 && bytesShifted == 0)
+			unmix_stereo (u, v, out, numSamples, mixbits, mixres, 0) ;
+		else
+			unmix_stereo_shift (u, v, out, numSamples, mixbits, mixres, shiftUV, shift, 0) ;
+		return ;
+	}
+
 	if (mixres != 0)
 	{
 		//Assert (bytesShifted != 0) ;
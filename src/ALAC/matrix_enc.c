@@ -45,6 +45,91 @@
     R = L - v ;
 */
 
+/*
+    Stereo (stride == 2) versions of the loops below.  Reading from fixed
+    offsets lets the compiler vectorise these loops ; the arithmetic is
+    identical to the general stride versions.
+*/
+
+static void
+mix_stereo (const int32_t * in, int32_t * u, int32_t * v, int32_t numSamples,
+				int32_t mixbits, int32_t mixres, int32_t inshift)
+{
+	int32_t		j ;
+
+	if (mixres != 0)
+	{
+		int32_t		mod = 1 << mixbits ;
+		int32_t		m2 = mod - mixres ;
+
+		for (j = 0 ; j < numSamples ; j++)
+		{
+			int32_t		l, r ;
+
+			l = in [2 * j + 0] >> inshift ;
+			r = in [2 * j + 1] >> inshift ;
+
+			u [j] = (mixres * l + m2 * r) >> mixbits ;
+			v [j] = l - r ;
+		}
+	}
+	else
+	{
+		for (j = 0 ; j < numSamples ; j++)
+		{
+			u [j] = in [2 * j + 0] >> inshift ;
+			v [j] = in [2 * j + 1] >> inshift ;
+		}
+	}
+}
+
+static void
+mix_stereo_shift (const int32_t * in, int32_t * u, int32_t * v, int32_t numSamples,
+				int32_t mixbits, int32_t mixres, uint16_t * shiftUV, int32_t shift, int32_t inshift)
+{
+	uint32_t	mask = (1ul << shift) - 1 ;
+	int32_t		j ;
+
+	if (mixres != 0)
+	{
+		int32_t		mod = 1 << mixbits ;
+		int32_t		m2 = mod - mixres ;
+
+		for (j = 0 ; j < numSamples ; j++)
+		{
+			int32_t		l, r ;
+
+			l = in [2 * j + 0] >> inshift ;
+			r = in [2 * j + 1] >> inshift ;
+
+			shiftUV [2 * j + 0] = (uint16_t) (l & mask) ;
+			shiftUV [2 * j + 1] = (uint16_t) (r & mask) ;
+
+			l >>= shift ;
+			r >>= shift ;
+
+			u [j] = (mixres * l + m2 * r) >> mixbits ;
+			v [j] = l - r ;
+		}
+	}
+	else
+	{
+		for (j = 0 ; j < numSamples ; j++)
+		{
+			int32_t		l, r ;
+
+			l = in [2 * j + 0] >> inshift ;
+			r = in [2 * j + 1] >> inshift ;
+
+			shiftUV [2 * j + 0] = (uint16_t) (l & mask) ;
+			shiftUV [2 * j + 1] = (uint16_t) (r & mask) ;
+
+			u [j] = l >> shift ;
+			v [j] = r >> shift ;
+		}
+	}
+}
+
 // 16-bit routines
 
 void
@@ -52,6 +137,12 @@ mix16 (const int32_t * in, uint32_t stride, int32_t * u, int32_t * v, int32_t nu
 {
 	int32_t		j ;
 
+	if (stride == 2)
+	{
+		mix_stereo (in, u, v, numSamples, mixbits, mixres, 16) ;
+		return ;
+	}
+
 	if (mixres != 0)
 	{
 		int32_t		mod = 1 << mixbits ;
@@ -91,6 +182,12 @@ mix20 (const int32_t * in, uint32_t stride, int32_t * u, int32_t * v, int32_t nu
 	int32_t		l, r ;
 	int32_t		j ;
 
+	if (stride == 2)
+	{
+		mix_stereo (in, u, v, numSamples, mixbits, mixres, 12) ;
+		return ;
+	}
+
 	if (mixres != 0)
 	{
 		/* matrixed stereo */
@@ -131,6 +228,17 @@ mix24 (const int32_t * in, uint32_t stride, int32_t * u, int32_t * v, int32_t nu
 	uint32_t	mask = (1ul << shift) - 1 ;
 	int32_t		j, k ;
 
+	if (stride == 2 && bytesShifted != 0)
+	{
+		mix_stereo_shift (in, u, v, numSamples, mixbits, mixres, shiftUV, shift, 8) ;
+		return ;
+	}
+	if (stride == 2 && mixres != 0)
+	{
+		mix_stereo (in, u, v, numSamples, mixbits, mixres, 8) ;
+		return ;
+	}
+
 	if (mixres != 0)
 	{
 		/* matrixed stereo */
@@ -215,6 +323,15 @@ mix32 (const int32_t * in, uint32_t stride, int32_t * u, int32_t * v, int32_t nu
 	int32_t		l, r ;
 	int32_t		j, k ;
 
+	if (stride == 2)
+	{
+		if (mixres == 0 && bytesShifted == 0)
+			mix_stereo (in, u, v, numSamples, mixbits, mixres, 0) ;
+		else
+			mix_stereo_shift (in, u, v, numSamples, mixbits, mixres, shiftUV, shift, 0) ;
+		return ;
+	}
+
 	if (mixres != 0)
 	{
 		int32_t		mod = 1 << mixbits ;
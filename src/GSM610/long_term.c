@@ -278,6 +278,34 @@ static void Calculation_of_the_LTP_parameters (
 
 #else	/* USE_FLOAT_MUL */
 
+/*
+ *  Cross-correlation of wt [0..39] with dp [-120..-1] for the 81 lags
+ *  40..120, L_result [l] being the value for lag 40 + l.  Each lag is
+ *  still accumulated in k order so the sums are identical to those of
+ *  the original nine-at-a-time unrolled search, but the loop over the
+ *  lags is independent and can be vectorised by the compiler.
+ */
+static void Cross_correlation (
+	float	* wt_float,	/* [0..39]	IN	*/
+	int16_t	* dp,		/* [-120..-1]	IN	*/
+	float	* L_result	/* [0..80]	OUT	*/)
+{
+	float	dp_rev [120] ;
+	int		k, l ;
+
+	/* dp_rev [m] = dp [-1 - m], so lag 40 + l reads dp_rev [39 - k + l]. */
+	for (k = 0 ; k < 120 ; k++) dp_rev [k] = dp [-1 - k] ;
+
+	for (l = 0 ; l < 81 ; l++) L_result [l] = 0 ;
+
+	for (k = 0 ; k < 40 ; k++)
+	{	float W = wt_float [k] ;
+		float *lp = dp_rev + 39 - k ;
+
+		for (l = 0 ; l < 81 ; l++) L_result [l] += W * lp [l] ;
+		}
+}
+
 #ifdef	LTP_CUT
 
 static void Cut_Calculation_of_the_LTP_parameters (
@@ -469,7 +497,7 @@ static void Calculation_of_the_LTP_parameters (
 	int16_t	Nc, bc ;
 
 	float	wt_float [40] ;
-	float	dp_float_base [120], * dp_float = dp_float_base + 120 ;
+	float	L_result [81] ;
 
 	int32_t	L_max, L_power ;
 	int16_t		R, S, dmax, scal ;
@@ -500,82 +528,19 @@ static void Calculation_of_the_LTP_parameters (
 	/*  Initialization of a working array wt */
 
 	for (k = 0 ; k < 40 ; k++)		wt_float [k] = SASR_W (din [k], scal) ;
-	for (k = -120 ; k < 0 ; k++)	dp_float [k] = dp [k] ;
 
 	/* Search for the maximum cross-correlation and coding of the LTP lag
 	 */
 	L_max = 0 ;
 	Nc = 40 ;	/* index for the maximum cross-correlation */
 
-	for (lambda = 40 ; lambda <= 120 ; lambda += 9)
-	{	/*  Calculate L_result for l = lambda .. lambda + 9. */
-		register float *lp = dp_float - lambda ;
-
-		register float W ;
-		register float a = lp [-8], b = lp [-7], c = lp [-6],
-						d = lp [-5], e = lp [-4], f = lp [-3],
-						g = lp [-2], h = lp [-1] ;
-		register float E ;
-		register float S0 = 0, S1 = 0, S2 = 0, S3 = 0, S4 = 0,
-						S5 = 0, S6 = 0, S7 = 0, S8 = 0 ;
-
-#		undef STEP
-#		define	STEP(K, a, b, c, d, e, f, g, h) \
-			W = wt_float [K] ;		\
-			E = W * a ; S8 += E ;		\
-			E = W * b ; S7 += E ;		\
-			E = W * c ; S6 += E ;		\
-			E = W * d ; S5 += E ;		\
-			E = W * e ; S4 += E ;		\
-			E = W * f ; S3 += E ;		\
-			E = W * g ; S2 += E ;		\
-			E = W * h ; S1 += E ;		\
-			a = lp [K] ;				\
-			E = W * a ; S0 += E
-
-#		define	STEP_A(K)	STEP (K, a, b, c, d, e, f, g, h)
-#		define	STEP_B(K)	STEP (K, b, c, d, e, f, g, h, a)
-#		define	STEP_C(K)	STEP (K, c, d, e, f, g, h, a, b)
-#		define	STEP_D(K)	STEP (K, d, e, f, g, h, a, b, c)
-#		define	STEP_E(K)	STEP (K, e, f, g, h, a, b, c, d)
-#		define	STEP_F(K)	STEP (K, f, g, h, a, b, c, d, e)
-#		define	STEP_G(K)	STEP (K, g, h, a, b, c, d, e, f)
-#		define	STEP_H(K)	STEP (K, h, a, b, c, d, e, f, g)
-
-		STEP_A (0) ; STEP_B (1) ; STEP_C (2) ; STEP_D (3) ;
-		STEP_E (4) ; STEP_F (5) ; STEP_G (6) ; STEP_H (7) ;
-
-		STEP_A (8) ; STEP_B (9) ; STEP_C (10) ; STEP_D (11) ;
-		STEP_E (12) ; STEP_F (13) ; STEP_G (14) ; STEP_H (15) ;
+	Cross_correlation (wt_float, dp, L_result) ;
 
-		STEP_A (16) ; STEP_B (17) ; STEP_C (18) ; STEP_D (19) ;
-		STEP_E (20) ; STEP_F (21) ; STEP_G (22) ; STEP_H (23) ;
-
-		STEP_A (24) ; STEP_B (25) ; STEP_C (26) ; STEP_D (27) ;
-		STEP_E (28) ; STEP_F (29) ; STEP_G (30) ; STEP_H (31) ;
-
-		STEP_A (32) ; STEP_B (33) ; STEP_C (34) ; STEP_D (35) ;
-		STEP_E (36) ; STEP_F (37) ; STEP_G (38) ; STEP_H (39) ;
-
-#		undef STEP_A
-#		undef STEP_B
-#		undef STEP_C
-#		undef STEP_D
-#		undef STEP_E
-#		undef STEP_F
-#		undef STEP_G
-#		undef STEP_H
-
-		if (S0 > L_max) { L_max = S0 ; Nc = lambda ; }
-		if (S1 > L_max) { L_max = S1 ; Nc = lambda + 1 ; }
-		if (S2 > L_max) { L_max = S2 ; Nc = lambda + 2 ; }
-		if (S3 > L_max) { L_max = S3 ; Nc = lambda + 3 ; }
-		if (S4 > L_max) { L_max = S4 ; Nc = lambda + 4 ; }
-		if (S5 > L_max) { L_max = S5 ; Nc = lambda + 5 ; }
-		if (S6 > L_max) { L_max = S6 ; Nc = lambda + 6 ; }
-		if (S7 > L_max) { L_max = S7 ; Nc = lambda + 7 ; }
-		if (S8 > L_max) { L_max = S8 ; Nc = lambda + 8 ; }
-	}
+	for (lambda = 40 ; lambda <= 120 ; lambda++)
+		if (L_result [lambda - 40] > L_max)
+		{	L_max = L_result [lambda - 40] ;
+			Nc = lambda ;
+			}
 	*Nc_out = Nc ;
 
 	L_max <<= 1 ;
@@ -678,10 +643,9 @@ static void Cut_Fast_Calculation_of_the_LTP_parameters (
 	/*  Compute the power of the reconstructed short term residual
 	 *  signal dp [..]
 	 */
-	dp_float -= Nc ;
 	L_power = 0 ;
 	for (k = 0 ; k < 40 ; ++k)
-	{	register float f = dp_float [k] ;
+	{	register float f = dp [k - Nc] ;
 		L_power += f * f ;
 		}
 
@@ -711,77 +675,23 @@ static void Fast_Calculation_of_the_LTP_parameters (
 	int16_t			Nc, bc ;
 
 	float		wt_float [40] ;
-	float		dp_float_base [120], * dp_float = dp_float_base + 120 ;
+	float		L_result [81] ;
 
 	register float	L_max, L_power ;
 
 	for (k = 0 ; k < 40 ; ++k) wt_float [k] = (float) din [k] ;
-	for (k = -120 ; k < 0 ; ++k) dp_float [k] = (float) dp [k] ;
 
 	/* Search for the maximum cross-correlation and coding of the LTP lag */
 	L_max = 0 ;
 	Nc = 40 ;	/* index for the maximum cross-correlation */
 
-	for (lambda = 40 ; lambda <= 120 ; lambda += 9)
-	{	/*  Calculate L_result for l = lambda .. lambda + 9. */
-		register float *lp = dp_float - lambda ;
-
-		register float W ;
-		register float a = lp [-8], b = lp [-7], c = lp [-6],
-						d = lp [-5], e = lp [-4], f = lp [-3],
-						g = lp [-2], h = lp [-1] ;
-		register float E ;
-		register float S0 = 0, S1 = 0, S2 = 0, S3 = 0, S4 = 0,
-						S5 = 0, S6 = 0, S7 = 0, S8 = 0 ;
-
-#		undef STEP
-#		define	STEP(K, a, b, c, d, e, f, g, h) \
-			W = wt_float [K] ;		\
-			E = W * a ; S8 += E ;		\
-			E = W * b ; S7 += E ;		\
-			E = W * c ; S6 += E ;		\
-			E = W * d ; S5 += E ;		\
-			E = W * e ; S4 += E ;		\
-			E = W * f ; S3 += E ;		\
-			E = W * g ; S2 += E ;		\
-			E = W * h ; S1 += E ;		\
-			a = lp [K] ;				\
-			E = W * a ; S0 += E
-
-#		define	STEP_A(K)	STEP (K, a, b, c, d, e, f, g, h)
-#		define	STEP_B(K)	STEP (K, b, c, d, e, f, g, h, a)
-#		define	STEP_C(K)	STEP (K, c, d, e, f, g, h, a, b)
-#		define	STEP_D(K)	STEP (K, d, e, f, g, h, a, b, c)
-#		define	STEP_E(K)	STEP (K, e, f, g, h, a, b, c, d)
-#		define	STEP_F(K)	STEP (K, f, g, h, a, b, c, d, e)
-#		define	STEP_G(K)	STEP (K, g, h, a, b, c, d, e, f)
-#		define	STEP_H(K)	STEP (K, h, a, b, c, d, e, f, g)
-
-		STEP_A (0) ; STEP_B (1) ; STEP_C (2) ; STEP_D (3) ;
-		STEP_E (4) ; STEP_F (5) ; STEP_G (6) ; STEP_H (7) ;
-
-		STEP_A (8) ; STEP_B (9) ; STEP_C (10) ; STEP_D (11) ;
-		STEP_E (12) ; STEP_F (13) ; STEP_G (14) ; STEP_H (15) ;
+	Cross_correlation (wt_float, dp, L_result) ;
 
-		STEP_A (16) ; STEP_B (17) ; STEP_C (18) ; STEP_D (19) ;
-		STEP_E (20) ; STEP_F (21) ; STEP_G (22) ; STEP_H (23) ;
-
-		STEP_A (24) ; STEP_B (25) ; STEP_C (26) ; STEP_D (27) ;
-		STEP_E (28) ; STEP_F (29) ; STEP_G (30) ; STEP_H (31) ;
-
-		STEP_A (32) ; STEP_B (33) ; STEP_C (34) ; STEP_D (35) ;
-		STEP_E (36) ; STEP_F (37) ; STEP_G (38) ; STEP_H (39) ;
-
-		if (S0 > L_max) { L_max = S0 ; Nc = lambda ; }
-		if (S1 > L_max) { L_max = S1 ; Nc = lambda + 1 ; }
-		if (S2 > L_max) { L_max = S2 ; Nc = lambda + 2 ; }
-		if (S3 > L_max) { L_max = S3 ; Nc = lambda + 3 ; }
-		if (S4 > L_max) { L_max = S4 ; Nc = lambda + 4 ; }
-		if (S5 > L_max) { L_max = S5 ; Nc = lambda + 5 ; }
-		if (S6 > L_max) { L_max = S6 ; Nc = lambda + 6 ; }
-		if (S7 > L_max) { L_max = S7 ; Nc = lambda + 7 ; }
-		if (S8 > L_max) { L_max = S8 ; Nc = lambda + 8 ; }
-	}
+	for (lambda = 40 ; lambda <= 120 ; lambda++)
+		if (L_result [lambda - 40] > L_max)
+		{	L_max = L_result [lambda - 40] ;
+			Nc = lambda ;
+			}
 	*Nc_out = Nc ;
 
 	if (L_max <= 0.0)
@@ -792,10 +702,9 @@ static void Fast_Calculation_of_the_LTP_parameters (
 	/*  Compute the power of the reconstructed short term residual
 	 *  signal dp [..]
 	 */
-	dp_float -= Nc ;
 	L_power = 0 ;
 	for (k = 0 ; k < 40 ; ++k)
-	{	register float f = dp_float [k] ;
+	{	register float f = dp [k - Nc] ;
 		L_power += f * f ;
 		}
 
@@ -29,10 +29,6 @@ static void Autocorrelation (
 
 	int16_t		temp, smax, scalauto ;
 
-#ifdef	USE_FLOAT_MUL
-	float		float_s [160] ;
-#endif
-
 	/*  Dynamic scaling of the array  s [0..159] */
 
 	/*  Search for the maximum. */
@@ -56,19 +52,10 @@ static void Autocorrelation (
 
 	if (scalauto > 0)
 	{
-
-# ifdef USE_FLOAT_MUL
-#	define SCALE(n)	\
-	case n: for (k = 0 ; k <= 159 ; k++) \
-			float_s [k] = (float)	\
-				(s [k] = GSM_MULT_R (s [k], 16384 >> (n-1))) ;\
-		break ;
-# else
 #	define SCALE(n)	\
 	case n: for (k = 0 ; k <= 159 ; k++) \
 			s [k] = GSM_MULT_R (s [k], 16384 >> (n-1)) ;\
 		break ;
-# endif /* USE_FLOAT_MUL */
 
 		switch (scalauto) {
 		SCALE (1)
@@ -78,58 +65,22 @@ static void Autocorrelation (
 		}
 # undef	SCALE
 	}
-# ifdef	USE_FLOAT_MUL
-	else for (k = 0 ; k <= 159 ; k++) float_s [k] = (float) s [k] ;
-# endif
 
 	/*  Compute the L_ACF [..].
+	 *
+	 *  After scaling |s [k]| <= 2048, so every product is exact in a float
+	 *  and the float version (USE_FLOAT_MUL) produced exactly these integers.
+	 *  Each lag is a plain dot product which the compiler can vectorise.
 	 */
-	{
-# ifdef	USE_FLOAT_MUL
-		register float	*sp = float_s ;
-		register float	sl = *sp ;
-
-#		define STEP(k)	L_ACF [k] += (int32_t) (sl * sp [- (k)]) ;
-# else
-		int16_t	*sp = s ;
-		int16_t	sl = *sp ;
-
-#		define STEP(k)	L_ACF [k] += ((int32_t) sl * sp [- (k)]) ;
-# endif
-
-#	define NEXTI	sl = *++sp
-
-
-	for (k = 9 ; k-- ; L_ACF [k] = 0) ;
-
-	STEP (0) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ; STEP (5) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ; STEP (5) ; STEP (6) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ; STEP (5) ; STEP (6) ; STEP (7) ;
-
-	for (i = 8 ; i <= 159 ; i++)
-	{	NEXTI ;
-
-		STEP (0) ;
-		STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ;
-		STEP (5) ; STEP (6) ; STEP (7) ; STEP (8) ;
-		}
+	for (k = 0 ; k <= 8 ; k++)
+	{	register int32_t L_sum = 0 ;
 
-	for (k = 9 ; k-- ; )
-		L_ACF [k] = SASL_L (L_ACF [k], 1) ;
+		for (i = k ; i <= 159 ; i++)
+			L_sum += (int32_t) s [i] * s [i - k] ;
+
+		L_ACF [k] = SASL_L (L_sum, 1) ;
+		}
 
-	}
 	/*   Rescaling of the array s [0..159]
 	 */
 	if (scalauto > 0)
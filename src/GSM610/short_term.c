@@ -248,6 +248,18 @@ static void Fast_Short_term_analysis_filtering (
 }
 #endif /* ! (defined (USE_FLOAT_MUL) && defined (FAST)) */
 
+/*
+ *  Branch free gsm_mult_r (). The only product that does not fit in a
+ *  int16_t is MIN_WORD * MIN_WORD which rounds to 32768, so saturating
+ *  the result gives the same value as the special case in gsm_mult_r ().
+ */
+static inline int16_t
+GSM_MULT_R_SAT (int16_t a, int16_t b)
+{	int32_t prod = GSM_MULT_R (a, b) ;
+
+	return prod > MAX_WORD ? MAX_WORD : prod ;
+} /* GSM_MULT_R_SAT */
+
 static void Short_term_synthesis_filtering (
 	struct gsm_state * S,
 	register int16_t	* rrp,	/* [0..7]	IN	*/
@@ -266,20 +278,13 @@ static void Short_term_synthesis_filtering (
 		{	/* sri = GSM_SUB(sri, gsm_mult_r(rrp[i], v [i])) ;
 			 */
 			tmp1 = rrp [i] ;
-			tmp2 = v [i] ;
-			tmp2 = (tmp1 == MIN_WORD && tmp2 == MIN_WORD
-				? MAX_WORD
-				: 0x0FFFF & (((int32_t) tmp1 * (int32_t) tmp2
-							+ 16384) >> 15)) ;
+			tmp2 = GSM_MULT_R_SAT (tmp1, v [i]) ;
 
 			sri = GSM_SUB (sri, tmp2) ;
 
 			/* v [i+1] = GSM_ADD (v [i], gsm_mult_r(rrp[i], sri)) ;
 			 */
-			tmp1 = (tmp1 == MIN_WORD && sri == MIN_WORD
-				? MAX_WORD
-				: 0x0FFFF & (((int32_t) tmp1 * (int32_t) sri
-							+ 16384) >> 15)) ;
+			tmp1 = GSM_MULT_R_SAT (tmp1, sri) ;
 
 			v [i + 1] = GSM_ADD (v [i], tmp1) ;
 		}
@@ -207,6 +207,7 @@ static int	aiff_read_comm_chunk (SF_PRIVATE *psf, COMM_CHUNK *comm_fmt) ;
 static int	aiff_read_header (SF_PRIVATE *psf, COMM_CHUNK *comm_fmt) ;
 
 static int	aiff_write_header (SF_PRIVATE *psf, int calc_length) ;
+static int	aiff_update_header (SF_PRIVATE *psf) ;
 static int	aiff_write_tailer (SF_PRIVATE *psf) ;
 static void	aiff_write_strings (SF_PRIVATE *psf, int location) ;
 
@@ -255,13 +256,14 @@ aiff_open (SF_PRIVATE *psf)
 		} ;
 
 	if (psf->file.mode == SFM_WRITE || psf->file.mode == SFM_RDWR)
-	{	if (psf->is_pipe)
+	{	/* Only fixed width codecs can be streamed, the rest need a rewind. */
+		if (psf->is_pipe && (psf->file.mode == SFM_RDWR || psf->bytewidth == 0))
 			return SFE_NO_PIPE_WRITE ;
 
 		if ((SF_CONTAINER (psf->sf.format)) != SF_FORMAT_AIFF)
 			return SFE_BAD_OPEN_FORMAT ;
 
-		if (psf->file.mode == SFM_WRITE && (subformat == SF_FORMAT_FLOAT || subformat == SF_FORMAT_DOUBLE))
+		if (psf->file.mode == SFM_WRITE && psf->is_pipe == SF_FALSE && (subformat == SF_FORMAT_FLOAT || subformat == SF_FORMAT_DOUBLE))
 		{	if ((psf->peak_info = peak_info_calloc (psf->sf.channels)) == NULL)
 				return SFE_MALLOC_FAILED ;
 			psf->peak_info->peak_loc = SF_PEAK_START ;
@@ -280,6 +282,7 @@ aiff_open (SF_PRIVATE *psf)
 			return error ;
 
 		psf->write_header	= aiff_write_header ;
+		psf->update_header	= aiff_update_header ;
 		psf->set_chunk		= aiff_set_chunk ;
 		} ;
 
@@ -428,8 +431,11 @@ aiff_read_header (SF_PRIVATE *psf, COMM_CHUNK *comm_fmt)
 	{	unsigned	marker ;
 		size_t jump = chunk_size & 1 ;
 
-		marker = chunk_size = 0 ;
-		psf_binheader_readf (psf, "Ejm4", jump, &marker, &chunk_size) ;
+		psf->rwf_endian = SF_ENDIAN_BIG ;
+		psf_header_skip (psf, jump) ;
+		psf_header_prefetch (psf, 8) ;
+		marker = psf_header_get_marker (psf) ;
+		chunk_size = psf_header_get_32 (psf) ;
 		if (marker == 0)
 		{	sf_count_t pos = psf_ftell (psf) ;
 			psf_log_printf (psf, "Have 0 marker at position %D (0x%x).\n", pos, pos) ;
@@ -449,7 +455,7 @@ aiff_read_header (SF_PRIVATE *psf, COMM_CHUNK *comm_fmt)
 					FORMsize = chunk_size ;
 
 					found_chunk |= HAVE_FORM ;
-					psf_binheader_readf (psf, "m", &marker) ;
+					marker = psf_header_get_marker (psf) ;
 					switch (marker)
 					{	case AIFC_MARKER :
 						case AIFF_MARKER :
@@ -541,7 +547,12 @@ aiff_read_header (SF_PRIVATE *psf, COMM_CHUNK *comm_fmt)
 					psf->datalength = SSNDsize - sizeof (ssnd_fmt) ;
 					psf->dataoffset = psf_ftell (psf) ;
 
-					if (psf->datalength > psf->filelength - psf->dataoffset || psf->datalength < 0)
+					if (SSNDsize == 0xFFFFFFFF && psf->is_pipe)
+					{	/* Streamed, so the length wasn't known. Read to the end of the pipe. */
+						psf_log_printf (psf, " SSND : 0xFFFFFFFF (unknown)\n") ;
+						psf->datalength = psf->filelength - psf->dataoffset ;
+						}
+					else if (psf->datalength > psf->filelength - psf->dataoffset || psf->datalength < 0)
 					{	psf_log_printf (psf, " SSND : %u (should be %D)\n", SSNDsize, psf->filelength - psf->dataoffset + sizeof (SSND_CHUNK)) ;
 						psf->datalength = psf->filelength - psf->dataoffset ;
 						}
@@ -977,6 +988,10 @@ aiff_close (SF_PRIVATE *psf)
 		paiff->markstr = NULL ;
 		} ;
 
+	/* Nothing can be appended or patched when streaming to a pipe. */
+	if (psf->file.mode == SFM_WRITE && psf->is_pipe)
+		return 0 ;
+
 	if (psf->file.mode == SFM_WRITE || psf->file.mode == SFM_RDWR)
 	{	aiff_write_tailer (psf) ;
 		aiff_write_header (psf, SF_TRUE) ;
@@ -988,6 +1003,7 @@ aiff_close (SF_PRIVATE *psf)
 static int
 aiff_read_comm_chunk (SF_PRIVATE *psf, COMM_CHUNK *comm_fmt)
 {	BUF_UNION	ubuf ;
+	unsigned char *ptr ;
 	int subformat, samplerate ;
 
 	ubuf.scbuf [0] = 0 ;
@@ -997,8 +1013,13 @@ aiff_read_comm_chunk (SF_PRIVATE *psf, COMM_CHUNK *comm_fmt)
 	** to take special care.
 	*/
 
-	psf_binheader_readf (psf, "E242b", &(comm_fmt->numChannels), &(comm_fmt->numSampleFrames),
-				&(comm_fmt->sampleSize), &(comm_fmt->sampleRate), SIGNED_SIZEOF (comm_fmt->sampleRate)) ;
+	psf->rwf_endian = SF_ENDIAN_BIG ;
+	psf_header_prefetch (psf, 18) ;
+	comm_fmt->numChannels = psf_header_get_16 (psf) ;
+	comm_fmt->numSampleFrames = psf_header_get_32 (psf) ;
+	comm_fmt->sampleSize = psf_header_get_16 (psf) ;
+	if ((ptr = psf_header_get (psf, SIGNED_SIZEOF (comm_fmt->sampleRate))) != NULL)
+		memcpy (comm_fmt->sampleRate, ptr, sizeof (comm_fmt->sampleRate)) ;
 
 	if (comm_fmt->size > 0x10000 && (comm_fmt->size & 0xffff) == 0)
 	{	psf_log_printf (psf, " COMM : %d (0x%x) *** should be ", comm_fmt->size, comm_fmt->size) ;
@@ -1164,6 +1185,7 @@ aiff_rewrite_header (SF_PRIVATE *psf)
 
 	/* FORM chunk. */
 	psf_binheader_writef (psf, "Etm8", FORM_MARKER, psf->filelength - 8) ;
+	psf->hpatch.riff_size = 4 ;
 
 	/* COMM chunk. */
 	if ((k = psf_find_read_chunk_m32 (&psf->rchunks, COMM_MARKER)) >= 0)
@@ -1196,6 +1218,33 @@ aiff_rewrite_header (SF_PRIVATE *psf)
 	return ;
 } /* aiff_rewrite_header */
 
+static void
+aiff_calc_length (SF_PRIVATE *psf)
+{
+	psf->filelength = psf_get_filelen (psf) ;
+
+	psf->datalength = psf->filelength - psf->dataoffset ;
+	if (psf->dataend)
+		psf->datalength -= psf->filelength - psf->dataend ;
+
+	if (psf->bytewidth > 0)
+		psf->sf.frames = psf->datalength / (psf->bytewidth * psf->sf.channels) ;
+} /* aiff_calc_length */
+
+/* The COMM chunk frame count, which is a block count for IMA ADPCM. */
+static uint32_t
+aiff_comm_frames (const SF_PRIVATE *psf)
+{
+	/* Unknown when streaming to a pipe. */
+	if (psf->is_pipe)
+		return 0xFFFFFFFF ;
+
+	if (SF_CODEC (psf->sf.format) == SF_FORMAT_IMA_ADPCM)
+		return psf->sf.frames / AIFC_IMA4_SAMPLES_PER_BLOCK ;
+
+	return (psf->sf.frames > 0xFFFFFFFF) ? 0xFFFFFFFF : psf->sf.frames ;
+} /* aiff_comm_frames */
+
 static int
 aiff_write_header (SF_PRIVATE *psf, int calc_length)
 {	sf_count_t		current ;
@@ -1208,21 +1257,22 @@ aiff_write_header (SF_PRIVATE *psf, int calc_length)
 	if ((paiff = psf->container_data) == NULL)
 		return SFE_INTERNAL ;
 
+	/*
+	** A pipe only gets the header written at open, with the sizes marked as
+	** unknown. It can't be rewritten once anything has gone down the pipe.
+	*/
+	if (psf->is_pipe && psf->pipeoffset > 0)
+		return 0 ;
+
 	current = psf_ftell (psf) ;
 
 	if (current > psf->dataoffset)
 		has_data = SF_TRUE ;
 
 	if (calc_length)
-	{	psf->filelength = psf_get_filelen (psf) ;
+		aiff_calc_length (psf) ;
 
-		psf->datalength = psf->filelength - psf->dataoffset ;
-		if (psf->dataend)
-			psf->datalength -= psf->filelength - psf->dataend ;
-
-		if (psf->bytewidth > 0)
-			psf->sf.frames = psf->datalength / (psf->bytewidth * psf->sf.channels) ;
-		} ;
+	psf_patch_header_reset (psf) ;
 
 	if (psf->file.mode == SFM_RDWR && psf->dataoffset > 0 && psf->rchunks.count > 0)
 	{	aiff_rewrite_header (psf) ;
@@ -1237,7 +1287,7 @@ aiff_write_header (SF_PRIVATE *psf, int calc_length)
 
 	/* Standard value here. */
 	bit_width = psf->bytewidth * 8 ;
-	comm_frames = (psf->sf.frames > 0xFFFFFFFF) ? 0xFFFFFFFF : psf->sf.frames ;
+	comm_frames = aiff_comm_frames (psf) ;
 
 	switch (SF_CODEC (psf->sf.format) | endian)
 	{	case SF_FORMAT_PCM_S8 | SF_ENDIAN_BIG :
@@ -1389,7 +1439,6 @@ aiff_write_header (SF_PRIVATE *psf, int calc_length)
 
 				/* Override standard value here.*/
 				bit_width = 16 ;
-				comm_frames = psf->sf.frames / AIFC_IMA4_SAMPLES_PER_BLOCK ;
 				break ;
 
 		default : return SFE_BAD_OPEN_FORMAT ;
@@ -1400,26 +1449,38 @@ aiff_write_header (SF_PRIVATE *psf, int calc_length)
 	psf->header.indx = 0 ;
 	psf_fseek (psf, 0, SEEK_SET) ;
 
-	psf_binheader_writef (psf, "Etm8", FORM_MARKER, psf->filelength - 8) ;
+	psf->rwf_endian = SF_ENDIAN_BIG ;
+	psf_header_put_marker (psf, FORM_MARKER) ;
+	psf_header_put_32 (psf, psf->is_pipe ? 0xFFFFFFFF : psf->filelength - 8) ;
+	psf->hpatch.riff_size = 4 ;
 
 	/* Write AIFF/AIFC marker and COM chunk. */
+	psf_header_put_marker (psf, comm_type) ;
 	if (comm_type == AIFC_MARKER)
-		/* AIFC must have an FVER chunk. */
-		psf_binheader_writef (psf, "Emm44", comm_type, FVER_MARKER, 4, 0xA2805140) ;
-	else
-		psf_binheader_writef (psf, "Em", comm_type) ;
+	{	/* AIFC must have an FVER chunk. */
+		psf_header_put_marker (psf, FVER_MARKER) ;
+		psf_header_put_32 (psf, 4) ;
+		psf_header_put_32 (psf, 0xA2805140) ;
+		} ;
 
 	paiff->comm_offset = psf->header.indx - 8 ;
 
 	memset (comm_sample_rate, 0, sizeof (comm_sample_rate)) ;
 	uint2tenbytefloat (psf->sf.samplerate, comm_sample_rate) ;
 
-	psf_binheader_writef (psf, "Em42t42", COMM_MARKER, comm_size, psf->sf.channels, comm_frames, bit_width) ;
-	psf_binheader_writef (psf, "b", comm_sample_rate, sizeof (comm_sample_rate)) ;
+	psf_header_put_marker (psf, COMM_MARKER) ;
+	psf_header_put_32 (psf, comm_size) ;
+	psf_header_put_16 (psf, psf->sf.channels) ;
+	psf_header_put_32 (psf, comm_frames) ;
+	psf_header_put_16 (psf, bit_width) ;
+	psf->hpatch.frames = psf->header.indx - 6 ;
+	psf_header_put_bytes (psf, comm_sample_rate, sizeof (comm_sample_rate)) ;
 
 	/* AIFC chunks have some extra data. */
 	if (comm_type == AIFC_MARKER)
-		psf_binheader_writef (psf, "mb", comm_encoding, comm_zero_bytes, sizeof (comm_zero_bytes)) ;
+	{	psf_header_put_marker (psf, comm_encoding) ;
+		psf_header_put_bytes (psf, comm_zero_bytes, sizeof (comm_zero_bytes)) ;
+		} ;
 
 	if (psf->channel_map && paiff->chanmap_tag)
 		psf_binheader_writef (psf, "Em4444", CHAN_MARKER, 12, paiff->chanmap_tag, 0, 0) ;
@@ -1455,6 +1516,7 @@ aiff_write_header (SF_PRIVATE *psf, int calc_length)
 	if (psf->peak_info != NULL && psf->peak_info->peak_loc == SF_PEAK_START)
 	{	psf_binheader_writef (psf, "Em4", PEAK_MARKER, AIFF_PEAK_CHUNK_SIZE (psf->sf.channels)) ;
 		psf_binheader_writef (psf, "E44", 1, time (NULL)) ;
+		psf->hpatch.peak = psf->header.indx ;
 		for (k = 0 ; k < psf->sf.channels ; k++)
 			psf_binheader_writef (psf, "Eft8", (float) psf->peak_info->peaks [k].value, psf->peak_info->peaks [k].position) ;
 		} ;
@@ -1465,7 +1527,11 @@ aiff_write_header (SF_PRIVATE *psf, int calc_length)
 
 	/* Write SSND chunk. */
 	paiff->ssnd_offset = psf->header.indx ;
-	psf_binheader_writef (psf, "Etm844", SSND_MARKER, psf->datalength + SIZEOF_SSND_CHUNK, 0, 0) ;
+	psf_header_put_marker (psf, SSND_MARKER) ;
+	psf_header_put_32 (psf, psf->is_pipe ? 0xFFFFFFFF : psf->datalength + SIZEOF_SSND_CHUNK) ;
+	psf_header_put_32 (psf, 0) ;
+	psf_header_put_32 (psf, 0) ;
+	psf->hpatch.data_size = paiff->ssnd_offset + 4 ;
 
 	/* Header construction complete so write it out. */
 	psf_fwrite (psf->header.ptr, psf->header.indx, 1, psf) ;
@@ -1477,6 +1543,7 @@ aiff_write_header (SF_PRIVATE *psf, int calc_length)
 		return psf->error = SFE_INTERNAL ;
 
 	psf->dataoffset = psf->header.indx ;
+	psf_patch_header_save (psf) ;
 
 	if (! has_data)
 		psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
@@ -1486,6 +1553,26 @@ aiff_write_header (SF_PRIVATE *psf, int calc_length)
 	return psf->error ;
 } /* aiff_write_header */
 
+static int
+aiff_update_header (SF_PRIVATE *psf)
+{
+	if (psf->is_pipe)
+		return 0 ;
+
+	if (psf->hpatch.dataoffset == 0 || psf->hpatch.dataoffset != psf->dataoffset)
+		return aiff_write_header (psf, SF_TRUE) ;
+
+	aiff_calc_length (psf) ;
+
+	/* The AIFF header is always big endian. */
+	psf_patch_header_int (psf, psf->hpatch.riff_size, 4, SF_ENDIAN_BIG, psf->filelength - 8) ;
+	psf_patch_header_int (psf, psf->hpatch.frames, 4, SF_ENDIAN_BIG, aiff_comm_frames (psf)) ;
+	psf_patch_header_peaks (psf, psf->hpatch.peak, 4, SF_ENDIAN_BIG) ;
+	psf_patch_header_int (psf, psf->hpatch.data_size, 4, SF_ENDIAN_BIG, psf->datalength + SIZEOF_SSND_CHUNK) ;
+
+	return psf_patch_header_flush (psf) ;
+} /* aiff_update_header */
+
 static int
 aiff_write_tailer (SF_PRIVATE *psf)
 {	int		k ;
@@ -1523,6 +1610,9 @@ static void
 aiff_write_strings (SF_PRIVATE *psf, int location)
 {	int	k, slen ;
 
+	if (psf->strings.data == NULL)
+		return ;
+
 	for (k = 0 ; k < SF_MAX_STRINGS ; k++)
 	{	if (psf->strings.data [k].type == 0)
 			break ;
@@ -22,7 +22,6 @@
 #include	<stdlib.h>
 #include	<string.h>
 #include	<math.h>
-#include	<errno.h>
 
 #include	"sndfile.h"
 #include	"sfendian.h"
@@ -34,8 +33,17 @@
 #define		ALAC_BYTE_BUFFER_SIZE	0x20000
 #define		ALAC_MAX_CHANNEL_COUNT	8	// Same as kALACMaxChannels in /ALACAudioTypes.h
 
+/* Same as the encoder's mMaxOutputBytes, no valid packet is bigger than this. */
+#define		ALAC_MAX_PACKET_BYTES(frames, channels)	((frames) * (channels) * ((10 + 32) / 8) + 1)
+
 typedef struct
 {	uint32_t	current, count, allocated ;
+
+	/*	Byte offset of each packet from the start of the data, ie a running
+	**	sum of packet_size []. Only built for reading (count + 1 entries).
+	*/
+	sf_count_t	*block_offset ;
+
 	uint32_t	packet_size [] ;
 } PAKT_INFO ;
 
@@ -58,11 +66,19 @@ typedef struct
 		ALAC_ENCODER encoder ;
 	} ;
 
-	char enctmpname [512] ;
-	FILE *enctmp ;
-
+	/*	When reading, byte_buffer holds byte_buffer_len bytes of consecutive
+	**	packets read from file offset byte_buffer_pos. When writing, it holds
+	**	byte_buffer_len bytes of encoded packets not yet written to the file.
+	*/
+	sf_count_t	byte_buffer_pos ;
+	uint32_t	byte_buffer_len ;
 	uint8_t	byte_buffer [ALAC_MAX_CHANNEL_COUNT * ALAC_BYTE_BUFFER_SIZE] ;
 
+	/*	Only set up when more than one thread was asked for. Each slot has its
+	**	own decoder or encoder.
+	*/
+	PSF_PIPE	*pipe ;
+
 	int	buffer	[] ;
 
 } ALAC_PRIVATE ;
@@ -89,15 +105,23 @@ static sf_count_t	alac_seek	(SF_PRIVATE *psf, int mode, sf_count_t offset) ;
 
 static int	alac_close		(SF_PRIVATE *psf) ;
 static int	alac_byterate	(SF_PRIVATE *psf) ;
+static int	alac_command	(SF_PRIVATE *psf, int command, void *data, int datasize) ;
+static int	alac_flush		(SF_PRIVATE *psf) ;
 
 static int alac_decode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac) ;
-static int alac_encode_block (ALAC_PRIVATE *plac) ;
+static int alac_encode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac) ;
+static uint8_t * alac_reader_load_packet (SF_PRIVATE *psf, ALAC_PRIVATE *plac, uint32_t packet_size) ;
+static int alac_writer_flush (SF_PRIVATE *psf, ALAC_PRIVATE *plac) ;
 
-static uint32_t alac_kuki_read (SF_PRIVATE * psf, uint32_t kuki_offset, uint8_t * kuki, size_t kuki_maxlen) ;
+static int alac_pipe_create (SF_PRIVATE *psf, ALAC_PRIVATE *plac, int threads) ;
+static void alac_pipe_destroy (ALAC_PRIVATE *plac) ;
+
+static uint32_t alac_kuki_read (SF_PRIVATE * psf, sf_count_t kuki_offset, uint8_t * kuki, size_t kuki_maxlen) ;
 
 static PAKT_INFO * alac_pakt_alloc (uint32_t initial_count) ;
-static PAKT_INFO * alac_pakt_read_decode (SF_PRIVATE * psf, uint32_t pakt_offset) ;
+static PAKT_INFO * alac_pakt_read_decode (SF_PRIVATE * psf, sf_count_t pakt_offset) ;
 static PAKT_INFO * alac_pakt_append (PAKT_INFO * info, uint32_t value) ;
+static void alac_pakt_free (PAKT_INFO * info) ;
 static uint8_t * alac_pakt_encode (const SF_PRIVATE *psf, uint32_t * pakt_size) ;
 static sf_count_t alac_pakt_block_offset (const PAKT_INFO *info, uint32_t block) ;
 
@@ -136,6 +160,7 @@ alac_init (SF_PRIVATE *psf, const ALAC_DECODER_INFO * info)
 		} ;
 
 	psf->byterate = alac_byterate ;
+	psf->codec_command = alac_command ;
 
 	return 0 ;
 } /* aiff_alac_init */
@@ -164,33 +189,44 @@ alac_get_desc_chunk_items (int subformat, uint32_t *fmt_flags, uint32_t *frames_
 static int
 alac_close	(SF_PRIVATE *psf)
 {	ALAC_PRIVATE *plac ;
-	BUF_UNION	ubuf ;
 
 	plac = psf->codec_data ;
 
 	if (psf->file.mode == SFM_WRITE)
 	{	ALAC_ENCODER *penc = &plac->encoder ;
 		SF_CHUNK_INFO chunk_info ;
-		sf_count_t readcount ;
 		uint8_t kuki_data [1024] ;
-		uint32_t pakt_size = 0, saved_partial_block_frames ;
+		uint32_t k, pakt_size = 0, saved_partial_block_frames ;
+
+		/*	Chunks may have been added since the header was last written if
+		**	no audio was written, so make sure the data starts after them.
+		*/
+		if (psf->have_written == SF_FALSE && psf->write_header != NULL)
+			psf->write_header (psf, SF_FALSE) ;
 
 		plac->final_write_block = 1 ;
 		saved_partial_block_frames = plac->partial_block_frames ;
 
 		/*	If a block has been partially assembled, write it out as the final block. */
 		if (plac->partial_block_frames && plac->partial_block_frames < plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
+
+		alac_flush (psf) ;
+		alac_pipe_destroy (plac) ;
 
 		plac->partial_block_frames = saved_partial_block_frames ;
 
+		/*	The encoded packets have been written straight after the header so
+		**	all that remains is to fill in the placeholder 'kuki' chunk that was
+		**	added at init time and to add the 'pakt' chunk. The container will
+		**	put the 'pakt' chunk after the audio data.
+		*/
 		alac_get_magic_cookie (penc, kuki_data, &plac->kuki_size) ;
 
-		memset (&chunk_info, 0, sizeof (chunk_info)) ;
-		chunk_info.id_size = snprintf (chunk_info.id, sizeof (chunk_info.id), "kuki") ;
-		chunk_info.data = kuki_data ;
-		chunk_info.datalen = plac->kuki_size ;
-		psf_save_write_chunk (&psf->wchunks, &chunk_info) ;
+		for (k = 0 ; k < psf->wchunks.used ; k++)
+			if (psf->wchunks.chunks [k].mark32 == MAKE_MARKER ('k', 'u', 'k', 'i')
+					&& psf->wchunks.chunks [k].len >= plac->kuki_size)
+				memcpy (psf->wchunks.chunks [k].data, kuki_data, plac->kuki_size) ;
 
 		memset (&chunk_info, 0, sizeof (chunk_info)) ;
 		chunk_info.id_size = snprintf (chunk_info.id, sizeof (chunk_info.id), "pakt") ;
@@ -200,21 +236,11 @@ alac_close	(SF_PRIVATE *psf)
 
 		free (chunk_info.data) ;
 		chunk_info.data = NULL ;
-
-		psf->write_header (psf, 1) ;
-
-		if (plac->enctmp != NULL)
-		{	fseek (plac->enctmp, 0, SEEK_SET) ;
-
-			while ((readcount = fread (ubuf.ucbuf, 1, sizeof (ubuf.ucbuf), plac->enctmp)) > 0)
-				psf_fwrite (ubuf.ucbuf, 1, readcount, psf) ;
-			fclose (plac->enctmp) ;
-			remove (plac->enctmpname) ;
-			} ;
 		} ;
 
-	if (plac->pakt_info)
-		free (plac->pakt_info) ;
+	alac_pipe_destroy (plac) ;
+
+	alac_pakt_free (plac->pakt_info) ;
 	plac->pakt_info = NULL ;
 
 	return 0 ;
@@ -229,6 +255,62 @@ alac_byterate	(SF_PRIVATE *psf)
 	return -1 ;
 } /* alac_byterate */
 
+static int
+alac_command (SF_PRIVATE *psf, int command, void *data, int UNUSED (datasize))
+{	ALAC_PRIVATE *plac ;
+	int threads ;
+
+	if ((plac = psf->codec_data) == NULL)
+		return SF_FALSE ;
+
+	switch (command)
+	{	case SFC_SET_ENCODER_THREADS :
+			if (psf->file.mode != SFM_WRITE || psf->have_written)
+				return SF_FALSE ;
+			break ;
+
+		case SFC_SET_DECODER_THREADS :
+			if (psf->file.mode != SFM_READ)
+				return SF_FALSE ;
+			break ;
+
+		default :
+			return SF_FALSE ;
+		} ;
+
+	threads = *((int *) data) ;
+	if (threads < 1 || threads > PSF_MAX_WORKERS)
+		return SF_FALSE ;
+
+	psf_log_printf (psf, "%s : Setting %s to %d.\n", __func__,
+			command == SFC_SET_ENCODER_THREADS ? "SFC_SET_ENCODER_THREADS" : "SFC_SET_DECODER_THREADS", threads) ;
+
+	alac_pipe_destroy (plac) ;
+
+	if (threads == 1)
+		return SF_TRUE ;
+
+	return alac_pipe_create (psf, plac, threads) ;
+} /* alac_command */
+
+/* Write out the encoded packets held in the pipe and in byte_buffer. */
+static int
+alac_flush (SF_PRIVATE *psf)
+{	ALAC_PRIVATE *plac ;
+	int result = 1 ;
+
+	if ((plac = psf->codec_data) == NULL || psf->file.mode != SFM_WRITE)
+		return 0 ;
+
+	if (plac->pipe != NULL)
+		result = psf_pipe_write_flush (plac->pipe) ;
+
+	if (alac_writer_flush (psf, plac) == 0)
+		result = 0 ;
+
+	return result ? 0 : SFE_INTERNAL ;
+} /* alac_flush */
+
 /*============================================================================================
 ** ALAC initialisation Functions.
 */
@@ -256,8 +338,7 @@ alac_reader_init (SF_PRIVATE *psf, const ALAC_DECODER_INFO * info)
 	plac->frames_per_block	= info->frames_per_packet ;
 	plac->bits_per_sample	= info->bits_per_sample ;
 
-	if (plac->pakt_info != NULL)
-		free (plac->pakt_info) ;
+	alac_pakt_free (plac->pakt_info) ;
 	plac->pakt_info = alac_pakt_read_decode (psf, info->pakt_offset) ;
 
 	if (plac->pakt_info == NULL)
@@ -307,7 +388,10 @@ alac_reader_init (SF_PRIVATE *psf, const ALAC_DECODER_INFO * info)
 static int
 alac_writer_init (SF_PRIVATE *psf)
 {	ALAC_PRIVATE	*plac ;
+	SF_CHUNK_INFO	chunk_info ;
+	uint8_t			kuki_data [1024] ;
 	uint32_t		alac_format_flags = 0 ;
+	int				error ;
 
 	plac = psf->codec_data ;
 
@@ -352,14 +436,27 @@ alac_writer_init (SF_PRIVATE *psf)
 
 	plac->pakt_info = alac_pakt_alloc (2000) ;
 
-	if ((plac->enctmp = psf_open_tmpfile (plac->enctmpname, sizeof (plac->enctmpname))) == NULL)
-	{	psf_log_printf (psf, "Error : Failed to open temp file '%s' : \n", plac->enctmpname, strerror (errno)) ;
-		return SFE_ALAC_FAIL_TMPFILE ;
-		} ;
-
 	alac_encoder_init (&plac->encoder, psf->sf.samplerate, psf->sf.channels, alac_format_flags, ALAC_FRAME_LENGTH) ;
 
-	return 0 ;
+	/*	The magic cookie isn't final until encoding is finished, but its size
+	**	is known now. Reserve space for it in the header so that the encoded
+	**	packets can be written directly to the file.
+	*/
+	memset (&chunk_info, 0, sizeof (chunk_info)) ;
+	chunk_info.id_size = snprintf (chunk_info.id, sizeof (chunk_info.id), "kuki") ;
+	chunk_info.data = kuki_data ;
+	chunk_info.datalen = plac->kuki_size ;
+	memset (kuki_data, 0, sizeof (kuki_data)) ;
+
+	if ((error = psf_save_write_chunk (&psf->wchunks, &chunk_info)) != 0)
+		return error ;
+
+	if (psf->write_header == NULL)
+		return SFE_INTERNAL ;
+
+	psf->codec_flush = alac_flush ;
+
+	return psf->write_header (psf, SF_FALSE) ;
 } /* alac_writer_init */
 
 /*============================================================================================
@@ -404,8 +501,23 @@ static int
 alac_decode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
 {	ALAC_DECODER *pdec = &plac->decoder ;
 	uint32_t	packet_size ;
+	uint8_t		*packet_data ;
 	BitBuffer	bit_buffer ;
 
+	if (plac->pipe != NULL)
+	{	PSF_PIPE_SLOT *slot ;
+
+		if ((slot = psf_pipe_read_block (plac->pipe, plac->pakt_info->current)) == NULL)
+			return 0 ;
+
+		plac->pakt_info->current ++ ;
+		plac->input_data_pos += slot->in_len ;
+		plac->frames_this_block = slot->out_len ;
+		memcpy (plac->buffer, slot->out, slot->out_len * plac->channels * sizeof (int)) ;
+		plac->partial_block_frames = 0 ;
+		return 1 ;
+		} ;
+
 	packet_size = alac_reader_next_packet_size (plac->pakt_info) ;
 	if (packet_size == 0)
 	{	if (plac->pakt_info->current < plac->pakt_info->count)
@@ -413,17 +525,15 @@ alac_decode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
 		return 0 ;
 		} ;
 
-	psf_fseek (psf, plac->input_data_pos, SEEK_SET) ;
-
 	if (packet_size > sizeof (plac->byte_buffer))
 	{	psf_log_printf (psf, "%s : bad packet_size (%u)\n", __func__, packet_size) ;
 		return 0 ;
 		} ;
 
-	if ((packet_size != psf_fread (plac->byte_buffer, 1, packet_size, psf)))
+	if ((packet_data = alac_reader_load_packet (psf, plac, packet_size)) == NULL)
 		return 0 ;
 
-	BitBufferInit (&bit_buffer, plac->byte_buffer, packet_size) ;
+	BitBufferInit (&bit_buffer, packet_data, packet_size) ;
 
 	plac->input_data_pos += packet_size ;
 	plac->frames_this_block = 0 ;
@@ -434,16 +544,69 @@ alac_decode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
 	return 1 ;
 } /* alac_decode_block */
 
+static uint8_t *
+alac_reader_load_packet (SF_PRIVATE *psf, ALAC_PRIVATE *plac, uint32_t packet_size)
+{	PAKT_INFO	*info = plac->pakt_info ;
+	sf_count_t	buffer_end = plac->byte_buffer_pos + plac->byte_buffer_len ;
+	uint32_t	k, readlen = packet_size ;
+
+	/* Packet already in the buffer? */
+	if (plac->input_data_pos >= plac->byte_buffer_pos && plac->input_data_pos + packet_size <= buffer_end)
+		return plac->byte_buffer + (plac->input_data_pos - plac->byte_buffer_pos) ;
+
+	/*
+	**	When reading sequentially, pull in as many whole packets as will fit
+	**	in a single read. After a seek, only read the one packet so that
+	**	random access doesn't pay for data it may never use.
+	*/
+	if (plac->input_data_pos == buffer_end && info->block_offset != NULL)
+	{	for (k = info->current ; k < info->count ; k++)
+		{	if (info->block_offset [k + 1] - info->block_offset [info->current - 1] > SIGNED_SIZEOF (plac->byte_buffer))
+				break ;
+			readlen = info->block_offset [k + 1] - info->block_offset [info->current - 1] ;
+			} ;
+		} ;
+
+	if (psf_fseek (psf, plac->input_data_pos, SEEK_SET) != plac->input_data_pos)
+		return NULL ;
+
+	plac->byte_buffer_pos = plac->input_data_pos ;
+	plac->byte_buffer_len = psf_fread (plac->byte_buffer, 1, readlen, psf) ;
+
+	if (plac->byte_buffer_len < packet_size)
+		return NULL ;
+
+	return plac->byte_buffer ;
+} /* alac_reader_load_packet */
+
 
 static int
-alac_encode_block (ALAC_PRIVATE *plac)
+alac_encode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
 {	ALAC_ENCODER *penc = &plac->encoder ;
 	uint32_t num_bytes = 0 ;
 
-	alac_encode (penc, plac->partial_block_frames, plac->buffer, plac->byte_buffer, &num_bytes) ;
+	if (plac->pipe != NULL)
+	{	PSF_PIPE_SLOT *slot ;
 
-	if (fwrite (plac->byte_buffer, 1, num_bytes, plac->enctmp) != num_bytes)
+		if ((slot = psf_pipe_write_slot (plac->pipe)) == NULL)
+			return 0 ;
+
+		memcpy (slot->in, plac->buffer, plac->partial_block_frames * plac->channels * sizeof (int)) ;
+		slot->in_len = plac->partial_block_frames ;
+		psf_pipe_write_submit (plac->pipe, slot) ;
+
+		plac->partial_block_frames = 0 ;
+		return 1 ;
+		} ;
+
+	/* Encoded packets are collected in byte_buffer and written out together. */
+	if (plac->byte_buffer_len + penc->mMaxOutputBytes > sizeof (plac->byte_buffer) && alac_writer_flush (psf, plac) == 0)
 		return 0 ;
+
+	alac_encode (penc, plac->partial_block_frames, plac->buffer, plac->byte_buffer + plac->byte_buffer_len, &num_bytes) ;
+
+	plac->byte_buffer_len += num_bytes ;
+
 	if ((plac->pakt_info = alac_pakt_append (plac->pakt_info, num_bytes)) == NULL)
 		return 0 ;
 
@@ -452,6 +615,145 @@ alac_encode_block (ALAC_PRIVATE *plac)
 	return 1 ;
 } /* alac_encode_block */
 
+static int
+alac_writer_flush (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
+{	uint32_t len = plac->byte_buffer_len ;
+
+	plac->byte_buffer_len = 0 ;
+
+	if (len > 0 && psf_fwrite (plac->byte_buffer, 1, len, psf) != len)
+		return 0 ;
+
+	return 1 ;
+} /* alac_writer_flush */
+
+/*============================================================================================
+** Decoding and encoding packets on worker threads.
+**
+** Packets can be decoded in any order because each one carries its own
+** predictor coefficients. The encoder adapts its coefficients from one packet
+** to the next, so each slot's encoder adapts over every n-th packet only. The
+** output is valid ALAC which depends on the number of threads, and may not be
+** byte for byte the same as a single threaded encode.
+*/
+
+static int
+alac_pipe_load (PSF_PIPE *pipe, PSF_PIPE_SLOT *slot, sf_count_t block)
+{	SF_PRIVATE		*psf = pipe->psf ;
+	ALAC_PRIVATE	*plac = pipe->codec ;
+	PAKT_INFO		*info = plac->pakt_info ;
+	sf_count_t		offset ;
+	uint32_t		packet_size ;
+
+	if (block >= info->count || (packet_size = info->packet_size [block]) == 0)
+		return 0 ;
+
+	if (packet_size > ALAC_MAX_PACKET_BYTES (plac->frames_per_block, plac->channels))
+	{	psf_log_printf (psf, "%s : bad packet_size (%u)\n", __func__, packet_size) ;
+		return 0 ;
+		} ;
+
+	offset = psf->dataoffset + alac_pakt_block_offset (info, block) ;
+
+	if (psf_fseek (psf, offset, SEEK_SET) != offset || psf_fread (slot->in, 1, packet_size, psf) != packet_size)
+		return 0 ;
+
+	slot->in_len = packet_size ;
+
+	return 1 ;
+} /* alac_pipe_load */
+
+static void
+alac_pipe_decode (PSF_PIPE_SLOT *slot)
+{	ALAC_PRIVATE	*plac = slot->pipe->codec ;
+	BitBuffer		bit_buffer ;
+	uint32_t		frames = 0 ;
+
+	BitBufferInit (&bit_buffer, slot->in, slot->in_len) ;
+	alac_decode (slot->state, &bit_buffer, slot->out, plac->frames_per_block, &frames) ;
+
+	slot->out_len = frames ;
+} /* alac_pipe_decode */
+
+static void
+alac_pipe_encode (PSF_PIPE_SLOT *slot)
+{	uint32_t num_bytes = 0 ;
+
+	alac_encode (slot->state, slot->in_len, slot->in, slot->out, &num_bytes) ;
+
+	slot->out_len = num_bytes ;
+} /* alac_pipe_encode */
+
+static int
+alac_pipe_emit (PSF_PIPE *pipe, PSF_PIPE_SLOT *slot)
+{	ALAC_PRIVATE *plac = pipe->codec ;
+
+	if (plac->byte_buffer_len + slot->out_len > sizeof (plac->byte_buffer) && alac_writer_flush (pipe->psf, plac) == 0)
+		return 0 ;
+
+	memcpy (plac->byte_buffer + plac->byte_buffer_len, slot->out, slot->out_len) ;
+	plac->byte_buffer_len += slot->out_len ;
+
+	if ((plac->pakt_info = alac_pakt_append (plac->pakt_info, slot->out_len)) == NULL)
+		return 0 ;
+
+	return 1 ;
+} /* alac_pipe_emit */
+
+static int
+alac_pipe_create (SF_PRIVATE *psf, ALAC_PRIVATE *plac, int threads)
+{	int k, frame_bytes = plac->frames_per_block * plac->channels * sizeof (int) ;
+
+	if (psf->file.mode == SFM_WRITE)
+		plac->pipe = psf_pipe_create (psf, threads, frame_bytes, plac->encoder.mMaxOutputBytes, sizeof (ALAC_ENCODER)) ;
+	else
+		plac->pipe = psf_pipe_create (psf, threads, ALAC_MAX_PACKET_BYTES (plac->frames_per_block, plac->channels),
+							frame_bytes, sizeof (ALAC_DECODER)) ;
+
+	if (plac->pipe == NULL)
+		return SF_FALSE ;
+
+	plac->pipe->codec = plac ;
+
+	for (k = 0 ; k < plac->pipe->count ; k++)
+	{	if (psf->file.mode == SFM_WRITE)
+			memcpy (plac->pipe->slots [k].state, &plac->encoder, sizeof (ALAC_ENCODER)) ;
+		else
+			memcpy (plac->pipe->slots [k].state, &plac->decoder, sizeof (ALAC_DECODER)) ;
+		} ;
+
+	if (psf->file.mode == SFM_WRITE)
+	{	plac->pipe->process = alac_pipe_encode ;
+		plac->pipe->emit = alac_pipe_emit ;
+		}
+	else
+	{	plac->pipe->process = alac_pipe_decode ;
+		plac->pipe->load = alac_pipe_load ;
+		} ;
+
+	return SF_TRUE ;
+} /* alac_pipe_create */
+
+static void
+alac_pipe_destroy (ALAC_PRIVATE *plac)
+{	ALAC_ENCODER *penc ;
+	int k ;
+
+	if (plac->pipe == NULL)
+		return ;
+
+	/* The magic cookie holds the size of the largest packet from any of the encoders. */
+	if (plac->pipe->emit != NULL)
+		for (k = 0 ; k < plac->pipe->count ; k++)
+		{	penc = plac->pipe->slots [k].state ;
+			plac->encoder.mMaxFrameBytes = SF_MAX (plac->encoder.mMaxFrameBytes, penc->mMaxFrameBytes) ;
+			plac->encoder.mTotalBytesGenerated += penc->mTotalBytesGenerated ;
+			} ;
+
+	psf_pipe_destroy (plac->pipe) ;
+	plac->pipe = NULL ;
+} /* alac_pipe_destroy */
+
 /*============================================================================================
 ** ALAC read functions.
 */
@@ -661,7 +963,7 @@ alac_write_s (SF_PRIVATE *psf, const short *ptr, sf_count_t len)
 		ptr += writecount ;
 
 		if (plac->partial_block_frames >= plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
 		} ;
 
 	return total ;
@@ -692,7 +994,7 @@ alac_write_i (SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 		ptr += writecount ;
 
 		if (plac->partial_block_frames >= plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
 		} ;
 
 	return total ;
@@ -725,7 +1027,7 @@ alac_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 		ptr += writecount ;
 
 		if (plac->partial_block_frames >= plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
 		} ;
 
 	return total ;
@@ -758,7 +1060,7 @@ alac_write_d (SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 		ptr += writecount ;
 
 		if (plac->partial_block_frames >= plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
 		} ;
 
 	return total ;
@@ -800,41 +1102,49 @@ alac_pakt_append (PAKT_INFO * info, uint32_t value)
 	return info ;
 } /* alac_pakt_append */
 
+static void
+alac_pakt_free (PAKT_INFO * info)
+{
+	if (info == NULL)
+		return ;
+
+	free (info->block_offset) ;
+	free (info) ;
+} /* alac_pakt_free */
+
 static PAKT_INFO *
-alac_pakt_read_decode (SF_PRIVATE * psf, uint32_t UNUSED (pakt_offset))
-{	SF_CHUNK_INFO chunk_info ;
-	PAKT_INFO * info = NULL ;
+alac_pakt_read_decode (SF_PRIVATE * psf, sf_count_t pakt_offset)
+{	PAKT_INFO * info = NULL ;
 	uint8_t *pakt_data = NULL ;
-	uint32_t bcount, value = 1, pakt_size ;
-	SF_CHUNK_ITERATOR * chunk_iterator ;
-
+	uint32_t bcount, value = 1, pakt_size, marker ;
+	uint64_t chunk_size ;
 
-	memset (&chunk_info, 0, sizeof (chunk_info)) ;
-	snprintf (chunk_info.id, sizeof (chunk_info.id), "pakt") ;
-	chunk_info.id_size = 4 ;
+	/* Read the chunk straight from the file, sf_probe () has no chunk table. */
+	if (psf_fseek (psf, pakt_offset, SEEK_SET) != pakt_offset)
+		return NULL ;
 
-	if ((chunk_iterator = psf_get_chunk_iterator (psf, chunk_info.id)) == NULL)
-	{	psf_log_printf (psf, "%s : no chunk iterator found\n", __func__) ;
-		free (chunk_info.data) ;
-		chunk_info.data = NULL ;
+	psf_fread (&marker, 1, sizeof (marker), psf) ;
+	if (marker != MAKE_MARKER ('p', 'a', 'k', 't'))
+	{	psf_log_printf (psf, "%s : no 'pakt' chunk found\n", __func__) ;
 		return NULL ;
 		} ;
 
-	psf->get_chunk_size (psf, chunk_iterator, &chunk_info) ;
-
-	pakt_size = chunk_info.datalen ;
-	chunk_info.data = pakt_data = malloc (pakt_size + 5) ;
+	psf_fread (&chunk_size, 1, sizeof (chunk_size), psf) ;
+	chunk_size = BE2H_64 (chunk_size) ;
 
-	if ((bcount = psf->get_chunk_data (psf, chunk_iterator, &chunk_info)) != SF_ERR_NO_ERROR)
-	{	while (chunk_iterator)
-			chunk_iterator = psf->next_chunk_iterator (psf, chunk_iterator) ;
-		free (chunk_info.data) ;
-		chunk_info.data = NULL ;
+	if (chunk_size < 24 || chunk_size > (uint64_t) psf->filelength)
+	{	psf_log_printf (psf, "%s : Bad size (%D) of 'pakt' chunk.\n", __func__, chunk_size) ;
 		return NULL ;
 		} ;
 
-	while (chunk_iterator)
-		chunk_iterator = psf->next_chunk_iterator (psf, chunk_iterator) ;
+	pakt_size = chunk_size ;
+	if ((pakt_data = malloc (pakt_size + 5)) == NULL)
+		return NULL ;
+
+	if (psf_fread (pakt_data, 1, pakt_size, psf) != pakt_size)
+	{	free (pakt_data) ;
+		return NULL ;
+		} ;
 
 	info = alac_pakt_alloc (pakt_size / 4) ;
 
@@ -864,12 +1174,21 @@ alac_pakt_read_decode (SF_PRIVATE * psf, uint32_t UNUSED (pakt_offset))
 		} ;
 
 	free (pakt_data) ;
+	pakt_data = NULL ;
+
+	/* Build the table of packet offsets so that seeking doesn't need to walk the packet sizes. */
+	if ((info->block_offset = malloc ((info->count + 1) * sizeof (info->block_offset [0]))) == NULL)
+		goto FreeExit ;
+
+	info->block_offset [0] = 0 ;
+	for (bcount = 0 ; bcount < info->count ; bcount++)
+		info->block_offset [bcount + 1] = info->block_offset [bcount] + info->packet_size [bcount] ;
 
 	return info ;
 
 FreeExit :
 	free (pakt_data) ;
-	free (info) ;
+	alac_pakt_free (info) ;
 	return NULL ;
 } /* alac_pakt_read_decode */
 
@@ -934,17 +1253,15 @@ alac_pakt_encode (const SF_PRIVATE *psf, uint32_t * pakt_size_out)
 
 static sf_count_t
 alac_pakt_block_offset (const PAKT_INFO *info, uint32_t block)
-{	sf_count_t offset = 0 ;
-	uint32_t k ;
-
-	for (k = 0 ; k < block ; k++)
-		offset += info->packet_size [k] ;
+{
+	if (block > info->count)
+		block = info->count ;
 
-	return offset ;
+	return info->block_offset [block] ;
 } /* alac_pakt_block_offset */
 
 static uint32_t
-alac_kuki_read (SF_PRIVATE * psf, uint32_t kuki_offset, uint8_t * kuki, size_t kuki_maxlen)
+alac_kuki_read (SF_PRIVATE * psf, sf_count_t kuki_offset, uint8_t * kuki, size_t kuki_maxlen)
 {	uint32_t marker ;
 	uint64_t kuki_size ;
 
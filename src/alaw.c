@@ -47,6 +47,15 @@ static void d2alaw_array (const double *buffer, int count, unsigned char *ptr, d
 int
 alaw_init (SF_PRIVATE *psf)
 {
+	psf->bytewidth = 1 ;
+	psf->blockwidth = psf->sf.channels ;
+
+	/* sf_probe () only needs the frame count. */
+	if (psf->probe)
+	{	psf_set_fixed_frames (psf) ;
+		return 0 ;
+		} ;
+
 	if (psf->file.mode == SFM_READ || psf->file.mode == SFM_RDWR)
 	{	psf->read_short		= alaw_read_alaw2s ;
 		psf->read_int		= alaw_read_alaw2i ;
@@ -61,15 +70,7 @@ alaw_init (SF_PRIVATE *psf)
 		psf->write_double	= alaw_write_d2alaw ;
 		} ;
 
-	psf->bytewidth = 1 ;
-	psf->blockwidth = psf->sf.channels ;
-
-	if (psf->filelength > psf->dataoffset)
-		psf->datalength = (psf->dataend) ? psf->dataend - psf->dataoffset : psf->filelength - psf->dataoffset ;
-	else
-		psf->datalength = 0 ;
-
-	psf->sf.frames = psf->blockwidth > 0 ? psf->datalength / psf->blockwidth : 0 ;
+	psf_set_fixed_frames (psf) ;
 
 	return 0 ;
 } /* alaw_init */
@@ -239,16 +239,19 @@ au_write_header (SF_PRIVATE *psf, int calc_length)
 		datalength = (int) (psf->datalength & 0x7FFFFFFF) ;
 
 	if (psf->endian == SF_ENDIAN_BIG)
-	{	psf_binheader_writef (psf, "Em4", DOTSND_MARKER, AU_DATA_OFFSET) ;
-		psf_binheader_writef (psf, "E4444", datalength, encoding, psf->sf.samplerate, psf->sf.channels) ;
-		}
+		psf_header_put_marker (psf, DOTSND_MARKER) ;
 	else if (psf->endian == SF_ENDIAN_LITTLE)
-	{	psf_binheader_writef (psf, "em4", DNSDOT_MARKER, AU_DATA_OFFSET) ;
-		psf_binheader_writef (psf, "e4444", datalength, encoding, psf->sf.samplerate, psf->sf.channels) ;
-		}
+		psf_header_put_marker (psf, DNSDOT_MARKER) ;
 	else
 		return (psf->error = SFE_BAD_OPEN_FORMAT) ;
 
+	psf->rwf_endian = psf->endian ;
+	psf_header_put_32 (psf, AU_DATA_OFFSET) ;
+	psf_header_put_32 (psf, datalength) ;
+	psf_header_put_32 (psf, encoding) ;
+	psf_header_put_32 (psf, psf->sf.samplerate) ;
+	psf_header_put_32 (psf, psf->sf.channels) ;
+
 	/* Header construction complete so write it out. */
 	psf_fwrite (psf->header.ptr, psf->header.indx, 1, psf) ;
 
@@ -293,23 +296,25 @@ au_read_header (SF_PRIVATE *psf)
 	int		marker, dword ;
 
 	memset (&au_fmt, 0, sizeof (au_fmt)) ;
-	psf_binheader_readf (psf, "pm", 0, &marker) ;
+	psf_binheader_readf (psf, "p", 0) ;
+	psf_header_prefetch (psf, 24) ;
+	marker = psf_header_get_marker (psf) ;
 	psf_log_printf (psf, "%M\n", marker) ;
 
 	if (marker == DOTSND_MARKER)
-	{	psf->endian = SF_ENDIAN_BIG ;
-
-		psf_binheader_readf (psf, "E44444", &(au_fmt.dataoffset), &(au_fmt.datasize),
-					&(au_fmt.encoding), &(au_fmt.samplerate), &(au_fmt.channels)) ;
-		}
+		psf->endian = SF_ENDIAN_BIG ;
 	else if (marker == DNSDOT_MARKER)
-	{	psf->endian = SF_ENDIAN_LITTLE ;
-		psf_binheader_readf (psf, "e44444", &(au_fmt.dataoffset), &(au_fmt.datasize),
-					&(au_fmt.encoding), &(au_fmt.samplerate), &(au_fmt.channels)) ;
-		}
+		psf->endian = SF_ENDIAN_LITTLE ;
 	else
 		return SFE_AU_NO_DOTSND ;
 
+	psf->rwf_endian = psf->endian ;
+	au_fmt.dataoffset = psf_header_get_32 (psf) ;
+	au_fmt.datasize = psf_header_get_32 (psf) ;
+	au_fmt.encoding = psf_header_get_32 (psf) ;
+	au_fmt.samplerate = psf_header_get_32 (psf) ;
+	au_fmt.channels = psf_header_get_32 (psf) ;
+
 	psf_log_printf (psf, "  Data Offset : %d\n", au_fmt.dataoffset) ;
 
 	if (psf->fileoffset > 0 && au_fmt.datasize == -1)
@@ -62,7 +62,7 @@ audio_detect (SF_PRIVATE * psf, AUDIO_DETECT *ad, const unsigned char * data, in
 			"    be_int_24_32 : %d\n",
 			vote.le_float, vote.be_float, vote.le_int_24_32, vote.be_int_24_32) ;
 
-	if (0) puts (psf->parselog.buf) ;
+	if (0) puts (psf_log_buffer (psf)) ;
 
 	if (ad->endianness == SF_ENDIAN_LITTLE && vote.le_float > (3 * datalen) / 4)
 	{	/* Almost certainly 32 bit floats. */
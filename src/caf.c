@@ -97,6 +97,7 @@ typedef struct
 static int	caf_close (SF_PRIVATE *psf) ;
 static int	caf_read_header (SF_PRIVATE *psf) ;
 static int	caf_write_header (SF_PRIVATE *psf, int calc_length) ;
+static int	caf_update_header (SF_PRIVATE *psf) ;
 static int	caf_write_tailer (SF_PRIVATE *psf) ;
 static int	caf_command (SF_PRIVATE *psf, int command, void *data, int datasize) ;
 static int	caf_read_chanmap (SF_PRIVATE * psf, sf_count_t chunk_size) ;
@@ -135,7 +136,8 @@ caf_open (SF_PRIVATE *psf)
 	subformat = SF_CODEC (psf->sf.format) ;
 
 	if (psf->file.mode == SFM_WRITE || psf->file.mode == SFM_RDWR)
-	{	if (psf->is_pipe)
+	{	/* Only fixed width codecs can be streamed, the rest need a rewind. */
+		if (psf->is_pipe && (psf->file.mode == SFM_RDWR || psf->bytewidth == 0))
 			return SFE_NO_PIPE_WRITE ;
 
 		format = SF_CONTAINER (psf->sf.format) ;
@@ -156,8 +158,9 @@ caf_open (SF_PRIVATE *psf)
 		/*
 		**	By default, add the peak chunk to floating point files. Default behaviour
 		**	can be switched off using sf_command (SFC_SET_PEAK_CHUNK, SF_FALSE).
+		**	The peaks aren't known until the end, which a pipe never gets back to.
 		*/
-		if (psf->file.mode == SFM_WRITE && (subformat == SF_FORMAT_FLOAT || subformat == SF_FORMAT_DOUBLE))
+		if (psf->file.mode == SFM_WRITE && psf->is_pipe == SF_FALSE && (subformat == SF_FORMAT_FLOAT || subformat == SF_FORMAT_DOUBLE))
 		{	if ((psf->peak_info = peak_info_calloc (psf->sf.channels)) == NULL)
 				return SFE_MALLOC_FAILED ;
 			psf->peak_info->peak_loc = SF_PEAK_START ;
@@ -167,6 +170,7 @@ caf_open (SF_PRIVATE *psf)
 			return error ;
 
 		psf->write_header	= caf_write_header ;
+		psf->update_header	= caf_update_header ;
 		psf->set_chunk		= caf_set_chunk ;
 		} ;
 
@@ -221,6 +225,10 @@ caf_open (SF_PRIVATE *psf)
 static int
 caf_close (SF_PRIVATE *psf)
 {
+	/* Nothing can be appended or patched when streaming to a pipe. */
+	if (psf->file.mode == SFM_WRITE && psf->is_pipe)
+		return 0 ;
+
 	if (psf->file.mode == SFM_WRITE || psf->file.mode == SFM_RDWR)
 	{	caf_write_tailer (psf) ;
 		caf_write_header (psf, SF_TRUE) ;
@@ -342,6 +350,7 @@ caf_read_header (SF_PRIVATE *psf)
 {	CAF_PRIVATE	*pcaf ;
 	BUF_UNION	ubuf ;
 	DESC_CHUNK desc ;
+	unsigned char *ptr ;
 	sf_count_t chunk_size ;
 	double srate ;
 	short version, flags ;
@@ -353,12 +362,20 @@ caf_read_header (SF_PRIVATE *psf)
 	memset (&desc, 0, sizeof (desc)) ;
 
 	/* Set position to start of file to begin reading header. */
-	psf_binheader_readf (psf, "pmE2E2", 0, &marker, &version, &flags) ;
+	psf_binheader_readf (psf, "p", 0) ;
+	psf->rwf_endian = SF_ENDIAN_BIG ;
+	psf_header_prefetch (psf, 8 + 12 + SIGNED_SIZEOF (DESC_CHUNK)) ;
+	marker = psf_header_get_marker (psf) ;
+	version = psf_header_get_16 (psf) ;
+	flags = psf_header_get_16 (psf) ;
 	psf_log_printf (psf, "%M\n  Version : %d\n  Flags   : %x\n", marker, version, flags) ;
 	if (marker != caff_MARKER)
 		return SFE_CAF_NOT_CAF ;
 
-	psf_binheader_readf (psf, "mE8b", &marker, &chunk_size, ubuf.ucbuf, 8) ;
+	marker = psf_header_get_marker (psf) ;
+	chunk_size = psf_header_get_64 (psf) ;
+	if ((ptr = psf_header_get (psf, 8)) != NULL)
+		memcpy (ubuf.ucbuf, ptr, 8) ;
 	srate = double64_be_read (ubuf.ucbuf) ;
 	snprintf (ubuf.cbuf, sizeof (ubuf.cbuf), "%5.3f", srate) ;
 	psf_log_printf (psf, "%M : %D\n  Sample rate  : %s\n", marker, chunk_size, ubuf.cbuf) ;
@@ -372,8 +389,12 @@ caf_read_header (SF_PRIVATE *psf)
 
 	psf->sf.samplerate = lrint (srate) ;
 
-	psf_binheader_readf (psf, "mE44444", &desc.fmt_id, &desc.fmt_flags, &desc.pkt_bytes, &desc.frames_per_packet,
-			&desc.channels_per_frame, &desc.bits_per_chan) ;
+	desc.fmt_id = psf_header_get_marker (psf) ;
+	desc.fmt_flags = psf_header_get_32 (psf) ;
+	desc.pkt_bytes = psf_header_get_32 (psf) ;
+	desc.frames_per_packet = psf_header_get_32 (psf) ;
+	desc.channels_per_frame = psf_header_get_32 (psf) ;
+	desc.bits_per_chan = psf_header_get_32 (psf) ;
 	psf_log_printf (psf, "  Format id    : %M\n  Format flags : %x\n  Bytes / packet   : %u\n"
 			"  Frames / packet  : %u\n  Channels / frame : %u\n  Bits / channel   : %u\n",
 			desc.fmt_id, desc.fmt_flags, desc.pkt_bytes, desc.frames_per_packet, desc.channels_per_frame, desc.bits_per_chan) ;
@@ -392,13 +413,17 @@ caf_read_header (SF_PRIVATE *psf)
 	{	marker = 0 ;
 		chunk_size = 0 ;
 
-		psf_binheader_readf (psf, "mE8", &marker, &chunk_size) ;
+		psf->rwf_endian = SF_ENDIAN_BIG ;
+		psf_header_prefetch (psf, 12) ;
+		marker = psf_header_get_marker (psf) ;
+		chunk_size = psf_header_get_64 (psf) ;
 		if (marker == 0)
 		{	sf_count_t pos = psf_ftell (psf) ;
 			psf_log_printf (psf, "Have 0 marker at position %D (0x%x).\n", pos, pos) ;
 			break ;
 			} ;
-		if (chunk_size < 0)
+		/* Only the data chunk may use -1, meaning its length is unknown. */
+		if (chunk_size < 0 && (marker != data_MARKER || chunk_size != -1))
 		{	psf_log_printf (psf, "%M : %D *** Should be >= 0 ***\n", marker, chunk_size) ;
 			break ;
 			} ;
@@ -460,8 +485,10 @@ caf_read_header (SF_PRIVATE *psf)
 			case data_MARKER :
 				psf_binheader_readf (psf, "E4", &k) ;
 				if (chunk_size == -1)
-				{	psf_log_printf (psf, "%M : -1\n") ;
+				{	/* Length unknown when written, the data runs to the end of the file. */
+					psf_log_printf (psf, "%M : -1\n", marker) ;
 					chunk_size = psf->filelength - psf->header.indx ;
+					psf->datalength = chunk_size ;
 					}
 				else if (psf->filelength > 0 && chunk_size > psf->filelength - psf->header.indx + 10)
 				{	psf_log_printf (psf, "%M : %D (should be %D)\n", marker, chunk_size, psf->filelength - psf->header.indx - 8) ;
@@ -479,7 +506,9 @@ caf_read_header (SF_PRIVATE *psf)
 				if (psf->datalength + psf->dataoffset < psf->filelength)
 					psf->dataend = psf->datalength + psf->dataoffset ;
 
-				psf_binheader_readf (psf, "j", make_size_t (psf->datalength)) ;
+				/* On a pipe there is no skipping the audio to look for more chunks. */
+				if (psf->sf.seekable)
+					psf_binheader_readf (psf, "j", make_size_t (psf->datalength)) ;
 				have_data = 1 ;
 				break ;
 
@@ -501,6 +530,7 @@ caf_read_header (SF_PRIVATE *psf)
 				else
 					psf_log_printf (psf, "%M : %D\n", marker, chunk_size) ;
 
+				pcaf->alac.pakt_offset = psf_ftell (psf) - 12 ;
 				psf_binheader_readf (psf, "E8844", &pcaf->alac.packets, &pcaf->alac.valid_frames,
 									&pcaf->alac.priming_frames, &pcaf->alac.remainder_frames) ;
 
@@ -517,7 +547,6 @@ caf_read_header (SF_PRIVATE *psf)
 							&& pcaf->alac.priming_frames == 0 && pcaf->alac.remainder_frames == 0)
 					psf_log_printf (psf, "*** 'pakt' chunk header is all zero.\n") ;
 
-				pcaf->alac.pakt_offset = psf_ftell (psf) - 12 ;
 				psf_binheader_readf (psf, "j", make_size_t (chunk_size) - 24) ;
 				break ;
 
@@ -574,6 +603,20 @@ caf_read_header (SF_PRIVATE *psf)
 /*------------------------------------------------------------------------------
 */
 
+static void
+caf_calc_length (SF_PRIVATE *psf)
+{
+	psf->filelength = psf_get_filelen (psf) ;
+
+	psf->datalength = psf->filelength - psf->dataoffset ;
+
+	if (psf->dataend)
+		psf->datalength -= psf->filelength - psf->dataend ;
+
+	if (psf->bytewidth > 0)
+		psf->sf.frames = psf->datalength / (psf->bytewidth * psf->sf.channels) ;
+} /* caf_calc_length */
+
 static int
 caf_write_header (SF_PRIVATE *psf, int calc_length)
 {	BUF_UNION	ubuf ;
@@ -586,35 +629,39 @@ caf_write_header (SF_PRIVATE *psf, int calc_length)
 	if ((pcaf = psf->container_data) == NULL)
 		return SFE_INTERNAL ;
 
+	/*
+	** A pipe only gets the header written at open, with the data size set to
+	** -1 which the spec reserves for an unknown length. It can't be rewritten
+	** once anything has gone down the pipe.
+	*/
+	if (psf->is_pipe && psf->pipeoffset > 0)
+		return 0 ;
+
 	memset (&desc, 0, sizeof (desc)) ;
 
 	current = psf_ftell (psf) ;
 
 	if (calc_length)
-	{	psf->filelength = psf_get_filelen (psf) ;
-
-		psf->datalength = psf->filelength - psf->dataoffset ;
-
-		if (psf->dataend)
-			psf->datalength -= psf->filelength - psf->dataend ;
-
-		if (psf->bytewidth > 0)
-			psf->sf.frames = psf->datalength / (psf->bytewidth * psf->sf.channels) ;
-		} ;
+		caf_calc_length (psf) ;
 
 	/* Reset the current header length to zero. */
 	psf->header.ptr [0] = 0 ;
 	psf->header.indx = 0 ;
 	psf_fseek (psf, 0, SEEK_SET) ;
+	psf_patch_header_reset (psf) ;
 
 	/* 'caff' marker, version and flags. */
-	psf_binheader_writef (psf, "Em22", caff_MARKER, 1, 0) ;
+	psf->rwf_endian = SF_ENDIAN_BIG ;
+	psf_header_put_marker (psf, caff_MARKER) ;
+	psf_header_put_16 (psf, 1) ;
+	psf_header_put_16 (psf, 0) ;
 
 	/* 'desc' marker and chunk size. */
-	psf_binheader_writef (psf, "Em8", desc_MARKER, (sf_count_t) (sizeof (DESC_CHUNK))) ;
+	psf_header_put_marker (psf, desc_MARKER) ;
+	psf_header_put_64 (psf, sizeof (DESC_CHUNK)) ;
 
  	double64_be_write (1.0 * psf->sf.samplerate, ubuf.ucbuf) ;
-	psf_binheader_writef (psf, "b", ubuf.ucbuf, make_size_t (8)) ;
+	psf_header_put_bytes (psf, ubuf.ucbuf, 8) ;
 
 	subformat = SF_CODEC (psf->sf.format) ;
 
@@ -721,13 +768,19 @@ caf_write_header (SF_PRIVATE *psf, int calc_length)
 			return SFE_UNIMPLEMENTED ;
 		} ;
 
-	psf_binheader_writef (psf, "mE44444", desc.fmt_id, desc.fmt_flags, desc.pkt_bytes, desc.frames_per_packet, desc.channels_per_frame, desc.bits_per_chan) ;
+	psf_header_put_marker (psf, desc.fmt_id) ;
+	psf_header_put_32 (psf, desc.fmt_flags) ;
+	psf_header_put_32 (psf, desc.pkt_bytes) ;
+	psf_header_put_32 (psf, desc.frames_per_packet) ;
+	psf_header_put_32 (psf, desc.channels_per_frame) ;
+	psf_header_put_32 (psf, desc.bits_per_chan) ;
 
 	caf_write_strings (psf, SF_STR_LOCATE_START) ;
 
 	if (psf->peak_info != NULL)
 	{	int k ;
 		psf_binheader_writef (psf, "Em84", peak_MARKER, (sf_count_t) CAF_PEAK_CHUNK_SIZE (psf->sf.channels), psf->peak_info->edit_number) ;
+		psf->hpatch.peak = psf->header.indx ;
 		for (k = 0 ; k < psf->sf.channels ; k++)
 			psf_binheader_writef (psf, "Ef8", (float) psf->peak_info->peaks [k].value, psf->peak_info->peaks [k].position) ;
 		} ;
@@ -735,25 +788,33 @@ caf_write_header (SF_PRIVATE *psf, int calc_length)
 	if (psf->channel_map && pcaf->chanmap_tag)
 		psf_binheader_writef (psf, "Em8444", chan_MARKER, (sf_count_t) 12, pcaf->chanmap_tag, 0, 0) ;
 
-	/* Write custom headers. */
+	/* Write custom headers. The 'pakt' chunk is only complete at close so it goes after the data. */
 	for (uk = 0 ; uk < psf->wchunks.used ; uk++)
-		psf_binheader_writef (psf, "m44b", (int) psf->wchunks.chunks [uk].mark32, 0, psf->wchunks.chunks [uk].len, psf->wchunks.chunks [uk].data, make_size_t (psf->wchunks.chunks [uk].len)) ;
+		if (psf->wchunks.chunks [uk].mark32 != pakt_MARKER)
+			psf_binheader_writef (psf, "m44b", (int) psf->wchunks.chunks [uk].mark32, 0, psf->wchunks.chunks [uk].len, psf->wchunks.chunks [uk].data, make_size_t (psf->wchunks.chunks [uk].len)) ;
 
 	if (append_free_block)
 	{	/* Add free chunk so that the actual audio data starts at a multiple 0x1000. */
 		sf_count_t free_len = 0x1000 - psf->header.indx - 16 - 12 ;
 		while (free_len < 0)
 			free_len += 0x1000 ;
-		psf_binheader_writef (psf, "Em8z", free_MARKER, free_len, make_size_t (free_len)) ;
+		psf_header_put_marker (psf, free_MARKER) ;
+		psf_header_put_64 (psf, free_len) ;
+		psf_header_put_zeros (psf, (int) free_len) ;
 		} ;
 
-	psf_binheader_writef (psf, "Em84", data_MARKER, psf->datalength + 4, 0) ;
+	psf->rwf_endian = SF_ENDIAN_BIG ;
+	psf_header_put_marker (psf, data_MARKER) ;
+	psf_header_put_64 (psf, psf->is_pipe ? -1 : psf->datalength + 4) ;
+	psf_header_put_32 (psf, 0) ;
+	psf->hpatch.data_size = psf->header.indx - 12 ;
 
 	psf_fwrite (psf->header.ptr, psf->header.indx, 1, psf) ;
 	if (psf->error)
 		return psf->error ;
 
 	psf->dataoffset = psf->header.indx ;
+	psf_patch_header_save (psf) ;
 	if (current < psf->dataoffset)
 		psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
 	else if (current > 0)
@@ -763,8 +824,27 @@ caf_write_header (SF_PRIVATE *psf, int calc_length)
 } /* caf_write_header */
 
 static int
-caf_write_tailer (SF_PRIVATE *psf)
+caf_update_header (SF_PRIVATE *psf)
 {
+	if (psf->is_pipe)
+		return 0 ;
+
+	if (psf->hpatch.dataoffset == 0 || psf->hpatch.dataoffset != psf->dataoffset)
+		return caf_write_header (psf, SF_TRUE) ;
+
+	caf_calc_length (psf) ;
+
+	/* The CAF header is always big endian. */
+	psf_patch_header_peaks (psf, psf->hpatch.peak, 8, SF_ENDIAN_BIG) ;
+	psf_patch_header_int (psf, psf->hpatch.data_size, 8, SF_ENDIAN_BIG, psf->datalength + 4) ;
+
+	return psf_patch_header_flush (psf) ;
+} /* caf_update_header */
+
+static int
+caf_write_tailer (SF_PRIVATE *psf)
+{	uint32_t uk ;
+
 	/* Reset the current header buffer length to zero. */
 	psf->header.ptr [0] = 0 ;
 	psf->header.indx = 0 ;
@@ -779,6 +859,10 @@ caf_write_tailer (SF_PRIVATE *psf)
 	else
 		psf->dataend = psf_fseek (psf, 0, SEEK_END) ;
 
+	for (uk = 0 ; uk < psf->wchunks.used ; uk++)
+		if (psf->wchunks.chunks [uk].mark32 == pakt_MARKER)
+			psf_binheader_writef (psf, "m44b", (int) psf->wchunks.chunks [uk].mark32, 0, psf->wchunks.chunks [uk].len, psf->wchunks.chunks [uk].data, make_size_t (psf->wchunks.chunks [uk].len)) ;
+
 	if (psf->dataend & 1)
 		psf_binheader_writef (psf, "z", 1) ;
 
@@ -930,6 +1014,9 @@ caf_write_strings (SF_PRIVATE * psf, int location)
  	const char * cptr ;
 	uint32_t k, string_count = 0 ;
 
+	if (psf->strings.data == NULL)
+		return ;
+
 	memset (&buf, 0, sizeof (buf)) ;
 
 	for (k = 0 ; k < SF_MAX_STRINGS ; k++)
@@ -89,16 +89,21 @@ psf_next_chunk_iterator (const READ_CHUNKS * pchk , SF_CHUNK_ITERATOR * iterator
 {	uint64_t hash = iterator->hash ;
 	uint32_t k ;
 
-	iterator->current++ ;
-
-	if (hash)
-	{	for (k = iterator->current ; k < pchk->used ; k++)
+	if (hash && iterator->current < pchk->used && pchk->chunks [iterator->current].hash == hash)
+	{	/* Follow the chain of chunks with the same hash. */
+		if ((k = pchk->chunks [iterator->current].next) > 0)
+		{	iterator->current = k ;
+			return iterator ;
+			} ;
+		}
+	else if (hash)
+	{	for (k = iterator->current + 1 ; k < pchk->used ; k++)
 			if (pchk->chunks [k].hash == hash)
 			{	iterator->current = k ;
 				return iterator ;
 				}
 		}
-	else if (iterator->current < pchk->used)
+	else if (++ iterator->current < pchk->used)
 		return iterator ;
 
 	/* No match, clear iterator and return NULL */
@@ -106,18 +111,83 @@ psf_next_chunk_iterator (const READ_CHUNKS * pchk , SF_CHUNK_ITERATOR * iterator
 	return NULL ;
 } /* psf_next_chunk_iterator */
 
+/*
+**	The read chunks are kept in file order in pchk->chunks, with an open
+**	addressing hash index on top so that looking up a chunk by its marker does
+**	not need a linear scan. Chunks sharing a hash are linked through their next
+**	field, in file order, so iterating over them is also linear in the number
+**	of matches rather than the number of chunks.
+*/
+
+static inline uint32_t
+read_chunk_slot (uint64_t hash, uint32_t index_len)
+{	hash ^= hash >> 32 ;
+	hash *= UINT64_C (0x9E3779B97F4A7C15) ;
+
+	return (uint32_t) (hash >> 32) & (index_len - 1) ;
+} /* read_chunk_slot */
+
+static READ_CHUNK_SLOT *
+read_chunk_lookup (const READ_CHUNKS * pchk, uint64_t hash)
+{	uint32_t k ;
+
+	if (pchk->index_len == 0)
+		return NULL ;
+
+	for (k = read_chunk_slot (hash, pchk->index_len) ; pchk->index [k].first > 0 ; k = (k + 1) & (pchk->index_len - 1))
+		if (pchk->chunks [pchk->index [k].first - 1].hash == hash)
+			break ;
+
+	return pchk->index + k ;
+} /* read_chunk_lookup */
+
+static int
+read_chunk_grow_index (READ_CHUNKS * pchk)
+{	READ_CHUNKS	old = *pchk ;
+	READ_CHUNK_SLOT	*slot ;
+	uint32_t k ;
+
+	pchk->index_len = old.index_len > 0 ? 2 * old.index_len : 64 ;
+	if ((pchk->index = calloc (pchk->index_len, sizeof (READ_CHUNK_SLOT))) == NULL)
+	{	pchk->index = old.index ;
+		pchk->index_len = old.index_len ;
+		return SFE_MALLOC_FAILED ;
+		} ;
+
+	for (k = 0 ; k < old.index_len ; k++)
+	{	if (old.index [k].first == 0)
+			continue ;
+		slot = read_chunk_lookup (pchk, pchk->chunks [old.index [k].first - 1].hash) ;
+		*slot = old.index [k] ;
+		} ;
+
+	free (old.index) ;
+
+	return SFE_NO_ERROR ;
+} /* read_chunk_grow_index */
+
 static int
 psf_store_read_chunk (READ_CHUNKS * pchk, const READ_CHUNK * rchunk)
-{	if (pchk->count == 0)
+{	READ_CHUNK_SLOT *slot ;
+	int error ;
+
+	if (pchk->no_store)
+		return 0 ;
+
+	if (pchk->count == 0)
 	{	pchk->used = 0 ;
 		pchk->count = 20 ;
 		pchk->chunks = calloc (pchk->count, sizeof (READ_CHUNK)) ;
+		if (pchk->chunks == NULL)
+		{	pchk->count = 0 ;
+			return SFE_MALLOC_FAILED ;
+			} ;
 		}
 	else if (pchk->used > pchk->count)
 		return SFE_INTERNAL ;
 	else if (pchk->used == pchk->count)
 	{	READ_CHUNK * old_ptr = pchk->chunks ;
-		int new_count = 3 * (pchk->count + 1) / 2 ;
+		uint32_t new_count = 2 * pchk->count ;
 
 		pchk->chunks = realloc (old_ptr, new_count * sizeof (READ_CHUNK)) ;
 		if (pchk->chunks == NULL)
@@ -127,7 +197,24 @@ psf_store_read_chunk (READ_CHUNKS * pchk, const READ_CHUNK * rchunk)
 		pchk->count = new_count ;
 		} ;
 
+	/* Keep the index at most half full. */
+	if (2 * (pchk->index_used + 1) > pchk->index_len && (error = read_chunk_grow_index (pchk)) != 0)
+		return error ;
+
 	pchk->chunks [pchk->used] = *rchunk ;
+	pchk->chunks [pchk->used].next = 0 ;
+
+	slot = read_chunk_lookup (pchk, rchunk->hash) ;
+	if (slot->first == 0)
+	{	slot->first = pchk->used + 1 ;
+		pchk->index_used ++ ;
+		}
+	else
+		pchk->chunks [slot->last - 1].next = pchk->used ;
+	slot->last = pchk->used + 1 ;
+
+	if (rchunk->hash != rchunk->mark32)
+		pchk->long_ids ++ ;
 
 	pchk->used ++ ;
 
@@ -153,8 +240,8 @@ psf_store_read_chunk_u32 (READ_CHUNKS * pchk, uint32_t marker, sf_count_t offset
 
 int
 psf_find_read_chunk_str (const READ_CHUNKS * pchk, const char * marker_str)
-{	uint64_t hash ;
-	uint32_t k ;
+{	const READ_CHUNK_SLOT *slot ;
+	uint64_t hash ;
 	union
 	{	uint32_t marker ;
 		char str [5] ;
@@ -164,16 +251,23 @@ psf_find_read_chunk_str (const READ_CHUNKS * pchk, const char * marker_str)
 
 	hash = strlen (marker_str) > 4 ? hash_of_str (marker_str) : u.marker ;
 
-	for (k = 0 ; k < pchk->used ; k++)
-		if (pchk->chunks [k].hash == hash)
-			return k ;
+	if ((slot = read_chunk_lookup (pchk, hash)) == NULL || slot->first == 0)
+		return -1 ;
 
-	return -1 ;
+	return slot->first - 1 ;
 } /* psf_find_read_chunk_str */
 
 int
 psf_find_read_chunk_m32 (const READ_CHUNKS * pchk, uint32_t marker)
-{	uint32_t k ;
+{	const READ_CHUNK_SLOT *slot ;
+	uint32_t k ;
+
+	/* Chunks with long ids match on the first four characters only. */
+	if (pchk->long_ids == 0)
+	{	if ((slot = read_chunk_lookup (pchk, marker)) == NULL || slot->first == 0)
+			return -1 ;
+		return slot->first - 1 ;
+		} ;
 
 	for (k = 0 ; k < pchk->used ; k++)
 		if (pchk->chunks [k].mark32 == marker)
@@ -181,6 +275,7 @@ psf_find_read_chunk_m32 (const READ_CHUNKS * pchk, uint32_t marker)
 
 	return -1 ;
 } /* psf_find_read_chunk_m32 */
+
 int
 psf_find_read_chunk_iterator (const READ_CHUNKS * pchk, const SF_CHUNK_ITERATOR * marker)
 {	if (marker->current < pchk->used)
@@ -236,6 +331,7 @@ psf_save_write_chunk (WRITE_CHUNKS * pchk, const SF_CHUNK_INFO * chunk_info)
 		{	pchk->chunks = old_ptr ;
 			return SFE_MALLOC_FAILED ;
 			} ;
+		pchk->count = new_count ;
 		} ;
 
 	len = chunk_info->datalen ;
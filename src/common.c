@@ -37,6 +37,12 @@
 
 #define	INITAL_HEADER_SIZE	256
 
+/*
+**	Upper limit on the cached header. Files with thousands of chunks ahead of
+**	the audio data (eg. one chunk per marker) need a few hundred kilobytes.
+*/
+#define	MAX_HEADER_SIZE		(1 << 20)
+
 /* Allocate and initialize the SF_PRIVATE struct. */
 SF_PRIVATE *
 psf_allocate (void)
@@ -54,7 +60,37 @@ psf_allocate (void)
 	return psf ;
 } /* psf_allocate */
 
-static int
+int
+psf_alloc_file_names (PSF_FILE *pfile)
+{	struct
+	{	PSF_PATH	path, dir ;
+		PSF_NAME	name ;
+	} *names ;
+
+	if (pfile->path != NULL)
+		return 0 ;
+
+	if ((names = calloc (1, sizeof (*names))) == NULL)
+		return SFE_MALLOC_FAILED ;
+
+	pfile->path = &names->path ;
+	pfile->dir = &names->dir ;
+	pfile->name = &names->name ;
+
+	return 0 ;
+} /* psf_alloc_file_names */
+
+void
+psf_free_file_names (PSF_FILE *pfile)
+{	/* The path is at the start of the block holding all three. */
+	free (pfile->path) ;
+
+	pfile->path = NULL ;
+	pfile->dir = NULL ;
+	pfile->name = NULL ;
+} /* psf_free_file_names */
+
+int
 psf_bump_header_allocation (SF_PRIVATE * psf, sf_count_t needed)
 {
 	sf_count_t newlen, smallest = INITAL_HEADER_SIZE ;
@@ -62,12 +98,22 @@ psf_bump_header_allocation (SF_PRIVATE * psf, sf_count_t needed)
 
 	newlen = (needed > psf->header.len) ? 2 * SF_MAX (needed, smallest) : 2 * psf->header.len ;
 
-	if (newlen > 100 * 1024)
+	if (newlen > MAX_HEADER_SIZE)
 	{	psf_log_printf (psf, "Request for header allocation of %D denied.\n", newlen) ;
 		return 1 ;
 		}
 
-	if ((ptr = realloc (psf->header.ptr, newlen)) == NULL)
+	if (psf->header.on_stack)
+	{	/* Can't realloc () the sf_probe () buffer, so move the header to the heap. */
+		if ((ptr = malloc (newlen)) != NULL)
+		{	memcpy (ptr, psf->header.ptr, psf->header.len) ;
+			psf->header.on_stack = SF_FALSE ;
+			} ;
+		}
+	else
+		ptr = realloc (psf->header.ptr, newlen) ;
+
+	if (ptr == NULL)
 	{	psf_log_printf (psf, "realloc (%p, %D) failed\n", psf->header.ptr, newlen) ;
 		psf->error = SFE_MALLOC_FAILED ;
 		return 1 ;
@@ -86,14 +132,34 @@ psf_bump_header_allocation (SF_PRIVATE * psf, sf_count_t needed)
 ** psf_log_printf allows libsndfile internal functions to print to an internal parselog which
 ** can later be displayed.
 ** The format specifiers are as for printf but without the field width and other modifiers.
-** Printing is performed to the parselog char array of the SF_PRIVATE struct.
+** Printing is performed to the parselog buffer of the SF_PRIVATE struct.
 ** Printing is done in such a way as to guarantee that the log never overflows the end of the
-** parselog array.
+** parselog buffer, which is grown as needed up to SF_PARSELOG_LEN bytes.
 */
 
+static void
+log_grow (SF_PRIVATE *psf)
+{	int		newlen ;
+	char	*ptr ;
+
+	if (psf->parselog.len >= SF_PARSELOG_LEN)
+		return ;
+
+	newlen = (psf->parselog.len > 0) ? SF_MIN (2 * psf->parselog.len, SF_PARSELOG_LEN) : SF_PARSELOG_LEN / 8 ;
+
+	if ((ptr = realloc (psf->parselog.buf, newlen)) == NULL)
+		return ;
+
+	psf->parselog.buf = ptr ;
+	psf->parselog.len = newlen ;
+} /* log_grow */
+
 static inline void
 log_putchar (SF_PRIVATE *psf, char ch)
-{	if (psf->parselog.indx < SIGNED_SIZEOF (psf->parselog.buf) - 1)
+{	if (psf->parselog.indx >= psf->parselog.len - 1)
+		log_grow (psf) ;
+
+	if (psf->parselog.indx < psf->parselog.len - 1)
 	{	psf->parselog.buf [psf->parselog.indx++] = ch ;
 		psf->parselog.buf [psf->parselog.indx] = 0 ;
 		} ;
@@ -107,6 +173,9 @@ psf_log_printf (SF_PRIVATE *psf, const char *format, ...)
 	int			d, tens, shift, width, width_specifier, left_align, slen ;
 	char		c, *strptr, istr [5], lead_char, sign_char ;
 
+	if (psf->fast_open)
+		return ;
+
 	va_start (ap, format) ;
 
 	while ((c = *format++))
@@ -690,9 +759,10 @@ psf_binheader_writef (SF_PRIVATE *psf, const char *format, ...)
 						header_put_be_int (psf, size) ;
 					else
 						header_put_le_int (psf, size) ;
-					memcpy (&(psf->header.ptr [psf->header.indx]), strptr, size) ;
+					/* Don't read the pad byte from strptr, it may lie beyond the end of the buffer. */
+					memset (&(psf->header.ptr [psf->header.indx]), 0, size) ;
+					memcpy (&(psf->header.ptr [psf->header.indx]), strptr, strlen (strptr)) ;
 					psf->header.indx += size ;
-					psf->header.ptr [psf->header.indx - 1] = 0 ;
 					count += 4 + size ;
 					break ;
 
@@ -796,6 +866,120 @@ psf_binheader_writef (SF_PRIVATE *psf, const char *format, ...)
 	return count ;
 } /* psf_binheader_writef */
 
+/*-----------------------------------------------------------------------------------------------
+**  Patch single fields of an already written header in place, at offsets recorded in
+**  psf->hpatch. Nothing is rebuilt; the fields are changed in a copy of the header and
+**  psf_patch_header_flush () writes the changed span back without moving the file position.
+*/
+
+void
+psf_patch_header_reset (SF_PRIVATE *psf)
+{
+	psf->hpatch.dataoffset = 0 ;
+	psf->hpatch.riff_size = psf->hpatch.data_size = 0 ;
+	psf->hpatch.frames = psf->hpatch.peak = 0 ;
+	psf->hpatch.layout = 0 ;
+	psf->hpatch.image_len = 0 ;
+	psf->hpatch.dirty_start = psf->hpatch.dirty_end = 0 ;
+} /* psf_patch_header_reset */
+
+void
+psf_patch_header_save (SF_PRIVATE *psf)
+{	unsigned char *image ;
+
+	psf->hpatch.dataoffset = psf->dataoffset ;
+	psf->hpatch.image_len = 0 ;
+	psf->hpatch.dirty_start = psf->hpatch.dirty_end = 0 ;
+
+	if (psf->header.indx > psf->hpatch.image_alloc)
+	{	/* Without a copy, each field is written on its own. */
+		if ((image = realloc (psf->hpatch.image, psf->header.indx)) == NULL)
+			return ;
+		psf->hpatch.image = image ;
+		psf->hpatch.image_alloc = psf->header.indx ;
+		} ;
+
+	memcpy (psf->hpatch.image, psf->header.ptr, psf->header.indx) ;
+	psf->hpatch.image_len = psf->header.indx ;
+} /* psf_patch_header_save */
+
+static void
+psf_patch_header_bytes (SF_PRIVATE *psf, sf_count_t offset, const unsigned char *buffer, int len)
+{
+	if (offset + len > psf->hpatch.image_len)
+	{	if (psf_fwrite_at (buffer, len, offset, psf) != len && psf->error == 0)
+			psf->error = SFE_SYSTEM ;
+		return ;
+		} ;
+
+	if (memcmp (psf->hpatch.image + offset, buffer, len) == 0)
+		return ;
+
+	memcpy (psf->hpatch.image + offset, buffer, len) ;
+
+	if (psf->hpatch.dirty_end == 0)
+	{	psf->hpatch.dirty_start = offset ;
+		psf->hpatch.dirty_end = offset + len ;
+		return ;
+		} ;
+
+	psf->hpatch.dirty_start = SF_MIN (psf->hpatch.dirty_start, offset) ;
+	psf->hpatch.dirty_end = SF_MAX (psf->hpatch.dirty_end, offset + len) ;
+} /* psf_patch_header_bytes */
+
+void
+psf_patch_header_int (SF_PRIVATE *psf, sf_count_t offset, int bytes, int endian, sf_count_t value)
+{	unsigned char buffer [8] ;
+	int k ;
+
+	if (offset <= 0)
+		return ;
+
+	for (k = 0 ; k < bytes ; k++)
+		buffer [endian == SF_ENDIAN_BIG ? bytes - 1 - k : k] = (value >> (8 * k)) & 0xFF ;
+
+	psf_patch_header_bytes (psf, offset, buffer, bytes) ;
+} /* psf_patch_header_int */
+
+void
+psf_patch_header_peaks (SF_PRIVATE *psf, sf_count_t offset, int pos_bytes, int endian)
+{	unsigned char buffer [12] ;
+	sf_count_t position ;
+	int ch, k ;
+
+	if (offset <= 0 || psf->peak_info == NULL)
+		return ;
+
+	/* Each entry is a float value followed by a 4 or 8 byte position. */
+	for (ch = 0 ; ch < psf->sf.channels ; ch++)
+	{	if (endian == SF_ENDIAN_BIG)
+			float32_be_write ((float) psf->peak_info->peaks [ch].value, buffer) ;
+		else
+			float32_le_write ((float) psf->peak_info->peaks [ch].value, buffer) ;
+
+		position = psf->peak_info->peaks [ch].position ;
+		for (k = 0 ; k < pos_bytes ; k++)
+			buffer [4 + (endian == SF_ENDIAN_BIG ? pos_bytes - 1 - k : k)] = (position >> (8 * k)) & 0xFF ;
+
+		psf_patch_header_bytes (psf, offset, buffer, 4 + pos_bytes) ;
+		offset += 4 + pos_bytes ;
+		} ;
+} /* psf_patch_header_peaks */
+
+int
+psf_patch_header_flush (SF_PRIVATE *psf)
+{	sf_count_t start, len ;
+
+	start = psf->hpatch.dirty_start ;
+	len = psf->hpatch.dirty_end - start ;
+	psf->hpatch.dirty_start = psf->hpatch.dirty_end = 0 ;
+
+	if (len > 0 && psf_fwrite_at (psf->hpatch.image + start, len, start, psf) != len && psf->error == 0)
+		psf->error = SFE_SYSTEM ;
+
+	return psf->error ;
+} /* psf_patch_header_flush */
+
 /*-----------------------------------------------------------------------------------------------
 **  Binary header reading functions. Returns number of bytes read.
 **
@@ -843,22 +1027,53 @@ psf_binheader_writef (SF_PRIVATE *psf, const char *format, ...)
 
 
 
+/*
+**	Make sure the next bytes of the header are in the header buffer, reading them
+**	from the file if needed. Returns bytes on success.
+*/
 static int
-header_read (SF_PRIVATE *psf, void *ptr, int bytes)
-{	int count = 0 ;
+header_fill (SF_PRIVATE *psf, int bytes, int log_short)
+{	int count = 0, want ;
 
 	if (psf->header.indx + bytes >= psf->header.len && psf_bump_header_allocation (psf, bytes))
 		return count ;
 
 	if (psf->header.indx + bytes > psf->header.end)
-	{	count = psf_fread (psf->header.ptr + psf->header.end, 1, bytes - (psf->header.end - psf->header.indx), psf) ;
-		if (count != bytes - (int) (psf->header.end - psf->header.indx))
-		{	psf_log_printf (psf, "Error : psf_fread returned short count.\n") ;
+	{	want = bytes - (int) (psf->header.end - psf->header.indx) ;
+		count = psf_fread (psf->header.ptr + psf->header.end, 1, want, psf) ;
+		/* Keep whatever was read, the file position has moved past it. */
+		psf->header.end += count ;
+		if (count != want)
+		{	if (log_short)
+				psf_log_printf (psf, "Error : psf_fread returned short count.\n") ;
 			return count ;
 			} ;
-		psf->header.end += count ;
 		} ;
 
+	return bytes ;
+} /* header_fill */
+
+int
+psf_header_fetch (SF_PRIVATE *psf, int bytes)
+{	return header_fill (psf, bytes, SF_TRUE) ;
+} /* psf_header_fetch */
+
+/*
+**	Read a whole record of fixed fields with a single read. A short read is not
+**	logged here, only when one of the fields then turns out to be missing.
+*/
+int
+psf_header_prefetch (SF_PRIVATE *psf, int bytes)
+{	return header_fill (psf, bytes, SF_FALSE) ;
+} /* psf_header_prefetch */
+
+static int
+header_read (SF_PRIVATE *psf, void *ptr, int bytes)
+{	int count ;
+
+	if ((count = psf_header_fetch (psf, bytes)) != bytes)
+		return count ;
+
 	memcpy (ptr, psf->header.ptr + psf->header.indx, bytes) ;
 	psf->header.indx += bytes ;
 
@@ -919,6 +1134,13 @@ header_seek (SF_PRIVATE *psf, sf_count_t position, int whence)
 	return ;
 } /* header_seek */
 
+void
+psf_header_skip (SF_PRIVATE *psf, sf_count_t bytes)
+{
+	if (bytes != 0)
+		header_seek (psf, bytes, SEEK_CUR) ;
+} /* psf_header_skip */
+
 static int
 header_gets (SF_PRIVATE *psf, char *ptr, int bufsize)
 {	int		k ;
@@ -1381,6 +1603,17 @@ u_bitwidth_to_subformat (int bits)
 	return array [((bits + 7) / 8) - 1] ;
 } /* bitwidth_to_subformat */
 
+void
+psf_set_fixed_frames (SF_PRIVATE *psf)
+{
+	if (psf->filelength > psf->dataoffset)
+		psf->datalength = (psf->dataend > 0) ? psf->dataend - psf->dataoffset : psf->filelength - psf->dataoffset ;
+	else
+		psf->datalength = 0 ;
+
+	psf->sf.frames = psf->blockwidth > 0 ? psf->datalength / psf->blockwidth : 0 ;
+} /* psf_set_fixed_frames */
+
 /*
 **	psf_rand_int32 : Not crypto quality, but more than adequate for things
 **	like stream serial numbers in Ogg files or the unique_id field of the
@@ -1486,6 +1719,60 @@ psf_decode_frame_count (SF_PRIVATE *psf)
 /*==============================================================================
 */
 
+/* Number of bytes of storage needed for a block cache with the given block size. */
+int
+psf_block_cache_size (int blocksize)
+{	if (blocksize <= 0)
+		return 0 ;
+
+	return SF_MAX (1, PSF_BLOCK_CACHE_BYTES / blocksize) * blocksize ;
+} /* psf_block_cache_size */
+
+void
+psf_block_cache_init (BLOCK_CACHE *cache, void *data, int blocksize, sf_count_t blocks)
+{	cache->data = data ;
+	cache->blocksize = blocksize ;
+	cache->max_blocks = SF_MAX (1, PSF_BLOCK_CACHE_BYTES / blocksize) ;
+	cache->blocks = blocks ;
+	cache->first = 0 ;
+	cache->bytes = 0 ;
+} /* psf_block_cache_init */
+
+/*
+** Copy block number 'block' into ptr, filling the cache from the file when the
+** block is not already in it. Returns the number of bytes copied which, like
+** psf_fread, is less than the block size on a short read.
+*/
+int
+psf_block_cache_read (SF_PRIVATE *psf, BLOCK_CACHE *cache, sf_count_t block, void *ptr)
+{	sf_count_t	offset, count ;
+
+	offset = (block - cache->first) * cache->blocksize ;
+
+	if (block < cache->first || offset >= cache->bytes)
+	{	/* Read as many blocks as fit, without going past the end of the data. */
+		count = SF_MIN ((sf_count_t) cache->max_blocks, cache->blocks - block) ;
+		count = SF_MAX ((sf_count_t) 1, count) ;
+
+		psf_fseek (psf, psf->dataoffset + block * cache->blocksize, SEEK_SET) ;
+
+		cache->first = block ;
+		cache->bytes = psf_fread (cache->data, 1, count * cache->blocksize, psf) ;
+		offset = 0 ;
+		} ;
+
+	count = SF_MIN (cache->bytes - offset, (sf_count_t) cache->blocksize) ;
+	if (count <= 0)
+		return 0 ;
+
+	memcpy (ptr, cache->data + offset, count) ;
+
+	return count ;
+} /* psf_block_cache_read */
+
+/*==============================================================================
+*/
+
 #define CASE_NAME(x)		case x : return #x ; break ;
 
 const char *
@@ -1722,29 +2009,3 @@ psf_d2i_clip_array (const double *src, int *dest, int count, int normalize)
 
 	return ;
 } /* psf_d2i_clip_array */
-
-FILE *
-psf_open_tmpfile (char * fname, size_t fnamelen)
-{	const char * tmpdir ;
-	FILE * file ;
-
-	if (OS_IS_WIN32)
-		tmpdir = getenv ("TEMP") ;
-	else
-	{	tmpdir = getenv ("TMPDIR") ;
-		tmpdir = tmpdir == NULL ? "/tmp" : tmpdir ;
-		} ;
-
-	if (tmpdir && access (tmpdir, R_OK | W_OK | X_OK) == 0)
-	{	snprintf (fname, fnamelen, "%s/%x%x-alac.tmp", tmpdir, psf_rand_int32 (), psf_rand_int32 ()) ;
-		if ((file = fopen (fname, "wb+")) != NULL)
-			return file ;
-		} ;
-
-	snprintf (fname, fnamelen, "%x%x-alac.tmp", psf_rand_int32 (), psf_rand_int32 ()) ;
-	if ((file = fopen (fname, "wb+")) != NULL)
-		return file ;
-
-	memset (fname, 0, fnamelen) ;
-	return NULL ;
-} /* psf_open_tmpfile */
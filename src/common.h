@@ -37,6 +37,8 @@
 #include "sndfile.h"
 #endif
 
+#include "sfendian.h"
+
 #ifdef __cplusplus
 #error "This code is not designed to be compiled with a C++ compiler."
 #endif
@@ -182,8 +184,8 @@ enum
 */
 
 typedef struct
-{	unsigned	kuki_offset ;
-	unsigned	pakt_offset ;
+{	sf_count_t	kuki_offset ;
+	sf_count_t	pakt_offset ;
 
 	unsigned	bits_per_sample ;
 	unsigned	frames_per_packet ;
@@ -237,8 +239,14 @@ typedef struct
 	uint32_t	mark32 ;
 	sf_count_t	offset ;
 	uint32_t	len ;
+	uint32_t	next ;		/* Index of the next chunk with the same hash, 0 if none. */
 } READ_CHUNK ;
 
+typedef struct
+{	uint32_t	first ;		/* Chunk index + 1 of the first and last chunk with a given */
+	uint32_t	last ;		/* hash, or 0 for an empty slot. */
+} READ_CHUNK_SLOT ;
+
 typedef struct
 {	uint64_t	hash ;
 	uint32_t	mark32 ;
@@ -250,6 +258,15 @@ typedef struct
 {	uint32_t	count ;
 	uint32_t	used ;
 	READ_CHUNK	*chunks ;
+
+	/* Open addressing hash index into chunks, keyed on the chunk hash. */
+	uint32_t	index_len ;
+	uint32_t	index_used ;
+	uint32_t	long_ids ;		/* Chunks where hash != mark32. */
+	READ_CHUNK_SLOT	*index ;
+
+	/* Set by sf_probe (), which has no use for the chunks. */
+	int			no_store ;
 } READ_CHUNKS ;
 typedef struct
 {	uint32_t	count ;
@@ -307,22 +324,31 @@ psf_isprint (int ch)
 **	contents.
 */
 
-typedef struct
-{
-	union
-	{	char		c [SF_FILENAME_LEN] ;
-		sfwchar_t	wc [SF_FILENAME_LEN] ;
-	} path ;
+/* The wide character names are only used by sf_wchar_open on Windows. */
+typedef union
+{	char		c [SF_FILENAME_LEN] ;
+#if USE_WINDOWS_API
+	sfwchar_t	wc [SF_FILENAME_LEN] ;
+#endif
+} PSF_PATH ;
 
-	union
-	{	char		c [SF_FILENAME_LEN] ;
-		sfwchar_t	wc [SF_FILENAME_LEN] ;
-	} dir ;
+typedef union
+{	char		c [SF_FILENAME_LEN / 4] ;
+#if USE_WINDOWS_API
+	sfwchar_t	wc [SF_FILENAME_LEN / 4] ;
+#endif
+} PSF_NAME ;
 
-	union
-	{	char		c [SF_FILENAME_LEN / 4] ;
-		sfwchar_t	wc [SF_FILENAME_LEN / 4] ;
-	} name ;
+typedef struct
+{
+	/*
+	**	These all point into a single block allocated by psf_alloc_file_names ()
+	**	when a file name is first needed, and are NULL for files opened from
+	**	a file descriptor or with virtual I/O.
+	*/
+	PSF_PATH		*path ;
+	PSF_PATH		*dir ;
+	PSF_NAME		*name ;
 
 #if USE_WINDOWS_API
 	/*
@@ -335,6 +361,13 @@ typedef struct
 #else
 	/* These fields can only be used in src/file_io.c. */
 	int 			filedes, savedes ;
+
+	/*
+	**	While space reserved by psf_fallocate () is still attached to the
+	**	file, alloc_end is non-zero and data_end is where the file would
+	**	end without the reservation.
+	*/
+	sf_count_t		data_end, alloc_end ;
 #endif
 
 	int				do_not_close_descriptor ;
@@ -371,29 +404,48 @@ typedef struct sf_private_tag
 
 	PSF_FILE		file, rsrc ;
 
-	char			syserr		[SF_SYSERR_LEN] ;
+	/* Allocated by psf_log_syserr () on the first system error. */
+	char			*syserr ;
 
 	/* parselog and indx should only be changed within the logging functions
-	** of common.c
+	** of common.c. The buffer starts out NULL and grows as needed up to
+	** SF_PARSELOG_LEN bytes.
 	*/
 	struct
-	{	char			buf	[SF_PARSELOG_LEN] ;
-		int				indx ;
+	{	char			*buf ;
+		int				indx, len ;
 	} parselog ;
 
 
 	struct
 	{	unsigned char	* ptr ;
 		sf_count_t		indx, end, len ;
+		int				on_stack ;	/* ptr is the sf_probe () stack buffer. */
 	} header ;
 
 	int				rwf_endian ;	/* Header endian-ness flag. */
 
+	/* File offsets of the header fields which change as audio data is
+	** written, recorded by write_header () so that update_header () only
+	** needs to patch those. An offset of zero means the field is absent and
+	** the offsets are only valid while psf->dataoffset == hpatch.dataoffset.
+	** The image is a copy of the header as written, so that all the patched
+	** fields go back to the file in a single write.
+	*/
+	struct
+	{	sf_count_t		dataoffset ;
+		sf_count_t		riff_size, data_size, frames, peak ;
+		int				layout ;	/* Container specific header variant. */
+		unsigned char	*image ;
+		sf_count_t		image_len, image_alloc ;
+		sf_count_t		dirty_start, dirty_end ;
+	} hpatch ;
+
 	/* Storage and housekeeping data for adding/reading strings from
 	** sound files.
 	*/
 	struct
-	{	STR_DATA	data [SF_MAX_STRINGS] ;
+	{	STR_DATA	*data ;		/* SF_MAX_STRINGS entries, allocated with storage. */
 		char		*storage ;
 		size_t		storage_len ;
 		size_t		storage_used ;
@@ -484,6 +536,12 @@ typedef struct sf_private_tag
 
 	int				ieee_replace ;
 
+	/* Opened with SFM_FAST_OPEN : no parse log and metadata parsed on demand. */
+	int				fast_open ;
+
+	/* Opened by sf_probe () : codecs only need to find the frame count. */
+	int				probe ;
+
 	/* A set of file specific function pointers */
 	sf_count_t		(*read_short)	(struct sf_private_tag*, short *ptr, sf_count_t len) ;
 	sf_count_t		(*read_int)		(struct sf_private_tag*, int *ptr, sf_count_t len) ;
@@ -500,6 +558,12 @@ typedef struct sf_private_tag
 	int				(*command)		(struct sf_private_tag*, int command, void *data, int datasize) ;
 	int				(*byterate)		(struct sf_private_tag*) ;
 
+	/* Optional, update the size fields of an already written header in place. */
+	int				(*update_header)	(struct sf_private_tag*) ;
+
+	/* Set by a container parser which skipped the metadata during a fast open. */
+	int				(*parse_metadata)	(struct sf_private_tag*) ;
+
 	/*
 	**	Separate close functions for the codec and the container.
 	**	The codec close function is always called first.
@@ -507,6 +571,18 @@ typedef struct sf_private_tag
 	int				(*codec_close)		(struct sf_private_tag*) ;
 	int				(*container_close)	(struct sf_private_tag*) ;
 
+	/* Optional, codec specific commands (eg SFC_SET_ENCODER_THREADS). */
+	int				(*codec_command)	(struct sf_private_tag*, int command, void *data, int datasize) ;
+
+	/* Optional, write out encoded data the codec is holding back. */
+	int				(*codec_flush)		(struct sf_private_tag*) ;
+
+	/* Only set while decoding ahead on a worker thread, see SFC_SET_READ_AHEAD. */
+	struct PSF_READ_AHEAD_tag	*read_ahead ;
+
+	/* Only set while encoding and writing on a worker thread, see SFC_SET_ASYNC_WRITE. */
+	struct PSF_ASYNC_WRITE_tag	*async_write ;
+
 	char			*format_desc ;
 
 	/* Virtual I/O functions. */
@@ -735,6 +811,8 @@ enum
 	SFE_FILENAME_TOO_LONG,
 	SFE_NEGATIVE_RW_LEN,
 	SFE_END_OF_FILE,
+	SFE_BAD_PROBE_FLAGS,
+	SFE_ASYNC_WRITE_SHORT,
 
 	SFE_MAX_ERROR			/* This must be last in list. */
 } ;
@@ -742,6 +820,10 @@ enum
 /* Allocate and initialize the SF_PRIVATE struct. */
 SF_PRIVATE * psf_allocate (void) ;
 
+/* Allocate (if not already done) and free the file name storage of a PSF_FILE. */
+int psf_alloc_file_names (PSF_FILE *pfile) ;
+void psf_free_file_names (PSF_FILE *pfile) ;
+
 int subformat_to_bytewidth (int format) ;
 int s_bitwidth_to_subformat (int bits) ;
 int u_bitwidth_to_subformat (int bits) ;
@@ -764,6 +846,12 @@ void	double64_le_write	(double in, unsigned char *out) ;
 void	psf_log_printf		(SF_PRIVATE *psf, const char *format, ...) ;
 void	psf_log_SF_INFO 	(SF_PRIVATE *psf) ;
 
+/* The log buffer is not allocated until something is logged. */
+static inline const char *
+psf_log_buffer (const SF_PRIVATE *psf)
+{	return psf->parselog.buf ? psf->parselog.buf : "" ;
+} /* psf_log_buffer */
+
 int32_t	psf_rand_int32 (void) ;
 
 void append_snprintf (char * dest, size_t maxlen, const char * fmt, ...) ;
@@ -774,12 +862,168 @@ sf_count_t psf_decode_frame_count (SF_PRIVATE *psf) ;
 /* Functions used when writing file headers. */
 
 int		psf_binheader_writef	(SF_PRIVATE *psf, const char *format, ...) ;
+void	psf_patch_header_reset	(SF_PRIVATE *psf) ;
+void	psf_patch_header_save	(SF_PRIVATE *psf) ;
+void	psf_patch_header_int	(SF_PRIVATE *psf, sf_count_t offset, int bytes, int endian, sf_count_t value) ;
+void	psf_patch_header_peaks	(SF_PRIVATE *psf, sf_count_t offset, int pos_bytes, int endian) ;
+int		psf_patch_header_flush	(SF_PRIVATE *psf) ;
 void	psf_asciiheader_printf	(SF_PRIVATE *psf, const char *format, ...) ;
 
 /* Functions used when reading file headers. */
 
 int		psf_binheader_readf	(SF_PRIVATE *psf, char const *format, ...) ;
 
+/*------------------------------------------------------------------------------------
+** Typed access to the header buffer for the fixed fields every file of a container
+** has (chunk headers, format fields and sizes). Each call compiles down to a bounds
+** check and a few byte stores or loads, where psf_binheader_writef () and
+** psf_binheader_readf () interpret a format string and walk a va_list. Values use
+** psf->rwf_endian like the '2', '4' and '8' format characters do, markers are stored
+** as they are in memory like 'm'. A failed allocation or a short read leaves the
+** header as it is and the getters return zero, just as the format string versions.
+*/
+
+int		psf_bump_header_allocation	(SF_PRIVATE *psf, sf_count_t needed) ;
+int		psf_header_fetch	(SF_PRIVATE *psf, int bytes) ;
+int		psf_header_prefetch	(SF_PRIVATE *psf, int bytes) ;
+void	psf_header_skip		(SF_PRIVATE *psf, sf_count_t bytes) ;
+
+static inline unsigned char *
+psf_header_put (SF_PRIVATE *psf, int bytes)
+{	unsigned char *ptr ;
+
+	if (psf->header.indx + bytes >= psf->header.len && psf_bump_header_allocation (psf, bytes))
+		return NULL ;
+
+	ptr = psf->header.ptr + psf->header.indx ;
+	psf->header.indx += bytes ;
+
+	return ptr ;
+} /* psf_header_put */
+
+static inline void
+psf_header_put_marker (SF_PRIVATE *psf, uint32_t marker)
+{	unsigned char *ptr ;
+
+	if ((ptr = psf_header_put (psf, 4)) != NULL)
+		memcpy (ptr, &marker, 4) ;
+} /* psf_header_put_marker */
+
+static inline void
+psf_header_put_16 (SF_PRIVATE *psf, int value)
+{	unsigned char *ptr ;
+
+	if ((ptr = psf_header_put (psf, 2)) == NULL)
+		return ;
+
+	if (psf->rwf_endian == SF_ENDIAN_BIG)
+		psf_put_be16 (ptr, 0, value) ;
+	else
+		psf_put_le16 (ptr, 0, value) ;
+} /* psf_header_put_16 */
+
+static inline void
+psf_header_put_32 (SF_PRIVATE *psf, uint32_t value)
+{	unsigned char *ptr ;
+
+	if ((ptr = psf_header_put (psf, 4)) == NULL)
+		return ;
+
+	if (psf->rwf_endian == SF_ENDIAN_BIG)
+		psf_put_be32 (ptr, 0, value) ;
+	else
+		psf_put_le32 (ptr, 0, value) ;
+} /* psf_header_put_32 */
+
+static inline void
+psf_header_put_64 (SF_PRIVATE *psf, sf_count_t value)
+{	unsigned char *ptr ;
+
+	if ((ptr = psf_header_put (psf, 8)) == NULL)
+		return ;
+
+	if (psf->rwf_endian == SF_ENDIAN_BIG)
+		psf_put_be64 (ptr, 0, value) ;
+	else
+		psf_put_le64 (ptr, 0, value) ;
+} /* psf_header_put_64 */
+
+static inline void
+psf_header_put_bytes (SF_PRIVATE *psf, const void *data, int bytes)
+{	unsigned char *ptr ;
+
+	if ((ptr = psf_header_put (psf, bytes)) != NULL)
+		memcpy (ptr, data, bytes) ;
+} /* psf_header_put_bytes */
+
+static inline void
+psf_header_put_zeros (SF_PRIVATE *psf, int bytes)
+{	unsigned char *ptr ;
+
+	if ((ptr = psf_header_put (psf, bytes)) != NULL)
+		memset (ptr, 0, bytes) ;
+} /* psf_header_put_zeros */
+
+static inline unsigned char *
+psf_header_get (SF_PRIVATE *psf, int bytes)
+{	unsigned char *ptr ;
+
+	if (psf->header.indx + bytes > psf->header.end && psf_header_fetch (psf, bytes) != bytes)
+		return NULL ;
+
+	ptr = psf->header.ptr + psf->header.indx ;
+	psf->header.indx += bytes ;
+
+	return ptr ;
+} /* psf_header_get */
+
+static inline uint32_t
+psf_header_get_marker (SF_PRIVATE *psf)
+{	unsigned char *ptr ;
+	uint32_t marker = 0 ;
+
+	if ((ptr = psf_header_get (psf, 4)) != NULL)
+		memcpy (&marker, ptr, 4) ;
+
+	return marker ;
+} /* psf_header_get_marker */
+
+static inline unsigned short
+psf_header_get_16 (SF_PRIVATE *psf)
+{	unsigned char *ptr ;
+
+	if ((ptr = psf_header_get (psf, 2)) == NULL)
+		return 0 ;
+
+	if (psf->rwf_endian == SF_ENDIAN_BIG)
+		return psf_get_be16 (ptr, 0) ;
+	return psf_get_le16 (ptr, 0) ;
+} /* psf_header_get_16 */
+
+static inline uint32_t
+psf_header_get_32 (SF_PRIVATE *psf)
+{	unsigned char *ptr ;
+
+	if ((ptr = psf_header_get (psf, 4)) == NULL)
+		return 0 ;
+
+	if (psf->rwf_endian == SF_ENDIAN_BIG)
+		return psf_get_be32 (ptr, 0) ;
+	return psf_get_le32 (ptr, 0) ;
+} /* psf_header_get_32 */
+
+static inline sf_count_t
+psf_header_get_64 (SF_PRIVATE *psf)
+{	unsigned char *ptr ;
+
+	if ((ptr = psf_header_get (psf, 8)) == NULL)
+		return 0 ;
+
+	if (psf->rwf_endian == SF_ENDIAN_BIG)
+		return psf_get_be64 (ptr, 0) ;
+	return psf_get_le64 (ptr, 0) ;
+} /* psf_header_get_64 */
+
 /* Functions used in the write function for updating the peak chunk. */
 
 void	peak_update_short	(SF_PRIVATE *psf, short *ptr, size_t items) ;
@@ -832,10 +1076,12 @@ void psf_init_files (SF_PRIVATE *psf) ;
 void psf_use_rsrc (SF_PRIVATE *psf, int on_off) ;
 
 SNDFILE * psf_open_file (SF_PRIVATE *psf, SF_INFO *sfinfo) ;
+void psf_set_open_mode (SF_PRIVATE *psf, int mode) ;
 
 sf_count_t psf_fseek (SF_PRIVATE *psf, sf_count_t offset, int whence) ;
 sf_count_t psf_fread (void *ptr, sf_count_t bytes, sf_count_t count, SF_PRIVATE *psf) ;
 sf_count_t psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t count, SF_PRIVATE *psf) ;
+sf_count_t psf_fwrite_at (const void *ptr, sf_count_t bytes, sf_count_t offset, SF_PRIVATE *psf) ;
 sf_count_t psf_fgets (char *buffer, sf_count_t bufsize, SF_PRIVATE *psf) ;
 sf_count_t psf_ftell (SF_PRIVATE *psf) ;
 sf_count_t psf_get_filelen (SF_PRIVATE *psf) ;
@@ -845,6 +1091,7 @@ void psf_fsync (SF_PRIVATE *psf) ;
 int psf_is_pipe (SF_PRIVATE *psf) ;
 
 int psf_ftruncate (SF_PRIVATE *psf, sf_count_t len) ;
+int psf_fallocate (SF_PRIVATE *psf, sf_count_t offset, sf_count_t len) ;
 int psf_fclose (SF_PRIVATE *psf) ;
 
 /* Open and close the resource fork of a file. */
@@ -923,6 +1170,9 @@ int		aiff_ima_init (SF_PRIVATE *psf, int blockalign, int samplesperblock) ;
 
 int		interleave_init (SF_PRIVATE *psf) ;
 
+/* Set datalength and frames for encodings where every frame is blockwidth bytes. */
+void	psf_set_fixed_frames (SF_PRIVATE *psf) ;
+
 /*------------------------------------------------------------------------------------
 ** Chunk logging functions.
 */
@@ -949,6 +1199,136 @@ fourcc_to_marker (const SF_CHUNK_INFO * chunk_info)
 	return (cptr [3] << 24) + (cptr [2] << 16) + (cptr [1] << 8) + cptr [0] ;
 } /* fourcc_to_marker */
 
+/*------------------------------------------------------------------------------------
+** Read ahead cache for codecs that read fixed size blocks (IMA ADPCM, MS ADPCM,
+** GSM 6.10, PAF24). A single read fills the cache with a run of blocks which are
+** then handed out by block number, rather than doing a read per (small) block.
+*/
+
+#define	PSF_BLOCK_CACHE_BYTES	(1 << 14)
+
+typedef struct
+{	unsigned char	*data ;
+	int				blocksize, max_blocks ;
+	sf_count_t		blocks ;	/* Number of blocks in the data chunk. */
+	sf_count_t		first ;		/* Block number of data [0]. */
+	sf_count_t		bytes ;		/* Number of valid bytes in data. */
+} BLOCK_CACHE ;
+
+int		psf_block_cache_size (int blocksize) ;
+void	psf_block_cache_init (BLOCK_CACHE *cache, void *data, int blocksize, sf_count_t blocks) ;
+int		psf_block_cache_read (SF_PRIVATE *psf, BLOCK_CACHE *cache, sf_count_t block, void *ptr) ;
+
+/*------------------------------------------------------------------------------------
+** Worker threads (worker.c), only ever created on request. A job must not touch
+** the SF_PRIVATE, all file I/O and logging stays on the caller's thread.
+** psf_workers_create () returns NULL if threads are not available.
+*/
+
+#define	PSF_MAX_WORKERS		64
+
+typedef struct SF_JOB_tag SF_JOB ;
+
+struct SF_JOB_tag
+{	void	(*run) (SF_JOB *job) ;
+	int		busy ;
+	SF_JOB	*next ;
+} ;
+
+typedef struct SF_WORKERS_tag SF_WORKERS ;
+
+SF_WORKERS *psf_workers_create (int threads) ;
+void	psf_workers_submit (SF_WORKERS *workers, SF_JOB *job) ;
+void	psf_workers_wait (SF_WORKERS *workers, SF_JOB *job) ;
+void	psf_workers_destroy (SF_WORKERS *workers) ;
+
+/* Never wait for the lock, SF_FALSE if it is taken or the job is still busy. */
+int		psf_workers_try_submit (SF_WORKERS *workers, SF_JOB *job) ;
+int		psf_workers_idle (SF_WORKERS *workers, SF_JOB *job) ;
+
+/*
+** Ordered pipeline of independent blocks on top of the workers. For decoding,
+** load () reads a block into slot->in on the caller's thread. For encoding, the
+** caller fills slot->in and emit () is called with each slot's output in block
+** order. process () runs on a worker and turns slot->in into slot->out.
+*/
+
+typedef struct PSF_PIPE_tag PSF_PIPE ;
+
+typedef struct
+{	SF_JOB		job ;
+	PSF_PIPE	*pipe ;
+	sf_count_t	block ;			/* Block held by the slot, -1 if none. */
+	void		*state ;		/* Per slot codec state, eg a decoder. */
+	void		*in, *out ;
+	int			in_len, out_len ;
+	int			error ;			/* Set by process () for the caller to log, eg a bad block header. */
+} PSF_PIPE_SLOT ;
+
+struct PSF_PIPE_tag
+{	SF_WORKERS	*workers ;
+	SF_PRIVATE	*psf ;
+	void		*codec ;
+
+	int			(*load)		(PSF_PIPE *pipe, PSF_PIPE_SLOT *slot, sf_count_t block) ;
+	void		(*process)	(PSF_PIPE_SLOT *slot) ;
+	int			(*emit)		(PSF_PIPE *pipe, PSF_PIPE_SLOT *slot) ;
+
+	sf_count_t	next ;			/* Next block to load or to submit. */
+	int			count, end ;
+
+	PSF_PIPE_SLOT	slots [] ;
+} ;
+
+PSF_PIPE *psf_pipe_create (SF_PRIVATE *psf, int threads, int in_bytes, int out_bytes, int state_bytes) ;
+void	psf_pipe_destroy (PSF_PIPE *pipe) ;
+void	psf_pipe_reset (PSF_PIPE *pipe) ;
+
+/* The returned slot stays valid until the next call, NULL past the end. */
+PSF_PIPE_SLOT *psf_pipe_read_block (PSF_PIPE *pipe, sf_count_t block) ;
+
+PSF_PIPE_SLOT *psf_pipe_write_slot (PSF_PIPE *pipe) ;
+void	psf_pipe_write_submit (PSF_PIPE *pipe, PSF_PIPE_SLOT *slot) ;
+int		psf_pipe_write_flush (PSF_PIPE *pipe) ;
+
+/*
+** Reading ahead (SFC_SET_READ_AHEAD). Its one worker calls the codec's read
+** functions, so unlike the jobs above it does use the SF_PRIVATE. While it runs
+** the caller's thread only takes decoded frames and never waits for it. Entry
+** points which touch the codec call psf_read_ahead_stop () first and
+** psf_read_ahead_start () when done. Errors found on the caller's thread while
+** the worker runs go through psf_read_ahead_set_error ().
+*/
+
+typedef struct PSF_READ_AHEAD_tag PSF_READ_AHEAD ;
+
+int		psf_read_ahead_set (SF_PRIVATE *psf, int frames) ;
+
+/* Wait for the worker. With reposition, also move the codec back to psf->read_current. */
+void	psf_read_ahead_stop (SF_PRIVATE *psf, int reposition) ;
+void	psf_read_ahead_start (SF_PRIVATE *psf) ;
+
+/* While held the worker stays stopped and reads go straight to the codec. */
+void	psf_read_ahead_hold (SF_PRIVATE *psf, int hold) ;
+
+int		psf_read_ahead_get_error (SF_PRIVATE *psf) ;
+void	psf_read_ahead_set_error (SF_PRIVATE *psf, int error) ;
+void	psf_read_ahead_destroy (SF_PRIVATE *psf) ;
+
+/*
+** Asynchronous writing (SFC_SET_ASYNC_WRITE). Like reading ahead, its one
+** worker calls the codec's write functions. Every entry point other than the
+** sf_write_* functions calls psf_async_write_stop () first.
+*/
+
+typedef struct PSF_ASYNC_WRITE_tag PSF_ASYNC_WRITE ;
+
+int		psf_async_write_set (SF_PRIVATE *psf, int blocks) ;
+
+/* Write out the queued blocks. Returns, and sets psf->error to, any failure so far. */
+int		psf_async_write_stop (SF_PRIVATE *psf) ;
+int		psf_async_write_destroy (SF_PRIVATE *psf) ;
+
 /*------------------------------------------------------------------------------------
 ** Functions that work like OpenBSD's strlcpy/strlcat to replace strncpy/strncat.
 **
@@ -1009,8 +1389,6 @@ int id3_skip (SF_PRIVATE * psf) ;
 
 void	alac_get_desc_chunk_items (int subformat, uint32_t *fmt_flags, uint32_t *frames_per_packet) ;
 
-FILE *	psf_open_tmpfile (char * fname, size_t fnamelen) ;
-
 /*------------------------------------------------------------------------------------
 ** Helper/debug functions.
 */
@@ -124,6 +124,12 @@
 /* Define to 1 if you have the `pipe' function. */
 #cmakedefine01 HAVE_PIPE
 
+/* Define to 1 if you have the `posix_fallocate' function. */
+#cmakedefine01 HAVE_POSIX_FALLOCATE
+
+/* Set to 1 if POSIX threads are available. */
+#cmakedefine01 HAVE_PTHREAD
+
 /* Define to 1 if you have the `read' function. */
 #cmakedefine01 HAVE_READ
 
@@ -79,7 +79,10 @@ ALL_SYMBOLS = (
 	(	"sf_get_chunk_data",	102 ),
 	(	"sf_get_chunk_iterator",	103 ),
 	(	"sf_next_chunk_iterator",	104 ),
-	(	"sf_current_byterate",	110 )
+	(	"sf_current_byterate",	110 ),
+	(	"sf_probe",				120 ),
+	(	"sf_probe_virtual",		121 ),
+	(	"sf_reopen",			130 )
 	)
 
 #-------------------------------------------------------------------------------
@@ -96,10 +96,16 @@ double64_init	(SF_PRIVATE *psf)
 		return SFE_INTERNAL ;
 		} ;
 
-	double64_caps = double64_get_capability (psf) ;
-
 	psf->blockwidth = sizeof (double) * psf->sf.channels ;
 
+	/* sf_probe () only needs the frame count. */
+	if (psf->probe)
+	{	psf_set_fixed_frames (psf) ;
+		return 0 ;
+		} ;
+
+	double64_caps = double64_get_capability (psf) ;
+
 	if (psf->file.mode == SFM_READ || psf->file.mode == SFM_RDWR)
 	{	switch (psf->endian + double64_caps)
 		{	case (SF_ENDIAN_BIG + DOUBLE_CAN_RW_BE) :
@@ -242,14 +248,7 @@ double64_init	(SF_PRIVATE *psf)
 			} ;
 		} ;
 
-	if (psf->filelength > psf->dataoffset)
-	{	psf->datalength = (psf->dataend > 0) ? psf->dataend - psf->dataoffset :
-							psf->filelength - psf->dataoffset ;
-		}
-	else
-		psf->datalength = 0 ;
-
-	psf->sf.frames = psf->datalength / psf->blockwidth ;
+	psf_set_fixed_frames (psf) ;
 
 	return 0 ;
 } /* double64_init */
@@ -37,14 +37,32 @@
 #include	"sfendian.h"
 #include	"common.h"
 
+/*
+** While decoding, a snapshot of the decoder state is taken every
+** DWVW_SEEK_INTERVAL samples so that seeking only has to decode forward
+** from the nearest snapshot instead of from the start of the data.
+*/
+#define	DWVW_SEEK_INTERVAL	4096
+
+typedef struct
+{	sf_count_t	bytepos ;
+	int			bit_count, bits, last_delta_width, last_sample ;
+} DWVW_CHECKPOINT ;
+
 typedef struct
 {	int		bit_width, dwm_maxsize, max_delta, span ;
 	int		samplecount ;
 	int		bit_count, bits, last_delta_width, last_sample ;
 	struct
 	{	int				index, end ;
+		/* Offset of buffer [0] relative to the start of the data. */
+		sf_count_t		start ;
 		unsigned char	buffer [256] ;
 	} b ;
+	struct
+	{	DWVW_CHECKPOINT	*points ;
+		int				count, allocated ;
+	} seek_index ;
 } DWVW_PRIVATE ;
 
 /*============================================================================================
@@ -70,6 +88,8 @@ static int	dwvw_decode_load_bits (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int bit_
 static int	dwvw_encode_data (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, const int *ptr, int len) ;
 static void dwvw_encode_store_bits (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int data, int new_bits) ;
 static void dwvw_read_reset (DWVW_PRIVATE *pdwvw) ;
+static void dwvw_store_checkpoint (DWVW_PRIVATE *pdwvw, int position, int delta_width, int sample) ;
+static int	dwvw_restore_checkpoint (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int index) ;
 
 /*============================================================================================
 ** DWVW initialisation function.
@@ -115,6 +135,10 @@ dwvw_init (SF_PRIVATE *psf, int bitwidth)
 	psf->seek = dwvw_seek ;
 	psf->byterate = dwvw_byterate ;
 
+	/*
+	** Counting the frames decodes the whole file, which also fills in the
+	** seek index as a side effect. The index survives the reset below.
+	*/
 	if (psf->file.mode == SFM_READ)
 	{	psf->sf.frames = psf_decode_frame_count (psf) ;
 		dwvw_read_reset (pdwvw) ;
@@ -147,12 +171,18 @@ dwvw_close (SF_PRIVATE *psf)
 			psf->write_header (psf, SF_TRUE) ;
 		} ;
 
+	free (pdwvw->seek_index.points) ;
+	pdwvw->seek_index.points = NULL ;
+
 	return 0 ;
 } /* dwvw_close */
 
 static sf_count_t
-dwvw_seek	(SF_PRIVATE *psf, int UNUSED (mode), sf_count_t offset)
+dwvw_seek	(SF_PRIVATE *psf, int mode, sf_count_t offset)
 {	DWVW_PRIVATE *pdwvw ;
+	BUF_UNION	ubuf ;
+	sf_count_t	target ;
+	int			index, count, readcount ;
 
 	if (! psf->codec_data)
 	{	psf->error = SFE_INTERNAL ;
@@ -167,8 +197,46 @@ dwvw_seek	(SF_PRIVATE *psf, int UNUSED (mode), sf_count_t offset)
 		return 0 ;
 		} ;
 
-	psf->error = SFE_BAD_SEEK ;
-	return	PSF_SEEK_ERROR ;
+	if (mode != SFM_READ || offset < 0 || offset > (SF_COUNT_MAX / psf->sf.channels))
+	{	psf->error = SFE_BAD_SEEK ;
+		return	PSF_SEEK_ERROR ;
+		} ;
+
+	target = offset * psf->sf.channels ;
+
+	/*
+	** Restart from the nearest checkpoint at or before the target, unless
+	** the current position is already closer.
+	*/
+	index = (int) (target / DWVW_SEEK_INTERVAL) ;
+	if (index >= pdwvw->seek_index.count)
+		index = pdwvw->seek_index.count - 1 ;
+
+	if (target < pdwvw->samplecount || (index >= 0 && pdwvw->samplecount < (sf_count_t) index * DWVW_SEEK_INTERVAL))
+	{	if (index < 0)
+		{	psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
+			dwvw_read_reset (pdwvw) ;
+			}
+		else if (dwvw_restore_checkpoint (psf, pdwvw, index))
+		{	psf->error = SFE_BAD_SEEK ;
+			return	PSF_SEEK_ERROR ;
+			} ;
+		} ;
+
+	/* Decode forward to the target, extending the seek index as we go. */
+	while (pdwvw->samplecount < target)
+	{	readcount = ARRAY_LEN (ubuf.ibuf) ;
+		if (target - pdwvw->samplecount < readcount)
+			readcount = (int) (target - pdwvw->samplecount) ;
+
+		count = dwvw_decode_data (psf, pdwvw, ubuf.ibuf, readcount) ;
+		if (count != readcount)
+		{	psf->error = SFE_BAD_SEEK ;
+			return	PSF_SEEK_ERROR ;
+			} ;
+		} ;
+
+	return offset ;
 } /* dwvw_seek */
 
 static int
@@ -311,7 +379,10 @@ dwvw_decode_data (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int *ptr, int len)
 	sample = pdwvw->last_sample ;
 
 	for (count = 0 ; count < len ; count++)
-	{	/* If bit_count parameter is zero get the delta_width_modifier. */
+	{	if (((pdwvw->samplecount + count) & (DWVW_SEEK_INTERVAL - 1)) == 0)
+			dwvw_store_checkpoint (pdwvw, pdwvw->samplecount + count, delta_width, sample) ;
+
+		/* If bit_count parameter is zero get the delta_width_modifier. */
 		delta_width_modifier = dwvw_decode_load_bits (psf, pdwvw, -1) ;
 
 		/* Check for end of input bit stream. Break loop if end. */
@@ -377,7 +448,8 @@ dwvw_decode_load_bits (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int bit_count)
 	/* Load bits in bit reseviour. */
 	while (pdwvw->bit_count < bit_count)
 	{	if (pdwvw->b.index >= pdwvw->b.end)
-		{	pdwvw->b.end = psf_fread (pdwvw->b.buffer, 1, sizeof (pdwvw->b.buffer), psf) ;
+		{	pdwvw->b.start += pdwvw->b.end ;
+			pdwvw->b.end = psf_fread (pdwvw->b.buffer, 1, sizeof (pdwvw->b.buffer), psf) ;
 			pdwvw->b.index = 0 ;
 			} ;
 
@@ -415,6 +487,8 @@ dwvw_decode_load_bits (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int bit_count)
 static void
 dwvw_read_reset (DWVW_PRIVATE *pdwvw)
 {	int bitwidth = pdwvw->bit_width ;
+	DWVW_CHECKPOINT *points = pdwvw->seek_index.points ;
+	int count = pdwvw->seek_index.count, allocated = pdwvw->seek_index.allocated ;
 
 	memset (pdwvw, 0, sizeof (DWVW_PRIVATE)) ;
 
@@ -422,8 +496,71 @@ dwvw_read_reset (DWVW_PRIVATE *pdwvw)
 	pdwvw->dwm_maxsize	= bitwidth / 2 ;
 	pdwvw->max_delta	= 1 << (bitwidth - 1) ;
 	pdwvw->span			= 1 << bitwidth ;
+
+	/* The seek index is only valid for the data, so keep it across resets. */
+	pdwvw->seek_index.points	= points ;
+	pdwvw->seek_index.count		= count ;
+	pdwvw->seek_index.allocated	= allocated ;
 } /* dwvw_read_reset */
 
+static void
+dwvw_store_checkpoint (DWVW_PRIVATE *pdwvw, int position, int delta_width, int sample)
+{	DWVW_CHECKPOINT *point ;
+	int index ;
+
+	index = position / DWVW_SEEK_INTERVAL ;
+
+	/* Checkpoints are stored in order, so only the next one is ever needed. */
+	if (index != pdwvw->seek_index.count)
+		return ;
+
+	if (pdwvw->seek_index.count >= pdwvw->seek_index.allocated)
+	{	int newsize = pdwvw->seek_index.allocated ? 2 * pdwvw->seek_index.allocated : 64 ;
+
+		if ((point = realloc (pdwvw->seek_index.points, newsize * sizeof (DWVW_CHECKPOINT))) == NULL)
+			return ;
+
+		pdwvw->seek_index.points = point ;
+		pdwvw->seek_index.allocated = newsize ;
+		} ;
+
+	point = pdwvw->seek_index.points + pdwvw->seek_index.count ;
+
+	point->bytepos			= pdwvw->b.start + pdwvw->b.index ;
+	point->bit_count		= pdwvw->bit_count ;
+	point->bits				= pdwvw->bits ;
+	point->last_delta_width	= delta_width ;
+	point->last_sample		= sample ;
+
+	pdwvw->seek_index.count ++ ;
+} /* dwvw_store_checkpoint */
+
+static int
+dwvw_restore_checkpoint (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int index)
+{	const DWVW_CHECKPOINT *point = pdwvw->seek_index.points + index ;
+
+	if (psf_fseek (psf, psf->dataoffset + point->bytepos, SEEK_SET) < 0)
+		return SFE_BAD_SEEK ;
+
+	dwvw_read_reset (pdwvw) ;
+
+	pdwvw->samplecount		= index * DWVW_SEEK_INTERVAL ;
+	pdwvw->bit_count		= point->bit_count ;
+	pdwvw->bits				= point->bits ;
+	pdwvw->last_delta_width	= point->last_delta_width ;
+	pdwvw->last_sample		= point->last_sample ;
+
+	/*
+	** The decoder treats an empty buffer as end of stream, so prime it
+	** with the bytes following the checkpoint.
+	*/
+	pdwvw->b.start	= point->bytepos ;
+	pdwvw->b.end	= psf_fread (pdwvw->b.buffer, 1, sizeof (pdwvw->b.buffer), psf) ;
+	pdwvw->b.index	= 0 ;
+
+	return 0 ;
+} /* dwvw_restore_checkpoint */
+
 static void
 dwvw_encode_store_bits (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int data, int new_bits)
 {	int 	byte ;
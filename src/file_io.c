@@ -65,6 +65,7 @@
 #endif
 
 static void psf_log_syserr (SF_PRIVATE *psf, int error) ;
+static sf_count_t psf_fwrite_at_by_seeking (const void *ptr, sf_count_t bytes, sf_count_t offset, SF_PRIVATE *psf) ;
 
 #if (USE_WINDOWS_API == 0)
 
@@ -101,6 +102,10 @@ psf_fclose (SF_PRIVATE *psf)
 	if (psf->virtual_io)
 		return 0 ;
 
+	/* Give back the reserved space that was never written to. */
+	if (psf->file.alloc_end > 0)
+		psf_ftruncate (psf, psf->file.data_end) ;
+
 	if (psf->file.do_not_close_descriptor)
 	{	psf->file.filedes = -1 ;
 		return 0 ;
@@ -120,8 +125,19 @@ psf_open_rsrc (SF_PRIVATE *psf)
 	if (psf->rsrc.filedes > 0)
 		return 0 ;
 
+	/* The resource fork is found from the file name. */
+	if (psf->file.path == NULL)
+	{	psf->error = SFE_SD2_FD_DISALLOWED ;
+		return psf->error ;
+		} ;
+
+	if (psf_alloc_file_names (&psf->rsrc))
+	{	psf->error = SFE_MALLOC_FAILED ;
+		return psf->error ;
+		} ;
+
 	/* Test for MacOSX style resource fork on HPFS or HPFS+ filesystems. */
-	snprintf (psf->rsrc.path.c, sizeof (psf->rsrc.path.c), "%s/..namedfork/rsrc", psf->file.path.c) ;
+	snprintf (psf->rsrc.path->c, sizeof (psf->rsrc.path->c), "%s/..namedfork/rsrc", psf->file.path->c) ;
 	psf->error = SFE_NO_ERROR ;
 	if ((psf->rsrc.filedes = psf_open_fd (&psf->rsrc)) >= 0)
 	{	psf->rsrclength = psf_get_filelen_fd (psf->rsrc.filedes) ;
@@ -140,7 +156,7 @@ psf_open_rsrc (SF_PRIVATE *psf)
 	** Now try for a resource fork stored as a separate file in the same
 	** directory, but preceded with a dot underscore.
 	*/
-	snprintf (psf->rsrc.path.c, sizeof (psf->rsrc.path.c), "%s._%s", psf->file.dir.c, psf->file.name.c) ;
+	snprintf (psf->rsrc.path->c, sizeof (psf->rsrc.path->c), "%s._%s", psf->file.dir->c, psf->file.name->c) ;
 	psf->error = SFE_NO_ERROR ;
 	if ((psf->rsrc.filedes = psf_open_fd (&psf->rsrc)) >= 0)
 	{	psf->rsrclength = psf_get_filelen_fd (psf->rsrc.filedes) ;
@@ -151,7 +167,7 @@ psf_open_rsrc (SF_PRIVATE *psf)
 	** Now try for a resource fork stored in a separate file in the
 	** .AppleDouble/ directory.
 	*/
-	snprintf (psf->rsrc.path.c, sizeof (psf->rsrc.path.c), "%s.AppleDouble/%s", psf->file.dir.c, psf->file.name.c) ;
+	snprintf (psf->rsrc.path->c, sizeof (psf->rsrc.path->c), "%s.AppleDouble/%s", psf->file.dir->c, psf->file.name->c) ;
 	psf->error = SFE_NO_ERROR ;
 	if ((psf->rsrc.filedes = psf_open_fd (&psf->rsrc)) >= 0)
 	{	psf->rsrclength = psf_get_filelen_fd (psf->rsrc.filedes) ;
@@ -174,6 +190,9 @@ psf_get_filelen (SF_PRIVATE *psf)
 	if (psf->virtual_io)
 		return psf->vio.get_filelen (psf->vio_user_data) ;
 
+	if (psf->file.alloc_end > 0)
+		return psf->file.data_end ;
+
 	filelen = psf_get_filelen_fd (psf->file.filedes) ;
 
 	if (filelen == -1)
@@ -270,6 +289,13 @@ psf_fseek (SF_PRIVATE *psf, sf_count_t offset, int whence)
 				break ;
 
 		case SEEK_END :
+				if (psf->file.alloc_end > 0)
+				{	/* The end of the file is the end of the data, not of the reserved space. */
+					offset += psf->file.data_end + psf->fileoffset ;
+					whence = SEEK_SET ;
+					break ;
+					} ;
+
 				if (psf->file.mode == SFM_WRITE)
 				{	new_position = lseek (psf->file.filedes, offset, whence) ;
 
@@ -394,9 +420,44 @@ psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf
 	if (psf->is_pipe)
 		psf->pipeoffset += total ;
 
+	if (psf->file.alloc_end > 0 && total > 0)
+	{	sf_count_t end = psf_ftell (psf) ;
+
+		if (end > psf->file.data_end)
+			psf->file.data_end = end ;
+		} ;
+
 	return total / bytes ;
 } /* psf_fwrite */
 
+/*
+**	Write bytes at a given offset without moving the file position, used for
+**	patching the size fields of a header which has already been written.
+*/
+sf_count_t
+psf_fwrite_at (const void *ptr, sf_count_t bytes, sf_count_t offset, SF_PRIVATE *psf)
+{	ssize_t count ;
+
+	if (psf->is_pipe)
+		return 0 ;
+
+	if (psf->virtual_io)
+		return psf_fwrite_at_by_seeking (ptr, bytes, offset, psf) ;
+
+	while ((count = pwrite (psf->file.filedes, ptr, bytes, offset + psf->fileoffset)) == -1 && errno == EINTR)
+		/* Do nothing. */ ;
+
+	if (count == -1)
+	{	psf_log_syserr (psf, errno) ;
+		return 0 ;
+		} ;
+
+	if (psf->file.alloc_end > 0 && offset + count > psf->file.data_end)
+		psf->file.data_end = offset + count ;
+
+	return count ;
+} /* psf_fwrite_at */
+
 sf_count_t
 psf_ftell (SF_PRIVATE *psf)
 {	sf_count_t pos ;
@@ -502,6 +563,9 @@ psf_ftruncate (SF_PRIVATE *psf, sf_count_t len)
 	if (len < 0)
 		return -1 ;
 
+	/* Like psf_fseek (), len is relative to the start of an embedded file. */
+	len += psf->fileoffset ;
+
 	if ((sizeof (off_t) < sizeof (sf_count_t)) && len > 0x7FFFFFFF)
 		return -1 ;
 
@@ -509,10 +573,55 @@ psf_ftruncate (SF_PRIVATE *psf, sf_count_t len)
 
 	if (retval == -1)
 		psf_log_syserr (psf, errno) ;
+	else
+		/* Anything reserved beyond len has gone with the truncation. */
+		psf->file.alloc_end = 0 ;
 
 	return retval ;
 } /* psf_ftruncate */
 
+int
+psf_fallocate (SF_PRIVATE *psf, sf_count_t offset, sf_count_t len)
+{
+#if HAVE_POSIX_FALLOCATE
+	sf_count_t filelen ;
+	int retval ;
+
+	/* Returns 0 on success, non-zero on failure. */
+	if (psf->virtual_io || psf->is_pipe || offset < 0 || len <= 0)
+		return 1 ;
+
+	if ((sizeof (off_t) < sizeof (sf_count_t)) && offset + len > 0x7FFFFFFF)
+		return -1 ;
+
+	if ((filelen = psf_get_filelen (psf)) < 0)
+		return -1 ;
+
+	/*
+	**	posix_fallocate () extends the file if offset + len is beyond its end.
+	**	Until the file is truncated or closed the length of the file seen by
+	**	the rest of the library is tracked in data_end instead.
+	*/
+	if ((retval = posix_fallocate (psf->file.filedes, offset + psf->fileoffset, len)) != 0)
+	{	psf_log_syserr (psf, retval) ;
+		return -1 ;
+		} ;
+
+	if (offset + len > filelen)
+	{	psf->file.data_end = filelen ;
+		psf->file.alloc_end = SF_MAX (psf->file.alloc_end, offset + len) ;
+		} ;
+
+	return 0 ;
+#else
+	(void) psf ;
+	(void) offset ;
+	(void) len ;
+
+	return 1 ;
+#endif
+} /* psf_fallocate */
+
 void
 psf_init_files (SF_PRIVATE *psf)
 {	psf->file.filedes = -1 ;
@@ -572,9 +681,9 @@ psf_open_fd (PSF_FILE * pfile)
 		} ;
 
 	if (mode == 0)
-		fd = open (pfile->path.c, oflag) ;
+		fd = open (pfile->path->c, oflag) ;
 	else
-		fd = open (pfile->path.c, oflag, mode) ;
+		fd = open (pfile->path->c, oflag, mode) ;
 
 	return fd ;
 } /* psf_open_fd */
@@ -585,7 +694,9 @@ psf_log_syserr (SF_PRIVATE *psf, int error)
 	/* Only log an error if no error has been set yet. */
 	if (psf->error == 0)
 	{	psf->error = SFE_SYSTEM ;
-		snprintf (psf->syserr, sizeof (psf->syserr), "System error : %s.", strerror (error)) ;
+		if (psf->syserr == NULL && (psf->syserr = malloc (SF_SYSERR_LEN)) == NULL)
+			return ;
+		snprintf (psf->syserr, SF_SYSERR_LEN, "System error : %s.", strerror (error)) ;
 		} ;
 
 	return ;
@@ -651,8 +762,19 @@ psf_open_rsrc (SF_PRIVATE *psf)
 	if (psf->rsrc.handle != NULL)
 		return 0 ;
 
+	/* The resource fork is found from the file name. */
+	if (psf->file.path == NULL)
+	{	psf->error = SFE_SD2_FD_DISALLOWED ;
+		return psf->error ;
+		} ;
+
+	if (psf_alloc_file_names (&psf->rsrc))
+	{	psf->error = SFE_MALLOC_FAILED ;
+		return psf->error ;
+		} ;
+
 	/* Test for MacOSX style resource fork on HPFS or HPFS+ filesystems. */
-	snprintf (psf->rsrc.path.c, sizeof (psf->rsrc.path.c), "%s/rsrc", psf->file.path.c) ;
+	snprintf (psf->rsrc.path->c, sizeof (psf->rsrc.path->c), "%s/rsrc", psf->file.path->c) ;
 	psf->error = SFE_NO_ERROR ;
 	if ((psf->rsrc.handle = psf_open_handle (&psf->rsrc)) != NULL)
 	{	psf->rsrclength = psf_get_filelen_handle (psf->rsrc.handle) ;
@@ -663,7 +785,7 @@ psf_open_rsrc (SF_PRIVATE *psf)
 	** Now try for a resource fork stored as a separate file in the same
 	** directory, but preceded with a dot underscore.
 	*/
-	snprintf (psf->rsrc.path.c, sizeof (psf->rsrc.path.c), "%s._%s", psf->file.dir.c, psf->file.name.c) ;
+	snprintf (psf->rsrc.path->c, sizeof (psf->rsrc.path->c), "%s._%s", psf->file.dir->c, psf->file.name->c) ;
 	psf->error = SFE_NO_ERROR ;
 	if ((psf->rsrc.handle = psf_open_handle (&psf->rsrc)) != NULL)
 	{	psf->rsrclength = psf_get_filelen_handle (psf->rsrc.handle) ;
@@ -674,7 +796,7 @@ psf_open_rsrc (SF_PRIVATE *psf)
 	** Now try for a resource fork stored in a separate file in the
 	** .AppleDouble/ directory.
 	*/
-	snprintf (psf->rsrc.path.c, sizeof (psf->rsrc.path.c), "%s.AppleDouble/%s", psf->file.dir.c, psf->file.name.c) ;
+	snprintf (psf->rsrc.path->c, sizeof (psf->rsrc.path->c), "%s.AppleDouble/%s", psf->file.dir->c, psf->file.name->c) ;
 	psf->error = SFE_NO_ERROR ;
 	if ((psf->rsrc.handle = psf_open_handle (&psf->rsrc)) != NULL)
 	{	psf->rsrclength = psf_get_filelen_handle (psf->rsrc.handle) ;
@@ -789,7 +911,7 @@ psf_open_handle (PSF_FILE * pfile)
 
 	if (pfile->use_wchar)
 		handle = CreateFileW (
-					pfile->path.wc,				/* pointer to name of the file */
+					pfile->path->wc,				/* pointer to name of the file */
 					dwDesiredAccess,			/* access (read-write) mode */
 					dwShareMode,				/* share mode */
 					0,							/* pointer to security attributes */
@@ -799,7 +921,7 @@ psf_open_handle (PSF_FILE * pfile)
 					) ;
 	else
 		handle = CreateFile (
-					pfile->path.c,				/* pointer to name of the file */
+					pfile->path->c,				/* pointer to name of the file */
 					dwDesiredAccess,			/* access (read-write) mode */
 					dwShareMode,				/* share mode */
 					0,							/* pointer to security attributes */
@@ -822,6 +944,9 @@ psf_log_syserr (SF_PRIVATE *psf, int error)
 	if (psf->error == 0)
 	{	psf->error = SFE_SYSTEM ;
 
+		if (psf->syserr == NULL && (psf->syserr = malloc (SF_SYSERR_LEN)) == NULL)
+			return ;
+
 		FormatMessage (
 			FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM,
 			NULL,
@@ -832,7 +957,7 @@ psf_log_syserr (SF_PRIVATE *psf, int error)
 			NULL
 			) ;
 
-		snprintf (psf->syserr, sizeof (psf->syserr), "System error : %s", (char*) lpMsgBuf) ;
+		snprintf (psf->syserr, SF_SYSERR_LEN, "System error : %s", (char*) lpMsgBuf) ;
 		LocalFree (lpMsgBuf) ;
 		} ;
 
@@ -1022,6 +1147,15 @@ psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf
 	return total / bytes ;
 } /* psf_fwrite */
 
+/* USE_WINDOWS_API */ sf_count_t
+psf_fwrite_at (const void *ptr, sf_count_t bytes, sf_count_t offset, SF_PRIVATE *psf)
+{
+	if (psf->is_pipe)
+		return 0 ;
+
+	return psf_fwrite_at_by_seeking (ptr, bytes, offset, psf) ;
+} /* psf_fwrite_at */
+
 /* USE_WINDOWS_API */ sf_count_t
 psf_ftell (SF_PRIVATE *psf)
 {	sf_count_t pos ;
@@ -1141,6 +1275,9 @@ psf_ftruncate (SF_PRIVATE *psf, sf_count_t len)
 	if (len < 0)
 		return 1 ;
 
+	/* Like psf_fseek (), len is relative to the start of an embedded file. */
+	len += psf->fileoffset ;
+
 	lDistanceToMoveLow = (DWORD) (len & 0xFFFFFFFF) ;
 	lDistanceToMoveHigh = (DWORD) ((len >> 32) & 0xFFFFFFFF) ;
 
@@ -1168,6 +1305,16 @@ psf_ftruncate (SF_PRIVATE *psf, sf_count_t len)
 	return retval ;
 } /* psf_ftruncate */
 
+/* USE_WINDOWS_API */ int
+psf_fallocate (SF_PRIVATE *psf, sf_count_t offset, sf_count_t len)
+{	/* Not implemented, the space is simply allocated as the file grows. */
+	(void) psf ;
+	(void) offset ;
+	(void) len ;
+
+	return 1 ;
+} /* psf_fallocate */
+
 
 #else
 /* Win32 file i/o functions implemented using Unix-style file i/o API */
@@ -1355,6 +1502,15 @@ psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf
 	return total / bytes ;
 } /* psf_fwrite */
 
+/* Win32 */ sf_count_t
+psf_fwrite_at (const void *ptr, sf_count_t bytes, sf_count_t offset, SF_PRIVATE *psf)
+{
+	if (psf->is_pipe)
+		return 0 ;
+
+	return psf_fwrite_at_by_seeking (ptr, bytes, offset, psf) ;
+} /* psf_fwrite_at */
+
 /* Win32 */ sf_count_t
 psf_ftell (SF_PRIVATE *psf)
 {	sf_count_t pos ;
@@ -1518,6 +1674,9 @@ psf_ftruncate (SF_PRIVATE *psf, sf_count_t len)
 	if (len < 0)
 		return 1 ;
 
+	/* Like psf_fseek (), len is relative to the start of an embedded file. */
+	len += psf->fileoffset ;
+
 	/* The global village idiots at micorsoft decided to implement
 	** nearly all the required 64 bit file offset functions except
 	** for one, truncate. The fscking morons!
@@ -1536,6 +1695,16 @@ psf_ftruncate (SF_PRIVATE *psf, sf_count_t len)
 	return retval ;
 } /* psf_ftruncate */
 
+/* Win32 */ int
+psf_fallocate (SF_PRIVATE *psf, sf_count_t offset, sf_count_t len)
+{	/* Not implemented, the space is simply allocated as the file grows. */
+	(void) psf ;
+	(void) offset ;
+	(void) len ;
+
+	return 1 ;
+} /* psf_fallocate */
+
 
 static void
 psf_log_syserr (SF_PRIVATE *psf, int error)
@@ -1543,7 +1712,9 @@ psf_log_syserr (SF_PRIVATE *psf, int error)
 	/* Only log an error if no error has been set yet. */
 	if (psf->error == 0)
 	{	psf->error = SFE_SYSTEM ;
-		snprintf (psf->syserr, sizeof (psf->syserr), "System error : %s", strerror (error)) ;
+		if (psf->syserr == NULL && (psf->syserr = malloc (SF_SYSERR_LEN)) == NULL)
+			return ;
+		snprintf (psf->syserr, SF_SYSERR_LEN, "System error : %s", strerror (error)) ;
 		} ;
 
 	return ;
@@ -1551,3 +1722,24 @@ psf_log_syserr (SF_PRIVATE *psf, int error)
 
 #endif
 
+/*
+**	Positional write for virtual I/O and the platforms without pwrite (),
+**	restoring the file position afterwards.
+*/
+static sf_count_t
+psf_fwrite_at_by_seeking (const void *ptr, sf_count_t bytes, sf_count_t offset, SF_PRIVATE *psf)
+{	sf_count_t current, count ;
+
+	if ((current = psf_ftell (psf)) < 0)
+		return 0 ;
+
+	if (psf_fseek (psf, offset, SEEK_SET) != offset)
+		return 0 ;
+
+	count = psf_fwrite (ptr, 1, bytes, psf) ;
+
+	psf_fseek (psf, current, SEEK_SET) ;
+
+	return count ;
+} /* psf_fwrite_at_by_seeking */
+
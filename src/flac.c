@@ -43,6 +43,13 @@
 
 #define ENC_BUFFER_SIZE 8192
 
+/* libFLAC 1.5.0 (API version 14) and later can encode frames on several threads. */
+#if defined (FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
+#define	HAVE_FLAC_ENCODER_THREADS	1
+#else
+#define	HAVE_FLAC_ENCODER_THREADS	0
+#endif
+
 typedef enum
 {	PFLAC_PCM_SHORT = 50,
 	PFLAC_PCM_INT = 51,
@@ -70,6 +77,7 @@ typedef struct
 	const FLAC__Frame *frame ;
 
 	unsigned compression ;
+	unsigned threads ;
 
 } FLAC_PRIVATE ;
 
@@ -84,6 +92,7 @@ static int			flac_close (SF_PRIVATE *psf) ;
 
 static int			flac_enc_init (SF_PRIVATE *psf) ;
 static int			flac_read_header (SF_PRIVATE *psf) ;
+static int			flac_probe_streaminfo (SF_PRIVATE *psf) ;
 
 static sf_count_t	flac_read_flac2s (SF_PRIVATE *psf, short *ptr, sf_count_t len) ;
 static sf_count_t	flac_read_flac2i (SF_PRIVATE *psf, int *ptr, sf_count_t len) ;
@@ -162,12 +171,143 @@ i2flac24_array (const int *src, int32_t *dest, int count)
 		dest [count] = src [count] >> 8 ;
 } /* i2flac24_array */
 
+/*
+**	Interleave and convert 'frames' frames starting at position 'pos' of the
+**	decoder's channel planes directly into the caller's buffer. Mono and
+**	stereo get loops of their own so that the compiler can vectorise them.
+*/
+
+static void
+flac_interleave_short (short *dest, const int32_t * const *buffer, unsigned pos, unsigned frames, unsigned channels, int shift)
+{	unsigned k, j ;
+
+	if (shift < 0)
+	{	shift = -shift ;
+
+		switch (channels)
+		{	case 1 :
+				for (k = 0 ; k < frames ; k++)
+					dest [k] = buffer [0][pos + k] >> shift ;
+				break ;
+
+			case 2 :
+				for (k = 0 ; k < frames ; k++)
+				{	dest [2 * k] = buffer [0][pos + k] >> shift ;
+					dest [2 * k + 1] = buffer [1][pos + k] >> shift ;
+					} ;
+				break ;
+
+			default :
+				for (k = 0 ; k < frames ; k++)
+					for (j = 0 ; j < channels ; j++)
+						dest [k * channels + j] = buffer [j][pos + k] >> shift ;
+				break ;
+			} ;
+		return ;
+		} ;
+
+	switch (channels)
+	{	case 1 :
+			for (k = 0 ; k < frames ; k++)
+				dest [k] = ((uint16_t) buffer [0][pos + k]) << shift ;
+			break ;
+
+		case 2 :
+			for (k = 0 ; k < frames ; k++)
+			{	dest [2 * k] = ((uint16_t) buffer [0][pos + k]) << shift ;
+				dest [2 * k + 1] = ((uint16_t) buffer [1][pos + k]) << shift ;
+				} ;
+			break ;
+
+		default :
+			for (k = 0 ; k < frames ; k++)
+				for (j = 0 ; j < channels ; j++)
+					dest [k * channels + j] = ((uint16_t) buffer [j][pos + k]) << shift ;
+			break ;
+		} ;
+} /* flac_interleave_short */
+
+static void
+flac_interleave_int (int *dest, const int32_t * const *buffer, unsigned pos, unsigned frames, unsigned channels, int shift)
+{	unsigned k, j ;
+
+	switch (channels)
+	{	case 1 :
+			for (k = 0 ; k < frames ; k++)
+				dest [k] = ((uint32_t) buffer [0][pos + k]) << shift ;
+			break ;
+
+		case 2 :
+			for (k = 0 ; k < frames ; k++)
+			{	dest [2 * k] = ((uint32_t) buffer [0][pos + k]) << shift ;
+				dest [2 * k + 1] = ((uint32_t) buffer [1][pos + k]) << shift ;
+				} ;
+			break ;
+
+		default :
+			for (k = 0 ; k < frames ; k++)
+				for (j = 0 ; j < channels ; j++)
+					dest [k * channels + j] = ((uint32_t) buffer [j][pos + k]) << shift ;
+			break ;
+		} ;
+} /* flac_interleave_int */
+
+static void
+flac_interleave_float (float *dest, const int32_t * const *buffer, unsigned pos, unsigned frames, unsigned channels, float norm)
+{	unsigned k, j ;
+
+	switch (channels)
+	{	case 1 :
+			for (k = 0 ; k < frames ; k++)
+				dest [k] = buffer [0][pos + k] * norm ;
+			break ;
+
+		case 2 :
+			for (k = 0 ; k < frames ; k++)
+			{	dest [2 * k] = buffer [0][pos + k] * norm ;
+				dest [2 * k + 1] = buffer [1][pos + k] * norm ;
+				} ;
+			break ;
+
+		default :
+			for (k = 0 ; k < frames ; k++)
+				for (j = 0 ; j < channels ; j++)
+					dest [k * channels + j] = buffer [j][pos + k] * norm ;
+			break ;
+		} ;
+} /* flac_interleave_float */
+
+static void
+flac_interleave_double (double *dest, const int32_t * const *buffer, unsigned pos, unsigned frames, unsigned channels, double norm)
+{	unsigned k, j ;
+
+	switch (channels)
+	{	case 1 :
+			for (k = 0 ; k < frames ; k++)
+				dest [k] = buffer [0][pos + k] * norm ;
+			break ;
+
+		case 2 :
+			for (k = 0 ; k < frames ; k++)
+			{	dest [2 * k] = buffer [0][pos + k] * norm ;
+				dest [2 * k + 1] = buffer [1][pos + k] * norm ;
+				} ;
+			break ;
+
+		default :
+			for (k = 0 ; k < frames ; k++)
+				for (j = 0 ; j < channels ; j++)
+					dest [k * channels + j] = buffer [j][pos + k] * norm ;
+			break ;
+		} ;
+} /* flac_interleave_double */
+
 static sf_count_t
 flac_buffer_copy (SF_PRIVATE *psf)
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
 	const FLAC__Frame *frame = pflac->frame ;
 	const int32_t* const *buffer = pflac->wbuffer ;
-	unsigned i = 0, j, offset, channels, len ;
+	unsigned i = 0, offset, channels, frames ;
 
 	if (psf->sf.channels != (int) frame->header.channels)
 	{	psf_log_printf (psf, "Error: FLAC frame changed from %d to %d channels\n"
@@ -210,113 +350,38 @@ flac_buffer_copy (SF_PRIVATE *psf)
 		return 0 ;
 		} ;
 
-	len = SF_MIN (pflac->len, frame->header.blocksize) ;
-
 	if (pflac->remain % channels != 0)
 	{	psf_log_printf (psf, "Error: pflac->remain %u    channels %u\n", pflac->remain, channels) ;
 		return 0 ;
 		} ;
 
+	/* Whole frames left in the decoded block that fit in the caller's buffer. */
+	frames = 0 ;
+	if (pflac->bufferpos < frame->header.blocksize && pflac->pos < pflac->len)
+		frames = SF_MIN (frame->header.blocksize - pflac->bufferpos, (pflac->len - pflac->pos) / channels) ;
+
 	switch (pflac->pcmtype)
 	{	case PFLAC_PCM_SHORT :
-			{	short *retpcm = (short*) pflac->ptr ;
-				int shift = 16 - frame->header.bits_per_sample ;
-				if (shift < 0)
-				{	shift = abs (shift) ;
-					for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-					{	offset = pflac->pos + i * channels ;
-
-						if (pflac->bufferpos >= frame->header.blocksize)
-							break ;
-
-						if (offset + channels > pflac->len)
-							break ;
-
-						for (j = 0 ; j < channels ; j++)
-							retpcm [offset + j] = buffer [j][pflac->bufferpos] >> shift ;
-						pflac->remain -= channels ;
-						pflac->bufferpos++ ;
-						}
-					}
-				else
-				{	for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-					{	offset = pflac->pos + i * channels ;
-
-						if (pflac->bufferpos >= frame->header.blocksize)
-							break ;
-
-						if (offset + channels > pflac->len)
-							break ;
-
-						for (j = 0 ; j < channels ; j++)
-							retpcm [offset + j] = ((uint16_t) buffer [j][pflac->bufferpos]) << shift ;
-
-						pflac->remain -= channels ;
-						pflac->bufferpos++ ;
-						} ;
-					} ;
-				} ;
+			flac_interleave_short ((short*) pflac->ptr + pflac->pos, buffer, pflac->bufferpos, frames, channels,
+						16 - (int) frame->header.bits_per_sample) ;
 			break ;
 
 		case PFLAC_PCM_INT :
-			{	int *retpcm = (int*) pflac->ptr ;
-				int shift = 32 - frame->header.bits_per_sample ;
-				for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-				{	offset = pflac->pos + i * channels ;
-
-					if (pflac->bufferpos >= frame->header.blocksize)
-						break ;
-
-					if (offset + channels > pflac->len)
-						break ;
-
-					for (j = 0 ; j < channels ; j++)
-						retpcm [offset + j] = ((uint32_t) buffer [j][pflac->bufferpos]) << shift ;
-					pflac->remain -= channels ;
-					pflac->bufferpos++ ;
-					} ;
-				} ;
+			flac_interleave_int ((int*) pflac->ptr + pflac->pos, buffer, pflac->bufferpos, frames, channels,
+						32 - (int) frame->header.bits_per_sample) ;
 			break ;
 
 		case PFLAC_PCM_FLOAT :
-			{	float *retpcm = (float*) pflac->ptr ;
-				float norm = (psf->norm_float == SF_TRUE) ? 1.0 / (1 << (frame->header.bits_per_sample - 1)) : 1.0 ;
+			{	float norm = (psf->norm_float == SF_TRUE) ? 1.0 / (1 << (frame->header.bits_per_sample - 1)) : 1.0 ;
 
-				for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-				{	offset = pflac->pos + i * channels ;
-
-					if (pflac->bufferpos >= frame->header.blocksize)
-						break ;
-
-					if (offset + channels > pflac->len)
-						break ;
-
-					for (j = 0 ; j < channels ; j++)
-						retpcm [offset + j] = buffer [j][pflac->bufferpos] * norm ;
-					pflac->remain -= channels ;
-					pflac->bufferpos++ ;
-					} ;
+				flac_interleave_float ((float*) pflac->ptr + pflac->pos, buffer, pflac->bufferpos, frames, channels, norm) ;
 				} ;
 			break ;
 
 		case PFLAC_PCM_DOUBLE :
-			{	double *retpcm = (double*) pflac->ptr ;
-				double norm = (psf->norm_double == SF_TRUE) ? 1.0 / (1 << (frame->header.bits_per_sample - 1)) : 1.0 ;
-
-				for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-				{	offset = pflac->pos + i * channels ;
-
-					if (pflac->bufferpos >= frame->header.blocksize)
-						break ;
+			{	double norm = (psf->norm_double == SF_TRUE) ? 1.0 / (1 << (frame->header.bits_per_sample - 1)) : 1.0 ;
 
-					if (offset + channels > pflac->len)
-						break ;
-
-					for (j = 0 ; j < channels ; j++)
-						retpcm [offset + j] = buffer [j][pflac->bufferpos] * norm ;
-					pflac->remain -= channels ;
-					pflac->bufferpos++ ;
-					} ;
+				flac_interleave_double ((double*) pflac->ptr + pflac->pos, buffer, pflac->bufferpos, frames, channels, norm) ;
 				} ;
 			break ;
 
@@ -324,8 +389,10 @@ flac_buffer_copy (SF_PRIVATE *psf)
 			return 0 ;
 		} ;
 
-	offset = i * channels ;
-	pflac->pos += i * channels ;
+	offset = frames * channels ;
+	pflac->bufferpos += frames ;
+	pflac->remain -= offset ;
+	pflac->pos += offset ;
 
 	return offset ;
 } /* flac_buffer_copy */
@@ -584,6 +651,9 @@ flac_write_strings (SF_PRIVATE *psf, FLAC_PRIVATE* pflac)
 {	FLAC__StreamMetadata_VorbisComment_Entry entry ;
 	int	k, string_count = 0 ;
 
+	if (psf->strings.data == NULL)
+		return ;
+
 	for (k = 0 ; k < SF_MAX_STRINGS ; k++)
 	{	if (psf->strings.data [k].type != 0)
 			string_count ++ ;
@@ -682,6 +752,7 @@ flac_open	(SF_PRIVATE *psf)
 
 	/* Set the default value here. Over-ridden later if necessary. */
 	pflac->compression = FLAC_DEFAULT_COMPRESSION_LEVEL ;
+	pflac->threads = 1 ;
 
 	if (psf->file.mode == SFM_RDWR)
 		return SFE_BAD_MODE_RW ;
@@ -754,7 +825,7 @@ flac_close	(SF_PRIVATE *psf)
 		free (pflac->encbuffer) ;
 		} ;
 
-	if (psf->file.mode == SFM_READ)
+	if (psf->file.mode == SFM_READ && pflac->fsd != NULL)
 	{	FLAC__stream_decoder_finish (pflac->fsd) ;
 		FLAC__stream_decoder_delete (pflac->fsd) ;
 		} ;
@@ -826,6 +897,13 @@ flac_enc_init (SF_PRIVATE *psf)
 		return SFE_FLAC_INIT_DECODER ;
 		} ;
 
+#if HAVE_FLAC_ENCODER_THREADS
+	if (pflac->threads > 1 && FLAC__stream_encoder_set_num_threads (pflac->fse, pflac->threads) != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK)
+	{	psf_log_printf (psf, "FLAC__stream_encoder_set_num_threads (%u) failed.\n", pflac->threads) ;
+		return SFE_FLAC_INIT_DECODER ;
+		} ;
+#endif
+
 	return 0 ;
 } /* flac_enc_init */
 
@@ -833,6 +911,9 @@ static int
 flac_read_header (SF_PRIVATE *psf)
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
 
+	if (psf->probe && flac_probe_streaminfo (psf) == 0)
+		return 0 ;
+
 	psf_fseek (psf, 0, SEEK_SET) ;
 	if (pflac->fsd)
 		FLAC__stream_decoder_delete (pflac->fsd) ;
@@ -860,6 +941,56 @@ flac_read_header (SF_PRIVATE *psf)
 	return psf->error ;
 } /* flac_read_header */
 
+/*
+**	sf_probe () only needs the STREAMINFO block, which is always the first
+**	metadata block of a native FLAC file, so there is no need to set up the
+**	decoder. Returns non-zero when the decoder has to read the header instead.
+*/
+static int
+flac_probe_streaminfo (SF_PRIVATE *psf)
+{	sf_count_t		packed ;
+	unsigned int	marker, block_len, channels, bitwidth ;
+	char			block_type ;
+
+	if ((SF_CONTAINER (psf->sf.format)) != SF_FORMAT_FLAC)
+		return 1 ;
+
+	/* Marker, block header, block sizes and frame sizes, then the packed stream parameters. */
+	if (psf_binheader_readf (psf, "pmE13j8", 0, &marker, &block_type, &block_len, 10, &packed) != 26)
+		return 1 ;
+
+	if (marker != MAKE_MARKER ('f', 'L', 'a', 'C') || (block_type & 0x7F) != FLAC__METADATA_TYPE_STREAMINFO || block_len != 34)
+		return 1 ;
+
+	/* 20 bits of sample rate, 3 of channels, 5 of bit width and 36 of frame count. */
+	psf->sf.samplerate = (int) ((packed >> 44) & 0xFFFFF) ;
+	channels = ((packed >> 41) & 0x7) + 1 ;
+	bitwidth = ((packed >> 36) & 0x1F) + 1 ;
+	psf->sf.frames = packed & SF_PLATFORM_S64 (0xFFFFFFFFF) ;
+
+	/* A stream of unknown length or width is left to the decoder. */
+	if (psf->sf.samplerate == 0 || psf->sf.frames == 0)
+		return 1 ;
+
+	switch (bitwidth)
+	{	case 8 :
+			psf->sf.format |= SF_FORMAT_PCM_S8 ;
+			break ;
+		case 16 :
+			psf->sf.format |= SF_FORMAT_PCM_16 ;
+			break ;
+		case 24 :
+			psf->sf.format |= SF_FORMAT_PCM_24 ;
+			break ;
+		default :
+			return 1 ;
+		} ;
+
+	psf->sf.channels = channels ;
+
+	return 0 ;
+} /* flac_probe_streaminfo */
+
 static int
 flac_command (SF_PRIVATE * psf, int command, void * data, int datasize)
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
@@ -887,6 +1018,28 @@ flac_command (SF_PRIVATE * psf, int command, void * data, int datasize)
 
 			return SF_TRUE ;
 
+		case SFC_SET_ENCODER_THREADS :
+			if (data == NULL || datasize != sizeof (int))
+				return SF_FALSE ;
+
+			if (psf->file.mode != SFM_WRITE || psf->have_written)
+				return SF_FALSE ;
+
+			if (! HAVE_FLAC_ENCODER_THREADS || *((int *) data) < 1)
+				return SF_FALSE ;
+
+			pflac->threads = *((int *) data) ;
+
+			psf_log_printf (psf, "%s : Setting SFC_SET_ENCODER_THREADS to %u.\n", __func__, pflac->threads) ;
+
+			if (flac_enc_init (psf) == 0)
+				return SF_TRUE ;
+
+			/* Most likely libFLAC was built without thread support. */
+			pflac->threads = 1 ;
+			flac_enc_init (psf) ;
+			return SF_FALSE ;
+
 		default :
 			return SF_FALSE ;
 		} ;
@@ -93,10 +93,16 @@ float32_init	(SF_PRIVATE *psf)
 		return SFE_INTERNAL ;
 		} ;
 
-	float_caps = float32_get_capability (psf) ;
-
 	psf->blockwidth = sizeof (float) * psf->sf.channels ;
 
+	/* sf_probe () only needs the frame count. */
+	if (psf->probe)
+	{	psf_set_fixed_frames (psf) ;
+		return 0 ;
+		} ;
+
+	float_caps = float32_get_capability (psf) ;
+
 	if (psf->file.mode == SFM_READ || psf->file.mode == SFM_RDWR)
 	{	switch (psf->endian + float_caps)
 		{	case (SF_ENDIAN_BIG + FLOAT_CAN_RW_BE) :
@@ -239,14 +245,7 @@ float32_init	(SF_PRIVATE *psf)
 			} ;
 		} ;
 
-	if (psf->filelength > psf->dataoffset)
-	{	psf->datalength = (psf->dataend > 0) ? psf->dataend - psf->dataoffset :
-							psf->filelength - psf->dataoffset ;
-		}
-	else
-		psf->datalength = 0 ;
-
-	psf->sf.frames = psf->blockwidth > 0 ? psf->datalength / psf->blockwidth : 0 ;
+	psf_set_fixed_frames (psf) ;
 
 	return 0 ;
 } /* float32_init */
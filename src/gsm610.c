@@ -32,6 +32,9 @@
 #define	GSM610_BLOCKSIZE		33
 #define	GSM610_SAMPLES			160
 
+/* Blocks handed to the worker at a time when encoding on a worker thread. */
+#define	GSM610_PIPE_BLOCKS		64
+
 typedef struct gsm610_tag
 {	int				blocks ;
 	int				blockcount, samplecount ;
@@ -45,6 +48,11 @@ typedef struct gsm610_tag
 
 	/* Damn I hate typedef-ed pointers; yes, gsm is a pointer type. */
 	gsm				gsm_data ;
+
+	PSF_PIPE		*pipe ;			/* Only when encoding on a worker thread. */
+
+	BLOCK_CACHE		cache ;
+	unsigned char	cache_data [] ;	/* Only allocated when reading. */
 } GSM610_PRIVATE ;
 
 static sf_count_t	gsm610_read_s	(SF_PRIVATE *psf, short *ptr, sf_count_t len) ;
@@ -69,6 +77,8 @@ static	int	gsm610_wav_encode_block	(SF_PRIVATE *psf, GSM610_PRIVATE *pgsm610) ;
 static sf_count_t	gsm610_seek	(SF_PRIVATE *psf, int mode, sf_count_t offset) ;
 
 static int	gsm610_close	(SF_PRIVATE *psf) ;
+static int	gsm610_command	(SF_PRIVATE *psf, int command, void *data, int datasize) ;
+static int	gsm610_flush	(SF_PRIVATE *psf) ;
 
 /*============================================================================================
 ** WAV GSM610 initialisation function.
@@ -89,7 +99,7 @@ gsm610_init	(SF_PRIVATE *psf)
 
 	psf->sf.seekable = SF_FALSE ;
 
-	if ((pgsm610 = calloc (1, sizeof (GSM610_PRIVATE))) == NULL)
+	if ((pgsm610 = calloc (1, sizeof (GSM610_PRIVATE) + (psf->file.mode == SFM_READ ? PSF_BLOCK_CACHE_BYTES : 0))) == NULL)
 		return SFE_MALLOC_FAILED ;
 
 	psf->codec_data = pgsm610 ;
@@ -152,6 +162,8 @@ Need separate gsm_data structs for encode and decode.
 
 		psf->sf.frames = pgsm610->samplesperblock * pgsm610->blocks ;
 
+		psf_block_cache_init (&pgsm610->cache, pgsm610->cache_data, pgsm610->blocksize, pgsm610->blocks) ;
+
 		psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
 
 		pgsm610->decode_block (psf, pgsm610) ;	/* Read first block. */
@@ -170,6 +182,9 @@ Need separate gsm_data structs for encode and decode.
 		psf->write_int		= gsm610_write_i ;
 		psf->write_float	= gsm610_write_f ;
 		psf->write_double	= gsm610_write_d ;
+
+		psf->codec_command	= gsm610_command ;
+		psf->codec_flush	= gsm610_flush ;
 		} ;
 
 	psf->codec_close = gsm610_close ;
@@ -198,7 +213,7 @@ gsm610_wav_decode_block	(SF_PRIVATE *psf, GSM610_PRIVATE *pgsm610)
 		return 1 ;
 		} ;
 
-	if ((k = psf_fread (pgsm610->block, 1, WAVLIKE_GSM610_BLOCKSIZE, psf)) != WAVLIKE_GSM610_BLOCKSIZE)
+	if ((k = psf_block_cache_read (psf, &pgsm610->cache, pgsm610->blockcount - 1, pgsm610->block)) != WAVLIKE_GSM610_BLOCKSIZE)
 		psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, WAVLIKE_GSM610_BLOCKSIZE) ;
 
 	if (gsm_decode (pgsm610->gsm_data, pgsm610->block, pgsm610->samples) < 0)
@@ -226,7 +241,7 @@ gsm610_decode_block	(SF_PRIVATE *psf, GSM610_PRIVATE *pgsm610)
 		return 1 ;
 		} ;
 
-	if ((k = psf_fread (pgsm610->block, 1, GSM610_BLOCKSIZE, psf)) != GSM610_BLOCKSIZE)
+	if ((k = psf_block_cache_read (psf, &pgsm610->cache, pgsm610->blockcount - 1, pgsm610->block)) != GSM610_BLOCKSIZE)
 		psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, GSM610_BLOCKSIZE) ;
 
 	if (gsm_decode (pgsm610->gsm_data, pgsm610->block, pgsm610->samples) < 0)
@@ -485,8 +500,11 @@ gsm610_write_block	(SF_PRIVATE *psf, GSM610_PRIVATE *pgsm610, const short *ptr,
 		pgsm610->samplecount += count ;
 		total = indx ;
 
-		if (pgsm610->samplecount >= pgsm610->samplesperblock)
-			pgsm610->encode_block (psf, pgsm610) ;
+		if (pgsm610->samplecount >= pgsm610->samplesperblock && pgsm610->encode_block (psf, pgsm610) == 0)
+		{	/* The pipe has failed. Leave these samples out so the write comes up short. */
+			pgsm610->samplecount -= count ;
+			return indx - count ;
+			} ;
 		} ;
 
 	return total ;
@@ -617,11 +635,134 @@ gsm610_close	(SF_PRIVATE *psf)
 
 		if (pgsm610->samplecount && pgsm610->samplecount < pgsm610->samplesperblock)
 			pgsm610->encode_block (psf, pgsm610) ;
+
+		gsm610_flush (psf) ;
 		} ;
 
+	psf_pipe_destroy (pgsm610->pipe) ;
+	pgsm610->pipe = NULL ;
+
 	if (pgsm610->gsm_data)
 		gsm_destroy (pgsm610->gsm_data) ;
 
 	return 0 ;
 } /* gsm610_close */
 
+
+/*==========================================================================================
+** Encoding on a worker thread. Each frame depends on the encoder state left by
+** the one before, so a file only ever gets one worker, which encodes the blocks
+** in order. Encoding is taken off the caller's thread, and several files being
+** written at once are encoded in parallel.
+*/
+
+static void
+gsm610_pipe_encode (PSF_PIPE_SLOT *slot)
+{	GSM610_PRIVATE	*pgsm610 = slot->pipe->codec ;
+	short			*samples = slot->in ;
+	unsigned char	*block = slot->out ;
+	int				k ;
+
+	for (k = 0 ; k < slot->in_len ; k++)
+	{	gsm_encode (pgsm610->gsm_data, samples, block) ;
+		if (pgsm610->samplesperblock == WAVLIKE_GSM610_SAMPLES)
+			gsm_encode (pgsm610->gsm_data, samples + WAVLIKE_GSM610_SAMPLES / 2, block + WAVLIKE_GSM610_BLOCKSIZE / 2) ;
+
+		samples += pgsm610->samplesperblock ;
+		block += pgsm610->blocksize ;
+		} ;
+
+	slot->out_len = slot->in_len * pgsm610->blocksize ;
+} /* gsm610_pipe_encode */
+
+static int
+gsm610_pipe_emit (PSF_PIPE *pipe, PSF_PIPE_SLOT *slot)
+{	int k ;
+
+	slot->in_len = 0 ;
+
+	if ((k = psf_fwrite (slot->out, 1, slot->out_len, pipe->psf)) != slot->out_len)
+	{	psf_log_printf (pipe->psf, "*** Warning : short write (%d != %d).\n", k, slot->out_len) ;
+		return 0 ;
+		} ;
+
+	return 1 ;
+} /* gsm610_pipe_emit */
+
+/* Used as the encode_block function while the pipe exists. */
+static int
+gsm610_pipe_encode_block (SF_PRIVATE * UNUSED (psf), GSM610_PRIVATE *pgsm610)
+{	PSF_PIPE_SLOT *slot ;
+
+	/* An earlier block failed to be written. */
+	if ((slot = psf_pipe_write_slot (pgsm610->pipe)) == NULL)
+		return 0 ;
+
+	memcpy ((short *) slot->in + slot->in_len * pgsm610->samplesperblock, pgsm610->samples, pgsm610->samplesperblock * sizeof (short)) ;
+
+	if (++ slot->in_len == GSM610_PIPE_BLOCKS)
+		psf_pipe_write_submit (pgsm610->pipe, slot) ;
+
+	pgsm610->samplecount = 0 ;
+	pgsm610->blockcount ++ ;
+
+	/* Set samples to zero for next block. */
+	memset (pgsm610->samples, 0, sizeof (pgsm610->samples)) ;
+
+	return 1 ;
+} /* gsm610_pipe_encode_block */
+
+static int
+gsm610_command (SF_PRIVATE *psf, int command, void *data, int UNUSED (datasize))
+{	GSM610_PRIVATE *pgsm610 ;
+	int threads ;
+
+	if ((pgsm610 = psf->codec_data) == NULL || command != SFC_SET_ENCODER_THREADS)
+		return SF_FALSE ;
+
+	if (psf->file.mode != SFM_WRITE || psf->have_written)
+		return SF_FALSE ;
+
+	threads = *((int *) data) ;
+	if (threads < 1 || threads > PSF_MAX_WORKERS)
+		return SF_FALSE ;
+
+	psf_log_printf (psf, "%s : Setting SFC_SET_ENCODER_THREADS to %d.\n", __func__, threads) ;
+
+	psf_pipe_destroy (pgsm610->pipe) ;
+	pgsm610->pipe = NULL ;
+
+	pgsm610->encode_block = (pgsm610->samplesperblock == WAVLIKE_GSM610_SAMPLES) ? gsm610_wav_encode_block : gsm610_encode_block ;
+
+	if (threads == 1)
+		return SF_TRUE ;
+
+	/* Any other count gets the one worker. */
+	pgsm610->pipe = psf_pipe_create (psf, 1, GSM610_PIPE_BLOCKS * pgsm610->samplesperblock * sizeof (short),
+										GSM610_PIPE_BLOCKS * pgsm610->blocksize, 0) ;
+	if (pgsm610->pipe == NULL)
+		return SF_FALSE ;
+
+	pgsm610->pipe->codec = pgsm610 ;
+	pgsm610->pipe->process = gsm610_pipe_encode ;
+	pgsm610->pipe->emit = gsm610_pipe_emit ;
+
+	pgsm610->encode_block = gsm610_pipe_encode_block ;
+
+	return SF_TRUE ;
+} /* gsm610_command */
+
+static int
+gsm610_flush (SF_PRIVATE *psf)
+{	GSM610_PRIVATE	*pgsm610 ;
+	PSF_PIPE_SLOT	*slot ;
+
+	if ((pgsm610 = psf->codec_data) == NULL || pgsm610->pipe == NULL)
+		return 0 ;
+
+	/* Hand over a partly filled slot. */
+	if ((slot = psf_pipe_write_slot (pgsm610->pipe)) != NULL && slot->in_len > 0)
+		psf_pipe_write_submit (pgsm610->pipe, slot) ;
+
+	return psf_pipe_write_flush (pgsm610->pipe) ? 0 : SFE_INTERNAL ;
+} /* gsm610_flush */
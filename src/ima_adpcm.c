@@ -37,6 +37,8 @@ typedef struct IMA_ADPCM_PRIVATE_tag
 	int				stepindx [2] ;
 	unsigned char	*block ;
 	short			*samples ;
+	BLOCK_CACHE		cache ;
+	PSF_PIPE		*pipe ;			/* Only when decoding on worker threads. */
 	short			data	[] ; /* ISO C99 struct flexible array. */
 } IMA_ADPCM_PRIVATE ;
 
@@ -81,8 +83,10 @@ static sf_count_t aiff_ima_seek		(SF_PRIVATE *psf, int mode, sf_count_t offset)
 static sf_count_t wavlike_ima_seek	(SF_PRIVATE *psf, int mode, sf_count_t offset) ;
 
 static int	ima_close	(SF_PRIVATE *psf) ;
+static int	ima_command	(SF_PRIVATE *psf, int command, void *data, int datasize) ;
 
 static int wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima) ;
+static int wavlike_ima_decode_samples (int channels, int blocksize, int samplesperblock, const unsigned char *block, short *samples) ;
 static int wavlike_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima) ;
 
 /*-static int aiff_ima_reader_init (SF_PRIVATE *psf, int blockalign, int samplesperblock) ;-*/
@@ -100,6 +104,51 @@ clamp_ima_step_index (int indx)
 	return indx ;
 } /* clamp_ima_step_index */
 
+/*
+**	Branch free versions of the inner steps of the IMA ADPCM decoder and
+**	encoder. The sign and magnitude bits of each nibble are essentially random
+**	so branching on them costs a misprediction every few samples.
+*/
+
+/* The signed difference encoded by a 4 bit IMA code for the given step size. */
+static inline int
+ima_code_to_diff (int step, int bytecode)
+{	int diff, sign ;
+
+	diff = step >> 3 ;
+	diff += (step >> 2) & - (bytecode & 1) ;
+	diff += (step >> 1) & - ((bytecode >> 1) & 1) ;
+	diff += step & - ((bytecode >> 2) & 1) ;
+
+	sign = - ((bytecode >> 3) & 1) ;
+	return (diff ^ sign) - sign ;
+} /* ima_code_to_diff */
+
+/* The 4 bit IMA code for the difference between a sample and its prediction. */
+static inline int
+ima_diff_to_code (int diff, int step)
+{	int bytecode, mask ;
+
+	mask = - (diff < 0) ;
+	bytecode = 8 & mask ;
+	diff = (diff ^ mask) - mask ;
+
+	mask = - (diff >= step) ;
+	bytecode |= 4 & mask ;
+	diff -= step & mask ;
+	step >>= 1 ;
+
+	mask = - (diff >= step) ;
+	bytecode |= 2 & mask ;
+	diff -= step & mask ;
+	step >>= 1 ;
+
+	mask = - (diff >= step) ;
+	bytecode |= 1 & mask ;
+
+	return bytecode ;
+} /* ima_diff_to_code */
+
 /*============================================================================================
 ** IMA ADPCM Reader initialisation function.
 */
@@ -167,6 +216,9 @@ ima_close	(SF_PRIVATE *psf)
 		psf->sf.frames = pima->samplesperblock * pima->blockcount / psf->sf.channels ;
 		} ;
 
+	psf_pipe_destroy (pima->pipe) ;
+	pima->pipe = NULL ;
+
 	return 0 ;
 } /* ima_close */
 
@@ -184,7 +236,8 @@ ima_reader_init (SF_PRIVATE *psf, int blockalign, int samplesperblock)
 
 	pimasize = sizeof (IMA_ADPCM_PRIVATE) + blockalign * psf->sf.channels + 3 * psf->sf.channels * samplesperblock ;
 
-	if (! (pima = calloc (1, pimasize)))
+	/* The block cache lives at the end of the same allocation. */
+	if (! (pima = calloc (1, pimasize + psf_block_cache_size (blockalign * psf->sf.channels))))
 		return SFE_MALLOC_FAILED ;
 
 	psf->codec_data = (void*) pima ;
@@ -226,6 +279,8 @@ ima_reader_init (SF_PRIVATE *psf, int blockalign, int samplesperblock)
 					} ;
 
 				pima->decode_block = wavlike_ima_decode_block ;
+				psf->codec_command = ima_command ;
+				psf_block_cache_init (&pima->cache, (unsigned char *) pima + pimasize, pima->blocksize, pima->blocks) ;
 
 				psf->sf.frames = pima->samplesperblock * pima->blocks ;
 				break ;
@@ -233,6 +288,9 @@ ima_reader_init (SF_PRIVATE *psf, int blockalign, int samplesperblock)
 		case SF_FORMAT_AIFF :
 				psf_log_printf (psf, "still need to check block count\n") ;
 				pima->decode_block = aiff_ima_decode_block ;
+				/* AIFF reads one block per channel at a time. */
+				psf_block_cache_init (&pima->cache, (unsigned char *) pima + pimasize, pima->blocksize * pima->channels,
+										(pima->blocks + pima->channels - 1) / pima->channels) ;
 				psf->sf.frames = pima->samplesperblock * pima->blocks / pima->channels ;
 				break ;
 
@@ -254,7 +312,7 @@ ima_reader_init (SF_PRIVATE *psf, int blockalign, int samplesperblock)
 static int
 aiff_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 {	unsigned char *blockdata ;
-	int		chan, k, diff, bytecode, predictor ;
+	int		chan, k, bytecode, predictor ;
 	short	step, stepindx, *sampledata ;
 
 static int count = 0 ;
@@ -268,7 +326,7 @@ count ++ ;
 		return 1 ;
 		} ;
 
-	if ((k = psf_fread (pima->block, 1, pima->blocksize * pima->channels, psf)) != pima->blocksize * pima->channels)
+	if ((k = psf_block_cache_read (psf, &pima->cache, pima->blockcount / pima->channels - 1, pima->block)) != pima->blocksize * pima->channels)
 		psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pima->blocksize) ;
 
 	/* Read and check the block header. */
@@ -301,13 +359,7 @@ count ++ ;
 			stepindx += ima_indx_adjust [bytecode] ;
 			stepindx = clamp_ima_step_index (stepindx) ;
 
-			diff = step >> 3 ;
-			if (bytecode & 1)	diff += step >> 2 ;
-			if (bytecode & 2)	diff += step >> 1 ;
-			if (bytecode & 4)	diff += step ;
-			if (bytecode & 8)	diff = -diff ;
-
-			predictor += diff ;
+			predictor += ima_code_to_diff (step, bytecode) ;
 			if (predictor < -32768)
 				predictor = -32768 ;
 			else if (predictor > 32767)
@@ -322,8 +374,8 @@ count ++ ;
 
 static int
 aiff_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
-{	int		chan, k, step, diff, vpdiff, blockindx, indx ;
-	short	bytecode, mask ;
+{	int		chan, k, step, blockindx, indx ;
+	short	bytecode ;
 
 	/* Encode the block header. */
 	for (chan = 0 ; chan < pima->channels ; chan ++)
@@ -339,30 +391,10 @@ aiff_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 	for (k = pima->channels ; k < (pima->samplesperblock * pima->channels) ; k ++)
 	{	chan = (pima->channels > 1) ? (k % 2) : 0 ;
 
-		diff = pima->samples [k] - pima->previous [chan] ;
-
-		bytecode = 0 ;
 		step = ima_step_size [pima->stepindx [chan]] ;
-		vpdiff = step >> 3 ;
-		if (diff < 0)
-		{	bytecode = 8 ;
-			diff = -diff ;
-			} ;
-		mask = 4 ;
-		while (mask)
-		{	if (diff >= step)
-			{	bytecode |= mask ;
-				diff -= step ;
-				vpdiff += step ;
-				} ;
-			step >>= 1 ;
-			mask >>= 1 ;
-			} ;
+		bytecode = ima_diff_to_code (pima->samples [k] - pima->previous [chan], step) ;
 
-		if (bytecode & 8)
-			pima->previous [chan] -= vpdiff ;
-		else
-			pima->previous [chan] += vpdiff ;
+		pima->previous [chan] += ima_code_to_diff (step, bytecode) ;
 
 		if (pima->previous [chan] > 32767)
 			pima->previous [chan] = 32767 ;
@@ -400,8 +432,7 @@ aiff_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 
 static int
 wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
-{	int		chan, k, predictor, blockindx, indx, indxstart, diff ;
-	short	step, bytecode, stepindx [2] ;
+{	int		k ;
 
 	pima->blockcount ++ ;
 	pima->samplecount = 0 ;
@@ -411,24 +442,51 @@ wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 		return 1 ;
 		} ;
 
-	if ((k = psf_fread (pima->block, 1, pima->blocksize, psf)) != pima->blocksize)
+	if (pima->pipe != NULL)
+	{	PSF_PIPE_SLOT *slot ;
+
+		/* A short read drops back to the code below, which logs it. */
+		if ((slot = psf_pipe_read_block (pima->pipe, pima->blockcount - 1)) != NULL)
+		{	memcpy (pima->block, slot->in, pima->blocksize) ;
+			memcpy (pima->samples, slot->out, pima->samplesperblock * pima->channels * sizeof (short)) ;
+			for (k = 0 ; k < slot->error ; k++)
+				psf_log_printf (psf, "IMA ADPCM synchronisation error.\n") ;
+			return 1 ;
+			} ;
+		} ;
+
+	if ((k = psf_block_cache_read (psf, &pima->cache, pima->blockcount - 1, pima->block)) != pima->blocksize)
 		psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pima->blocksize) ;
 
+	for (k = wavlike_ima_decode_samples (pima->channels, pima->blocksize, pima->samplesperblock, pima->block, pima->samples) ; k > 0 ; k--)
+		psf_log_printf (psf, "IMA ADPCM synchronisation error.\n") ;
+
+	return 1 ;
+} /* wavlike_ima_decode_block */
+
+/*	Decode one block. This only touches its arguments so blocks can be decoded
+**	on worker threads. Returns the number of channels with a bad block header.
+*/
+static int
+wavlike_ima_decode_samples (int channels, int blocksize, int samplesperblock, const unsigned char *block, short *samples)
+{	int		chan, k, predictor, blockindx, indx, indxstart, sync_errors = 0 ;
+	short	step, bytecode, stepindx [2] ;
+
 	/* Read and check the block header. */
 
-	for (chan = 0 ; chan < pima->channels ; chan++)
-	{	predictor = pima->block [chan*4] | (pima->block [chan*4+1] << 8) ;
+	for (chan = 0 ; chan < channels ; chan++)
+	{	predictor = block [chan*4] | (block [chan*4+1] << 8) ;
 		if (predictor & 0x8000)
 			predictor -= 0x10000 ;
 
-		stepindx [chan] = pima->block [chan*4+2] ;
+		stepindx [chan] = block [chan*4+2] ;
 		stepindx [chan] = clamp_ima_step_index (stepindx [chan]) ;
 
 
-		if (pima->block [chan*4+3] != 0)
-			psf_log_printf (psf, "IMA ADPCM synchronisation error.\n") ;
+		if (block [chan*4+3] != 0)
+			sync_errors ++ ;
 
-		pima->samples [chan] = predictor ;
+		samples [chan] = predictor ;
 		} ;
 
 	/*
@@ -436,44 +494,34 @@ wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 	**	correct sample positions.
 	*/
 
-	blockindx = 4 * pima->channels ;
+	blockindx = 4 * channels ;
 
-	indxstart = pima->channels ;
-	while (blockindx < pima->blocksize)
-	{	for (chan = 0 ; chan < pima->channels ; chan++)
+	indxstart = channels ;
+	while (blockindx < blocksize)
+	{	for (chan = 0 ; chan < channels ; chan++)
 		{	indx = indxstart + chan ;
 			for (k = 0 ; k < 4 ; k++)
-			{	bytecode = pima->block [blockindx++] ;
-				pima->samples [indx] = bytecode & 0x0F ;
-				indx += pima->channels ;
-				pima->samples [indx] = (bytecode >> 4) & 0x0F ;
-				indx += pima->channels ;
+			{	bytecode = block [blockindx++] ;
+				samples [indx] = bytecode & 0x0F ;
+				indx += channels ;
+				samples [indx] = (bytecode >> 4) & 0x0F ;
+				indx += channels ;
 				} ;
 			} ;
-		indxstart += 8 * pima->channels ;
+		indxstart += 8 * channels ;
 		} ;
 
 	/* Decode the encoded 4 bit samples. */
 
-	for (k = pima->channels ; k < (pima->samplesperblock * pima->channels) ; k ++)
-	{	chan = (pima->channels > 1) ? (k % 2) : 0 ;
+	for (k = channels ; k < (samplesperblock * channels) ; k ++)
+	{	chan = (channels > 1) ? (k % 2) : 0 ;
 
-		bytecode = pima->samples [k] & 0xF ;
+		bytecode = samples [k] & 0xF ;
 
 		step = ima_step_size [stepindx [chan]] ;
-		predictor = pima->samples [k - pima->channels] ;
+		predictor = samples [k - channels] ;
 
-		diff = step >> 3 ;
-		if (bytecode & 1)
-			diff += step >> 2 ;
-		if (bytecode & 2)
-			diff += step >> 1 ;
-		if (bytecode & 4)
-			diff += step ;
-		if (bytecode & 8)
-			diff = -diff ;
-
-		predictor += diff ;
+		predictor += ima_code_to_diff (step, bytecode) ;
 
 		if (predictor > 32767)
 			predictor = 32767 ;
@@ -483,16 +531,16 @@ wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 		stepindx [chan] += ima_indx_adjust [bytecode] ;
 		stepindx [chan] = clamp_ima_step_index (stepindx [chan]) ;
 
-		pima->samples [k] = predictor ;
+		samples [k] = predictor ;
 		} ;
 
-	return 1 ;
-} /* wavlike_ima_decode_block */
+	return sync_errors ;
+} /* wavlike_ima_decode_samples */
 
 static int
 wavlike_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
-{	int		chan, k, step, diff, vpdiff, blockindx, indx, indxstart ;
-	short	bytecode, mask ;
+{	int		chan, k, step, blockindx, indx, indxstart ;
+	short	bytecode ;
 
 	/* Encode the block header. */
 	for (chan = 0 ; chan < pima->channels ; chan++)
@@ -510,30 +558,10 @@ wavlike_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 	for (k = pima->channels ; k < (pima->samplesperblock * pima->channels) ; k ++)
 	{	chan = (pima->channels > 1) ? (k % 2) : 0 ;
 
-		diff = pima->samples [k] - pima->previous [chan] ;
-
-		bytecode = 0 ;
 		step = ima_step_size [pima->stepindx [chan]] ;
-		vpdiff = step >> 3 ;
-		if (diff < 0)
-		{	bytecode = 8 ;
-			diff = -diff ;
-			} ;
-		mask = 4 ;
-		while (mask)
-		{	if (diff >= step)
-			{	bytecode |= mask ;
-				diff -= step ;
-				vpdiff += step ;
-				} ;
-			step >>= 1 ;
-			mask >>= 1 ;
-			} ;
+		bytecode = ima_diff_to_code (pima->samples [k] - pima->previous [chan], step) ;
 
-		if (bytecode & 8)
-			pima->previous [chan] -= vpdiff ;
-		else
-			pima->previous [chan] += vpdiff ;
+		pima->previous [chan] += ima_code_to_diff (step, bytecode) ;
 
 		if (pima->previous [chan] > 32767)
 			pima->previous [chan] = 32767 ;
@@ -807,6 +835,60 @@ wavlike_ima_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 	return newblock * pima->samplesperblock + newsample ;
 } /* wavlike_ima_seek */
 
+/*==========================================================================================
+** Decoding WAV and W64 blocks on worker threads. Each block carries its own
+** predictor and step index, so the blocks decode the same as they do serially.
+** AIFF blocks are only 34 bytes per channel, too small to be worth a job.
+*/
+
+static int
+wavlike_ima_pipe_load (PSF_PIPE *pipe, PSF_PIPE_SLOT *slot, sf_count_t block)
+{	IMA_ADPCM_PRIVATE *pima = pipe->codec ;
+
+	if (block >= pima->blocks)
+		return 0 ;
+
+	return psf_block_cache_read (pipe->psf, &pima->cache, block, slot->in) == pima->blocksize ;
+} /* wavlike_ima_pipe_load */
+
+static void
+wavlike_ima_pipe_decode (PSF_PIPE_SLOT *slot)
+{	IMA_ADPCM_PRIVATE *pima = slot->pipe->codec ;
+
+	slot->error = wavlike_ima_decode_samples (pima->channels, pima->blocksize, pima->samplesperblock, slot->in, slot->out) ;
+} /* wavlike_ima_pipe_decode */
+
+static int
+ima_command (SF_PRIVATE *psf, int command, void *data, int UNUSED (datasize))
+{	IMA_ADPCM_PRIVATE *pima ;
+	int threads ;
+
+	if ((pima = psf->codec_data) == NULL || command != SFC_SET_DECODER_THREADS)
+		return SF_FALSE ;
+
+	threads = *((int *) data) ;
+	if (threads < 1 || threads > PSF_MAX_WORKERS)
+		return SF_FALSE ;
+
+	psf_log_printf (psf, "%s : Setting SFC_SET_DECODER_THREADS to %d.\n", __func__, threads) ;
+
+	psf_pipe_destroy (pima->pipe) ;
+	pima->pipe = NULL ;
+
+	if (threads == 1)
+		return SF_TRUE ;
+
+	pima->pipe = psf_pipe_create (psf, threads, pima->blocksize, pima->samplesperblock * pima->channels * sizeof (short), 0) ;
+	if (pima->pipe == NULL)
+		return SF_FALSE ;
+
+	pima->pipe->codec = pima ;
+	pima->pipe->load = wavlike_ima_pipe_load ;
+	pima->pipe->process = wavlike_ima_pipe_decode ;
+
+	return SF_TRUE ;
+} /* ima_command */
+
 /*==========================================================================================
 ** IMA ADPCM Write Functions.
 */
@@ -36,6 +36,8 @@ typedef struct
 	sf_count_t		samplecount ;
 	short			*samples ;
 	unsigned char	*block ;
+	BLOCK_CACHE		cache ;
+	PSF_PIPE		*pipe ;			/* Only when using worker threads. */
 	short			dummydata [] ; /* ISO C99 struct flexible array. */
 } MSADPCM_PRIVATE ;
 
@@ -107,6 +109,8 @@ static sf_count_t	msadpcm_write_d	(SF_PRIVATE *psf, const double *ptr, sf_count_
 
 static sf_count_t msadpcm_seek	(SF_PRIVATE *psf, int mode, sf_count_t offset) ;
 static	int	msadpcm_close	(SF_PRIVATE *psf) ;
+static	int	msadpcm_command	(SF_PRIVATE *psf, int command, void *data, int datasize) ;
+static	int	msadpcm_flush	(SF_PRIVATE *psf) ;
 
 static	void	choose_predictor (unsigned int channels, short *data, int *bpred, int *idelta) ;
 
@@ -135,7 +139,8 @@ wavlike_msadpcm_init	(SF_PRIVATE *psf, int blockalign, int samplesperblock)
 
 	pmssize = sizeof (MSADPCM_PRIVATE) + blockalign + 3 * psf->sf.channels * samplesperblock ;
 
-	if (! (psf->codec_data = calloc (1, pmssize)))
+	/* When reading, the block cache lives at the end of the same allocation. */
+	if (! (psf->codec_data = calloc (1, pmssize + (psf->file.mode == SFM_READ ? psf_block_cache_size (blockalign) : 0))))
 		return SFE_MALLOC_FAILED ;
 	pms = (MSADPCM_PRIVATE*) psf->codec_data ;
 
@@ -160,6 +165,8 @@ wavlike_msadpcm_init	(SF_PRIVATE *psf, int blockalign, int samplesperblock)
 		else
 			pms->blocks = psf->datalength / pms->blocksize ;
 
+		psf_block_cache_init (&pms->cache, (unsigned char *) pms + pmssize, pms->blocksize, pms->blocks) ;
+
 		count = 2 * (pms->blocksize - 6 * pms->channels) / pms->channels ;
 		if (pms->samplesperblock != count)
 		{	psf_log_printf (psf, "*** Error : samplesperblock should be %d.\n", count) ;
@@ -185,8 +192,11 @@ wavlike_msadpcm_init	(SF_PRIVATE *psf, int blockalign, int samplesperblock)
 		psf->write_int		= msadpcm_write_i ;
 		psf->write_float	= msadpcm_write_f ;
 		psf->write_double	= msadpcm_write_d ;
+
+		psf->codec_flush = msadpcm_flush ;
 		} ;
 
+	psf->codec_command = msadpcm_command ;
 	psf->codec_close = msadpcm_close ;
 	psf->seek = msadpcm_seek ;
 
@@ -195,65 +205,51 @@ wavlike_msadpcm_init	(SF_PRIVATE *psf, int blockalign, int samplesperblock)
 
 
 static inline short
-msadpcm_get_bpred (SF_PRIVATE *psf, MSADPCM_PRIVATE *pms, unsigned char value)
+msadpcm_get_bpred (unsigned char value, int *bad)
 {	if (value >= WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT)
-	{	if (pms->sync_error == 0)
-		{	pms->sync_error = 1 ;
-			psf_log_printf (psf, "MS ADPCM synchronisation error (%u should be < %u).\n", value, WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT) ;
-			} ;
+	{	if (*bad == 0)
+			*bad = value ;
 		return 0 ;
 		} ;
 	return value ;
 } /* msadpcm_get_bpred */
 
-
+/*	Decode one block. This only touches its arguments so blocks can be decoded
+**	on worker threads. Returns the first out of range predictor, or 0.
+*/
 static int
-msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
-{	int		chan, k, blockindx, sampleindx ;
+msadpcm_decode_samples	(int channels, int blocksize, int samplesperblock, const unsigned char *block, short *samples)
+{	int		chan, k, blockindx, sampleindx, bad = 0 ;
 	short	bytecode, bpred [2], chan_idelta [2] ;
 
 	int predict ;
 	int current ;
 	int idelta ;
 
-	pms->blockcount ++ ;
-	pms->samplecount = 0 ;
-
-	if (pms->blockcount > pms->blocks)
-	{	memset (pms->samples, 0, pms->samplesperblock * pms->channels) ;
-		return 1 ;
-		} ;
-
-	if ((k = psf_fread (pms->block, 1, pms->blocksize, psf)) != pms->blocksize)
-	{	psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pms->blocksize) ;
-		if (k <= 0)
-			return 1 ;
-		} ;
-
 	/* Read and check the block header. */
 
-	if (pms->channels == 1)
-	{	bpred [0] = msadpcm_get_bpred (psf, pms, pms->block [0]) ;
+	if (channels == 1)
+	{	bpred [0] = msadpcm_get_bpred (block [0], &bad) ;
 
-		chan_idelta [0] = pms->block [1] | (pms->block [2] << 8) ;
+		chan_idelta [0] = block [1] | (block [2] << 8) ;
 		chan_idelta [1] = 0 ;
 
-		pms->samples [1] = pms->block [3] | (pms->block [4] << 8) ;
-		pms->samples [0] = pms->block [5] | (pms->block [6] << 8) ;
+		samples [1] = block [3] | (block [4] << 8) ;
+		samples [0] = block [5] | (block [6] << 8) ;
 		blockindx = 7 ;
 		}
 	else
-	{	bpred [0] = msadpcm_get_bpred (psf, pms, pms->block [0]) ;
-		bpred [1] = msadpcm_get_bpred (psf, pms, pms->block [1]) ;
+	{	bpred [0] = msadpcm_get_bpred (block [0], &bad) ;
+		bpred [1] = msadpcm_get_bpred (block [1], &bad) ;
 
-		chan_idelta [0] = pms->block [2] | (pms->block [3] << 8) ;
-		chan_idelta [1] = pms->block [4] | (pms->block [5] << 8) ;
+		chan_idelta [0] = block [2] | (block [3] << 8) ;
+		chan_idelta [1] = block [4] | (block [5] << 8) ;
 
-		pms->samples [2] = pms->block [6] | (pms->block [7] << 8) ;
-		pms->samples [3] = pms->block [8] | (pms->block [9] << 8) ;
+		samples [2] = block [6] | (block [7] << 8) ;
+		samples [3] = block [8] | (block [9] << 8) ;
 
-		pms->samples [0] = pms->block [10] | (pms->block [11] << 8) ;
-		pms->samples [1] = pms->block [12] | (pms->block [13] << 8) ;
+		samples [0] = block [10] | (block [11] << 8) ;
+		samples [1] = block [12] | (block [13] << 8) ;
 
 		blockindx = 14 ;
 		} ;
@@ -273,19 +269,19 @@ msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 	** correct sample positions.
 	*/
 
-	sampleindx = 2 * pms->channels ;
-	while (blockindx < pms->blocksize)
-	{	bytecode = pms->block [blockindx++] ;
-		pms->samples [sampleindx++] = (bytecode >> 4) & 0x0F ;
-		pms->samples [sampleindx++] = bytecode & 0x0F ;
+	sampleindx = 2 * channels ;
+	while (blockindx < blocksize)
+	{	bytecode = block [blockindx++] ;
+		samples [sampleindx++] = (bytecode >> 4) & 0x0F ;
+		samples [sampleindx++] = bytecode & 0x0F ;
 		} ;
 
 	/* Decode the encoded 4 bit samples. */
 
-	for (k = 2 * pms->channels ; k < (pms->samplesperblock * pms->channels) ; k ++)
-	{	chan = (pms->channels > 1) ? (k % 2) : 0 ;
+	for (k = 2 * channels ; k < (samplesperblock * channels) ; k ++)
+	{	chan = (channels > 1) ? (k % 2) : 0 ;
 
-		bytecode = pms->samples [k] & 0xF ;
+		bytecode = samples [k] & 0xF ;
 
 		/* Compute next Adaptive Scale Factor (ASF) */
 		idelta = chan_idelta [chan] ;
@@ -295,8 +291,8 @@ msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 		if (bytecode & 0x8)
 			bytecode -= 0x10 ;
 
-		predict = ((pms->samples [k - pms->channels] * AdaptCoeff1 [bpred [chan]])
-					+ (pms->samples [k - 2 * pms->channels] * AdaptCoeff2 [bpred [chan]])) >> 8 ; /* => / 256 => FIXED_POINT_COEFF_BASE == 256 */
+		predict = ((samples [k - channels] * AdaptCoeff1 [bpred [chan]])
+					+ (samples [k - 2 * channels] * AdaptCoeff2 [bpred [chan]])) >> 8 ; /* => / 256 => FIXED_POINT_COEFF_BASE == 256 */
 		current = (bytecode * idelta) + predict ;
 
 		if (current > 32767)
@@ -304,9 +300,54 @@ msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 		else if (current < -32768)
 			current = -32768 ;
 
-		pms->samples [k] = current ;
+		samples [k] = current ;
+		} ;
+
+	return bad ;
+} /* msadpcm_decode_samples */
+
+static void
+msadpcm_sync_error	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms, int bad)
+{	if (bad == 0 || pms->sync_error != 0)
+		return ;
+
+	pms->sync_error = 1 ;
+	psf_log_printf (psf, "MS ADPCM synchronisation error (%u should be < %u).\n", bad, WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT) ;
+} /* msadpcm_sync_error */
+
+static int
+msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
+{	int		k ;
+
+	pms->blockcount ++ ;
+	pms->samplecount = 0 ;
+
+	if (pms->blockcount > pms->blocks)
+	{	memset (pms->samples, 0, pms->samplesperblock * pms->channels) ;
+		return 1 ;
+		} ;
+
+	if (pms->pipe != NULL)
+	{	PSF_PIPE_SLOT *slot ;
+
+		/* A short read drops back to the code below, which logs it. */
+		if ((slot = psf_pipe_read_block (pms->pipe, pms->blockcount - 1)) != NULL)
+		{	memcpy (pms->block, slot->in, pms->blocksize) ;
+			memcpy (pms->samples, slot->out, pms->samplesperblock * pms->channels * sizeof (short)) ;
+			msadpcm_sync_error (psf, pms, slot->error) ;
+			return 0 ;
+			} ;
 		} ;
 
+	if ((k = psf_block_cache_read (psf, &pms->cache, pms->blockcount - 1, pms->block)) != pms->blocksize)
+	{	psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pms->blocksize) ;
+		if (k <= 0)
+			return 1 ;
+		} ;
+
+	k = msadpcm_decode_samples (pms->channels, pms->blocksize, pms->samplesperblock, pms->block, pms->samples) ;
+	msadpcm_sync_error (psf, pms, k) ;
+
 	return 0 ;
 } /* msadpcm_decode_block */
 
@@ -516,33 +557,37 @@ wavlike_msadpcm_write_adapt_coeffs	(SF_PRIVATE *psf)
 /*==========================================================================================
 */
 
-static int
-msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
+/*	Encode one block of samples. This only touches its arguments so blocks can
+**	be encoded on worker threads. The samples are replaced by their decoded
+**	values, as they must be for the predictor.
+*/
+static void
+msadpcm_encode_samples	(int channels, int samplesperblock, short *samples, unsigned char *block)
 {	unsigned int	blockindx ;
 	unsigned char	byte ;
 	int				chan, k, predict, bpred [2], idelta [2], errordelta, newsamp ;
 
-	choose_predictor (pms->channels, pms->samples, bpred, idelta) ;
+	choose_predictor (channels, samples, bpred, idelta) ;
 
 	/* Write the block header. */
 
-	if (pms->channels == 1)
-	{	pms->block [0]	= bpred [0] ;
-		pms->block [1]	= idelta [0] & 0xFF ;
-		pms->block [2]	= idelta [0] >> 8 ;
-		pms->block [3]	= pms->samples [1] & 0xFF ;
-		pms->block [4]	= pms->samples [1] >> 8 ;
-		pms->block [5]	= pms->samples [0] & 0xFF ;
-		pms->block [6]	= pms->samples [0] >> 8 ;
+	if (channels == 1)
+	{	block [0]	= bpred [0] ;
+		block [1]	= idelta [0] & 0xFF ;
+		block [2]	= idelta [0] >> 8 ;
+		block [3]	= samples [1] & 0xFF ;
+		block [4]	= samples [1] >> 8 ;
+		block [5]	= samples [0] & 0xFF ;
+		block [6]	= samples [0] >> 8 ;
 
 		blockindx = 7 ;
 		byte = 0 ;
 
 		/* Encode the samples as 4 bit. */
 
-		for (k = 2 ; k < pms->samplesperblock ; k++)
-		{	predict = (pms->samples [k-1] * AdaptCoeff1 [bpred [0]] + pms->samples [k-2] * AdaptCoeff2 [bpred [0]]) >> 8 ;
-			errordelta = (pms->samples [k] - predict) / idelta [0] ;
+		for (k = 2 ; k < samplesperblock ; k++)
+		{	predict = (samples [k-1] * AdaptCoeff1 [bpred [0]] + samples [k-2] * AdaptCoeff2 [bpred [0]]) >> 8 ;
+			errordelta = (samples [k] - predict) / idelta [0] ;
 			if (errordelta < -8)
 				errordelta = -8 ;
 			else if (errordelta > 7)
@@ -557,45 +602,45 @@ msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 
 			byte = (byte << 4) | (errordelta & 0xF) ;
 			if (k % 2)
-			{	pms->block [blockindx++] = byte ;
+			{	block [blockindx++] = byte ;
 				byte = 0 ;
 				} ;
 
 			idelta [0] = (idelta [0] * AdaptationTable [errordelta]) >> 8 ;
 			if (idelta [0] < 16)
 				idelta [0] = 16 ;
-			pms->samples [k] = newsamp ;
+			samples [k] = newsamp ;
 			} ;
 		}
 	else
 	{	/* Stereo file. */
-		pms->block [0]	= bpred [0] ;
-		pms->block [1]	= bpred [1] ;
+		block [0]	= bpred [0] ;
+		block [1]	= bpred [1] ;
 
-		pms->block [2]	= idelta [0] & 0xFF ;
-		pms->block [3]	= idelta [0] >> 8 ;
-		pms->block [4]	= idelta [1] & 0xFF ;
-		pms->block [5]	= idelta [1] >> 8 ;
+		block [2]	= idelta [0] & 0xFF ;
+		block [3]	= idelta [0] >> 8 ;
+		block [4]	= idelta [1] & 0xFF ;
+		block [5]	= idelta [1] >> 8 ;
 
-		pms->block [6]	= pms->samples [2] & 0xFF ;
-		pms->block [7]	= pms->samples [2] >> 8 ;
-		pms->block [8]	= pms->samples [3] & 0xFF ;
-		pms->block [9]	= pms->samples [3] >> 8 ;
+		block [6]	= samples [2] & 0xFF ;
+		block [7]	= samples [2] >> 8 ;
+		block [8]	= samples [3] & 0xFF ;
+		block [9]	= samples [3] >> 8 ;
 
-		pms->block [10]	= pms->samples [0] & 0xFF ;
-		pms->block [11]	= pms->samples [0] >> 8 ;
-		pms->block [12]	= pms->samples [1] & 0xFF ;
-		pms->block [13]	= pms->samples [1] >> 8 ;
+		block [10]	= samples [0] & 0xFF ;
+		block [11]	= samples [0] >> 8 ;
+		block [12]	= samples [1] & 0xFF ;
+		block [13]	= samples [1] >> 8 ;
 
 		blockindx = 14 ;
 		byte = 0 ;
 		chan = 1 ;
 
-		for (k = 4 ; k < 2 * pms->samplesperblock ; k++)
+		for (k = 4 ; k < 2 * samplesperblock ; k++)
 		{	chan = k & 1 ;
 
-			predict = (pms->samples [k-2] * AdaptCoeff1 [bpred [chan]] + pms->samples [k-4] * AdaptCoeff2 [bpred [chan]]) >> 8 ;
-			errordelta = (pms->samples [k] - predict) / idelta [chan] ;
+			predict = (samples [k-2] * AdaptCoeff1 [bpred [chan]] + samples [k-4] * AdaptCoeff2 [bpred [chan]]) >> 8 ;
+			errordelta = (samples [k] - predict) / idelta [chan] ;
 
 
 			if (errordelta < -8)
@@ -613,21 +658,39 @@ msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 			byte = (byte << 4) | (errordelta & 0xF) ;
 
 			if (chan)
-			{	pms->block [blockindx++] = byte ;
+			{	block [blockindx++] = byte ;
 				byte = 0 ;
 				} ;
 
 			idelta [chan] = (idelta [chan] * AdaptationTable [errordelta]) >> 8 ;
 			if (idelta [chan] < 16)
 				idelta [chan] = 16 ;
-			pms->samples [k] = newsamp ;
+			samples [k] = newsamp ;
 			} ;
 		} ;
+} /* msadpcm_encode_samples */
+
+static int
+msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
+{	int k ;
+
+	if (pms->pipe != NULL)
+	{	PSF_PIPE_SLOT *slot ;
 
-	/* Write the block to disk. */
+		if ((slot = psf_pipe_write_slot (pms->pipe)) == NULL)
+			return 0 ;
 
-	if ((k = psf_fwrite (pms->block, 1, pms->blocksize, psf)) != pms->blocksize)
-		psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, pms->blocksize) ;
+		memcpy (slot->in, pms->samples, pms->samplesperblock * pms->channels * sizeof (short)) ;
+		psf_pipe_write_submit (pms->pipe, slot) ;
+		}
+	else
+	{	msadpcm_encode_samples (pms->channels, pms->samplesperblock, pms->samples, pms->block) ;
+
+		/* Write the block to disk. */
+
+		if ((k = psf_fwrite (pms->block, 1, pms->blocksize, psf)) != pms->blocksize)
+			psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, pms->blocksize) ;
+		} ;
 
 	memset (pms->samples, 0, pms->samplesperblock * sizeof (short)) ;
 
@@ -770,6 +833,70 @@ msadpcm_write_d	(SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 	return total ;
 } /* msadpcm_write_d */
 
+/*========================================================================================
+** Decoding and encoding blocks on worker threads. Each block starts from its own
+** predictor and idelta, so the results are the same as when done serially.
+*/
+
+static int
+msadpcm_pipe_load	(PSF_PIPE *pipe, PSF_PIPE_SLOT *slot, sf_count_t block)
+{	MSADPCM_PRIVATE *pms = pipe->codec ;
+
+	if (block >= pms->blocks)
+		return 0 ;
+
+	return psf_block_cache_read (pipe->psf, &pms->cache, block, slot->in) == pms->blocksize ;
+} /* msadpcm_pipe_load */
+
+static void
+msadpcm_pipe_decode	(PSF_PIPE_SLOT *slot)
+{	MSADPCM_PRIVATE *pms = slot->pipe->codec ;
+
+	slot->error = msadpcm_decode_samples (pms->channels, pms->blocksize, pms->samplesperblock, slot->in, slot->out) ;
+} /* msadpcm_pipe_decode */
+
+static void
+msadpcm_pipe_encode	(PSF_PIPE_SLOT *slot)
+{	MSADPCM_PRIVATE *pms = slot->pipe->codec ;
+
+	msadpcm_encode_samples (pms->channels, pms->samplesperblock, slot->in, slot->out) ;
+} /* msadpcm_pipe_encode */
+
+static int
+msadpcm_pipe_emit	(PSF_PIPE *pipe, PSF_PIPE_SLOT *slot)
+{	MSADPCM_PRIVATE *pms = pipe->codec ;
+	int k ;
+
+	if ((k = psf_fwrite (slot->out, 1, pms->blocksize, pipe->psf)) != pms->blocksize)
+	{	psf_log_printf (pipe->psf, "*** Warning : short write (%d != %d).\n", k, pms->blocksize) ;
+		return 0 ;
+		} ;
+
+	return 1 ;
+} /* msadpcm_pipe_emit */
+
+/*
+**	A short final block is padded with whatever the previous block left behind
+**	in the buffer, the decoded values of its second half. Fetch those from the
+**	slot the previous block was encoded in.
+*/
+static void
+msadpcm_pipe_restore	(MSADPCM_PRIVATE *pms)
+{	PSF_PIPE	*pipe = pms->pipe ;
+	short		*prev ;
+	int			k ;
+
+	psf_pipe_write_flush (pipe) ;
+
+	if (pipe->next == 0)
+		return ;
+
+	prev = pipe->slots [(pipe->next - 1) % pipe->count].in ;
+
+	for (k = SF_MAX (pms->samplesperblock, (int) pms->samplecount * pms->channels) ; k < pms->samplesperblock * pms->channels ; k++)
+		pms->samples [k] = prev [k] ;
+} /* msadpcm_pipe_restore */
+
 /*========================================================================================
 */
 
@@ -785,12 +912,88 @@ msadpcm_close	(SF_PRIVATE *psf)
 		*/
 
 		if (pms->samplecount && pms->samplecount < pms->samplesperblock)
+		{	if (pms->pipe != NULL)
+				msadpcm_pipe_restore (pms) ;
 			msadpcm_encode_block (psf, pms) ;
+			} ;
+
+		msadpcm_flush (psf) ;
 		} ;
 
+	psf_pipe_destroy (pms->pipe) ;
+	pms->pipe = NULL ;
+
 	return 0 ;
 } /* msadpcm_close */
 
+static int
+msadpcm_command	(SF_PRIVATE *psf, int command, void *data, int UNUSED (datasize))
+{	MSADPCM_PRIVATE *pms ;
+	int threads ;
+
+	if ((pms = psf->codec_data) == NULL)
+		return SF_FALSE ;
+
+	switch (command)
+	{	case SFC_SET_ENCODER_THREADS :
+			if (psf->file.mode != SFM_WRITE || psf->have_written)
+				return SF_FALSE ;
+			break ;
+
+		case SFC_SET_DECODER_THREADS :
+			if (psf->file.mode != SFM_READ)
+				return SF_FALSE ;
+			break ;
+
+		default :
+			return SF_FALSE ;
+		} ;
+
+	threads = *((int *) data) ;
+	if (threads < 1 || threads > PSF_MAX_WORKERS)
+		return SF_FALSE ;
+
+	psf_log_printf (psf, "%s : Setting %s to %d.\n", __func__,
+			command == SFC_SET_ENCODER_THREADS ? "SFC_SET_ENCODER_THREADS" : "SFC_SET_DECODER_THREADS", threads) ;
+
+	psf_pipe_destroy (pms->pipe) ;
+	pms->pipe = NULL ;
+
+	if (threads == 1)
+		return SF_TRUE ;
+
+	/* Encoding turns the samples into a block, decoding a block into samples. */
+	if (command == SFC_SET_ENCODER_THREADS)
+		pms->pipe = psf_pipe_create (psf, threads, pms->samplesperblock * pms->channels * sizeof (short), pms->blocksize, 0) ;
+	else
+		pms->pipe = psf_pipe_create (psf, threads, pms->blocksize, pms->samplesperblock * pms->channels * sizeof (short), 0) ;
+
+	if (pms->pipe == NULL)
+		return SF_FALSE ;
+
+	pms->pipe->codec = pms ;
+	if (command == SFC_SET_ENCODER_THREADS)
+	{	pms->pipe->process = msadpcm_pipe_encode ;
+		pms->pipe->emit = msadpcm_pipe_emit ;
+		}
+	else
+	{	pms->pipe->load = msadpcm_pipe_load ;
+		pms->pipe->process = msadpcm_pipe_decode ;
+		} ;
+
+	return SF_TRUE ;
+} /* msadpcm_command */
+
+static int
+msadpcm_flush	(SF_PRIVATE *psf)
+{	MSADPCM_PRIVATE *pms ;
+
+	if ((pms = psf->codec_data) == NULL || pms->pipe == NULL)
+		return 0 ;
+
+	return psf_pipe_write_flush (pms->pipe) ? 0 : SFE_INTERNAL ;
+} /* msadpcm_flush */
+
 /*========================================================================================
 ** Static functions.
 */
@@ -815,29 +1018,44 @@ msadpcm_close	(SF_PRIVATE *psf)
 
 static	void
 choose_predictor (unsigned int channels, short *data, int *block_pred, int *idelta)
-{	unsigned int	chan, k, bpred, idelta_sum, best_bpred, best_idelta ;
+{	unsigned int	chan, k, bpred, idelta_sum [WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT], best_bpred, best_idelta ;
 
 	for (chan = 0 ; chan < channels ; chan++)
-	{	best_bpred = best_idelta = 0 ;
+	{	/* Cost of all seven coefficient pairs at once, from this channel's samples. */
+		for (bpred = 0 ; bpred < WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT ; bpred++)
+			idelta_sum [bpred] = 0 ;
+
+		for (k = 2 ; k < 2 + IDELTA_COUNT ; k++)
+		{	int s0 = data [(k - 2) * channels + chan] ;
+			int s1 = data [(k - 1) * channels + chan] ;
+			int s2 = data [k * channels + chan] ;
 
-		for (bpred = 0 ; bpred < 7 ; bpred++)
-		{	idelta_sum = 0 ;
-			for (k = 2 ; k < 2 + IDELTA_COUNT ; k++)
-				idelta_sum += abs (data [k * channels] - ((data [(k - 1) * channels] * AdaptCoeff1 [bpred] + data [(k - 2) * channels] * AdaptCoeff2 [bpred]) >> 8)) ;
-			idelta_sum /= (4 * IDELTA_COUNT) ;
+			for (bpred = 0 ; bpred < WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT ; bpred++)
+				idelta_sum [bpred] += abs (s2 - ((s1 * AdaptCoeff1 [bpred] + s0 * AdaptCoeff2 [bpred]) >> 8)) ;
+			} ;
 
-			if (bpred == 0 || idelta_sum < best_idelta)
+		/*
+		**	Pick the first pair with the smallest cost, except that the first
+		**	pair with a zero cost wins outright.
+		*/
+		best_bpred = 0 ;
+		best_idelta = idelta_sum [0] / (4 * IDELTA_COUNT) ;
+
+		for (bpred = 0 ; bpred < WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT ; bpred++)
+		{	idelta_sum [bpred] /= (4 * IDELTA_COUNT) ;
+
+			if (idelta_sum [bpred] < best_idelta)
 			{	best_bpred = bpred ;
-				best_idelta = idelta_sum ;
+				best_idelta = idelta_sum [bpred] ;
 				} ;
 
-			if (! idelta_sum)
+			if (idelta_sum [bpred] == 0)
 			{	best_bpred = bpred ;
 				best_idelta = 16 ;
 				break ;
 				} ;
+			} ;
 
-			} ; /* for bpred ... */
 		if (best_idelta < 16)
 			best_idelta = 16 ;
 
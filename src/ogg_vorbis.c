@@ -368,7 +368,7 @@ vorbis_write_header (SF_PRIVATE *psf, int UNUSED (calc_length))
 	vorbis_comment_init (&vdata->vcomment) ;
 
 	vorbis_comment_add_tag (&vdata->vcomment, "ENCODER", "libsndfile") ;
-	for (k = 0 ; k < SF_MAX_STRINGS ; k++)
+	for (k = 0 ; psf->strings.data != NULL && k < SF_MAX_STRINGS ; k++)
 	{	const char * name ;
 
 		if (psf->strings.data [k].type == 0)
@@ -45,6 +45,9 @@
 #define	PAF24_SAMPLES_PER_BLOCK		10
 #define	PAF24_BLOCK_SIZE			32
 
+/* Blocks are tiny, so each worker job decodes this many. */
+#define	PAF24_PIPE_BLOCKS			256
+
 /*------------------------------------------------------------------------------
 ** Typedefs.
 */
@@ -61,9 +64,12 @@ typedef	struct
 typedef struct
 {	int				max_blocks, channels, blocksize ;
 	int				read_block, write_block, read_count, write_count ;
+	int				endswap ;
 	sf_count_t		sample_count ;
 	int				*samples ;
 	int				*block ;
+	BLOCK_CACHE		cache ;		/* Only used in SFM_READ mode. */
+	PSF_PIPE		*pipe ;		/* Only when decoding on worker threads. */
 	int				data [] ; /* ISO C99 struct flexible array. */
 } PAF24_PRIVATE ;
 
@@ -339,6 +345,7 @@ paf_write_header (SF_PRIVATE *psf, int UNUSED (calc_length))
 static int paf24_read_block (SF_PRIVATE *psf, PAF24_PRIVATE *ppaf24) ;
 static int paf24_write_block (SF_PRIVATE *psf, PAF24_PRIVATE *ppaf24) ;
 static int paf24_close (SF_PRIVATE *psf) ;
+static int paf24_command (SF_PRIVATE *psf, int command, void *data, int datasize) ;
 
 
 static int
@@ -355,6 +362,10 @@ paf24_init (SF_PRIVATE *psf)
 	*/
 	psf->last_op = 0 ;
 
+	/* When reading, the block cache lives at the end of the same allocation. */
+	if (psf->file.mode == SFM_READ)
+		paf24size += psf_block_cache_size (PAF24_BLOCK_SIZE * psf->sf.channels) ;
+
 	if (! (psf->codec_data = calloc (1, paf24size)))
 		return SFE_MALLOC_FAILED ;
 
@@ -365,6 +376,7 @@ paf24_init (SF_PRIVATE *psf)
 	ppaf24->block		= ppaf24->data + PAF24_SAMPLES_PER_BLOCK * ppaf24->channels ;
 
 	ppaf24->blocksize = PAF24_BLOCK_SIZE * ppaf24->channels ;
+	ppaf24->endswap = (CPU_IS_BIG_ENDIAN && psf->endian == SF_ENDIAN_LITTLE) || (CPU_IS_LITTLE_ENDIAN && psf->endian == SF_ENDIAN_BIG) ;
 
 	if (psf->file.mode == SFM_READ || psf->file.mode == SFM_RDWR)
 	{	paf24_read_block (psf, ppaf24) ;	/* Read first block. */
@@ -385,6 +397,9 @@ paf24_init (SF_PRIVATE *psf)
 	psf->seek	= paf24_seek ;
 	psf->container_close	= paf24_close ;
 
+	if (psf->file.mode == SFM_READ)
+		psf->codec_command = paf24_command ;
+
 	psf->filelength = psf_get_filelen (psf) ;
 	psf->datalength = psf->filelength - psf->dataoffset ;
 
@@ -396,6 +411,9 @@ paf24_init (SF_PRIVATE *psf)
 	else
 		ppaf24->max_blocks = psf->datalength / ppaf24->blocksize ;
 
+	if (psf->file.mode == SFM_READ)
+		psf_block_cache_init (&ppaf24->cache, ppaf24->block + 8 * ppaf24->channels, ppaf24->blocksize, ppaf24->max_blocks) ;
+
 	ppaf24->read_block = 0 ;
 	if (psf->file.mode == SFM_RDWR)
 		ppaf24->write_block = ppaf24->max_blocks ;
@@ -474,16 +492,37 @@ paf24_close (SF_PRIVATE *psf)
 			paf24_write_block (psf, ppaf24) ;
 		} ;
 
+	psf_pipe_destroy (ppaf24->pipe) ;
+	ppaf24->pipe = NULL ;
+
 	return 0 ;
 } /* paf24_close */
 
 /*---------------------------------------------------------------------------
 */
-static int
-paf24_read_block (SF_PRIVATE *psf, PAF24_PRIVATE *ppaf24)
+
+/* Only uses its arguments, so it can run on a worker thread. */
+static void
+paf24_unpack_block (int channels, int endswap, int *block, int *samples)
 {	int				k, channel ;
 	unsigned char	*cptr ;
 
+	/* Do endian swapping if necessary. */
+	if (endswap)
+		endswap_int_array (block, 8 * channels) ;
+
+	/* Unpack block. */
+	for (k = 0 ; k < PAF24_SAMPLES_PER_BLOCK * channels ; k++)
+	{	channel = k % channels ;
+		cptr = ((unsigned char *) block) + PAF24_BLOCK_SIZE * channel + 3 * (k / channels) ;
+		samples [k] = (cptr [0] << 8) | (cptr [1] << 16) | (((unsigned) cptr [2]) << 24) ;
+		} ;
+} /* paf24_unpack_block */
+
+static int
+paf24_read_block (SF_PRIVATE *psf, PAF24_PRIVATE *ppaf24)
+{	int				k ;
+
 	ppaf24->read_block ++ ;
 	ppaf24->read_count = 0 ;
 
@@ -492,20 +531,30 @@ paf24_read_block (SF_PRIVATE *psf, PAF24_PRIVATE *ppaf24)
 		return 1 ;
 		} ;
 
+	if (ppaf24->pipe != NULL)
+	{	PSF_PIPE_SLOT	*slot ;
+		int				indx = (ppaf24->read_block - 1) % PAF24_PIPE_BLOCKS ;
+
+		/* A short read drops back to the code below, which logs it. */
+		slot = psf_pipe_read_block (ppaf24->pipe, (ppaf24->read_block - 1) / PAF24_PIPE_BLOCKS) ;
+		if (slot != NULL && indx < slot->in_len)
+		{	memcpy (ppaf24->block, (char *) slot->in + indx * ppaf24->blocksize, ppaf24->blocksize) ;
+			memcpy (ppaf24->samples, (int *) slot->out + indx * PAF24_SAMPLES_PER_BLOCK * ppaf24->channels,
+						PAF24_SAMPLES_PER_BLOCK * ppaf24->channels * sizeof (int)) ;
+			return 1 ;
+			} ;
+		} ;
+
 	/* Read the block. */
-	if ((k = psf_fread (ppaf24->block, 1, ppaf24->blocksize, psf)) != ppaf24->blocksize)
-		psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, ppaf24->blocksize) ;
+	if (psf->file.mode == SFM_READ)
+		k = psf_block_cache_read (psf, &ppaf24->cache, ppaf24->read_block - 1, ppaf24->block) ;
+	else
+		k = psf_fread (ppaf24->block, 1, ppaf24->blocksize, psf) ;
 
-	/* Do endian swapping if necessary. */
-	if ((CPU_IS_BIG_ENDIAN && psf->endian == SF_ENDIAN_LITTLE) || (CPU_IS_LITTLE_ENDIAN && psf->endian == SF_ENDIAN_BIG))
-		endswap_int_array (ppaf24->block, 8 * ppaf24->channels) ;
+	if (k != ppaf24->blocksize)
+		psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, ppaf24->blocksize) ;
 
-	/* Unpack block. */
-	for (k = 0 ; k < PAF24_SAMPLES_PER_BLOCK * ppaf24->channels ; k++)
-	{	channel = k % ppaf24->channels ;
-		cptr = ((unsigned char *) ppaf24->block) + PAF24_BLOCK_SIZE * channel + 3 * (k / ppaf24->channels) ;
-		ppaf24->samples [k] = (cptr [0] << 8) | (cptr [1] << 16) | (((unsigned) cptr [2]) << 24) ;
-		} ;
+	paf24_unpack_block (ppaf24->channels, ppaf24->endswap, ppaf24->block, ppaf24->samples) ;
 
 	return 1 ;
 } /* paf24_read_block */
@@ -816,3 +865,65 @@ paf24_write_d (SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 	return total ;
 } /* paf24_write_d */
 
+/*==============================================================================
+** Decoding blocks on worker threads. Each pipe block is PAF24_PIPE_BLOCKS file
+** blocks, in_len says how many of them were read.
+*/
+
+static int
+paf24_pipe_load (PSF_PIPE *pipe, PSF_PIPE_SLOT *slot, sf_count_t block)
+{	PAF24_PRIVATE	*ppaf24 = pipe->codec ;
+	sf_count_t		first = block * PAF24_PIPE_BLOCKS ;
+	int				k ;
+
+	/* A partial block at the end of the file is left to paf24_read_block (). */
+	for (k = 0 ; k < PAF24_PIPE_BLOCKS && first + k < ppaf24->max_blocks ; k++)
+		if (psf_block_cache_read (pipe->psf, &ppaf24->cache, first + k, (char *) slot->in + k * ppaf24->blocksize) != ppaf24->blocksize)
+			break ;
+
+	slot->in_len = k ;
+
+	return k > 0 ;
+} /* paf24_pipe_load */
+
+static void
+paf24_pipe_decode (PSF_PIPE_SLOT *slot)
+{	PAF24_PRIVATE	*ppaf24 = slot->pipe->codec ;
+	int				k ;
+
+	for (k = 0 ; k < slot->in_len ; k++)
+		paf24_unpack_block (ppaf24->channels, ppaf24->endswap, (int *) ((char *) slot->in + k * ppaf24->blocksize),
+				(int *) slot->out + k * PAF24_SAMPLES_PER_BLOCK * ppaf24->channels) ;
+} /* paf24_pipe_decode */
+
+static int
+paf24_command (SF_PRIVATE *psf, int command, void *data, int UNUSED (datasize))
+{	PAF24_PRIVATE	*ppaf24 ;
+	int				threads ;
+
+	if ((ppaf24 = psf->codec_data) == NULL || command != SFC_SET_DECODER_THREADS)
+		return SF_FALSE ;
+
+	threads = *((int *) data) ;
+	if (threads < 1 || threads > PSF_MAX_WORKERS)
+		return SF_FALSE ;
+
+	psf_log_printf (psf, "%s : Setting SFC_SET_DECODER_THREADS to %d.\n", __func__, threads) ;
+
+	psf_pipe_destroy (ppaf24->pipe) ;
+	ppaf24->pipe = NULL ;
+
+	if (threads == 1)
+		return SF_TRUE ;
+
+	ppaf24->pipe = psf_pipe_create (psf, threads, PAF24_PIPE_BLOCKS * ppaf24->blocksize,
+						PAF24_PIPE_BLOCKS * PAF24_SAMPLES_PER_BLOCK * ppaf24->channels * sizeof (int), 0) ;
+	if (ppaf24->pipe == NULL)
+		return SF_FALSE ;
+
+	ppaf24->pipe->codec = ppaf24 ;
+	ppaf24->pipe->load = paf24_pipe_load ;
+	ppaf24->pipe->process = paf24_pipe_decode ;
+
+	return SF_TRUE ;
+} /* paf24_command */
@@ -264,14 +264,7 @@ pcm_init (SF_PRIVATE *psf)
 
 		} ;
 
-	if (psf->filelength > psf->dataoffset)
-	{	psf->datalength = (psf->dataend > 0) ? psf->dataend - psf->dataoffset :
-							psf->filelength - psf->dataoffset ;
-		}
-	else
-		psf->datalength = 0 ;
-
-	psf->sf.frames = psf->blockwidth > 0 ? psf->datalength / psf->blockwidth : 0 ;
+	psf_set_fixed_frames (psf) ;
 
 	return 0 ;
 } /* pcm_init */
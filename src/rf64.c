@@ -63,12 +63,26 @@
 
 #define RIFF_DOWNGRADE_BYTES	((sf_count_t) 0xffffffff)
 
+/*
+** Size of the ds64 chunk body (RIFF size, data size, frames and an empty
+** table). A downgraded header reserves this much with a JUNK chunk so that
+** the two layouts are the same size and the data never has to move.
+*/
+#define DS64_CHUNK_SIZE			28
+
+/* Header layouts, recorded in psf->hpatch.layout. */
+enum
+{	RF64_LAYOUT_RIFF = 1,
+	RF64_LAYOUT_DS64
+} ;
+
 /*------------------------------------------------------------------------------
 ** Private static functions.
 */
 
 static int	rf64_read_header (SF_PRIVATE *psf, int *blockalign, int *framesperblock) ;
 static int	rf64_write_header (SF_PRIVATE *psf, int calc_length) ;
+static int	rf64_update_header (SF_PRIVATE *psf) ;
 static int	rf64_write_tailer (SF_PRIVATE *psf) ;
 static int	rf64_close (SF_PRIVATE *psf) ;
 static int	rf64_command (SF_PRIVATE *psf, int command, void * UNUSED (data), int datasize) ;
@@ -122,6 +136,7 @@ rf64_open (SF_PRIVATE *psf)
 			return error ;
 
 		psf->write_header = rf64_write_header ;
+		psf->update_header = rf64_update_header ;
 		psf->set_chunk = rf64_set_chunk ;
 		} ;
 
@@ -199,8 +214,10 @@ rf64_read_header (SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 
 	while (NOT (done))
 	{
-		marker = chunk_size = 0 ;
-		psf_binheader_readf (psf, "em4", &marker, &chunk_size) ;
+		psf->rwf_endian = SF_ENDIAN_LITTLE ;
+		psf_header_prefetch (psf, 8) ;
+		marker = psf_header_get_marker (psf) ;
+		chunk_size = psf_header_get_32 (psf) ;
 
 		if (marker == 0)
 		{	sf_count_t pos = psf_ftell (psf) ;
@@ -219,11 +236,14 @@ rf64_read_header (SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 
 				{	unsigned int table_len, bytesread ;
 
-					/* Read ds64 sizes (3 8-byte words). */
-					bytesread = psf_binheader_readf (psf, "888", &riff_size, &ds64_datalength, &frame_count) ;
+					/* Read ds64 sizes (3 8-byte words) and the table length. */
+					psf_header_prefetch (psf, 28) ;
+					riff_size = psf_header_get_64 (psf) ;
+					ds64_datalength = psf_header_get_64 (psf) ;
+					frame_count = psf_header_get_64 (psf) ;
+					table_len = psf_header_get_32 (psf) ;
+					bytesread = 28 ;
 
-					/* Read table length. */
-					bytesread += psf_binheader_readf (psf, "4", &table_len) ;
 					/* Skip table for now. (this was "table_len + 4", why?) */
 					bytesread += psf_binheader_readf (psf, "j", table_len) ;
 
@@ -345,6 +365,20 @@ rf64_read_header (SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 				psf_binheader_readf (psf, "j", chunk_size) ;
 				break ;
 
+			case fact_MARKER :
+				if (chunk_size < 4)
+				{	psf_log_printf (psf, "%M : %u (should be >= 4)\n", marker, chunk_size) ;
+					psf_binheader_readf (psf, "j", chunk_size) ;
+					break ;
+					} ;
+
+				{	uint32_t fact_frames ;
+
+					psf_binheader_readf (psf, "4j", &fact_frames, make_size_t (chunk_size - 4)) ;
+					psf_log_printf (psf, "%M : %u\n  frames : %u\n", marker, chunk_size, fact_frames) ;
+				}
+				break ;
+
 			default :
 					if (chunk_size >= 0xffff0000)
 					{	psf_log_printf (psf, "*** Unknown chunk marker (%X) at position %D with length %u. Exiting parser.\n", marker, psf_ftell (psf) - 8, chunk_size) ;
@@ -542,26 +576,24 @@ rf64_write_fmt_chunk (SF_PRIVATE *psf)
 		case SF_FORMAT_ALAW :
 			fmt_size = 2 + 2 + 4 + 4 + 2 + 2 + 2 + 2 + 4 + 4 + 2 + 2 + 8 ;
 
-			/* fmt : format, channels, samplerate */
-			psf_binheader_writef (psf, "4224", fmt_size, WAVE_FORMAT_EXTENSIBLE, psf->sf.channels, psf->sf.samplerate) ;
-			/*  fmt : bytespersec */
-			psf_binheader_writef (psf, "4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-			/*  fmt : blockalign, bitwidth */
-			psf_binheader_writef (psf, "22", psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
+			/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth */
+			psf_header_put_32 (psf, fmt_size) ;
+			wavlike_write_fmt_fields (psf, WAVE_FORMAT_EXTENSIBLE, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+						psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
 
 			/* cbSize 22 is sizeof (WAVEFORMATEXTENSIBLE) - sizeof (WAVEFORMATEX) */
-			psf_binheader_writef (psf, "2", 22) ;
+			psf_header_put_16 (psf, 22) ;
 
 			/* wValidBitsPerSample, for our use same as bitwidth as we use it fully */
-			psf_binheader_writef (psf, "2", psf->bytewidth * 8) ;
+			psf_header_put_16 (psf, psf->bytewidth * 8) ;
 
 			/* For an Ambisonic file set the channel mask to zero.
 			** Otherwise use a default based on the channel count.
 			*/
 			if (wpriv->wavex_ambisonic != SF_AMBISONIC_NONE)
-				psf_binheader_writef (psf, "4", 0) ;
+				psf_header_put_32 (psf, 0) ;
 			else if (wpriv->wavex_channelmask != 0)
-				psf_binheader_writef (psf, "4", wpriv->wavex_channelmask) ;
+				psf_header_put_32 (psf, wpriv->wavex_channelmask) ;
 			else
 			{	/*
 				** Ok some liberty is taken here to use the most commonly used channel masks
@@ -570,27 +602,27 @@ rf64_write_fmt_chunk (SF_PRIVATE *psf)
 				*/
 				switch (psf->sf.channels)
 				{	case 1 :	/* center channel mono */
-						psf_binheader_writef (psf, "4", 0x4) ;
+						psf_header_put_32 (psf, 0x4) ;
 						break ;
 
 					case 2 :	/* front left and right */
-						psf_binheader_writef (psf, "4", 0x1 | 0x2) ;
+						psf_header_put_32 (psf, 0x1 | 0x2) ;
 						break ;
 
 					case 4 :	/* Quad */
-						psf_binheader_writef (psf, "4", 0x1 | 0x2 | 0x10 | 0x20) ;
+						psf_header_put_32 (psf, 0x1 | 0x2 | 0x10 | 0x20) ;
 						break ;
 
 					case 6 :	/* 5.1 */
-						psf_binheader_writef (psf, "4", 0x1 | 0x2 | 0x4 | 0x8 | 0x10 | 0x20) ;
+						psf_header_put_32 (psf, 0x1 | 0x2 | 0x4 | 0x8 | 0x10 | 0x20) ;
 						break ;
 
 					case 8 :	/* 7.1 */
-						psf_binheader_writef (psf, "4", 0x1 | 0x2 | 0x4 | 0x8 | 0x10 | 0x20 | 0x40 | 0x80) ;
+						psf_header_put_32 (psf, 0x1 | 0x2 | 0x4 | 0x8 | 0x10 | 0x20 | 0x40 | 0x80) ;
 						break ;
 
 					default :	/* 0 when in doubt , use direct out, ie NO mapping*/
-						psf_binheader_writef (psf, "4", 0x0) ;
+						psf_header_put_32 (psf, 0x0) ;
 						break ;
 					} ;
 				} ;
@@ -633,6 +665,30 @@ rf64_write_fmt_chunk (SF_PRIVATE *psf)
 } /* rf64_write_fmt_chunk */
 
 
+static void
+rf64_calc_length (SF_PRIVATE *psf)
+{
+	psf->filelength = psf_get_filelen (psf) ;
+	psf->datalength = psf->filelength - psf->dataoffset ;
+
+	if (psf->dataend)
+		psf->datalength -= psf->filelength - psf->dataend ;
+
+	if (psf->bytewidth > 0)
+		psf->sf.frames = psf->datalength / (psf->bytewidth * psf->sf.channels) ;
+} /* rf64_calc_length */
+
+/* Whether the header is written as plain RIFF or as RF64 with a ds64 chunk. */
+static int
+rf64_header_layout (SF_PRIVATE *psf)
+{	WAVLIKE_PRIVATE	*wpriv = psf->container_data ;
+
+	if (wpriv->rf64_downgrade && psf->filelength < RIFF_DOWNGRADE_BYTES)
+		return RF64_LAYOUT_RIFF ;
+
+	return RF64_LAYOUT_DS64 ;
+} /* rf64_header_layout */
+
 static int
 rf64_write_header (SF_PRIVATE *psf, int calc_length)
 {	sf_count_t	current, pad_size ;
@@ -648,34 +704,51 @@ rf64_write_header (SF_PRIVATE *psf, int calc_length)
 		has_data = SF_TRUE ;
 
 	if (calc_length)
-	{	psf->filelength = psf_get_filelen (psf) ;
-		psf->datalength = psf->filelength - psf->dataoffset ;
-
-		if (psf->dataend)
-			psf->datalength -= psf->filelength - psf->dataend ;
-
-		if (psf->bytewidth > 0)
-			psf->sf.frames = psf->datalength / (psf->bytewidth * psf->sf.channels) ;
-		} ;
+		rf64_calc_length (psf) ;
 
 	/* Reset the current header length to zero. */
 	psf->header.ptr [0] = 0 ;
 	psf->header.indx = 0 ;
 	psf_fseek (psf, 0, SEEK_SET) ;
-
-	if (wpriv->rf64_downgrade && psf->filelength < RIFF_DOWNGRADE_BYTES)
-	{	psf_binheader_writef (psf, "etm8m", RIFF_MARKER, (psf->filelength < 8) ? 8 : psf->filelength - 8, WAVE_MARKER) ;
-		psf_binheader_writef (psf, "m4z", JUNK_MARKER, 24, 24) ;
-		add_fact_chunk = 1 ;
+	psf_patch_header_reset (psf) ;
+
+	psf->hpatch.layout = rf64_header_layout (psf) ;
+	psf->rwf_endian = SF_ENDIAN_LITTLE ;
+	if (psf->hpatch.layout == RF64_LAYOUT_RIFF)
+	{	psf_header_put_marker (psf, RIFF_MARKER) ;
+		psf_header_put_32 (psf, (psf->filelength < 8) ? 8 : psf->filelength - 8) ;
+		psf_header_put_marker (psf, WAVE_MARKER) ;
+		/* Room for the ds64 chunk should the file grow past 4 gigabytes. */
+		psf_header_put_marker (psf, JUNK_MARKER) ;
+		psf_header_put_32 (psf, DS64_CHUNK_SIZE) ;
+		psf_header_put_zeros (psf, DS64_CHUNK_SIZE) ;
+		psf->hpatch.riff_size = 4 ;
 		}
 	else
-	{	psf_binheader_writef (psf, "em4m", RF64_MARKER, 0xffffffff, WAVE_MARKER) ;
-		/* Currently no table. */
-		psf_binheader_writef (psf, "m48884", ds64_MARKER, 28, psf->filelength - 8, psf->datalength, psf->sf.frames, 0) ;
+	{	psf_header_put_marker (psf, RF64_MARKER) ;
+		psf_header_put_32 (psf, 0xffffffff) ;
+		psf_header_put_marker (psf, WAVE_MARKER) ;
+		/* ds64 : size, RIFF size, data size, frames and table length (currently no table). */
+		psf_header_put_marker (psf, ds64_MARKER) ;
+		psf_header_put_32 (psf, DS64_CHUNK_SIZE) ;
+		psf_header_put_64 (psf, psf->filelength - 8) ;
+		psf_header_put_64 (psf, psf->datalength) ;
+		psf_header_put_64 (psf, psf->sf.frames) ;
+		psf_header_put_32 (psf, 0) ;
+		psf->hpatch.riff_size = psf->header.indx - 28 ;
+		psf->hpatch.data_size = psf->header.indx - 20 ;
+		psf->hpatch.frames = psf->header.indx - 12 ;
 		} ;
 
+	/*
+	** A file which may be downgraded has a 'fact' chunk in both layouts, so
+	** that crossing 4 gigabytes in either direction is a same size rewrite
+	** of the header and never touches the data.
+	*/
+	add_fact_chunk = wpriv->rf64_downgrade ;
+
 	/* WAVE and 'fmt ' markers. */
-	psf_binheader_writef (psf, "m", fmt_MARKER) ;
+	psf_header_put_marker (psf, fmt_MARKER) ;
 
 	/* Write the 'fmt ' chunk. */
 	switch (psf->sf.format & SF_FORMAT_TYPEMASK)
@@ -689,7 +762,15 @@ rf64_write_header (SF_PRIVATE *psf, int calc_length)
 				if ((error = rf64_write_fmt_chunk (psf)) != 0)
 					return error ;
 				if (add_fact_chunk)
-					psf_binheader_writef (psf, "tm48", fact_MARKER, 4, psf->sf.frames) ;
+				{	psf_header_put_marker (psf, fact_MARKER) ;
+					psf_header_put_32 (psf, 4) ;
+					if (psf->hpatch.layout == RF64_LAYOUT_RIFF)
+					{	psf_header_put_32 (psf, psf->sf.frames) ;
+						psf->hpatch.frames = psf->header.indx - 4 ;
+						}
+					else	/* The frame count is in the ds64 chunk. */
+						psf_header_put_32 (psf, 0xffffffff) ;
+					} ;
 				break ;
 
 		default :
@@ -707,7 +788,9 @@ rf64_write_header (SF_PRIVATE *psf, int calc_length)
 		wavlike_write_strings (psf, SF_STR_LOCATE_START) ;
 
 	if (psf->peak_info != NULL && psf->peak_info->peak_loc == SF_PEAK_START)
-		wavlike_write_peak_chunk (psf) ;
+	{	wavlike_write_peak_chunk (psf) ;
+		psf->hpatch.peak = psf->header.indx - 8 * psf->sf.channels ;
+		} ;
 
 	/* Write custom headers. */
 	if (psf->wchunks.used > 0)
@@ -746,21 +829,26 @@ rf64_write_header (SF_PRIVATE *psf, int calc_length)
 	if (pad_size >= 0)
 		psf_binheader_writef (psf, "m4z", PAD_MARKER, (unsigned int) pad_size, make_size_t (pad_size)) ;
 
-	if (wpriv->rf64_downgrade && (psf->filelength < RIFF_DOWNGRADE_BYTES))
-		psf_binheader_writef (psf, "tm8", data_MARKER, psf->datalength) ;
+	psf_header_put_marker (psf, data_MARKER) ;
+	if (psf->hpatch.layout == RF64_LAYOUT_RIFF)
+	{	psf_header_put_32 (psf, psf->datalength) ;
+		psf->hpatch.data_size = psf->header.indx - 4 ;
+		}
 	else
-		psf_binheader_writef (psf, "m4", data_MARKER, 0xffffffff) ;
-
-	psf_fwrite (psf->header.ptr, psf->header.indx, 1, psf) ;
-	if (psf->error)
-		return psf->error ;
+		psf_header_put_32 (psf, 0xffffffff) ;
 
+	/* Check before writing, a header of a different size would overwrite audio. */
 	if (has_data && psf->dataoffset != psf->header.indx)
 	{	psf_log_printf (psf, "Oooops : has_data && psf->dataoffset != psf->header.indx\n") ;
 		return psf->error = SFE_INTERNAL ;
 		} ;
 
+	psf_fwrite (psf->header.ptr, psf->header.indx, 1, psf) ;
+	if (psf->error)
+		return psf->error ;
+
 	psf->dataoffset = psf->header.indx ;
+	psf_patch_header_save (psf) ;
 
 	if (NOT (has_data))
 		psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
@@ -770,6 +858,34 @@ rf64_write_header (SF_PRIVATE *psf, int calc_length)
 	return psf->error ;
 } /* rf64_write_header */
 
+static int
+rf64_update_header (SF_PRIVATE *psf)
+{
+	if (psf->hpatch.dataoffset == 0 || psf->hpatch.dataoffset != psf->dataoffset)
+		return rf64_write_header (psf, SF_TRUE) ;
+
+	rf64_calc_length (psf) ;
+
+	/* Crossing 4 gigabytes swaps the JUNK and ds64 chunks, same size in place. */
+	if (rf64_header_layout (psf) != psf->hpatch.layout)
+		return rf64_write_header (psf, SF_FALSE) ;
+
+	if (psf->hpatch.layout == RF64_LAYOUT_RIFF)
+	{	psf_patch_header_int (psf, psf->hpatch.riff_size, 4, SF_ENDIAN_LITTLE, (psf->filelength < 8) ? 8 : psf->filelength - 8) ;
+		psf_patch_header_int (psf, psf->hpatch.frames, 4, SF_ENDIAN_LITTLE, psf->sf.frames) ;
+		psf_patch_header_int (psf, psf->hpatch.data_size, 4, SF_ENDIAN_LITTLE, psf->datalength) ;
+		}
+	else
+	{	psf_patch_header_int (psf, psf->hpatch.riff_size, 8, SF_ENDIAN_LITTLE, psf->filelength - 8) ;
+		psf_patch_header_int (psf, psf->hpatch.data_size, 8, SF_ENDIAN_LITTLE, psf->datalength) ;
+		psf_patch_header_int (psf, psf->hpatch.frames, 8, SF_ENDIAN_LITTLE, psf->sf.frames) ;
+		} ;
+
+	psf_patch_header_peaks (psf, psf->hpatch.peak, 4, SF_ENDIAN_LITTLE) ;
+
+	return psf_patch_header_flush (psf) ;
+} /* rf64_update_header */
+
 static int
 rf64_write_tailer (SF_PRIVATE *psf)
 {
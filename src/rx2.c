@@ -252,7 +252,7 @@ rx2_open	(SF_PRIVATE *psf)
 			break ;
 		} ;
 
-	puts (psf->parselog.buf) ;
+	puts (psf_log_buffer (psf)) ;
 	puts ("-----------------------------------") ;
 
 	printf ("SDAT length  : %d\n", sdat_length) ;
@@ -269,7 +269,9 @@ rx2_open	(SF_PRIVATE *psf)
 
 	puts (" ") ;
 
-	psf->parselog.buf [0] = 0 ;
+	psf->parselog.indx = 0 ;
+	if (psf->parselog.buf)
+		psf->parselog.buf [0] = 0 ;
 
 	/* OK, have the header although not too sure what it all means. */
 
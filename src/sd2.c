@@ -240,7 +240,7 @@ sd2_write_rsrc_fork (SF_PRIVATE *psf, int UNUSED (calc_length))
 	/* Very start of resource fork. */
 	psf_binheader_writef (psf, "E444", rsrc.data_offset, rsrc.map_offset, rsrc.data_length) ;
 
-	psf_binheader_writef (psf, "Eop", make_size_t (0x30), psf->file.name.c) ;
+	psf_binheader_writef (psf, "Eop", make_size_t (0x30), psf->file.name ? psf->file.name->c : "") ;
 	psf_binheader_writef (psf, "Eo2mm", make_size_t (0x50), 0, Sd2f_MARKER, lsf1_MARKER) ;
 
 	/* Very start of resource map. */
@@ -174,6 +174,35 @@ psf_put_be16 (uint8_t *ptr, int offset, int16_t value)
 	ptr [offset + 1] = value ;
 } /* psf_put_be16 */
 
+static inline void
+psf_put_le64 (uint8_t *ptr, int offset, int64_t value)
+{
+	ptr [offset] = value ;
+	ptr [offset + 1] = value >> 8 ;
+	ptr [offset + 2] = value >> 16 ;
+	ptr [offset + 3] = value >> 24 ;
+	ptr [offset + 4] = value >> 32 ;
+	ptr [offset + 5] = value >> 40 ;
+	ptr [offset + 6] = value >> 48 ;
+	ptr [offset + 7] = value >> 56 ;
+} /* psf_put_le64 */
+
+static inline void
+psf_put_le32 (uint8_t *ptr, int offset, int32_t value)
+{
+	ptr [offset] = value ;
+	ptr [offset + 1] = value >> 8 ;
+	ptr [offset + 2] = value >> 16 ;
+	ptr [offset + 3] = value >> 24 ;
+} /* psf_put_le32 */
+
+static inline void
+psf_put_le16 (uint8_t *ptr, int offset, int16_t value)
+{
+	ptr [offset] = value ;
+	ptr [offset + 1] = value >> 8 ;
+} /* psf_put_le16 */
+
 static inline int64_t
 psf_get_be64 (uint8_t *ptr, int offset)
 {	int64_t value ;
@@ -29,6 +29,9 @@
 
 #define		SNDFILE_MAGICK	0x1234C0DE
 
+/* Size of the sf_probe () header buffer, larger headers move to the heap. */
+#define		SF_PROBE_HEADER_LEN		1024
+
 #ifdef __APPLE__
 	/*
 	**	Detect if a compile for a universal binary is being attempted and barf if it is.
@@ -270,6 +273,8 @@ ErrorStruct SndfileErrors [] =
 	{	SFE_FILENAME_TOO_LONG	, "Error : Supplied filename too long." },
 	{	SFE_NEGATIVE_RW_LEN		, "Error : Length parameter passed to read/write is negative." },
 	{	SFE_END_OF_FILE			,	"Error : Unexpected end of file."	},
+	{	SFE_BAD_PROBE_FLAGS		, "Error : Unknown flags passed to sf_probe ()." },
+	{	SFE_ASYNC_WRITE_SHORT	, "Error : Not all the data queued by an asynchronous write could be written." },
 
 	{	SFE_MAX_ERROR			, "Maximum error number." },
 	{	SFE_MAX_ERROR + 1		, NULL }
@@ -282,12 +287,30 @@ static int 	format_from_extension (SF_PRIVATE *psf) ;
 static int	guess_file_type (SF_PRIVATE *psf) ;
 static int	validate_sfinfo (SF_INFO *sfinfo) ;
 static int	validate_psf (SF_PRIVATE *psf) ;
-static void	save_header_info (SF_PRIVATE *psf) ;
 static int	copy_filename (SF_PRIVATE *psf, const char *path) ;
+static void	parse_deferred_metadata (SF_PRIVATE *psf) ;
+static int	psf_update_header (SF_PRIVATE *psf) ;
 static int	psf_close (SF_PRIVATE *psf) ;
+static int	psf_release (SF_PRIVATE *psf) ;
+static int	psf_finish (SF_PRIVATE *psf) ;
+static void	psf_free_buffers (SF_PRIVATE *psf) ;
+static int	psf_recycle (SF_PRIVATE *psf) ;
+static SNDFILE	*psf_open_path (SF_PRIVATE *psf, const char *path, int mode, SF_INFO *sfinfo) ;
+static int	psf_open_container (SF_PRIVATE *psf) ;
+static int	psf_probe (SF_PRIVATE *psf, SF_INFO *sfinfo, int flags) ;
+static void	fill_file_names (PSF_FILE *pfile, const char *path) ;
 
 static int	try_resource_fork (SF_PRIVATE * psf) ;
 
+static int	psf_command (SNDFILE *sndfile, int command, void *data, int datasize) ;
+static int	command_keeps_read_ahead (int command) ;
+
+static void	psf_stop_workers (SF_PRIVATE *psf) ;
+static void	psf_start_workers (SF_PRIVATE *psf) ;
+static int	psf_current_error (SF_PRIVATE *psf) ;
+static sf_count_t	psf_read_error (SF_PRIVATE *psf, int error) ;
+static sf_count_t	psf_write_error (SF_PRIVATE *psf, int error) ;
+
 /*------------------------------------------------------------------------------
 ** Private (static) variables.
 */
@@ -297,6 +320,11 @@ static char	sf_parselog [SF_BUFFER_LEN] = { 0 } ;
 static char	sf_syserr [SF_SYSERR_LEN] = { 0 } ;
 
 /*------------------------------------------------------------------------------
+**	If c is non zero, wait for any read ahead or asynchronous write worker and
+**	clear the error. c is evaluated after b is set, so the read functions pass
+**	psf->read_ahead == NULL and the write functions psf->async_write == NULL.
+**	They leave the worker running and psf->error, which it may be using, alone.
+**	After stopping a read ahead worker, psf_start_workers () starts it again.
 */
 
 #define	VALIDATE_SNDFILE_AND_ASSIGN_PSF(a, b, c)	\
@@ -314,7 +342,10 @@ static char	sf_syserr [SF_SYSERR_LEN] = { 0 } ;
 			{	(b)->error = SFE_BAD_SNDFILE_PTR ;	\
 				return 0 ;							\
 				} ;									\
-			if (c) (b)->error = 0 ;					\
+			if (c)									\
+			{	psf_stop_workers (b) ;				\
+				(b)->error = 0 ;					\
+				} ;									\
 			}
 
 /*------------------------------------------------------------------------------
@@ -335,21 +366,25 @@ sf_open	(const char *path, int mode, SF_INFO *sfinfo)
 
 	psf_init_files (psf) ;
 
-	psf_log_printf (psf, "File : %s\n", path) ;
+	return psf_open_path (psf, path, mode, sfinfo) ;
+} /* sf_open */
 
-	if (copy_filename (psf, path) != 0)
-	{	sf_errno = psf->error ;
-		return	NULL ;
-		} ;
+SNDFILE*
+sf_reopen	(SNDFILE *sndfile, const char *path, int mode, SF_INFO *sfinfo)
+{	SF_PRIVATE 	*psf ;
+	int			error ;
 
-	psf->file.mode = mode ;
-	if (strcmp (path, "-") == 0)
-		psf->error = psf_set_stdio (psf) ;
-	else
-		psf->error = psf_fopen (psf) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
-	return psf_open_file (psf, sfinfo) ;
-} /* sf_open */
+	/* Finish off the current file just like sf_close () does. */
+	if ((error = psf_recycle (psf)) != 0)
+	{	sf_errno = (error < 0) ? SFE_SYSTEM : error ;
+		psf_close (psf) ;
+		return NULL ;
+		} ;
+
+	return psf_open_path (psf, path, mode, sfinfo) ;
+} /* sf_reopen */
 
 SNDFILE*
 sf_open_fd	(int fd, int mode, SF_INFO *sfinfo, int close_desc)
@@ -366,9 +401,8 @@ sf_open_fd	(int fd, int mode, SF_INFO *sfinfo, int close_desc)
 		} ;
 
 	psf_init_files (psf) ;
-	copy_filename (psf, "") ;
 
-	psf->file.mode = mode ;
+	psf_set_open_mode (psf, mode) ;
 	psf_set_file (psf, fd) ;
 	psf->is_pipe = psf_is_pipe (psf) ;
 	psf->fileoffset = psf_ftell (psf) ;
@@ -390,13 +424,13 @@ sf_open_virtual	(SF_VIRTUAL_IO *sfvirtual, int mode, SF_INFO *sfinfo, void *user
 		return NULL ;
 		} ;
 
-	if ((mode == SFM_READ || mode == SFM_RDWR) && sfvirtual->read == NULL)
+	if ((mode & SFM_READ) && sfvirtual->read == NULL)
 	{	sf_errno = SFE_BAD_VIRTUAL_IO ;
 		snprintf (sf_parselog, sizeof (sf_parselog), "Bad vio_read in SF_VIRTUAL_IO struct.\n") ;
 		return NULL ;
 		} ;
 
-	if ((mode == SFM_WRITE || mode == SFM_RDWR) && sfvirtual->write == NULL)
+	if ((mode & SFM_WRITE) && sfvirtual->write == NULL)
 	{	sf_errno = SFE_BAD_VIRTUAL_IO ;
 		snprintf (sf_parselog, sizeof (sf_parselog), "Bad vio_write in SF_VIRTUAL_IO struct.\n") ;
 		return NULL ;
@@ -413,11 +447,66 @@ sf_open_virtual	(SF_VIRTUAL_IO *sfvirtual, int mode, SF_INFO *sfinfo, void *user
 	psf->vio = *sfvirtual ;
 	psf->vio_user_data = user_data ;
 
-	psf->file.mode = mode ;
+	psf_set_open_mode (psf, mode) ;
 
 	return psf_open_file (psf, sfinfo) ;
 } /* sf_open_virtual */
 
+int
+sf_probe (const char *path, SF_INFO *sfinfo, int flags)
+{	SF_PRIVATE	sf_data, *psf = &sf_data ;
+	PSF_PATH	file_path, file_dir ;
+	PSF_NAME	file_name ;
+
+	if (sfinfo == NULL)
+		return SFE_BAD_SF_INFO_PTR ;
+
+	if (flags & ~SF_PROBE_FULL)
+		return SFE_BAD_PROBE_FLAGS ;
+
+	if (strlen (path) >= sizeof (file_path.c))
+		return SFE_FILENAME_TOO_LONG ;
+
+	memset (psf, 0, sizeof (SF_PRIVATE)) ;
+	psf_init_files (psf) ;
+
+	/* Keep the file names on the stack, psf_probe () clears the pointers. */
+	psf->file.path = &file_path ;
+	psf->file.dir = &file_dir ;
+	psf->file.name = &file_name ;
+	fill_file_names (&psf->file, path) ;
+
+	psf->file.mode = SFM_READ ;
+	psf->error = psf_fopen (psf) ;
+
+	return psf_probe (psf, sfinfo, flags) ;
+} /* sf_probe */
+
+int
+sf_probe_virtual (SF_VIRTUAL_IO *sfvirtual, SF_INFO *sfinfo, void *user_data, int flags)
+{	SF_PRIVATE	sf_data, *psf = &sf_data ;
+
+	if (sfvirtual->get_filelen == NULL || sfvirtual->seek == NULL || sfvirtual->tell == NULL || sfvirtual->read == NULL)
+		return SFE_BAD_VIRTUAL_IO ;
+
+	if (sfinfo == NULL)
+		return SFE_BAD_SF_INFO_PTR ;
+
+	if (flags & ~SF_PROBE_FULL)
+		return SFE_BAD_PROBE_FLAGS ;
+
+	memset (psf, 0, sizeof (SF_PRIVATE)) ;
+	psf_init_files (psf) ;
+
+	psf->virtual_io = SF_TRUE ;
+	psf->vio = *sfvirtual ;
+	psf->vio_user_data = user_data ;
+
+	psf->file.mode = SFM_READ ;
+
+	return psf_probe (psf, sfinfo, flags) ;
+} /* sf_probe_virtual */
+
 int
 sf_close	(SNDFILE *sndfile)
 {	SF_PRIVATE	*psf ;
@@ -434,6 +523,13 @@ sf_write_sync	(SNDFILE *sndfile)
 	if ((psf = (SF_PRIVATE *) sndfile) == NULL)
 		return ;
 
+	/* A failed asynchronous write is left in psf->error. */
+	if (psf->async_write != NULL && psf_async_write_stop (psf) != 0)
+		return ;
+
+	if (psf->codec_flush && psf->file.mode != SFM_READ)
+		psf->codec_flush (psf) ;
+
 	psf_fsync (psf) ;
 
 	return ;
@@ -480,9 +576,9 @@ sf_strerror (SNDFILE *sndfile)
 		if (psf->Magick != SNDFILE_MAGICK)
 			return	"sf_strerror : Bad magic number." ;
 
-		errnum = psf->error ;
+		errnum = psf_current_error (psf) ;
 
-		if (errnum == SFE_SYSTEM && psf->syserr [0])
+		if (errnum == SFE_SYSTEM && psf->syserr && psf->syserr [0])
 			return psf->syserr ;
 		} ;
 
@@ -501,10 +597,7 @@ sf_error (SNDFILE *sndfile)
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 0) ;
 
-	if (psf->error)
-		return psf->error ;
-
-	return 0 ;
+	return psf_current_error (psf) ;
 } /* sf_error */
 
 /*------------------------------------------------------------------------------
@@ -520,7 +613,7 @@ sf_perror (SNDFILE *sndfile)
 		}
 	else
 	{	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 0) ;
-		errnum = psf->error ;
+		errnum = psf_current_error (psf) ;
 		} ;
 
 	fprintf (stderr, "%s\n", sf_error_number (errnum)) ;
@@ -543,7 +636,7 @@ sf_error_str (SNDFILE *sndfile, char *str, size_t maxlen)
 		errnum = sf_errno ;
 	else
 	{	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 0) ;
-		errnum = psf->error ;
+		errnum = psf_current_error (psf) ;
 		} ;
 
 	snprintf (str, maxlen, "%s", sf_error_number (errnum)) ;
@@ -881,6 +974,52 @@ sf_version_string (void)
 
 int
 sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
+{	SF_PRIVATE *psf = (SF_PRIVATE *) sndfile ;
+	int retval ;
+
+	if (psf == NULL || psf->Magick != SNDFILE_MAGICK || psf->read_ahead == NULL)
+		return psf_command (sndfile, command, data, datasize) ;
+
+	/* SFC_SET_READ_AHEAD replaces psf->read_ahead, it stops the worker itself. */
+	if (command_keeps_read_ahead (command) || command == SFC_SET_READ_AHEAD)
+		return psf_command (sndfile, command, data, datasize) ;
+
+	/* Anything else may use the codec, including sf_read_* calls from SFC_CALC_SIGNAL_MAX and friends. */
+	psf_read_ahead_hold (psf, SF_TRUE) ;
+	retval = psf_command (sndfile, command, data, datasize) ;
+	psf_read_ahead_hold (psf, SF_FALSE) ;
+
+	return retval ;
+} /* sf_command */
+
+/* Commands which only look at fields the read ahead worker never writes, and never set psf->error. */
+static int
+command_keeps_read_ahead (int command)
+{
+	switch (command)
+	{	case SFC_GET_SIMPLE_FORMAT_COUNT :
+		case SFC_GET_SIMPLE_FORMAT :
+		case SFC_GET_FORMAT_MAJOR_COUNT :
+		case SFC_GET_FORMAT_MAJOR :
+		case SFC_GET_FORMAT_SUBTYPE_COUNT :
+		case SFC_GET_FORMAT_SUBTYPE :
+		case SFC_GET_FORMAT_INFO :
+		case SFC_GET_CURRENT_SF_INFO :
+		case SFC_GET_NORM_FLOAT :
+		case SFC_GET_NORM_DOUBLE :
+		case SFC_GET_CLIPPING :
+		case SFC_RAW_DATA_NEEDS_ENDSWAP :
+			return SF_TRUE ;
+
+		default :
+			break ;
+		} ;
+
+	return SF_FALSE ;
+} /* command_keeps_read_ahead */
+
+static int
+psf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 {	SF_PRIVATE *psf = (SF_PRIVATE *) sndfile ;
 	double quality ;
 	int old_value ;
@@ -942,7 +1081,25 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 		return strlen (data) ;
 		} ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL || command_keeps_read_ahead (command) == SF_FALSE) ;
+
+	if (psf->parse_metadata)
+	{	switch (command)
+		{	case SFC_GET_SIGNAL_MAX :
+			case SFC_GET_MAX_ALL_CHANNELS :
+			case SFC_GET_LOOP_INFO :
+			case SFC_GET_BROADCAST_INFO :
+			case SFC_GET_CART_INFO :
+			case SFC_GET_CUE_COUNT :
+			case SFC_GET_CUE :
+			case SFC_GET_INSTRUMENT :
+				parse_deferred_metadata (psf) ;
+				break ;
+
+			default :
+				break ;
+			} ;
+		} ;
 
 	switch (command)
 	{	case SFC_SET_NORM_FLOAT :
@@ -1007,11 +1164,17 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 			/* Can only do this is in SFM_WRITE mode. */
 			if (psf->file.mode != SFM_WRITE && psf->file.mode != SFM_RDWR)
 				return SF_FALSE ;
+			/* The peaks go in the header, which can't be revisited on a pipe. */
+			if (psf->is_pipe)
+				return SF_FALSE ;
 			/* If data has already been written this must fail. */
 			if (psf->have_written)
 			{	psf->error = SFE_CMD_HAS_DATA ;
 				return SF_FALSE ;
 				} ;
+			/* See psf_async_write_set (). */
+			if (datasize != SF_FALSE && psf->async_write != NULL)
+				return SF_FALSE ;
 			/* Everything seems OK, so set psf->has_peak and re-write header. */
 			if (datasize == SF_FALSE && psf->peak_info != NULL)
 			{	free (psf->peak_info) ;
@@ -1033,7 +1196,7 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 		case SFC_GET_LOG_INFO :
 			if (data == NULL)
 				return SFE_BAD_COMMAND_PARAM ;
-			snprintf (data, datasize, "%s", psf->parselog.buf) ;
+			snprintf (data, datasize, "%s", psf_log_buffer (psf)) ;
 			break ;
 
 		case SFC_CALC_SIGNAL_MAX :
@@ -1073,8 +1236,10 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 			return psf_get_max_all_channels (psf, (double*) data) ;
 
 		case SFC_UPDATE_HEADER_NOW :
+			if (psf->codec_flush && psf->file.mode != SFM_READ)
+				psf->codec_flush (psf) ;
 			if (psf->write_header)
-				psf->write_header (psf, SF_TRUE) ;
+				psf_update_header (psf) ;
 			break ;
 
 		case SFC_SET_UPDATE_HEADER_AUTO :
@@ -1132,6 +1297,24 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 				} ;
 			break ;
 
+		case SFC_SET_PREALLOCATE :
+			if (data == NULL || datasize != sizeof (sf_count_t) || *((sf_count_t *) data) < 0)
+				return (psf->error = SFE_BAD_COMMAND_PARAM) ;
+			if (psf->file.mode != SFM_WRITE && psf->file.mode != SFM_RDWR)
+				return SF_FALSE ;
+			/* Only possible when the size of the audio data follows from its frame count. */
+			if (psf->blockwidth <= 0 || psf->sf.seekable == SF_FALSE)
+				return SF_FALSE ;
+			{	sf_count_t frames = *((sf_count_t *) data) ;
+
+				if (frames <= psf->sf.frames)
+					return SF_TRUE ;
+
+				if (psf_fallocate (psf, psf->dataoffset, frames * psf->blockwidth) != 0)
+					return SF_FALSE ;
+				} ;
+			return SF_TRUE ;
+
 		case SFC_SET_RAW_START_OFFSET :
 			if (data == NULL || datasize != sizeof (sf_count_t))
 				return (psf->error = SFE_BAD_COMMAND_PARAM) ;
@@ -1363,6 +1546,29 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 			quality = 1.0 - SF_MAX (0.0, SF_MIN (1.0, quality)) ;
 			return sf_command (sndfile, SFC_SET_COMPRESSION_LEVEL, &quality, sizeof (quality)) ;
 
+		case SFC_SET_ENCODER_THREADS :
+		case SFC_SET_DECODER_THREADS :
+			if (data == NULL || datasize != sizeof (int))
+				return SF_FALSE ;
+
+			/* Codecs which run their own threads, otherwise the container (eg FLAC). */
+			if (psf->codec_command)
+				return psf->codec_command (psf, command, data, datasize) ;
+			if (psf->command)
+				return psf->command (psf, command, data, datasize) ;
+			return SF_FALSE ;
+
+		case SFC_SET_READ_AHEAD :
+			if (data == NULL || datasize != sizeof (int))
+				return SF_FALSE ;
+
+			return psf_read_ahead_set (psf, *((int *) data)) ;
+
+		case SFC_SET_ASYNC_WRITE :
+			if (data == NULL || datasize != sizeof (int))
+				return SF_FALSE ;
+
+			return psf_async_write_set (psf, *((int *) data)) ;
 
 		default :
 			/* Must be a file specific command. Pass it on. */
@@ -1374,7 +1580,7 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 		} ;
 
 	return 0 ;
-} /* sf_command */
+} /* psf_command */
 
 /*------------------------------------------------------------------------------
 */
@@ -1384,7 +1590,8 @@ sf_seek	(SNDFILE *sndfile, sf_count_t offset, int whence)
 {	SF_PRIVATE 	*psf ;
 	sf_count_t	seek_from_start = 0, retval ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	/* Asking for the read position leaves a read ahead worker running. */
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL || offset != 0 || (whence != SEEK_CUR && whence != (SEEK_CUR | SFM_READ))) ;
 
 	if (! psf->sf.seekable)
 	{	psf->error = SFE_NOT_SEEKABLE ;
@@ -1506,6 +1713,12 @@ sf_get_string (SNDFILE *sndfile, int str_type)
 	if (psf->Magick != SNDFILE_MAGICK)
 		return NULL ;
 
+	if (psf->parse_metadata)
+	{	psf_stop_workers (psf) ;
+		parse_deferred_metadata (psf) ;
+		psf_start_workers (psf) ;
+		} ;
+
 	return psf_get_string (psf, str_type) ;
 } /* sf_get_string */
 
@@ -1524,6 +1737,7 @@ sf_set_string (SNDFILE *sndfile, int str_type, const char* str)
 int
 sf_current_byterate (SNDFILE *sndfile)
 {	SF_PRIVATE 	*psf ;
+	int			byterate ;
 
 	if ((psf = (SF_PRIVATE*) sndfile) == NULL)
 		return -1 ;
@@ -1535,7 +1749,11 @@ sf_current_byterate (SNDFILE *sndfile)
 		return psf->sf.samplerate * psf->sf.channels * psf->bytewidth ;
 
 	if (psf->byterate)
-		return psf->byterate (psf) ;
+	{	psf_stop_workers (psf) ;
+		byterate = psf->byterate (psf) ;
+		psf_start_workers (psf) ;
+		return byterate ;
+		} ;
 
 	switch (SF_CODEC (psf->sf.format))
 	{	case SF_FORMAT_IMA_ADPCM :
@@ -1576,6 +1794,10 @@ sf_read_raw		(SNDFILE *sndfile, void *ptr, sf_count_t bytes)
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
+	/* Raw reads carry on from psf->read_current, not from where the worker got to. */
+	if (psf->read_ahead != NULL)
+		psf_read_ahead_stop (psf, SF_TRUE) ;
+
 	bytewidth = (psf->bytewidth > 0) ? psf->bytewidth : 1 ;
 	blockwidth = (psf->blockwidth > 0) ? psf->blockwidth : 1 ;
 
@@ -1611,6 +1833,8 @@ sf_read_raw		(SNDFILE *sndfile, void *ptr, sf_count_t bytes)
 
 	psf->last_op = SFM_READ ;
 
+	psf_start_workers (psf) ;
+
 	return count ;
 } /* sf_read_raw */
 
@@ -1625,22 +1849,16 @@ sf_read_short	(SNDFILE *sndfile, short *ptr, sf_count_t len)
 	if (len == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL) ;
 
 	if (len <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_WRITE)
-	{	psf->error = SFE_NOT_READMODE ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NOT_READMODE) ;
 
 	if (len % psf->sf.channels)
-	{	psf->error = SFE_BAD_READ_ALIGN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_BAD_READ_ALIGN) ;
 
 	if (psf->read_current >= psf->sf.frames)
 	{	psf_memset (ptr, 0, len * sizeof (short)) ;
@@ -1648,9 +1866,7 @@ sf_read_short	(SNDFILE *sndfile, short *ptr, sf_count_t len)
 		} ;
 
 	if (psf->read_short == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return	0 ;
-		} ;
+		return psf_read_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_READ)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
@@ -1680,17 +1896,13 @@ sf_readf_short		(SNDFILE *sndfile, short *ptr, sf_count_t frames)
 	if (frames == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL) ;
 
 	if (frames <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_WRITE)
-	{	psf->error = SFE_NOT_READMODE ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NOT_READMODE) ;
 
 	if (psf->read_current >= psf->sf.frames)
 	{	psf_memset (ptr, 0, frames * psf->sf.channels * sizeof (short)) ;
@@ -1698,9 +1910,7 @@ sf_readf_short		(SNDFILE *sndfile, short *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->read_short == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_READ)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
@@ -1733,22 +1943,16 @@ sf_read_int		(SNDFILE *sndfile, int *ptr, sf_count_t len)
 	if (len == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL) ;
 
 	if (len <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_WRITE)
-	{	psf->error = SFE_NOT_READMODE ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NOT_READMODE) ;
 
 	if (len % psf->sf.channels)
-	{	psf->error = SFE_BAD_READ_ALIGN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_BAD_READ_ALIGN) ;
 
 	if (psf->read_current >= psf->sf.frames)
 	{	psf_memset (ptr, 0, len * sizeof (int)) ;
@@ -1756,9 +1960,7 @@ sf_read_int		(SNDFILE *sndfile, int *ptr, sf_count_t len)
 		} ;
 
 	if (psf->read_int == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_READ)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
@@ -1788,17 +1990,13 @@ sf_readf_int	(SNDFILE *sndfile, int *ptr, sf_count_t frames)
 	if (frames == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL) ;
 
 	if (frames <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_WRITE)
-	{	psf->error = SFE_NOT_READMODE ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NOT_READMODE) ;
 
 	if (psf->read_current >= psf->sf.frames)
 	{	psf_memset (ptr, 0, frames * psf->sf.channels * sizeof (int)) ;
@@ -1806,9 +2004,7 @@ sf_readf_int	(SNDFILE *sndfile, int *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->read_int == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return	0 ;
-		} ;
+		return psf_read_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_READ)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
@@ -1841,22 +2037,16 @@ sf_read_float	(SNDFILE *sndfile, float *ptr, sf_count_t len)
 	if (len == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL) ;
 
 	if (len <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_WRITE)
-	{	psf->error = SFE_NOT_READMODE ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NOT_READMODE) ;
 
 	if (len % psf->sf.channels)
-	{	psf->error = SFE_BAD_READ_ALIGN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_BAD_READ_ALIGN) ;
 
 	if (psf->read_current >= psf->sf.frames)
 	{	psf_memset (ptr, 0, len * sizeof (float)) ;
@@ -1864,9 +2054,7 @@ sf_read_float	(SNDFILE *sndfile, float *ptr, sf_count_t len)
 		} ;
 
 	if (psf->read_float == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return	0 ;
-		} ;
+		return psf_read_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_READ)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
@@ -1896,17 +2084,13 @@ sf_readf_float	(SNDFILE *sndfile, float *ptr, sf_count_t frames)
 	if (frames == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL) ;
 
 	if (frames <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_WRITE)
-	{	psf->error = SFE_NOT_READMODE ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NOT_READMODE) ;
 
 	if (psf->read_current >= psf->sf.frames)
 	{	psf_memset (ptr, 0, frames * psf->sf.channels * sizeof (float)) ;
@@ -1914,9 +2098,7 @@ sf_readf_float	(SNDFILE *sndfile, float *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->read_float == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return	0 ;
-		} ;
+		return psf_read_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_READ)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
@@ -1949,22 +2131,16 @@ sf_read_double	(SNDFILE *sndfile, double *ptr, sf_count_t len)
 	if (len == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL) ;
 
 	if (len <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_WRITE)
-	{	psf->error = SFE_NOT_READMODE ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NOT_READMODE) ;
 
 	if (len % psf->sf.channels)
-	{	psf->error = SFE_BAD_READ_ALIGN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_BAD_READ_ALIGN) ;
 
 	if (psf->read_current >= psf->sf.frames)
 	{	psf_memset (ptr, 0, len * sizeof (double)) ;
@@ -1972,9 +2148,7 @@ sf_read_double	(SNDFILE *sndfile, double *ptr, sf_count_t len)
 		} ;
 
 	if (psf->read_double == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return	0 ;
-		} ;
+		return psf_read_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_READ)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
@@ -2004,17 +2178,13 @@ sf_readf_double	(SNDFILE *sndfile, double *ptr, sf_count_t frames)
 	if (frames == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->read_ahead == NULL) ;
 
 	if (frames <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_WRITE)
-	{	psf->error = SFE_NOT_READMODE ;
-		return 0 ;
-		} ;
+		return psf_read_error (psf, SFE_NOT_READMODE) ;
 
 	if (psf->read_current >= psf->sf.frames)
 	{	psf_memset (ptr, 0, frames * psf->sf.channels * sizeof (double)) ;
@@ -2022,9 +2192,7 @@ sf_readf_double	(SNDFILE *sndfile, double *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->read_double == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return	0 ;
-		} ;
+		return psf_read_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_READ)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
@@ -2100,7 +2268,7 @@ sf_write_raw	(SNDFILE *sndfile, const void *ptr, sf_count_t len)
 		} ;
 
 	if (psf->auto_header && psf->write_header != NULL)
-		psf->write_header (psf, SF_TRUE) ;
+		psf_update_header (psf) ;
 
 	return count ;
 } /* sf_write_raw */
@@ -2116,27 +2284,19 @@ sf_write_short	(SNDFILE *sndfile, const short *ptr, sf_count_t len)
 	if (len == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->async_write == NULL) ;
 
 	if (len <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_READ)
-	{	psf->error = SFE_NOT_WRITEMODE ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NOT_WRITEMODE) ;
 
 	if (len % psf->sf.channels)
-	{	psf->error = SFE_BAD_WRITE_ALIGN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_BAD_WRITE_ALIGN) ;
 
 	if (psf->write_short == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_WRITE)
 		if (psf->seek (psf, SFM_WRITE, psf->write_current) < 0)
@@ -2160,7 +2320,7 @@ sf_write_short	(SNDFILE *sndfile, const short *ptr, sf_count_t len)
 		} ;
 
 	if (psf->auto_header && psf->write_header != NULL)
-		psf->write_header (psf, SF_TRUE) ;
+		psf_update_header (psf) ;
 
 	return count ;
 } /* sf_write_short */
@@ -2173,22 +2333,16 @@ sf_writef_short	(SNDFILE *sndfile, const short *ptr, sf_count_t frames)
 	if (frames == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->async_write == NULL) ;
 
 	if (frames <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_READ)
-	{	psf->error = SFE_NOT_WRITEMODE ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NOT_WRITEMODE) ;
 
 	if (psf->write_short == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_WRITE)
 		if (psf->seek (psf, SFM_WRITE, psf->write_current) < 0)
@@ -2212,7 +2366,7 @@ sf_writef_short	(SNDFILE *sndfile, const short *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->auto_header && psf->write_header != NULL)
-		psf->write_header (psf, SF_TRUE) ;
+		psf_update_header (psf) ;
 
 	return count / psf->sf.channels ;
 } /* sf_writef_short */
@@ -2228,27 +2382,19 @@ sf_write_int	(SNDFILE *sndfile, const int *ptr, sf_count_t len)
 	if (len == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->async_write == NULL) ;
 
 	if (len <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_READ)
-	{	psf->error = SFE_NOT_WRITEMODE ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NOT_WRITEMODE) ;
 
 	if (len % psf->sf.channels)
-	{	psf->error = SFE_BAD_WRITE_ALIGN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_BAD_WRITE_ALIGN) ;
 
 	if (psf->write_int == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_WRITE)
 		if (psf->seek (psf, SFM_WRITE, psf->write_current) < 0)
@@ -2272,7 +2418,7 @@ sf_write_int	(SNDFILE *sndfile, const int *ptr, sf_count_t len)
 		} ;
 
 	if (psf->auto_header && psf->write_header != NULL)
-		psf->write_header (psf, SF_TRUE) ;
+		psf_update_header (psf) ;
 
 	return count ;
 } /* sf_write_int */
@@ -2285,22 +2431,16 @@ sf_writef_int	(SNDFILE *sndfile, const int *ptr, sf_count_t frames)
 	if (frames == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->async_write == NULL) ;
 
 	if (frames <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_READ)
-	{	psf->error = SFE_NOT_WRITEMODE ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NOT_WRITEMODE) ;
 
 	if (psf->write_int == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_WRITE)
 		if (psf->seek (psf, SFM_WRITE, psf->write_current) < 0)
@@ -2324,7 +2464,7 @@ sf_writef_int	(SNDFILE *sndfile, const int *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->auto_header && psf->write_header != NULL)
-		psf->write_header (psf, SF_TRUE) ;
+		psf_update_header (psf) ;
 
 	return count / psf->sf.channels ;
 } /* sf_writef_int */
@@ -2340,27 +2480,19 @@ sf_write_float	(SNDFILE *sndfile, const float *ptr, sf_count_t len)
 	if (len == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->async_write == NULL) ;
 
 	if (len <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_READ)
-	{	psf->error = SFE_NOT_WRITEMODE ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NOT_WRITEMODE) ;
 
 	if (len % psf->sf.channels)
-	{	psf->error = SFE_BAD_WRITE_ALIGN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_BAD_WRITE_ALIGN) ;
 
 	if (psf->write_float == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_WRITE)
 		if (psf->seek (psf, SFM_WRITE, psf->write_current) < 0)
@@ -2384,7 +2516,7 @@ sf_write_float	(SNDFILE *sndfile, const float *ptr, sf_count_t len)
 		} ;
 
 	if (psf->auto_header && psf->write_header != NULL)
-		psf->write_header (psf, SF_TRUE) ;
+		psf_update_header (psf) ;
 
 	return count ;
 } /* sf_write_float */
@@ -2397,22 +2529,16 @@ sf_writef_float	(SNDFILE *sndfile, const float *ptr, sf_count_t frames)
 	if (frames == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->async_write == NULL) ;
 
 	if (frames <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_READ)
-	{	psf->error = SFE_NOT_WRITEMODE ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NOT_WRITEMODE) ;
 
 	if (psf->write_float == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_WRITE)
 		if (psf->seek (psf, SFM_WRITE, psf->write_current) < 0)
@@ -2436,7 +2562,7 @@ sf_writef_float	(SNDFILE *sndfile, const float *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->auto_header && psf->write_header != NULL)
-		psf->write_header (psf, SF_TRUE) ;
+		psf_update_header (psf) ;
 
 	return count / psf->sf.channels ;
 } /* sf_writef_float */
@@ -2452,27 +2578,19 @@ sf_write_double	(SNDFILE *sndfile, const double *ptr, sf_count_t len)
 	if (len == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->async_write == NULL) ;
 
 	if (len <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_READ)
-	{	psf->error = SFE_NOT_WRITEMODE ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NOT_WRITEMODE) ;
 
 	if (len % psf->sf.channels)
-	{	psf->error = SFE_BAD_WRITE_ALIGN ;
-		return	0 ;
-		} ;
+		return psf_write_error (psf, SFE_BAD_WRITE_ALIGN) ;
 
 	if (psf->write_double == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_WRITE)
 		if (psf->seek (psf, SFM_WRITE, psf->write_current) < 0)
@@ -2496,7 +2614,7 @@ sf_write_double	(SNDFILE *sndfile, const double *ptr, sf_count_t len)
 		} ;
 
 	if (psf->auto_header && psf->write_header != NULL)
-		psf->write_header (psf, SF_TRUE) ;
+		psf_update_header (psf) ;
 
 	return count ;
 } /* sf_write_double */
@@ -2509,22 +2627,16 @@ sf_writef_double	(SNDFILE *sndfile, const double *ptr, sf_count_t frames)
 	if (frames == 0)
 		return 0 ;
 
-	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, psf->async_write == NULL) ;
 
 	if (frames <= 0)
-	{	psf->error = SFE_NEGATIVE_RW_LEN ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NEGATIVE_RW_LEN) ;
 
 	if (psf->file.mode == SFM_READ)
-	{	psf->error = SFE_NOT_WRITEMODE ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_NOT_WRITEMODE) ;
 
 	if (psf->write_double == NULL || psf->seek == NULL)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return 0 ;
-		} ;
+		return psf_write_error (psf, SFE_UNIMPLEMENTED) ;
 
 	if (psf->last_op != SFM_WRITE)
 		if (psf->seek (psf, SFM_WRITE, psf->write_current) < 0)
@@ -2548,7 +2660,7 @@ sf_writef_double	(SNDFILE *sndfile, const double *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->auto_header && psf->write_header != NULL)
-		psf->write_header (psf, SF_TRUE) ;
+		psf_update_header (psf) ;
 
 	return count / psf->sf.channels ;
 } /* sf_writef_double */
@@ -2569,7 +2681,7 @@ try_resource_fork (SF_PRIVATE * psf)
 		} ;
 
 	/* More checking here. */
-	psf_log_printf (psf, "Resource fork : %s\n", psf->rsrc.path.c) ;
+	psf_log_printf (psf, "Resource fork : %s\n", psf->rsrc.path->c) ;
 
 	return SF_FORMAT_SD2 ;
 } /* try_resource_fork */
@@ -2580,7 +2692,7 @@ format_from_extension (SF_PRIVATE *psf)
 	char buffer [16] ;
 	int format = 0 ;
 
-	if ((cptr = strrchr (psf->file.name.c, '.')) == NULL)
+	if (psf->file.name == NULL || (cptr = strrchr (psf->file.name->c, '.')) == NULL)
 		return 0 ;
 
 	cptr ++ ;
@@ -2795,46 +2907,193 @@ validate_psf (SF_PRIVATE *psf)
 	return 1 ;
 } /* validate_psf */
 
-static void
-save_header_info (SF_PRIVATE *psf)
-{	snprintf (sf_parselog, sizeof (sf_parselog), "%s", psf->parselog.buf) ;
-} /* save_header_info */
-
 static int
 copy_filename (SF_PRIVATE *psf, const char *path)
-{	const char *ccptr ;
-	char *cptr ;
-
-	if (strlen (path) > 1 && strlen (path) - 1 >= sizeof (psf->file.path.c))
+{
+	if (strlen (path) > 1 && strlen (path) - 1 >= sizeof (psf->file.path->c))
 	{	psf->error = SFE_FILENAME_TOO_LONG ;
 		return psf->error ;
 		} ;
 
-	snprintf (psf->file.path.c, sizeof (psf->file.path.c), "%s", path) ;
+	if ((psf->error = psf_alloc_file_names (&psf->file)) != 0)
+		return psf->error ;
+
+	fill_file_names (&psf->file, path) ;
+
+	return 0 ;
+} /* copy_filename */
+
+static SNDFILE *
+psf_open_path (SF_PRIVATE *psf, const char *path, int mode, SF_INFO *sfinfo)
+{
+	psf_set_open_mode (psf, mode) ;
+
+	psf_log_printf (psf, "File : %s\n", path) ;
+
+	if (copy_filename (psf, path) != 0)
+	{	sf_errno = psf->error ;
+		psf_close (psf) ;
+		return	NULL ;
+		} ;
+
+	if (strcmp (path, "-") == 0)
+		psf->error = psf_set_stdio (psf) ;
+	else
+		psf->error = psf_fopen (psf) ;
+
+	return psf_open_file (psf, sfinfo) ;
+} /* psf_open_path */
+
+static void
+fill_file_names (PSF_FILE *pfile, const char *path)
+{	const char *ccptr ;
+	char *cptr ;
+
+	snprintf (pfile->path->c, sizeof (pfile->path->c), "%s", path) ;
 	if ((ccptr = strrchr (path, '/')) || (ccptr = strrchr (path, '\\')))
 		ccptr ++ ;
 	else
 		ccptr = path ;
 
-	snprintf (psf->file.name.c, sizeof (psf->file.name.c), "%s", ccptr) ;
+	snprintf (pfile->name->c, sizeof (pfile->name->c), "%s", ccptr) ;
 
 	/* Now grab the directory. */
-	snprintf (psf->file.dir.c, sizeof (psf->file.dir.c), "%s", path) ;
-	if ((cptr = strrchr (psf->file.dir.c, '/')) || (cptr = strrchr (psf->file.dir.c, '\\')))
+	snprintf (pfile->dir->c, sizeof (pfile->dir->c), "%s", path) ;
+	if ((cptr = strrchr (pfile->dir->c, '/')) || (cptr = strrchr (pfile->dir->c, '\\')))
 		cptr [1] = 0 ;
 	else
-		psf->file.dir.c [0] = 0 ;
+		pfile->dir->c [0] = 0 ;
+} /* fill_file_names */
+
+void
+psf_set_open_mode (SF_PRIVATE *psf, int mode)
+{	/* SFM_FAST_OPEN is a flag, the remaining bits are the actual mode. */
+	psf->fast_open = (mode & SFM_FAST_OPEN) ? SF_TRUE : SF_FALSE ;
+	psf->file.mode = mode & ~SFM_FAST_OPEN ;
+} /* psf_set_open_mode */
+
+static void
+parse_deferred_metadata (SF_PRIVATE *psf)
+{	int (*parse_metadata) (SF_PRIVATE *psf) = psf->parse_metadata ;
+	sf_count_t position ;
+	int error ;
+
+	/* Only ever try once, even if the parse fails. */
+	psf->parse_metadata = NULL ;
+
+	/* The parser reads the header chunks, so put the file position back afterwards. */
+	position = psf_ftell (psf) ;
+	error = parse_metadata (psf) ;
+	psf->header.indx = psf->header.end = 0 ;
+	psf_fseek (psf, position, SEEK_SET) ;
+
+	if (error)
+		psf->error = error ;
+} /* parse_deferred_metadata */
+
+/*
+**	Bring the header up to date with the audio data written so far. Once data
+**	has been written the header layout is fixed, so containers which recorded
+**	where their size fields are only need to patch those.
+*/
+static int
+psf_update_header (SF_PRIVATE *psf)
+{
+	if (psf->update_header != NULL && psf->have_written)
+		return psf->update_header (psf) ;
+
+	return psf->write_header (psf, SF_TRUE) ;
+} /* psf_update_header */
+
+/* Wait for a worker which is using the SF_PRIVATE in the caller's place. */
+static void
+psf_stop_workers (SF_PRIVATE *psf)
+{
+	if (psf->read_ahead != NULL)
+		psf_read_ahead_stop (psf, SF_FALSE) ;
+
+	if (psf->async_write != NULL)
+		psf_async_write_stop (psf) ;
+} /* psf_stop_workers */
+
+/* Carry on reading ahead after psf_stop_workers (). */
+static void
+psf_start_workers (SF_PRIVATE *psf)
+{
+	if (psf->read_ahead != NULL)
+		psf_read_ahead_start (psf) ;
+} /* psf_start_workers */
+
+/* The error for sf_error () and friends, without stopping a read ahead worker. */
+static int
+psf_current_error (SF_PRIVATE *psf)
+{
+	if (psf->read_ahead != NULL)
+		return psf_read_ahead_get_error (psf) ;
+
+	if (psf->async_write != NULL)
+		psf_async_write_stop (psf) ;
+
+	return psf->error ;
+} /* psf_current_error */
+
+/* For the sf_read_* functions, which don't stop a read ahead worker. */
+static sf_count_t
+psf_read_error (SF_PRIVATE *psf, int error)
+{
+	if (psf->read_ahead != NULL)
+		psf_read_ahead_set_error (psf, error) ;
+	else
+		psf->error = error ;
 
 	return 0 ;
-} /* copy_filename */
+} /* psf_read_error */
+
+/* For the sf_write_* functions, which don't wait for an asynchronous write. */
+static sf_count_t
+psf_write_error (SF_PRIVATE *psf, int error)
+{
+	if (psf->async_write != NULL)
+		psf_async_write_stop (psf) ;
+
+	psf->error = error ;
+
+	return 0 ;
+} /* psf_write_error */
 
 /*==============================================================================
 */
 
 static int
 psf_close (SF_PRIVATE *psf)
-{	uint32_t k ;
-	int	error = 0 ;
+{	int	error ;
+
+	error = psf_release (psf) ;
+
+	memset (psf, 0, sizeof (SF_PRIVATE)) ;
+	free (psf) ;
+
+	return error ;
+} /* psf_close */
+
+/* Close the file and free everything psf points to, but not psf itself. */
+static int
+psf_release (SF_PRIVATE *psf)
+{	int	error ;
+
+	error = psf_finish (psf) ;
+	psf_free_buffers (psf) ;
+
+	return error ;
+} /* psf_release */
+
+/* Let the codec and container finish off the file, then close it. */
+static int
+psf_finish (SF_PRIVATE *psf)
+{	int	error = 0, async_error ;
+
+	psf_read_ahead_destroy (psf) ;
+	async_error = psf_async_write_destroy (psf) ;
 
 	if (psf->codec_close)
 	{	error = psf->codec_close (psf) ;
@@ -2848,8 +3107,17 @@ psf_close (SF_PRIVATE *psf)
 	error = psf_fclose (psf) ;
 	psf_close_rsrc (psf) ;
 
+	/* Otherwise the caller would never hear that queued data was lost. */
+	return (async_error != 0) ? async_error : error ;
+} /* psf_finish */
+
+static void
+psf_free_buffers (SF_PRIVATE *psf)
+{	uint32_t k ;
+
 	/* For an ISO C compliant implementation it is ok to free a NULL pointer. */
-	free (psf->header.ptr) ;
+	if (! psf->header.on_stack)
+		free (psf->header.ptr) ;
 	free (psf->container_data) ;
 	free (psf->codec_data) ;
 	free (psf->interleave) ;
@@ -2862,144 +3130,86 @@ psf_close (SF_PRIVATE *psf)
 	free (psf->channel_map) ;
 	free (psf->format_desc) ;
 	free (psf->strings.storage) ;
+	free (psf->strings.data) ;
+	free (psf->syserr) ;
+	free (psf->parselog.buf) ;
+	psf_free_file_names (&psf->file) ;
+	psf_free_file_names (&psf->rsrc) ;
 
 	if (psf->wchunks.chunks)
 		for (k = 0 ; k < psf->wchunks.used ; k++)
 			free (psf->wchunks.chunks [k].data) ;
 	free (psf->rchunks.chunks) ;
+	free (psf->rchunks.index) ;
 	free (psf->wchunks.chunks) ;
 	free (psf->iterator) ;
 	free (psf->cart_16k) ;
+	free (psf->hpatch.image) ;
+} /* psf_free_buffers */
 
-	memset (psf, 0, sizeof (SF_PRIVATE)) ;
-	free (psf) ;
-
-	return error ;
-} /* psf_close */
-
-SNDFILE *
-psf_open_file (SF_PRIVATE *psf, SF_INFO *sfinfo)
-{	int		error, format ;
-
-	sf_errno = error = 0 ;
-	sf_parselog [0] = 0 ;
-
-	if (psf->error)
-	{	error = psf->error ;
-		goto error_exit ;
-		} ;
-
-	if (psf->file.mode != SFM_READ && psf->file.mode != SFM_WRITE && psf->file.mode != SFM_RDWR)
-	{	error = SFE_BAD_OPEN_MODE ;
-		goto error_exit ;
-		} ;
-
-	if (sfinfo == NULL)
-	{	error = SFE_BAD_SF_INFO_PTR ;
-		goto error_exit ;
-		} ;
-
-	if (psf->file.mode == SFM_READ)
-	{	if ((SF_CONTAINER (sfinfo->format)) == SF_FORMAT_RAW)
-		{	if (sf_format_check (sfinfo) == 0)
-			{	error = SFE_RAW_BAD_FORMAT ;
-				goto error_exit ;
-				} ;
-			}
-		else
-			memset (sfinfo, 0, sizeof (SF_INFO)) ;
-		} ;
-
-	memcpy (&psf->sf, sfinfo, sizeof (SF_INFO)) ;
-
-	psf->Magick 		= SNDFILE_MAGICK ;
-	psf->norm_float 	= SF_TRUE ;
-	psf->norm_double	= SF_TRUE ;
-	psf->dataoffset		= -1 ;
-	psf->datalength		= -1 ;
-	psf->read_current	= -1 ;
-	psf->write_current	= -1 ;
-	psf->auto_header 	= SF_FALSE ;
-	psf->rwf_endian		= SF_ENDIAN_LITTLE ;
-	psf->seek			= psf_default_seek ;
-	psf->float_int_mult = 0 ;
-	psf->float_max		= -1.0 ;
-
-	/* An attempt at a per SF_PRIVATE unique id. */
-	psf->unique_id		= psf_rand_int32 () ;
-
-	psf->sf.sections = 1 ;
-
-	psf->is_pipe = psf_is_pipe (psf) ;
-
-	if (psf->is_pipe)
-	{	psf->sf.seekable = SF_FALSE ;
-		psf->filelength = SF_COUNT_MAX ;
-		}
-	else
-	{	psf->sf.seekable = SF_TRUE ;
-
-		/* File is open, so get the length. */
-		psf->filelength = psf_get_filelen (psf) ;
-		} ;
-
-	if (psf->fileoffset > 0)
-	{	switch (psf->file.mode)
-		{	case SFM_READ :
-				if (psf->filelength < 44)
-				{	psf_log_printf (psf, "Short filelength: %D (fileoffset: %D)\n", psf->filelength, psf->fileoffset) ;
-					error = SFE_BAD_OFFSET ;
-					goto error_exit ;
-					} ;
-				break ;
-
-			case SFM_WRITE :
-				psf->fileoffset = 0 ;
-				psf_fseek (psf, 0, SEEK_END) ;
-				psf->fileoffset = psf_ftell (psf) ;
-				break ;
+/*
+**	Close the file like psf_close (), but keep psf and the buffers the next
+**	file can use (header, log, file names and read chunk tables), emptied
+**	so that psf looks the same as a freshly allocated one.
+*/
+static int
+psf_recycle (SF_PRIVATE *psf)
+{	unsigned char	*header ;
+	sf_count_t		header_len ;
+	char			*parselog ;
+	int				parselog_len ;
+	PSF_FILE		file ;
+	READ_CHUNKS		rchunks ;
+	int				error ;
+
+	error = psf_finish (psf) ;
+
+	/* Take the buffers to keep away from psf_free_buffers (). */
+	header = psf->header.ptr ;
+	header_len = psf->header.len ;
+	parselog = psf->parselog.buf ;
+	parselog_len = psf->parselog.len ;
+	file = psf->file ;
+	rchunks = psf->rchunks ;
+
+	psf->header.ptr = NULL ;
+	psf->parselog.buf = NULL ;
+	psf->file.path = NULL ;
+	psf->rchunks.chunks = NULL ;
+	psf->rchunks.index = NULL ;
+
+	psf_free_buffers (psf) ;
 
-			case SFM_RDWR :
-				error = SFE_NO_EMBEDDED_RDWR ;
-				goto error_exit ;
-			} ;
+	memset (psf, 0, sizeof (SF_PRIVATE)) ;
+	psf_init_files (psf) ;
 
-		psf_log_printf (psf, "Embedded file offset : %D\n", psf->fileoffset) ;
-		} ;
+	memset (header, 0, header_len) ;
+	psf->header.ptr = header ;
+	psf->header.len = header_len ;
 
-	if (psf->filelength == SF_COUNT_MAX)
-		psf_log_printf (psf, "Length : unknown\n") ;
-	else
-		psf_log_printf (psf, "Length : %D\n", psf->filelength) ;
+	if (parselog != NULL)
+		parselog [0] = 0 ;
+	psf->parselog.buf = parselog ;
+	psf->parselog.len = parselog_len ;
 
-	if (psf->file.mode == SFM_WRITE || (psf->file.mode == SFM_RDWR && psf->filelength == 0))
-	{	/* If the file is being opened for write or RDWR and the file is currently
-		** empty, then the SF_INFO struct must contain valid data.
-		*/
-		if ((SF_CONTAINER (psf->sf.format)) == 0)
-		{	error = SFE_ZERO_MAJOR_FORMAT ;
-			goto error_exit ;
-			} ;
-		if ((SF_CODEC (psf->sf.format)) == 0)
-		{	error = SFE_ZERO_MINOR_FORMAT ;
-			goto error_exit ;
-			} ;
+	psf->file.path = file.path ;
+	psf->file.dir = file.dir ;
+	psf->file.name = file.name ;
 
-		if (sf_format_check (&psf->sf) == 0)
-		{	error = SFE_BAD_OPEN_FORMAT ;
-			goto error_exit ;
-			} ;
-		}
-	else if ((SF_CONTAINER (psf->sf.format)) != SF_FORMAT_RAW)
-	{	/* If type RAW has not been specified then need to figure out file type. */
-		psf->sf.format = guess_file_type (psf) ;
+	if (rchunks.index != NULL)
+		memset (rchunks.index, 0, rchunks.index_len * sizeof (READ_CHUNK_SLOT)) ;
+	psf->rchunks.count = rchunks.count ;
+	psf->rchunks.chunks = rchunks.chunks ;
+	psf->rchunks.index_len = rchunks.index_len ;
+	psf->rchunks.index = rchunks.index ;
 
-		if (psf->sf.format == 0)
-			psf->sf.format = format_from_extension (psf) ;
-		} ;
+	return error ;
+} /* psf_recycle */
 
-	/* Prevent unnecessary seeks */
-	psf->last_op = psf->file.mode ;
+/* Hand the file over to the parser for its container and check the result. */
+static int
+psf_open_container (SF_PRIVATE *psf)
+{	int		error, format ;
 
 	/* Set bytewidth if known. */
 	switch (SF_CODEC (psf->sf.format))
@@ -3149,7 +3359,7 @@ psf_open_file (SF_PRIVATE *psf, SF_INFO *sfinfo)
 		} ;
 
 	if (error)
-		goto error_exit ;
+		return error ;
 
 	/* For now, check whether embedding is supported. */
 	format = SF_CONTAINER (psf->sf.format) ;
@@ -3167,8 +3377,7 @@ psf_open_file (SF_PRIVATE *psf, SF_INFO *sfinfo)
 				break ;
 
 			default :
-				error = SFE_NO_EMBED_SUPPORT ;
-				goto error_exit ;
+				return SFE_NO_EMBED_SUPPORT ;
 			} ;
 		} ;
 
@@ -3176,23 +3385,216 @@ psf_open_file (SF_PRIVATE *psf, SF_INFO *sfinfo)
 		psf_log_printf (psf, "Embedded file length : %D\n", psf->filelength) ;
 
 	if (psf->file.mode == SFM_RDWR && sf_format_check (&psf->sf) == 0)
-	{	error = SFE_BAD_MODE_RW ;
-		goto error_exit ;
-		} ;
+		return SFE_BAD_MODE_RW ;
 
 	if (validate_sfinfo (&psf->sf) == 0)
 	{	psf_log_SF_INFO (psf) ;
-		save_header_info (psf) ;
-		error = SFE_BAD_SF_INFO ;
-		goto error_exit ;
+		return SFE_BAD_SF_INFO ;
 		} ;
 
 	if (validate_psf (psf) == 0)
-	{	save_header_info (psf) ;
-		error = SFE_INTERNAL ;
+		return SFE_INTERNAL ;
+
+	return 0 ;
+} /* psf_open_container */
+
+/*
+**	Parse the header like a fast open for read, but with psf and the header
+**	buffer on the stack and without touching the global error state, so that
+**	sf_probe () is reentrant. The chunk table is never built, and unless
+**	SF_PROBE_FULL is set, codecs whose frame count follows from the header
+**	skip the rest of their setup.
+*/
+static int
+psf_probe (SF_PRIVATE *psf, SF_INFO *sfinfo, int flags)
+{	unsigned char header [SF_PROBE_HEADER_LEN] ;
+	int error ;
+
+	psf->header.ptr = header ;
+	psf->header.len = sizeof (header) ;
+	psf->header.on_stack = SF_TRUE ;
+
+	memset (sfinfo, 0, sizeof (SF_INFO)) ;
+
+	psf->fast_open		= SF_TRUE ;
+	psf->norm_float 	= SF_TRUE ;
+	psf->norm_double	= SF_TRUE ;
+	psf->dataoffset		= -1 ;
+	psf->datalength		= -1 ;
+	psf->read_current	= -1 ;
+	psf->write_current	= -1 ;
+	psf->rwf_endian		= SF_ENDIAN_LITTLE ;
+	psf->seek			= psf_default_seek ;
+	psf->float_max		= -1.0 ;
+	psf->sf.sections	= 1 ;
+
+	psf->probe = (flags & SF_PROBE_FULL) ? SF_FALSE : SF_TRUE ;
+	psf->rchunks.no_store = SF_TRUE ;
+
+	if ((error = psf->error) != 0)
+		goto probe_exit ;
+
+	psf->is_pipe = psf_is_pipe (psf) ;
+	psf->sf.seekable = psf->is_pipe ? SF_FALSE : SF_TRUE ;
+	psf->filelength = psf->is_pipe ? SF_COUNT_MAX : psf_get_filelen (psf) ;
+
+	psf->sf.format = guess_file_type (psf) ;
+	if (psf->sf.format == 0)
+		psf->sf.format = format_from_extension (psf) ;
+
+	if ((error = psf->error) != 0)
+		goto probe_exit ;
+
+	psf->last_op = psf->file.mode ;
+
+	if ((error = psf_open_container (psf)) != 0)
+		goto probe_exit ;
+
+	memcpy (sfinfo, &psf->sf, sizeof (SF_INFO)) ;
+
+probe_exit :
+	/* The file names (if any) belong to sf_probe (). */
+	psf->file.path = NULL ;
+	psf->file.dir = NULL ;
+	psf->file.name = NULL ;
+
+	psf_release (psf) ;
+
+	return error ;
+} /* psf_probe */
+
+SNDFILE *
+psf_open_file (SF_PRIVATE *psf, SF_INFO *sfinfo)
+{	int		error ;
+
+	sf_errno = error = 0 ;
+	sf_parselog [0] = 0 ;
+
+	if (psf->error)
+	{	error = psf->error ;
+		goto error_exit ;
+		} ;
+
+	if (psf->file.mode != SFM_READ && psf->file.mode != SFM_WRITE && psf->file.mode != SFM_RDWR)
+	{	error = SFE_BAD_OPEN_MODE ;
+		goto error_exit ;
+		} ;
+
+	if (psf->fast_open && psf->file.mode != SFM_READ)
+	{	error = SFE_BAD_OPEN_MODE ;
+		goto error_exit ;
+		} ;
+
+	if (sfinfo == NULL)
+	{	error = SFE_BAD_SF_INFO_PTR ;
 		goto error_exit ;
 		} ;
 
+	if (psf->file.mode == SFM_READ)
+	{	if ((SF_CONTAINER (sfinfo->format)) == SF_FORMAT_RAW)
+		{	if (sf_format_check (sfinfo) == 0)
+			{	error = SFE_RAW_BAD_FORMAT ;
+				goto error_exit ;
+				} ;
+			}
+		else
+			memset (sfinfo, 0, sizeof (SF_INFO)) ;
+		} ;
+
+	memcpy (&psf->sf, sfinfo, sizeof (SF_INFO)) ;
+
+	psf->Magick 		= SNDFILE_MAGICK ;
+	psf->norm_float 	= SF_TRUE ;
+	psf->norm_double	= SF_TRUE ;
+	psf->dataoffset		= -1 ;
+	psf->datalength		= -1 ;
+	psf->read_current	= -1 ;
+	psf->write_current	= -1 ;
+	psf->auto_header 	= SF_FALSE ;
+	psf->rwf_endian		= SF_ENDIAN_LITTLE ;
+	psf->seek			= psf_default_seek ;
+	psf->float_int_mult = 0 ;
+	psf->float_max		= -1.0 ;
+
+	/* An attempt at a per SF_PRIVATE unique id. */
+	psf->unique_id		= psf_rand_int32 () ;
+
+	psf->sf.sections = 1 ;
+
+	psf->is_pipe = psf_is_pipe (psf) ;
+
+	if (psf->is_pipe)
+	{	psf->sf.seekable = SF_FALSE ;
+		psf->filelength = SF_COUNT_MAX ;
+		}
+	else
+	{	psf->sf.seekable = SF_TRUE ;
+
+		/* File is open, so get the length. */
+		psf->filelength = psf_get_filelen (psf) ;
+		} ;
+
+	if (psf->fileoffset > 0)
+	{	switch (psf->file.mode)
+		{	case SFM_READ :
+				if (psf->filelength < 44)
+				{	psf_log_printf (psf, "Short filelength: %D (fileoffset: %D)\n", psf->filelength, psf->fileoffset) ;
+					error = SFE_BAD_OFFSET ;
+					goto error_exit ;
+					} ;
+				break ;
+
+			case SFM_WRITE :
+				psf->fileoffset = 0 ;
+				psf_fseek (psf, 0, SEEK_END) ;
+				psf->fileoffset = psf_ftell (psf) ;
+				break ;
+
+			case SFM_RDWR :
+				error = SFE_NO_EMBEDDED_RDWR ;
+				goto error_exit ;
+			} ;
+
+		psf_log_printf (psf, "Embedded file offset : %D\n", psf->fileoffset) ;
+		} ;
+
+	if (psf->filelength == SF_COUNT_MAX)
+		psf_log_printf (psf, "Length : unknown\n") ;
+	else
+		psf_log_printf (psf, "Length : %D\n", psf->filelength) ;
+
+	if (psf->file.mode == SFM_WRITE || (psf->file.mode == SFM_RDWR && psf->filelength == 0))
+	{	/* If the file is being opened for write or RDWR and the file is currently
+		** empty, then the SF_INFO struct must contain valid data.
+		*/
+		if ((SF_CONTAINER (psf->sf.format)) == 0)
+		{	error = SFE_ZERO_MAJOR_FORMAT ;
+			goto error_exit ;
+			} ;
+		if ((SF_CODEC (psf->sf.format)) == 0)
+		{	error = SFE_ZERO_MINOR_FORMAT ;
+			goto error_exit ;
+			} ;
+
+		if (sf_format_check (&psf->sf) == 0)
+		{	error = SFE_BAD_OPEN_FORMAT ;
+			goto error_exit ;
+			} ;
+		}
+	else if ((SF_CONTAINER (psf->sf.format)) != SF_FORMAT_RAW)
+	{	/* If type RAW has not been specified then need to figure out file type. */
+		psf->sf.format = guess_file_type (psf) ;
+
+		if (psf->sf.format == 0)
+			psf->sf.format = format_from_extension (psf) ;
+		} ;
+
+	/* Prevent unnecessary seeks */
+	psf->last_op = psf->file.mode ;
+
+	if ((error = psf_open_container (psf)) != 0)
+		goto error_exit ;
+
 	psf->read_current = 0 ;
 	psf->write_current = 0 ;
 	if (psf->file.mode == SFM_RDWR)
@@ -3214,9 +3616,9 @@ psf_open_file (SF_PRIVATE *psf, SF_INFO *sfinfo)
 error_exit :
 	sf_errno = error ;
 
-	if (error == SFE_SYSTEM)
+	if (error == SFE_SYSTEM && psf->syserr)
 		snprintf (sf_syserr, sizeof (sf_syserr), "%s", psf->syserr) ;
-	snprintf (sf_parselog, sizeof (sf_parselog), "%s", psf->parselog.buf) ;
+	snprintf (sf_parselog, sizeof (sf_parselog), "%s", psf_log_buffer (psf)) ;
 
 	switch (error)
 	{	case SF_ERR_SYSTEM :
@@ -49,6 +49,10 @@ psf_store_string (SF_PRIVATE *psf, int str_type, const char *str)
 			return SFE_STR_BAD_STRING ;
 		} ;
 
+	/* The string table is only allocated when the first string is stored. */
+	if (psf->strings.data == NULL && (psf->strings.data = calloc (SF_MAX_STRINGS, sizeof (STR_DATA))) == NULL)
+		return SFE_MALLOC_FAILED ;
+
 	/* Find the next free slot in table. */
 	for (k = 0 ; k < SF_MAX_STRINGS ; k++)
 	{	/* If we find a matching entry clear it. */
@@ -168,6 +172,9 @@ const char*
 psf_get_string (SF_PRIVATE *psf, int str_type)
 {	int k ;
 
+	if (psf->strings.data == NULL)
+		return NULL ;
+
 	for (k = 0 ; k < SF_MAX_STRINGS ; k++)
 		if (str_type == psf->strings.data [k].type)
 			return psf->strings.storage + psf->strings.data [k].offset ;
@@ -179,6 +186,9 @@ int
 psf_location_string_count (const SF_PRIVATE * psf, int location)
 {	int k, count = 0 ;
 
+	if (psf->strings.data == NULL)
+		return 0 ;
+
 	for (k = 0 ; k < SF_MAX_STRINGS ; k++)
 		if (psf->strings.data [k].type > 0 && psf->strings.data [k].flags & location)
 			count ++ ;
@@ -240,12 +240,15 @@ svx_read_header	(SF_PRIVATE *psf)
 
 					psf_log_printf (psf, " %M : %u\n", marker, chunk_size) ;
 
-					if (strlen (psf->file.name.c) != chunk_size)
-					{	if (chunk_size > sizeof (psf->file.name.c) - 1)
+					if (psf_alloc_file_names (&psf->file))
+						return SFE_MALLOC_FAILED ;
+
+					if (strlen (psf->file.name->c) != chunk_size)
+					{	if (chunk_size > sizeof (psf->file.name->c) - 1)
 							return SFE_SVX_BAD_NAME_LENGTH ;
 
-						psf_binheader_readf (psf, "b", psf->file.name.c, chunk_size) ;
-						psf->file.name.c [chunk_size] = 0 ;
+						psf_binheader_readf (psf, "b", psf->file.name->c, chunk_size) ;
+						psf->file.name->c [chunk_size] = 0 ;
 						}
 					else
 						psf_binheader_readf (psf, "j", chunk_size) ;
@@ -380,7 +383,7 @@ svx_write_header (SF_PRIVATE *psf, int calc_length)
 		psf_binheader_writef (psf, "Em44", CHAN_MARKER, 4, 6) ;
 
 	/* Filename and annotation strings. */
-	psf_binheader_writef (psf, "Emsms", NAME_MARKER, psf->file.name.c, ANNO_MARKER, annotation) ;
+	psf_binheader_writef (psf, "Emsms", NAME_MARKER, psf->file.name ? psf->file.name->c : "", ANNO_MARKER, annotation) ;
 
 	/* BODY marker and size. */
 	psf_binheader_writef (psf, "Etm8", BODY_MARKER, (psf->datalength < 0) ?
@@ -102,6 +102,8 @@ test_audio_detect (void)
 		errors ++ ;
 		} ;
 
+	free (psf.parselog.buf) ;
+
 	if (errors != 0)
 	{	printf ("\n    Errors : %d\n\n", errors) ;
 		exit (1) ;
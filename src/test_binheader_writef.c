@@ -59,3 +59,61 @@ test_binheader_writef (void)
 	puts ("ok") ;
 } /* test_log_printf */
 
+
+void
+test_header_put_get (void)
+{	SF_PRIVATE	sf_typed, sf_writef, *psf ;
+	int			k, endian, errors = 0 ;
+
+	print_test_name ("Testing header put/get") ;
+
+	for (k = 0 ; k < 2 ; k++)
+	{	endian = k ? SF_ENDIAN_BIG : SF_ENDIAN_LITTLE ;
+
+		memset (&sf_typed, 0, sizeof (sf_typed)) ;
+		memset (&sf_writef, 0, sizeof (sf_writef)) ;
+
+		psf = &sf_writef ;
+		psf_binheader_writef (psf, endian == SF_ENDIAN_BIG ? "Em2248z" : "em2248z",
+				MAKE_MARKER ('d', 'a', 't', 'a'), 0x1234, -2, 0x89abcdef,
+				(sf_count_t) 0x0123456789abcdefLL, (size_t) 3) ;
+
+		psf = &sf_typed ;
+		psf->rwf_endian = endian ;
+		psf_header_put_marker (psf, MAKE_MARKER ('d', 'a', 't', 'a')) ;
+		psf_header_put_16 (psf, 0x1234) ;
+		psf_header_put_16 (psf, -2) ;
+		psf_header_put_32 (psf, 0x89abcdef) ;
+		psf_header_put_64 (psf, 0x0123456789abcdefLL) ;
+		psf_header_put_zeros (psf, 3) ;
+
+		if (sf_typed.header.indx != sf_writef.header.indx
+				|| memcmp (sf_typed.header.ptr, sf_writef.header.ptr, (size_t) sf_typed.header.indx) != 0)
+		{	printf ("\n\nLine %d : typed header does not match psf_binheader_writef (endian %d).\n", __LINE__, endian) ;
+			errors ++ ;
+			} ;
+
+		/* Read back from the in-memory header without touching a file. */
+		psf->header.end = psf->header.indx ;
+		psf->header.indx = 0 ;
+
+		if (psf_header_get_marker (psf) != MAKE_MARKER ('d', 'a', 't', 'a')
+				|| psf_header_get_16 (psf) != 0x1234
+				|| psf_header_get_16 (psf) != 0xfffe
+				|| psf_header_get_32 (psf) != 0x89abcdef
+				|| psf_header_get_64 (psf) != 0x0123456789abcdefLL)
+		{	printf ("\n\nLine %d : typed header read back failed (endian %d).\n", __LINE__, endian) ;
+			errors ++ ;
+			} ;
+
+		free (sf_typed.header.ptr) ;
+		free (sf_writef.header.ptr) ;
+		} ;
+
+	if (errors)
+	{	puts ("\nExiting due to errors.\n") ;
+		exit (1) ;
+		} ;
+
+	puts ("ok") ;
+} /* test_header_put_get */
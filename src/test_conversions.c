@@ -60,9 +60,10 @@ conversion_test (char endian)
 
 	psf = &sf_private ;
 	memset (psf, 0, sizeof (sf_private)) ;
+	psf_alloc_file_names (&psf->file) ;
 
 	psf->file.mode = SFM_WRITE ;
-	snprintf (psf->file.path.c, sizeof (psf->file.path.c), "%s", filename) ;
+	snprintf (psf->file.path->c, sizeof (psf->file.path->c), "%s", filename) ;
 
 	if (psf_fopen (psf) != 0)
 	{	printf ("\n\nError : failed to open file '%s' for write.\n\n", filename) ;
@@ -73,11 +74,13 @@ conversion_test (char endian)
 	psf_fwrite (psf->header.ptr, 1, psf->header.indx, psf) ;
 	free (psf->header.ptr) ;
 	psf_fclose (psf) ;
+	psf_free_file_names (&psf->file) ;
 
 	memset (psf, 0, sizeof (sf_private)) ;
+	psf_alloc_file_names (&psf->file) ;
 
 	psf->file.mode = SFM_READ ;
-	snprintf (psf->file.path.c, sizeof (psf->file.path.c), "%s", filename) ;
+	snprintf (psf->file.path->c, sizeof (psf->file.path->c), "%s", filename) ;
 
 	if (psf_fopen (psf) != 0)
 	{	printf ("\n\nError : failed to open file '%s' for read.\n\n", filename) ;
@@ -87,6 +90,7 @@ conversion_test (char endian)
 	bytes = psf_binheader_readf (psf, format_str, &t8, &t16, &t24, &t32, &t64) ;
 	free (psf->header.ptr) ;
 	psf_fclose (psf) ;
+	psf_free_file_names (&psf->file) ;
 
 	if (bytes != 18)
 	{	printf ("\n\nLine %d : read %d bytes.\n\n", __LINE__, bytes) ;
@@ -64,6 +64,7 @@ file_open_test (const char *filename)
 
 	memset (&sf_data, 0, sizeof (sf_data)) ;
 	psf = &sf_data ;
+	psf_alloc_file_names (&psf->file) ;
 
 	/* Ensure that the file doesn't already exist. */
 	if (unlink (filename) != 0 && errno != ENOENT)
@@ -72,7 +73,7 @@ file_open_test (const char *filename)
 		} ;
 
 	psf->file.mode = SFM_READ ;
-	snprintf (psf->file.path.c, sizeof (psf->file.path.c), "%s", filename) ;
+	snprintf (psf->file.path->c, sizeof (psf->file.path->c), "%s", filename) ;
 
 	/* Test that open for read fails if the file doesn't exist. */
 	error = psf_fopen (psf) ;
@@ -90,7 +91,7 @@ file_open_test (const char *filename)
 
 	test_close_or_die (psf, __LINE__) ;
 
-	unlink (psf->file.path.c) ;
+	unlink (psf->file.path->c) ;
 
 	/* Test file open in read/write mode for a non-existant file. */
 	psf->file.mode = SFM_RDWR ;
@@ -104,7 +105,9 @@ file_open_test (const char *filename)
 
 	test_close_or_die (psf, __LINE__) ;
 
-	unlink (psf->file.path.c) ;
+	unlink (psf->file.path->c) ;
+	psf_free_file_names (&psf->file) ;
+	free (psf->syserr) ;
 	puts ("ok") ;
 } /* file_open_test */
 
@@ -125,7 +128,8 @@ file_read_write_test (const char *filename)
 
 	memset (&sf_data, 0, sizeof (sf_data)) ;
 	psf = &sf_data ;
-	snprintf (psf->file.path.c, sizeof (psf->file.path.c), "%s", filename) ;
+	psf_alloc_file_names (&psf->file) ;
+	snprintf (psf->file.path->c, sizeof (psf->file.path->c), "%s", filename) ;
 
 	/* Test file open in write mode. */
 	psf->file.mode = SFM_WRITE ;
@@ -261,6 +265,7 @@ file_read_write_test (const char *filename)
 
 	test_close_or_die (psf, __LINE__) ;
 
+	psf_free_file_names (&psf->file) ;
 	puts ("ok") ;
 } /* file_read_write_test */
 
@@ -281,7 +286,8 @@ file_truncate_test (const char *filename)
 	memset (buffer, 0xEE, sizeof (buffer)) ;
 
 	psf = &sf_data ;
-	snprintf (psf->file.path.c, sizeof (psf->file.path.c), "%s", filename) ;
+	psf_alloc_file_names (&psf->file) ;
+	snprintf (psf->file.path->c, sizeof (psf->file.path->c), "%s", filename) ;
 
 	/*
 	** Open the file write mode, write 0xEE data and then extend the file
@@ -323,6 +329,7 @@ file_truncate_test (const char *filename)
 	test_seek_or_die (psf, 0, SEEK_END, SIGNED_SIZEOF (buffer) / 4, __LINE__) ;
 	test_close_or_die (psf, __LINE__) ;
 
+	psf_free_file_names (&psf->file) ;
 	puts ("ok") ;
 } /* file_truncate_test */
 
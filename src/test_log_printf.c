@@ -32,35 +32,35 @@
 	{	psf->parselog.indx = 0 ;			\
 		snprintf (buffer, sizeof (buffer), (fmt)) ;	\
 		psf_log_printf (psf, (fmt)) ;				\
-		err += compare_strings_or_die (line, fmt, buffer, psf->parselog.buf) ;	\
+		err += compare_strings_or_die (line, fmt, buffer, psf_log_buffer (psf)) ;	\
 		}
 
 #define	CMP_2_ARGS(line, err, fmt, a)	\
 	{	psf->parselog.indx = 0 ;				\
 		snprintf (buffer, sizeof (buffer), (fmt), (a), (a)) ;	\
 		psf_log_printf (psf, (fmt), (a), (a)) ;					\
-		err += compare_strings_or_die (line, fmt, buffer, psf->parselog.buf) ;	\
+		err += compare_strings_or_die (line, fmt, buffer, psf_log_buffer (psf)) ;	\
 		}
 
 #define	CMP_4_ARGS(line, err, fmt, a)	\
 	{	psf->parselog.indx = 0 ;				\
 		snprintf (buffer, sizeof (buffer), (fmt), (a), (a), (a), (a)) ;	\
 		psf_log_printf (psf, (fmt), (a), (a), (a), (a)) ;				\
-		err += compare_strings_or_die (line, fmt, buffer, psf->parselog.buf) ;	\
+		err += compare_strings_or_die (line, fmt, buffer, psf_log_buffer (psf)) ;	\
 		}
 
 #define	CMP_5_ARGS(line, err, fmt, a)	\
 	{	psf->parselog.indx = 0 ;				\
 		snprintf (buffer, sizeof (buffer), (fmt), (a), (a), (a), (a), (a)) ;	\
 		psf_log_printf (psf, (fmt), (a), (a), (a), (a), (a)) ;					\
-		err += compare_strings_or_die (line, fmt, buffer, psf->parselog.buf) ;		\
+		err += compare_strings_or_die (line, fmt, buffer, psf_log_buffer (psf)) ;		\
 		}
 
 #define	CMP_6_ARGS(line, err, fmt, a)	\
 	{	psf->parselog.indx = 0 ;				\
 		snprintf (buffer, sizeof (buffer), (fmt), (a), (a), (a), (a), (a), (a)) ;	\
 		psf_log_printf (psf, (fmt), (a), (a), (a), (a), (a), (a)) ;					\
-		err += compare_strings_or_die (line, fmt, buffer, psf->parselog.buf) ;			\
+		err += compare_strings_or_die (line, fmt, buffer, psf_log_buffer (psf)) ;			\
 		}
 
 static int
@@ -113,6 +113,8 @@ test_log_printf (void)
 	/* Test printing of strings. */
 	CMP_4_ARGS (__LINE__, errors, "B %s, %3s, %8s, %-8s", "str") ;
 
+	free (psf->parselog.buf) ;
+
 	if (errors)
 	{	puts ("\nExiting due to errors.\n") ;
 		exit (1) ;
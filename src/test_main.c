@@ -54,6 +54,7 @@ main (void)
 
 	test_log_printf () ;
 	test_binheader_writef () ;
+	test_header_put_get () ;
 	test_file_io () ;
 
 	test_audio_detect () ;
@@ -63,6 +64,8 @@ main (void)
 	test_broadcast_var () ;
 	test_cart_var () ;
 
+	test_sf_private_footprint () ;
+
 	return 0 ;
 } /* main */
 
@@ -28,6 +28,7 @@ void test_conversions (void) ;
 void test_endswap (void) ;
 void test_log_printf (void) ;
 void test_binheader_writef (void) ;
+void test_header_put_get (void) ;
 void test_file_io (void) ;
 
 void test_float_convert (void) ;
@@ -40,3 +41,5 @@ void test_psf_strlcpy_crlf (void) ;
 void test_broadcast_var (void) ;
 
 void test_cart_var (void) ;
+
+void test_sf_private_footprint (void) ;
@@ -0,0 +1,136 @@
+/*
+** Copyright (C) 2017 Erik de Castro Lopo <erikd@mega-nerd.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "sfconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#include "sf_unistd.h"
+#endif
+
+#include "common.h"
+
+#include "test_main.h"
+
+/*
+**	Applications may keep many thousands of files open, so the part of
+**	SF_PRIVATE allocated for every handle needs to stay small. The file
+**	names, log, system error and string table are allocated on demand.
+*/
+#define	MAX_SF_PRIVATE_SIZE		1024
+
+static size_t
+handle_footprint (const SF_PRIVATE *psf)
+{	size_t footprint = sizeof (SF_PRIVATE) ;
+
+	footprint += psf->header.len ;
+	footprint += psf->parselog.len ;
+
+	if (psf->file.path)
+		footprint += 2 * sizeof (PSF_PATH) + sizeof (PSF_NAME) ;
+	if (psf->rsrc.path)
+		footprint += 2 * sizeof (PSF_PATH) + sizeof (PSF_NAME) ;
+	if (psf->syserr)
+		footprint += SF_SYSERR_LEN ;
+	if (psf->strings.data)
+		footprint += SF_MAX_STRINGS * sizeof (STR_DATA) ;
+	footprint += psf->strings.storage_len ;
+
+	return footprint ;
+} /* handle_footprint */
+
+void
+test_sf_private_footprint (void)
+{	const char *filename = "footprint.wav" ;
+	static short data [256] ;
+	SNDFILE		*file ;
+	SF_PRIVATE	*psf ;
+	SF_INFO		sfinfo ;
+	size_t		path_footprint, fd_footprint ;
+	int			fd ;
+
+	print_test_name ("Testing SF_PRIVATE footprint") ;
+
+	if (sizeof (SF_PRIVATE) > MAX_SF_PRIVATE_SIZE)
+	{	printf ("\n\nError : sizeof (SF_PRIVATE) is %zd (should be <= %d).\n\n", sizeof (SF_PRIVATE), MAX_SF_PRIVATE_SIZE) ;
+		exit (1) ;
+		} ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate = 44100 ;
+	sfinfo.channels = 1 ;
+	sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16 ;
+
+	if ((file = sf_open (filename, SFM_WRITE, &sfinfo)) == NULL)
+	{	printf ("\n\nError : sf_open (%s) failed : %s\n\n", filename, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+	sf_write_short (file, data, ARRAY_LEN (data)) ;
+	sf_close (file) ;
+
+	/* A file opened by name needs its file names. */
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	if ((file = sf_open (filename, SFM_READ, &sfinfo)) == NULL)
+	{	printf ("\n\nError : sf_open (%s) failed : %s\n\n", filename, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	psf = (SF_PRIVATE *) file ;
+	if (psf->file.path == NULL || strcmp (psf->file.name->c, filename) != 0)
+	{	printf ("\n\nError : file name of '%s' not set.\n\n", filename) ;
+		exit (1) ;
+		} ;
+	if (psf->rsrc.path != NULL || psf->syserr != NULL || psf->strings.data != NULL)
+	{	printf ("\n\nError : unused parts of SF_PRIVATE were allocated.\n\n") ;
+		exit (1) ;
+		} ;
+
+	path_footprint = handle_footprint (psf) ;
+	sf_close (file) ;
+
+	/* A file opened from a file descriptor has no file names. */
+	if ((fd = open (filename, O_RDONLY)) < 0)
+	{	printf ("\n\nError : open (%s) failed.\n\n", filename) ;
+		exit (1) ;
+		} ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	if ((file = sf_open_fd (fd, SFM_READ, &sfinfo, SF_TRUE)) == NULL)
+	{	printf ("\n\nError : sf_open_fd failed : %s\n\n", sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	psf = (SF_PRIVATE *) file ;
+	if (psf->file.path != NULL)
+	{	printf ("\n\nError : file names allocated for sf_open_fd.\n\n") ;
+		exit (1) ;
+		} ;
+
+	fd_footprint = handle_footprint (psf) ;
+	sf_close (file) ;
+
+	unlink (filename) ;
+
+	printf ("ok (%zd bytes, WAV by name %zd, by fd %zd)\n", sizeof (SF_PRIVATE), path_footprint, fd_footprint) ;
+} /* test_sf_private_footprint */
@@ -36,6 +36,15 @@ static sf_count_t ulaw_write_d2ulaw (SF_PRIVATE *psf, const double *ptr, sf_coun
 int
 ulaw_init (SF_PRIVATE *psf)
 {
+	psf->bytewidth = 1 ;
+	psf->blockwidth = psf->sf.channels ;
+
+	/* sf_probe () only needs the frame count. */
+	if (psf->probe)
+	{	psf_set_fixed_frames (psf) ;
+		return 0 ;
+		} ;
+
 	if (psf->file.mode == SFM_READ || psf->file.mode == SFM_RDWR)
 	{	psf->read_short		= ulaw_read_ulaw2s ;
 		psf->read_int		= ulaw_read_ulaw2i ;
@@ -50,16 +59,7 @@ ulaw_init (SF_PRIVATE *psf)
 		psf->write_double	= ulaw_write_d2ulaw ;
 		} ;
 
-	psf->bytewidth = 1 ;
-	psf->blockwidth = psf->sf.channels ;
-
-	if (psf->filelength > psf->dataoffset)
-		psf->datalength = (psf->dataend) ? psf->dataend - psf->dataoffset :
-							psf->filelength - psf->dataoffset ;
-	else
-		psf->datalength = 0 ;
-
-	psf->sf.frames = psf->blockwidth > 0 ? psf->datalength / psf->blockwidth : 0 ;
+	psf_set_fixed_frames (psf) ;
 
 	return 0 ;
 } /* ulaw_init */
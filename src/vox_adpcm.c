@@ -52,7 +52,33 @@ static sf_count_t vox_write_i (SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 static sf_count_t vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len) ;
 static sf_count_t vox_write_d (SF_PRIVATE *psf, const double *ptr, sf_count_t len) ;
 
-static int vox_read_block (SF_PRIVATE *psf, IMA_OKI_ADPCM *pvox, short *ptr, int len) ;
+/*
+**	When reading, the codes are decoded IMA_OKI_ADPCM_CODE_LEN bytes (one chunk)
+**	at a time and the predictor state is saved at the start of every
+**	VOX_CHECKPOINT_CHUNKS chunks as they are decoded, so that a seek only has to
+**	decode forward from the nearest checkpoint rather than from the start.
+*/
+
+#define	VOX_CHECKPOINT_CHUNKS	16
+
+typedef struct
+{	int		last_output ;
+	int		step_index ;
+} VOX_CHECKPOINT ;
+
+typedef struct
+{	IMA_OKI_ADPCM	codec ;
+
+	sf_count_t		chunk ;		/* Index of the next chunk to be decoded. */
+	int				pcm_indx ;	/* Number of samples of codec.pcm already returned. */
+
+	int				checkpoint_count, checkpoint_max ;
+	VOX_CHECKPOINT	checkpoints [] ;
+} VOX_PRIVATE ;
+
+static int vox_read_block (SF_PRIVATE *psf, VOX_PRIVATE *pvox, short *ptr, int len) ;
+
+static sf_count_t vox_seek (SF_PRIVATE *psf, int mode, sf_count_t offset) ;
 
 /*------------------------------------------------------------------------------
 */
@@ -60,7 +86,7 @@ static int vox_read_block (SF_PRIVATE *psf, IMA_OKI_ADPCM *pvox, short *ptr, int
 static int
 codec_close (SF_PRIVATE * psf)
 {
-	IMA_OKI_ADPCM * p = (IMA_OKI_ADPCM *) psf->codec_data ;
+	IMA_OKI_ADPCM * p = &((VOX_PRIVATE *) psf->codec_data)->codec ;
 
 	if (p->errors)
 		psf_log_printf (psf, "*** Warning : ADPCM state errors: %d\n", p->errors) ;
@@ -69,7 +95,8 @@ codec_close (SF_PRIVATE * psf)
 
 int
 vox_adpcm_init (SF_PRIVATE *psf)
-{	IMA_OKI_ADPCM *pvox = NULL ;
+{	VOX_PRIVATE *pvox = NULL ;
+	int		checkpoint_max = 0 ;
 
 	if (psf->file.mode == SFM_RDWR)
 		return SFE_BAD_MODE_RW ;
@@ -77,11 +104,14 @@ vox_adpcm_init (SF_PRIVATE *psf)
 	if (psf->file.mode == SFM_WRITE && psf->sf.channels != 1)
 		return SFE_CHANNEL_COUNT ;
 
-	if ((pvox = malloc (sizeof (IMA_OKI_ADPCM))) == NULL)
+	if (psf->file.mode == SFM_READ && ! psf->is_pipe && psf->filelength > 0)
+		checkpoint_max = psf->filelength / (VOX_CHECKPOINT_CHUNKS * IMA_OKI_ADPCM_CODE_LEN) + 1 ;
+
+	if ((pvox = calloc (1, sizeof (VOX_PRIVATE) + checkpoint_max * sizeof (VOX_CHECKPOINT))) == NULL)
 		return SFE_MALLOC_FAILED ;
 
 	psf->codec_data = (void*) pvox ;
-	memset (pvox, 0, sizeof (IMA_OKI_ADPCM)) ;
+	pvox->checkpoint_max = checkpoint_max ;
 
 	if (psf->file.mode == SFM_WRITE)
 	{	psf->write_short	= vox_write_s ;
@@ -106,14 +136,18 @@ vox_adpcm_init (SF_PRIVATE *psf)
 
 	psf->sf.frames = psf->filelength * 2 ;
 
-	psf->sf.seekable = SF_FALSE ;
+	/* Reading can seek using the checkpoints, writing can not seek. */
+	psf->sf.seekable = (checkpoint_max > 0) ? SF_TRUE : SF_FALSE ;
 	psf->codec_close = codec_close ;
 
 	/* Seek back to start of data. */
 	if (psf_fseek (psf, 0 , SEEK_SET) == -1)
 		return SFE_BAD_SEEK ;
 
-	ima_oki_adpcm_init (pvox, IMA_OKI_ADPCM_TYPE_OKI) ;
+	ima_oki_adpcm_init (&pvox->codec, IMA_OKI_ADPCM_TYPE_OKI) ;
+
+	if (checkpoint_max > 0)
+		psf->seek = vox_seek ;
 
 	return 0 ;
 } /* vox_adpcm_init */
@@ -121,41 +155,118 @@ vox_adpcm_init (SF_PRIVATE *psf)
 /*==============================================================================
 */
 
+/* Decode the next chunk of codes into pvox->codec.pcm, returning the number of samples. */
 static int
-vox_read_block (SF_PRIVATE *psf, IMA_OKI_ADPCM *pvox, short *ptr, int len)
-{	int	indx = 0, k ;
+vox_decode_chunk (SF_PRIVATE *psf, VOX_PRIVATE *pvox)
+{	IMA_OKI_ADPCM *codec = &pvox->codec ;
+	sf_count_t checkpoint ;
+	int	k ;
+
+	checkpoint = pvox->chunk / VOX_CHECKPOINT_CHUNKS ;
+	if (pvox->chunk % VOX_CHECKPOINT_CHUNKS == 0 && checkpoint == pvox->checkpoint_count && checkpoint < pvox->checkpoint_max)
+	{	pvox->checkpoints [checkpoint].last_output = codec->last_output ;
+		pvox->checkpoints [checkpoint].step_index = codec->step_index ;
+		pvox->checkpoint_count ++ ;
+		} ;
 
-	while (indx < len)
-	{	pvox->code_count = (len - indx > IMA_OKI_ADPCM_PCM_LEN) ? IMA_OKI_ADPCM_CODE_LEN : (len - indx + 1) / 2 ;
+	pvox->pcm_indx = 0 ;
 
-		if ((k = psf_fread (pvox->codes, 1, pvox->code_count, psf)) != pvox->code_count)
-		{	if (psf_ftell (psf) != psf->filelength)
-				psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pvox->code_count) ;
-			if (k == 0)
-				break ;
+	if ((k = psf_fread (codec->codes, 1, IMA_OKI_ADPCM_CODE_LEN, psf)) != IMA_OKI_ADPCM_CODE_LEN)
+	{	if (psf_ftell (psf) != psf->filelength)
+			psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, IMA_OKI_ADPCM_CODE_LEN) ;
+		if (k <= 0)
+		{	codec->pcm_count = 0 ;
+			return 0 ;
 			} ;
+		} ;
 
-		pvox->code_count = k ;
+	codec->code_count = k ;
+	ima_oki_adpcm_decode_block (codec) ;
+	pvox->chunk ++ ;
 
-		ima_oki_adpcm_decode_block (pvox) ;
+	return codec->pcm_count ;
+} /* vox_decode_chunk */
 
-		memcpy (&(ptr [indx]), pvox->pcm, pvox->pcm_count * sizeof (short)) ;
-		indx += pvox->pcm_count ;
+static int
+vox_read_block (SF_PRIVATE *psf, VOX_PRIVATE *pvox, short *ptr, int len)
+{	int	indx = 0, count ;
+
+	while (indx < len)
+	{	if (pvox->pcm_indx >= pvox->codec.pcm_count && vox_decode_chunk (psf, pvox) == 0)
+			break ;
+
+		count = SF_MIN (pvox->codec.pcm_count - pvox->pcm_indx, len - indx) ;
+
+		memcpy (&(ptr [indx]), pvox->codec.pcm + pvox->pcm_indx, count * sizeof (short)) ;
+		pvox->pcm_indx += count ;
+		indx += count ;
 		} ;
 
 	return indx ;
 } /* vox_read_block */
 
+static sf_count_t
+vox_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
+{	VOX_PRIVATE *pvox ;
+	sf_count_t	chunk, checkpoint ;
+
+	if ((pvox = (VOX_PRIVATE*) psf->codec_data) == NULL)
+	{	psf->error = SFE_INTERNAL ;
+		return PSF_SEEK_ERROR ;
+		} ;
+
+	if (mode != SFM_READ || offset < 0 || offset > psf->sf.frames)
+	{	psf->error = SFE_BAD_SEEK ;
+		return PSF_SEEK_ERROR ;
+		} ;
+
+	chunk = offset / IMA_OKI_ADPCM_PCM_LEN ;
+
+	/* The chunk holding offset may already be decoded. */
+	if (pvox->codec.pcm_count > 0 && chunk == pvox->chunk - 1)
+	{	pvox->pcm_indx = offset % IMA_OKI_ADPCM_PCM_LEN ;
+		return offset ;
+		} ;
+
+	checkpoint = SF_MIN (chunk / VOX_CHECKPOINT_CHUNKS, (sf_count_t) pvox->checkpoint_count - 1) ;
+
+	/*
+	**	Restart from the checkpoint unless decoding forward from the current
+	**	position is shorter.
+	*/
+	if (checkpoint >= 0 && (chunk < pvox->chunk || pvox->chunk < checkpoint * VOX_CHECKPOINT_CHUNKS))
+	{	pvox->chunk = checkpoint * VOX_CHECKPOINT_CHUNKS ;
+		pvox->codec.last_output = pvox->checkpoints [checkpoint].last_output ;
+		pvox->codec.step_index = pvox->checkpoints [checkpoint].step_index ;
+
+		if (psf_fseek (psf, psf->dataoffset + pvox->chunk * IMA_OKI_ADPCM_CODE_LEN, SEEK_SET) < 0)
+		{	psf->error = SFE_BAD_SEEK ;
+			return PSF_SEEK_ERROR ;
+			} ;
+		} ;
+
+	pvox->codec.pcm_count = 0 ;
+	pvox->pcm_indx = 0 ;
+
+	while (pvox->chunk <= chunk)
+		if (vox_decode_chunk (psf, pvox) == 0)
+			break ;
+
+	pvox->pcm_indx = SF_MIN ((int) (offset - (pvox->chunk - 1) * IMA_OKI_ADPCM_PCM_LEN), pvox->codec.pcm_count) ;
+
+	return offset ;
+} /* vox_seek */
+
 
 static sf_count_t
 vox_read_s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM 	*pvox ;
+{	VOX_PRIVATE	*pvox ;
 	int			readcount, count ;
 	sf_count_t	total = 0 ;
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	while (len > 0)
 	{	readcount = (len > 0x10000000) ? 0x10000000 : (int) len ;
@@ -173,7 +284,7 @@ vox_read_s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 
 static sf_count_t
 vox_read_i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, readcount, count ;
@@ -181,7 +292,7 @@ vox_read_i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	sptr = ubuf.sbuf ;
 	bufferlen = ARRAY_LEN (ubuf.sbuf) ;
@@ -201,7 +312,7 @@ vox_read_i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
 
 static sf_count_t
 vox_read_f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, readcount, count ;
@@ -210,7 +321,7 @@ vox_read_f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	normfact = (psf->norm_float == SF_TRUE) ? 1.0 / ((float) 0x8000) : 1.0 ;
 
@@ -232,7 +343,7 @@ vox_read_f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 
 static sf_count_t
 vox_read_d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, readcount, count ;
@@ -241,7 +352,7 @@ vox_read_d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	normfact = (psf->norm_double == SF_TRUE) ? 1.0 / ((double) 0x8000) : 1.0 ;
 
@@ -286,18 +397,18 @@ vox_write_block (SF_PRIVATE *psf, IMA_OKI_ADPCM *pvox, const short *ptr, int len
 
 static sf_count_t
 vox_write_s (SF_PRIVATE *psf, const short *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM 	*pvox ;
+{	VOX_PRIVATE	*pvox ;
 	int			writecount, count ;
 	sf_count_t	total = 0 ;
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	while (len)
 	{	writecount = (len > 0x10000000) ? 0x10000000 : (int) len ;
 
-		count = vox_write_block (psf, pvox, ptr, writecount) ;
+		count = vox_write_block (psf, &pvox->codec, ptr, writecount) ;
 
 		total += count ;
 		len -= count ;
@@ -310,7 +421,7 @@ vox_write_s (SF_PRIVATE *psf, const short *ptr, sf_count_t len)
 
 static sf_count_t
 vox_write_i	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, writecount, count ;
@@ -318,7 +429,7 @@ vox_write_i	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	sptr = ubuf.sbuf ;
 	bufferlen = ARRAY_LEN (ubuf.sbuf) ;
@@ -326,7 +437,7 @@ vox_write_i	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 	{	writecount = (len >= bufferlen) ? bufferlen : (int) len ;
 		for (k = 0 ; k < writecount ; k++)
 			sptr [k] = ptr [total + k] >> 16 ;
-		count = vox_write_block (psf, pvox, sptr, writecount) ;
+		count = vox_write_block (psf, &pvox->codec, sptr, writecount) ;
 		total += count ;
 		len -= writecount ;
 		if (count != writecount)
@@ -338,7 +449,7 @@ vox_write_i	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 
 static sf_count_t
 vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, writecount, count ;
@@ -347,7 +458,7 @@ vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	normfact = (psf->norm_float == SF_TRUE) ? (1.0 * 0x7FFF) : 1.0 ;
 
@@ -357,7 +468,7 @@ vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 	{	writecount = (len >= bufferlen) ? bufferlen : (int) len ;
 		for (k = 0 ; k < writecount ; k++)
 			sptr [k] = lrintf (normfact * ptr [total + k]) ;
-		count = vox_write_block (psf, pvox, sptr, writecount) ;
+		count = vox_write_block (psf, &pvox->codec, sptr, writecount) ;
 		total += count ;
 		len -= writecount ;
 		if (count != writecount)
@@ -369,7 +480,7 @@ vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 
 static sf_count_t
 vox_write_d	(SF_PRIVATE *psf, const double *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, writecount, count ;
@@ -378,7 +489,7 @@ vox_write_d	(SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	normfact = (psf->norm_double == SF_TRUE) ? (1.0 * 0x7FFF) : 1.0 ;
 
@@ -388,7 +499,7 @@ vox_write_d	(SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 	{	writecount = (len >= bufferlen) ? bufferlen : (int) len ;
 		for (k = 0 ; k < writecount ; k++)
 			sptr [k] = lrint (normfact * ptr [total + k]) ;
-		count = vox_write_block (psf, pvox, sptr, writecount) ;
+		count = vox_write_block (psf, &pvox->codec, sptr, writecount) ;
 		total += count ;
 		len -= writecount ;
 		if (count != writecount)
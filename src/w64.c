@@ -114,6 +114,7 @@ enum
 
 static int	w64_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock) ;
 static int	w64_write_header (SF_PRIVATE *psf, int calc_length) ;
+static int	w64_update_header (SF_PRIVATE *psf) ;
 static int	w64_close (SF_PRIVATE *psf) ;
 
 /*------------------------------------------------------------------------------
@@ -165,6 +166,7 @@ w64_open	(SF_PRIVATE *psf)
 			return error ;
 
 		psf->write_header = w64_write_header ;
+		psf->update_header = w64_update_header ;
 		} ;
 
 	psf->container_close = w64_close ;
@@ -440,6 +442,19 @@ w64_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 	return 0 ;
 } /* w64_read_header */
 
+static void
+w64_calc_length (SF_PRIVATE *psf)
+{
+	psf->filelength = psf_get_filelen (psf) ;
+
+	psf->datalength = psf->filelength - psf->dataoffset ;
+	if (psf->dataend)
+		psf->datalength -= psf->filelength - psf->dataend ;
+
+	if (psf->bytewidth)
+		psf->sf.frames = psf->datalength / (psf->bytewidth * psf->sf.channels) ;
+} /* w64_calc_length */
+
 static int
 w64_write_header (SF_PRIVATE *psf, int calc_length)
 {	sf_count_t 	fmt_size, current ;
@@ -449,23 +464,21 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 	current = psf_ftell (psf) ;
 
 	if (calc_length)
-	{	psf->filelength = psf_get_filelen (psf) ;
-
-		psf->datalength = psf->filelength - psf->dataoffset ;
-		if (psf->dataend)
-			psf->datalength -= psf->filelength - psf->dataend ;
-
-		if (psf->bytewidth)
-			psf->sf.frames = psf->datalength / (psf->bytewidth * psf->sf.channels) ;
-		} ;
+		w64_calc_length (psf) ;
 
 	/* Reset the current header length to zero. */
 	psf->header.ptr [0] = 0 ;
 	psf->header.indx = 0 ;
 	psf_fseek (psf, 0, SEEK_SET) ;
+	psf_patch_header_reset (psf) ;
 
 	/* riff marker, length, wave and 'fmt ' markers. */
-	psf_binheader_writef (psf, "eh8hh", riff_MARKER16, psf->filelength, wave_MARKER16, fmt_MARKER16) ;
+	psf->rwf_endian = SF_ENDIAN_LITTLE ;
+	psf_header_put_bytes (psf, riff_MARKER16, 16) ;
+	psf_header_put_64 (psf, psf->filelength) ;
+	psf_header_put_bytes (psf, wave_MARKER16, 16) ;
+	psf_header_put_bytes (psf, fmt_MARKER16, 16) ;
+	psf->hpatch.riff_size = 16 ;
 
 	subformat = SF_CODEC (psf->sf.format) ;
 
@@ -478,12 +491,10 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 					fmt_pad = (size_t) ((fmt_size & 0x7) ? 8 - (fmt_size & 0x7) : 0) ;
 					fmt_size += fmt_pad ;
 
-					/* fmt : format, channels, samplerate */
-					psf_binheader_writef (psf, "e8224", fmt_size, WAVE_FORMAT_PCM, psf->sf.channels, psf->sf.samplerate) ;
-					/*  fmt : bytespersec */
-					psf_binheader_writef (psf, "e4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-					/*  fmt : blockalign, bitwidth */
-					psf_binheader_writef (psf, "e22", psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
+					/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth */
+					psf_header_put_64 (psf, fmt_size) ;
+					wavlike_write_fmt_fields (psf, WAVE_FORMAT_PCM, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+								psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
 					break ;
 
 		case SF_FORMAT_FLOAT :
@@ -492,12 +503,10 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 					fmt_pad = (size_t) ((fmt_size & 0x7) ? 8 - (fmt_size & 0x7) : 0) ;
 					fmt_size += fmt_pad ;
 
-					/* fmt : format, channels, samplerate */
-					psf_binheader_writef (psf, "e8224", fmt_size, WAVE_FORMAT_IEEE_FLOAT, psf->sf.channels, psf->sf.samplerate) ;
-					/*  fmt : bytespersec */
-					psf_binheader_writef (psf, "e4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-					/*  fmt : blockalign, bitwidth */
-					psf_binheader_writef (psf, "e22", psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
+					/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth */
+					psf_header_put_64 (psf, fmt_size) ;
+					wavlike_write_fmt_fields (psf, WAVE_FORMAT_IEEE_FLOAT, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+								psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
 
 					add_fact_chunk = SF_TRUE ;
 					break ;
@@ -507,12 +516,10 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 					fmt_pad = (size_t) ((fmt_size & 0x7) ? 8 - (fmt_size & 0x7) : 0) ;
 					fmt_size += fmt_pad ;
 
-					/* fmt : format, channels, samplerate */
-					psf_binheader_writef (psf, "e8224", fmt_size, WAVE_FORMAT_MULAW, psf->sf.channels, psf->sf.samplerate) ;
-					/*  fmt : bytespersec */
-					psf_binheader_writef (psf, "e4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-					/*  fmt : blockalign, bitwidth */
-					psf_binheader_writef (psf, "e22", psf->bytewidth * psf->sf.channels, 8) ;
+					/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth */
+					psf_header_put_64 (psf, fmt_size) ;
+					wavlike_write_fmt_fields (psf, WAVE_FORMAT_MULAW, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+								psf->bytewidth * psf->sf.channels, 8) ;
 
 					add_fact_chunk = SF_TRUE ;
 					break ;
@@ -522,12 +529,10 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 					fmt_pad = (size_t) ((fmt_size & 0x7) ? 8 - (fmt_size & 0x7) : 0) ;
 					fmt_size += fmt_pad ;
 
-					/* fmt : format, channels, samplerate */
-					psf_binheader_writef (psf, "e8224", fmt_size, WAVE_FORMAT_ALAW, psf->sf.channels, psf->sf.samplerate) ;
-					/*  fmt : bytespersec */
-					psf_binheader_writef (psf, "e4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-					/*  fmt : blockalign, bitwidth */
-					psf_binheader_writef (psf, "e22", psf->bytewidth * psf->sf.channels, 8) ;
+					/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth */
+					psf_header_put_64 (psf, fmt_size) ;
+					wavlike_write_fmt_fields (psf, WAVE_FORMAT_ALAW, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+								psf->bytewidth * psf->sf.channels, 8) ;
 
 					add_fact_chunk = SF_TRUE ;
 					break ;
@@ -545,14 +550,13 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 						fmt_pad = (size_t) ((fmt_size & 0x7) ? 8 - (fmt_size & 0x7) : 0) ;
 						fmt_size += fmt_pad ;
 
-						/* fmt : size, WAV format type, channels. */
-						psf_binheader_writef (psf, "e822", fmt_size, WAVE_FORMAT_IMA_ADPCM, psf->sf.channels) ;
+						/* fmt : size, WAV format type, channels, samplerate, bytespersec, blockalign, bitwidth */
+						psf_header_put_64 (psf, fmt_size) ;
+						wavlike_write_fmt_fields (psf, WAVE_FORMAT_IMA_ADPCM, bytespersec, blockalign, 4) ;
 
-						/* fmt : samplerate, bytespersec. */
-						psf_binheader_writef (psf, "e44", psf->sf.samplerate, bytespersec) ;
-
-						/* fmt : blockalign, bitwidth, extrabytes, framesperblock. */
-						psf_binheader_writef (psf, "e2222", blockalign, 4, 2, framesperblock) ;
+						/* fmt : extrabytes, framesperblock. */
+						psf_header_put_16 (psf, 2) ;
+						psf_header_put_16 (psf, framesperblock) ;
 						} ;
 
 					add_fact_chunk = SF_TRUE ;
@@ -571,14 +575,14 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 						fmt_pad = (size_t) ((fmt_size & 0x7) ? 8 - (fmt_size & 0x7) : 0) ;
 						fmt_size += fmt_pad ;
 
-						/* fmt : size, W64 format type, channels. */
-						psf_binheader_writef (psf, "e822", fmt_size, WAVE_FORMAT_MS_ADPCM, psf->sf.channels) ;
-
-						/* fmt : samplerate, bytespersec. */
-						psf_binheader_writef (psf, "e44", psf->sf.samplerate, bytespersec) ;
+						/* fmt : size, W64 format type, channels, samplerate, bytespersec, blockalign, bitwidth */
+						psf_header_put_64 (psf, fmt_size) ;
+						wavlike_write_fmt_fields (psf, WAVE_FORMAT_MS_ADPCM, bytespersec, blockalign, 4) ;
 
-						/* fmt : blockalign, bitwidth, extrabytes, framesperblock. */
-						psf_binheader_writef (psf, "e22222", blockalign, 4, extrabytes, framesperblock, 7) ;
+						/* fmt : extrabytes, framesperblock, number of coefficients. */
+						psf_header_put_16 (psf, extrabytes) ;
+						psf_header_put_16 (psf, framesperblock) ;
+						psf_header_put_16 (psf, 7) ;
 
 						wavlike_msadpcm_write_adapt_coeffs (psf) ;
 						} ;
@@ -597,14 +601,13 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 						fmt_pad = (size_t) ((fmt_size & 0x7) ? 8 - (fmt_size & 0x7) : 0) ;
 						fmt_size += fmt_pad ;
 
-						/* fmt : size, WAV format type, channels. */
-						psf_binheader_writef (psf, "e822", fmt_size, WAVE_FORMAT_GSM610, psf->sf.channels) ;
+						/* fmt : size, WAV format type, channels, samplerate, bytespersec, blockalign, bitwidth */
+						psf_header_put_64 (psf, fmt_size) ;
+						wavlike_write_fmt_fields (psf, WAVE_FORMAT_GSM610, bytespersec, WAVLIKE_GSM610_BLOCKSIZE, 0) ;
 
-						/* fmt : samplerate, bytespersec. */
-						psf_binheader_writef (psf, "e44", psf->sf.samplerate, bytespersec) ;
-
-						/* fmt : blockalign, bitwidth, extrabytes, framesperblock. */
-						psf_binheader_writef (psf, "e2222", WAVLIKE_GSM610_BLOCKSIZE, 0, 2, WAVLIKE_GSM610_SAMPLES) ;
+						/* fmt : extrabytes, framesperblock. */
+						psf_header_put_16 (psf, 2) ;
+						psf_header_put_16 (psf, WAVLIKE_GSM610_SAMPLES) ;
 						} ;
 
 					add_fact_chunk = SF_TRUE ;
@@ -615,18 +618,26 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 
 	/* Pad to 8 bytes with zeros. */
 	if (fmt_pad > 0)
-		psf_binheader_writef (psf, "z", fmt_pad) ;
+		psf_header_put_zeros (psf, (int) fmt_pad) ;
 
 	if (add_fact_chunk)
-		psf_binheader_writef (psf, "eh88", fact_MARKER16, (sf_count_t) (16 + 8 + 8), psf->sf.frames) ;
+	{	psf_header_put_bytes (psf, fact_MARKER16, 16) ;
+		psf_header_put_64 (psf, 16 + 8 + 8) ;
+		psf_header_put_64 (psf, psf->sf.frames) ;
+		psf->hpatch.frames = psf->header.indx - 8 ;
+		} ;
+
+	psf_header_put_bytes (psf, data_MARKER16, 16) ;
+	psf_header_put_64 (psf, psf->datalength + 24) ;
+	psf->hpatch.data_size = psf->header.indx - 8 ;
 
-	psf_binheader_writef (psf, "eh8", data_MARKER16, psf->datalength + 24) ;
 	psf_fwrite (psf->header.ptr, psf->header.indx, 1, psf) ;
 
 	if (psf->error)
 		return psf->error ;
 
 	psf->dataoffset = psf->header.indx ;
+	psf_patch_header_save (psf) ;
 
 	if (current > 0)
 		psf_fseek (psf, current, SEEK_SET) ;
@@ -634,6 +645,21 @@ w64_write_header (SF_PRIVATE *psf, int calc_length)
 	return psf->error ;
 } /* w64_write_header */
 
+static int
+w64_update_header (SF_PRIVATE *psf)
+{
+	if (psf->hpatch.dataoffset == 0 || psf->hpatch.dataoffset != psf->dataoffset)
+		return w64_write_header (psf, SF_TRUE) ;
+
+	w64_calc_length (psf) ;
+
+	psf_patch_header_int (psf, psf->hpatch.riff_size, 8, SF_ENDIAN_LITTLE, psf->filelength) ;
+	psf_patch_header_int (psf, psf->hpatch.frames, 8, SF_ENDIAN_LITTLE, psf->sf.frames) ;
+	psf_patch_header_int (psf, psf->hpatch.data_size, 8, SF_ENDIAN_LITTLE, psf->datalength + 24) ;
+
+	return psf_patch_header_flush (psf) ;
+} /* w64_update_header */
+
 static int
 w64_close (SF_PRIVATE *psf)
 {
@@ -138,13 +138,17 @@ static const EXT_SUBFORMAT MSGUID_SUBTYPE_PVOCEX =
 
 static int	wav_read_header		(SF_PRIVATE *psf, int *blockalign, int *framesperblock) ;
 static int	wav_write_header	(SF_PRIVATE *psf, int calc_length) ;
+static int	wav_update_header	(SF_PRIVATE *psf) ;
 
 static int	wav_write_tailer (SF_PRIVATE *psf) ;
 static int	wav_command (SF_PRIVATE *psf, int command, void *data, int datasize) ;
 static int	wav_close (SF_PRIVATE *psf) ;
 
+static int	wav_read_cue_chunk (SF_PRIVATE *psf, uint32_t chunklen) ;
 static int	wav_read_smpl_chunk (SF_PRIVATE *psf, uint32_t chunklen) ;
 static int	wav_read_acid_chunk (SF_PRIVATE *psf, uint32_t chunklen) ;
+static int	wav_read_metadata_chunk (SF_PRIVATE *psf, uint32_t marker, uint32_t chunklen) ;
+static int	wav_parse_metadata (SF_PRIVATE *psf) ;
 
 static int wav_set_chunk (SF_PRIVATE *psf, const SF_CHUNK_INFO * chunk_info) ;
 static SF_CHUNK_ITERATOR * wav_next_chunk_iterator (SF_PRIVATE *psf, SF_CHUNK_ITERATOR * iterator) ;
@@ -179,7 +183,8 @@ wav_open	(SF_PRIVATE *psf)
 	subformat = SF_CODEC (psf->sf.format) ;
 
 	if (psf->file.mode == SFM_WRITE || psf->file.mode == SFM_RDWR)
-	{	if (psf->is_pipe)
+	{	/* Only fixed width codecs can be streamed, the rest need a rewind. */
+		if (psf->is_pipe && (psf->file.mode == SFM_RDWR || psf->bytewidth == 0))
 			return SFE_NO_PIPE_WRITE ;
 
 		wpriv->wavex_ambisonic = SF_AMBISONIC_NONE ;
@@ -211,14 +216,16 @@ wav_open	(SF_PRIVATE *psf)
 
 		/* By default, add the peak chunk to floating point files. Default behaviour
 		** can be switched off using sf_command (SFC_SET_PEAK_CHUNK, SF_FALSE).
+		** The peaks aren't known until the end, which a pipe never gets back to.
 		*/
-		if (psf->file.mode == SFM_WRITE && (subformat == SF_FORMAT_FLOAT || subformat == SF_FORMAT_DOUBLE))
+		if (psf->file.mode == SFM_WRITE && psf->is_pipe == SF_FALSE && (subformat == SF_FORMAT_FLOAT || subformat == SF_FORMAT_DOUBLE))
 		{	if ((psf->peak_info = peak_info_calloc (psf->sf.channels)) == NULL)
 				return SFE_MALLOC_FAILED ;
 			psf->peak_info->peak_loc = SF_PEAK_START ;
 			} ;
 
 		psf->write_header	= wav_write_header ;
+		psf->update_header	= wav_update_header ;
 		psf->set_chunk		= wav_set_chunk ;
 		} ;
 
@@ -295,6 +302,10 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 		return SFE_INTERNAL ;
 	wav_fmt = &wpriv->wav_fmt ;
 
+	/* A fast open only records the position of the metadata chunks. */
+	if (psf->fast_open && psf->sf.seekable)
+		psf->parse_metadata = wav_parse_metadata ;
+
 	/* Set position to start of file to begin reading header. */
 	psf_binheader_readf (psf, "pmj", 0, &marker, -4) ;
 	psf->header.indx = 0 ;
@@ -308,8 +319,10 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 	while (! done)
 	{	size_t jump = chunk_size & 1 ;
 
-		marker = chunk_size = 0 ;
-		psf_binheader_readf (psf, "jm4", jump, &marker, &chunk_size) ;
+		psf_header_skip (psf, jump) ;
+		psf_header_prefetch (psf, 8) ;
+		marker = psf_header_get_marker (psf) ;
+		chunk_size = psf_header_get_32 (psf) ;
 		if (marker == 0)
 		{	sf_count_t pos = psf_ftell (psf) ;
 			psf_log_printf (psf, "Have 0 marker at position %D (0x%x).\n", pos, pos) ;
@@ -351,7 +364,7 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 							psf_log_printf (psf, "RIFX : %u\n", RIFFsize) ;
 					} ;
 
-					psf_binheader_readf (psf, "m", &marker) ;
+					marker = psf_header_get_marker (psf) ;
 					if (marker != WAVE_MARKER)
 						return SFE_WAV_NO_WAVE ;
 					parsestage |= HAVE_WAVE ;
@@ -398,7 +411,13 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 							psf->datalength = psf->filelength - psf->dataoffset ;
 							} ;
 
-						if (psf->datalength > psf->filelength - psf->dataoffset)
+						if (chunk_size == 0xffffffff && psf->is_pipe)
+						{	/* Streamed, so the length wasn't known. Read to the end of the pipe. */
+							psf_log_printf (psf, "data : 0xffffffff (unknown)\n") ;
+							psf->datalength = psf->filelength - psf->dataoffset ;
+							chunk_size = 0 ;
+							}
+						else if (psf->datalength > psf->filelength - psf->dataoffset)
 						{	psf_log_printf (psf, "data : %D (should be %D)\n", psf->datalength, psf->filelength - psf->dataoffset) ;
 							psf->datalength = psf->filelength - psf->dataoffset ;
 							}
@@ -432,7 +451,7 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 					if ((parsestage & HAVE_fmt) != HAVE_fmt)
 						psf_log_printf (psf, "*** Should have 'fmt ' chunk before 'fact'\n") ;
 
-					psf_binheader_readf (psf, "4", & (fact_chunk.frames)) ;
+					fact_chunk.frames = psf_header_get_32 (psf) ;
 
 					if (chunk_size > SIGNED_SIZEOF (fact_chunk))
 						psf_binheader_readf (psf, "j", (int) (chunk_size - SIGNED_SIZEOF (fact_chunk))) ;
@@ -452,60 +471,19 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 					parsestage |= HAVE_PEAK ;
 
 					psf_log_printf (psf, "%M : %u\n", marker, chunk_size) ;
-					if ((error = wavlike_read_peak_chunk (psf, chunk_size)) != 0)
+					if ((error = wav_read_metadata_chunk (psf, marker, chunk_size)) != 0)
 						return error ;
-					psf->peak_info->peak_loc = ((parsestage & HAVE_data) == 0) ? SF_PEAK_START : SF_PEAK_END ;
+					if (psf->peak_info != NULL)
+						psf->peak_info->peak_loc = ((parsestage & HAVE_data) == 0) ? SF_PEAK_START : SF_PEAK_END ;
 					break ;
 
 			case cue_MARKER :
 					parsestage |= HAVE_other ;
 
-					{	uint32_t thisread, bytesread, cue_count, position, offset ;
-						int id, chunk_id, chunk_start, block_start, cue_index ;
-
-						bytesread = psf_binheader_readf (psf, "4", &cue_count) ;
-						psf_log_printf (psf, "%M : %u\n", marker, chunk_size) ;
-
-						if (cue_count > 1000)
-						{	psf_log_printf (psf, "  Count : %u (skipping)\n", cue_count) ;
-							psf_binheader_readf (psf, "j", (cue_count > 20 ? 20 : cue_count) * 24) ;
-							break ;
-							} ;
-
-						psf_log_printf (psf, "  Count : %d\n", cue_count) ;
-
-						if ((psf->cues = psf_cues_alloc (cue_count)) == NULL)
-							return SFE_MALLOC_FAILED ;
-
-						cue_index = 0 ;
-
-						while (cue_count)
-						{
-							if ((thisread = psf_binheader_readf (psf, "e44m444", &id, &position, &chunk_id, &chunk_start, &block_start, &offset)) == 0)
-								break ;
-							bytesread += thisread ;
-
-							psf_log_printf (psf,	"   Cue ID : %2d"
-													"  Pos : %5u  Chunk : %M"
-													"  Chk Start : %d  Blk Start : %d"
-													"  Offset : %5d\n",
-									id, position, chunk_id, chunk_start, block_start, offset) ;
-							psf->cues->cue_points [cue_index].indx = id ;
-							psf->cues->cue_points [cue_index].position = position ;
-							psf->cues->cue_points [cue_index].fcc_chunk = chunk_id ;
-							psf->cues->cue_points [cue_index].chunk_start = chunk_start ;
-							psf->cues->cue_points [cue_index].block_start = block_start ;
-							psf->cues->cue_points [cue_index].sample_offset = offset ;
-							psf->cues->cue_points [cue_index].name [0] = '\0' ;
-							cue_count -- ;
-							cue_index ++ ;
-							} ;
+					psf_log_printf (psf, "%M : %u\n", marker, chunk_size) ;
 
-						if (bytesread != chunk_size)
-						{	psf_log_printf (psf, "**** Chunk size weirdness (%d != %d)\n", chunk_size, bytesread) ;
-							psf_binheader_readf (psf, "j", chunk_size - bytesread) ;
-							} ;
-						} ;
+					if ((error = wav_read_metadata_chunk (psf, marker, chunk_size)))
+						return error ;
 					break ;
 
 			case smpl_MARKER :
@@ -513,7 +491,7 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 
 					psf_log_printf (psf, "smpl : %u\n", chunk_size) ;
 
-					if ((error = wav_read_smpl_chunk (psf, chunk_size)))
+					if ((error = wav_read_metadata_chunk (psf, marker, chunk_size)))
 						return error ;
 					break ;
 
@@ -522,7 +500,7 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 
 					psf_log_printf (psf, "acid : %u\n", chunk_size) ;
 
-					if ((error = wav_read_acid_chunk (psf, chunk_size)))
+					if ((error = wav_read_metadata_chunk (psf, marker, chunk_size)))
 						return error ;
 					break ;
 
@@ -530,7 +508,7 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 			case LIST_MARKER :
 					parsestage |= HAVE_other ;
 
-					if ((error = wavlike_subchunk_parse (psf, marker, chunk_size)) != 0)
+					if ((error = wav_read_metadata_chunk (psf, marker, chunk_size)) != 0)
 						return error ;
 					break ;
 
@@ -539,7 +517,7 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 					The 'bext' chunk can actually be updated, so don't need to set this.
 					parsestage |= HAVE_other ;
 					*/
-					if ((error = wavlike_read_bext_chunk (psf, chunk_size)))
+					if ((error = wav_read_metadata_chunk (psf, marker, chunk_size)))
 						return error ;
 					break ;
 
@@ -553,7 +531,7 @@ wav_read_header	(SF_PRIVATE *psf, int *blockalign, int *framesperblock)
 					break ;
 
 			case cart_MARKER:
-					if ((error = wavlike_read_cart_chunk (psf, chunk_size)))
+					if ((error = wav_read_metadata_chunk (psf, marker, chunk_size)))
 						return error ;
 					break ;
 
@@ -731,24 +709,20 @@ wav_write_fmt_chunk (SF_PRIVATE *psf)
 		case SF_FORMAT_PCM_32 :
 					fmt_size = 2 + 2 + 4 + 4 + 2 + 2 ;
 
-					/* fmt : format, channels, samplerate */
-					psf_binheader_writef (psf, "4224", fmt_size, WAVE_FORMAT_PCM, psf->sf.channels, psf->sf.samplerate) ;
-					/*  fmt : bytespersec */
-					psf_binheader_writef (psf, "4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-					/*  fmt : blockalign, bitwidth */
-					psf_binheader_writef (psf, "22", psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
+					/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth */
+					psf_header_put_32 (psf, fmt_size) ;
+					wavlike_write_fmt_fields (psf, WAVE_FORMAT_PCM, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+								psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
 					break ;
 
 		case SF_FORMAT_FLOAT :
 		case SF_FORMAT_DOUBLE :
 					fmt_size = 2 + 2 + 4 + 4 + 2 + 2 ;
 
-					/* fmt : format, channels, samplerate */
-					psf_binheader_writef (psf, "4224", fmt_size, WAVE_FORMAT_IEEE_FLOAT, psf->sf.channels, psf->sf.samplerate) ;
-					/*  fmt : bytespersec */
-					psf_binheader_writef (psf, "4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-					/*  fmt : blockalign, bitwidth */
-					psf_binheader_writef (psf, "22", psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
+					/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth */
+					psf_header_put_32 (psf, fmt_size) ;
+					wavlike_write_fmt_fields (psf, WAVE_FORMAT_IEEE_FLOAT, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+								psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
 
 					add_fact_chunk = SF_TRUE ;
 					break ;
@@ -756,12 +730,11 @@ wav_write_fmt_chunk (SF_PRIVATE *psf)
 		case SF_FORMAT_ULAW :
 					fmt_size = 2 + 2 + 4 + 4 + 2 + 2 + 2 ;
 
-					/* fmt : format, channels, samplerate */
-					psf_binheader_writef (psf, "4224", fmt_size, WAVE_FORMAT_MULAW, psf->sf.channels, psf->sf.samplerate) ;
-					/*  fmt : bytespersec */
-					psf_binheader_writef (psf, "4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-					/*  fmt : blockalign, bitwidth, extrabytes */
-					psf_binheader_writef (psf, "222", psf->bytewidth * psf->sf.channels, 8, 0) ;
+					/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth, extrabytes */
+					psf_header_put_32 (psf, fmt_size) ;
+					wavlike_write_fmt_fields (psf, WAVE_FORMAT_MULAW, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+								psf->bytewidth * psf->sf.channels, 8) ;
+					psf_header_put_16 (psf, 0) ;
 
 					add_fact_chunk = SF_TRUE ;
 					break ;
@@ -769,12 +742,11 @@ wav_write_fmt_chunk (SF_PRIVATE *psf)
 		case SF_FORMAT_ALAW :
 					fmt_size = 2 + 2 + 4 + 4 + 2 + 2 + 2 ;
 
-					/* fmt : format, channels, samplerate */
-					psf_binheader_writef (psf, "4224", fmt_size, WAVE_FORMAT_ALAW, psf->sf.channels, psf->sf.samplerate) ;
-					/*  fmt : bytespersec */
-					psf_binheader_writef (psf, "4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-					/*  fmt : blockalign, bitwidth, extrabytes */
-					psf_binheader_writef (psf, "222", psf->bytewidth * psf->sf.channels, 8, 0) ;
+					/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth, extrabytes */
+					psf_header_put_32 (psf, fmt_size) ;
+					wavlike_write_fmt_fields (psf, WAVE_FORMAT_ALAW, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+								psf->bytewidth * psf->sf.channels, 8) ;
+					psf_header_put_16 (psf, 0) ;
 
 					add_fact_chunk = SF_TRUE ;
 					break ;
@@ -790,12 +762,13 @@ wav_write_fmt_chunk (SF_PRIVATE *psf)
 						/* fmt chunk. */
 						fmt_size = 2 + 2 + 4 + 4 + 2 + 2 + 2 + 2 ;
 
-						/* fmt : size, WAV format type, channels, samplerate, bytespersec */
-						psf_binheader_writef (psf, "42244", fmt_size, WAVE_FORMAT_IMA_ADPCM,
-									psf->sf.channels, psf->sf.samplerate, bytespersec) ;
+						/* fmt : size, WAV format type, channels, samplerate, bytespersec, blockalign, bitwidth */
+						psf_header_put_32 (psf, fmt_size) ;
+						wavlike_write_fmt_fields (psf, WAVE_FORMAT_IMA_ADPCM, bytespersec, blockalign, 4) ;
 
-						/* fmt : blockalign, bitwidth, extrabytes, framesperblock. */
-						psf_binheader_writef (psf, "2222", blockalign, 4, 2, framesperblock) ;
+						/* fmt : extrabytes, framesperblock. */
+						psf_header_put_16 (psf, 2) ;
+						psf_header_put_16 (psf, framesperblock) ;
 						} ;
 
 					add_fact_chunk = SF_TRUE ;
@@ -812,14 +785,14 @@ wav_write_fmt_chunk (SF_PRIVATE *psf)
 						extrabytes	= 2 + 2 + WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT * (2 + 2) ;
 						fmt_size	= 2 + 2 + 4 + 4 + 2 + 2 + 2 + extrabytes ;
 
-						/* fmt : size, WAV format type, channels. */
-						psf_binheader_writef (psf, "422", fmt_size, WAVE_FORMAT_MS_ADPCM, psf->sf.channels) ;
+						/* fmt : size, WAV format type, channels, samplerate, bytespersec, blockalign, bitwidth */
+						psf_header_put_32 (psf, fmt_size) ;
+						wavlike_write_fmt_fields (psf, WAVE_FORMAT_MS_ADPCM, bytespersec, blockalign, 4) ;
 
-						/* fmt : samplerate, bytespersec. */
-						psf_binheader_writef (psf, "44", psf->sf.samplerate, bytespersec) ;
-
-						/* fmt : blockalign, bitwidth, extrabytes, framesperblock. */
-						psf_binheader_writef (psf, "22222", blockalign, 4, extrabytes, framesperblock, 7) ;
+						/* fmt : extrabytes, framesperblock, number of coefficients. */
+						psf_header_put_16 (psf, extrabytes) ;
+						psf_header_put_16 (psf, framesperblock) ;
+						psf_header_put_16 (psf, 7) ;
 
 						wavlike_msadpcm_write_adapt_coeffs (psf) ;
 						} ;
@@ -832,12 +805,13 @@ wav_write_fmt_chunk (SF_PRIVATE *psf)
 					/* fmt chunk. */
 					fmt_size = 2 + 2 + 4 + 4 + 2 + 2 + 2 + 2 ;
 
-					/* fmt : size, WAV format type, channels, samplerate, bytespersec */
-					psf_binheader_writef (psf, "42244", fmt_size, WAVE_FORMAT_G721_ADPCM,
-								psf->sf.channels, psf->sf.samplerate, psf->sf.samplerate * psf->sf.channels / 2) ;
+					/* fmt : size, WAV format type, channels, samplerate, bytespersec, blockalign, bitwidth */
+					psf_header_put_32 (psf, fmt_size) ;
+					wavlike_write_fmt_fields (psf, WAVE_FORMAT_G721_ADPCM, psf->sf.samplerate * psf->sf.channels / 2, 64, 4) ;
 
-					/* fmt : blockalign, bitwidth, extrabytes, auxblocksize. */
-					psf_binheader_writef (psf, "2222", 64, 4, 2, 0) ;
+					/* fmt : extrabytes, auxblocksize. */
+					psf_header_put_16 (psf, 2) ;
+					psf_header_put_16 (psf, 0) ;
 
 					add_fact_chunk = SF_TRUE ;
 					break ;
@@ -854,14 +828,13 @@ wav_write_fmt_chunk (SF_PRIVATE *psf)
 						/* fmt chunk. */
 						fmt_size = 2 + 2 + 4 + 4 + 2 + 2 + 2 + 2 ;
 
-						/* fmt : size, WAV format type, channels. */
-						psf_binheader_writef (psf, "422", fmt_size, WAVE_FORMAT_GSM610, psf->sf.channels) ;
-
-						/* fmt : samplerate, bytespersec. */
-						psf_binheader_writef (psf, "44", psf->sf.samplerate, bytespersec) ;
+						/* fmt : size, WAV format type, channels, samplerate, bytespersec, blockalign, bitwidth */
+						psf_header_put_32 (psf, fmt_size) ;
+						wavlike_write_fmt_fields (psf, WAVE_FORMAT_GSM610, bytespersec, blockalign, 0) ;
 
-						/* fmt : blockalign, bitwidth, extrabytes, framesperblock. */
-						psf_binheader_writef (psf, "2222", blockalign, 0, 2, framesperblock) ;
+						/* fmt : extrabytes, framesperblock. */
+						psf_header_put_16 (psf, 2) ;
+						psf_header_put_16 (psf, framesperblock) ;
 						} ;
 
 					add_fact_chunk = SF_TRUE ;
@@ -871,7 +844,11 @@ wav_write_fmt_chunk (SF_PRIVATE *psf)
 		} ;
 
 	if (add_fact_chunk)
-		psf_binheader_writef (psf, "tm48", fact_MARKER, 4, psf->sf.frames) ;
+	{	psf_header_put_marker (psf, fact_MARKER) ;
+		psf_header_put_32 (psf, 4) ;
+		psf_header_put_32 (psf, psf->sf.frames) ;
+		psf->hpatch.frames = psf->header.indx - 4 ;
+		} ;
 
 	return 0 ;
 } /* wav_write_fmt_chunk */
@@ -898,26 +875,24 @@ wavex_write_fmt_chunk (SF_PRIVATE *psf)
 		case SF_FORMAT_ALAW :
 			fmt_size = 2 + 2 + 4 + 4 + 2 + 2 + 2 + 2 + 4 + 4 + 2 + 2 + 8 ;
 
-			/* fmt : format, channels, samplerate */
-			psf_binheader_writef (psf, "4224", fmt_size, WAVE_FORMAT_EXTENSIBLE, psf->sf.channels, psf->sf.samplerate) ;
-			/*  fmt : bytespersec */
-			psf_binheader_writef (psf, "4", psf->sf.samplerate * psf->bytewidth * psf->sf.channels) ;
-			/*  fmt : blockalign, bitwidth */
-			psf_binheader_writef (psf, "22", psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
+			/* fmt : size, format, channels, samplerate, bytespersec, blockalign, bitwidth */
+			psf_header_put_32 (psf, fmt_size) ;
+			wavlike_write_fmt_fields (psf, WAVE_FORMAT_EXTENSIBLE, psf->sf.samplerate * psf->bytewidth * psf->sf.channels,
+						psf->bytewidth * psf->sf.channels, psf->bytewidth * 8) ;
 
 			/* cbSize 22 is sizeof (WAVEFORMATEXTENSIBLE) - sizeof (WAVEFORMATEX) */
-			psf_binheader_writef (psf, "2", 22) ;
+			psf_header_put_16 (psf, 22) ;
 
 			/* wValidBitsPerSample, for our use same as bitwidth as we use it fully */
-			psf_binheader_writef (psf, "2", psf->bytewidth * 8) ;
+			psf_header_put_16 (psf, psf->bytewidth * 8) ;
 
 			/* For an Ambisonic file set the channel mask to zero.
 			** Otherwise use a default based on the channel count.
 			*/
 			if (wpriv->wavex_ambisonic != SF_AMBISONIC_NONE)
-				psf_binheader_writef (psf, "4", 0) ;
+				psf_header_put_32 (psf, 0) ;
 			else if (wpriv->wavex_channelmask != 0)
-				psf_binheader_writef (psf, "4", wpriv->wavex_channelmask) ;
+				psf_header_put_32 (psf, wpriv->wavex_channelmask) ;
 			else
 			{	/*
 				** Ok some liberty is taken here to use the most commonly used channel masks
@@ -926,27 +901,27 @@ wavex_write_fmt_chunk (SF_PRIVATE *psf)
 				*/
 				switch (psf->sf.channels)
 				{	case 1 :	/* center channel mono */
-						psf_binheader_writef (psf, "4", 0x4) ;
+						psf_header_put_32 (psf, 0x4) ;
 						break ;
 
 					case 2 :	/* front left and right */
-						psf_binheader_writef (psf, "4", 0x1 | 0x2) ;
+						psf_header_put_32 (psf, 0x1 | 0x2) ;
 						break ;
 
 					case 4 :	/* Quad */
-						psf_binheader_writef (psf, "4", 0x1 | 0x2 | 0x10 | 0x20) ;
+						psf_header_put_32 (psf, 0x1 | 0x2 | 0x10 | 0x20) ;
 						break ;
 
 					case 6 :	/* 5.1 */
-						psf_binheader_writef (psf, "4", 0x1 | 0x2 | 0x4 | 0x8 | 0x10 | 0x20) ;
+						psf_header_put_32 (psf, 0x1 | 0x2 | 0x4 | 0x8 | 0x10 | 0x20) ;
 						break ;
 
 					case 8 :	/* 7.1 */
-						psf_binheader_writef (psf, "4", 0x1 | 0x2 | 0x4 | 0x8 | 0x10 | 0x20 | 0x40 | 0x80) ;
+						psf_header_put_32 (psf, 0x1 | 0x2 | 0x4 | 0x8 | 0x10 | 0x20 | 0x40 | 0x80) ;
 						break ;
 
 					default :	/* 0 when in doubt , use direct out, ie NO mapping*/
-						psf_binheader_writef (psf, "4", 0x0) ;
+						psf_header_put_32 (psf, 0x0) ;
 						break ;
 					} ;
 				} ;
@@ -993,37 +968,53 @@ wavex_write_fmt_chunk (SF_PRIVATE *psf)
 		default : return SFE_UNIMPLEMENTED ;
 		} ;
 
-	psf_binheader_writef (psf, "tm48", fact_MARKER, 4, psf->sf.frames) ;
+	psf_header_put_marker (psf, fact_MARKER) ;
+	psf_header_put_32 (psf, 4) ;
+	psf_header_put_32 (psf, psf->sf.frames) ;
+	psf->hpatch.frames = psf->header.indx - 4 ;
 
 	return 0 ;
 } /* wavex_write_fmt_chunk */
 
 
+static void
+wav_calc_length (SF_PRIVATE *psf)
+{
+	psf->filelength = psf_get_filelen (psf) ;
+
+	psf->datalength = psf->filelength - psf->dataoffset ;
+
+	if (psf->dataend)
+		psf->datalength -= psf->filelength - psf->dataend ;
+	else if (psf->bytewidth > 0 && psf->sf.seekable == SF_TRUE)
+		psf->datalength = psf->sf.frames * psf->bytewidth * psf->sf.channels ;
+} /* wav_calc_length */
+
 static int
 wav_write_header (SF_PRIVATE *psf, int calc_length)
 {	sf_count_t	current ;
 	int 		error, has_data = SF_FALSE ;
 
+	/*
+	** A pipe only gets the header written at open, with the sizes marked as
+	** unknown. It can't be rewritten once anything has gone down the pipe.
+	*/
+	if (psf->is_pipe && psf->pipeoffset > 0)
+		return 0 ;
+
 	current = psf_ftell (psf) ;
 
 	if (current > psf->dataoffset)
 		has_data = SF_TRUE ;
 
 	if (calc_length)
-	{	psf->filelength = psf_get_filelen (psf) ;
-
-		psf->datalength = psf->filelength - psf->dataoffset ;
-
-		if (psf->dataend)
-			psf->datalength -= psf->filelength - psf->dataend ;
-		else if (psf->bytewidth > 0 && psf->sf.seekable == SF_TRUE)
-			psf->datalength = psf->sf.frames * psf->bytewidth * psf->sf.channels ;
-		} ;
+		wav_calc_length (psf) ;
 
 	/* Reset the current header length to zero. */
 	psf->header.ptr [0] = 0 ;
 	psf->header.indx = 0 ;
 	psf_fseek (psf, 0, SEEK_SET) ;
+	psf_patch_header_reset (psf) ;
 
 	/*
 	** RIFX signifies big-endian format for all header and data.
@@ -1034,12 +1025,22 @@ wav_write_header (SF_PRIVATE *psf, int calc_length)
 	/* RIFF/RIFX marker, length, WAVE and 'fmt ' markers. */
 
 	if (psf->endian == SF_ENDIAN_LITTLE)
-		psf_binheader_writef (psf, "etm8", RIFF_MARKER, (psf->filelength < 8) ? 8 : psf->filelength - 8) ;
+	{	psf->rwf_endian = SF_ENDIAN_LITTLE ;
+		psf_header_put_marker (psf, RIFF_MARKER) ;
+		}
+	else
+	{	psf->rwf_endian = SF_ENDIAN_BIG ;
+		psf_header_put_marker (psf, RIFX_MARKER) ;
+		} ;
+	if (psf->is_pipe)
+		psf_header_put_32 (psf, 0xffffffff) ;
 	else
-		psf_binheader_writef (psf, "Etm8", RIFX_MARKER, (psf->filelength < 8) ? 8 : psf->filelength - 8) ;
+		psf_header_put_32 (psf, (psf->filelength < 8) ? 8 : psf->filelength - 8) ;
+	psf->hpatch.riff_size = 4 ;
 
 	/* WAVE and 'fmt ' markers. */
-	psf_binheader_writef (psf, "mm", WAVE_MARKER, fmt_MARKER) ;
+	psf_header_put_marker (psf, WAVE_MARKER) ;
+	psf_header_put_marker (psf, fmt_MARKER) ;
 
 	/* Write the 'fmt ' chunk. */
 	switch (SF_CONTAINER (psf->sf.format))
@@ -1062,7 +1063,9 @@ wav_write_header (SF_PRIVATE *psf, int calc_length)
 		wavlike_write_strings (psf, SF_STR_LOCATE_START) ;
 
 	if (psf->peak_info != NULL && psf->peak_info->peak_loc == SF_PEAK_START)
-		wavlike_write_peak_chunk (psf) ;
+	{	wavlike_write_peak_chunk (psf) ;
+		psf->hpatch.peak = psf->header.indx - 8 * psf->sf.channels ;
+		} ;
 
 	if (psf->broadcast_16k != NULL)
 		wavlike_write_bext_chunk (psf) ;
@@ -1116,7 +1119,10 @@ wav_write_header (SF_PRIVATE *psf, int calc_length)
 		psf_binheader_writef (psf, "m4z", PAD_MARKER, k, k) ;
 		} ;
 
-	psf_binheader_writef (psf, "tm8", data_MARKER, psf->datalength) ;
+	psf_header_put_marker (psf, data_MARKER) ;
+	psf_header_put_32 (psf, psf->is_pipe ? 0xffffffff : psf->datalength) ;
+	psf->hpatch.data_size = psf->header.indx - 4 ;
+
 	psf_fwrite (psf->header.ptr, psf->header.indx, 1, psf) ;
 	if (psf->error)
 		return psf->error ;
@@ -1127,6 +1133,7 @@ wav_write_header (SF_PRIVATE *psf, int calc_length)
 		} ;
 
 	psf->dataoffset = psf->header.indx ;
+	psf_patch_header_save (psf) ;
 
 	if (! has_data)
 		psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
@@ -1136,6 +1143,26 @@ wav_write_header (SF_PRIVATE *psf, int calc_length)
 	return psf->error ;
 } /* wav_write_header */
 
+static int
+wav_update_header (SF_PRIVATE *psf)
+{	int endian = (psf->endian == SF_ENDIAN_LITTLE) ? SF_ENDIAN_LITTLE : SF_ENDIAN_BIG ;
+
+	if (psf->is_pipe)
+		return 0 ;
+
+	if (psf->hpatch.dataoffset == 0 || psf->hpatch.dataoffset != psf->dataoffset)
+		return wav_write_header (psf, SF_TRUE) ;
+
+	wav_calc_length (psf) ;
+
+	psf_patch_header_int (psf, psf->hpatch.riff_size, 4, endian, (psf->filelength < 8) ? 8 : psf->filelength - 8) ;
+	psf_patch_header_int (psf, psf->hpatch.frames, 4, endian, psf->sf.frames) ;
+	psf_patch_header_peaks (psf, psf->hpatch.peak, 4, endian) ;
+	psf_patch_header_int (psf, psf->hpatch.data_size, 4, endian, psf->datalength) ;
+
+	return psf_patch_header_flush (psf) ;
+} /* wav_update_header */
+
 
 static int
 wav_write_tailer (SF_PRIVATE *psf)
@@ -1174,6 +1201,10 @@ wav_write_tailer (SF_PRIVATE *psf)
 static int
 wav_close (SF_PRIVATE *psf)
 {
+	/* Nothing can be appended or patched when streaming to a pipe. */
+	if (psf->file.mode == SFM_WRITE && psf->is_pipe)
+		return 0 ;
+
 	if (psf->file.mode == SFM_WRITE || psf->file.mode == SFM_RDWR)
 	{	wav_write_tailer (psf) ;
 
@@ -1230,6 +1261,56 @@ wav_command (SF_PRIVATE *psf, int command, void * UNUSED (data), int datasize)
 	return 0 ;
 } /* wav_command */
 
+static int
+wav_read_cue_chunk (SF_PRIVATE *psf, uint32_t chunklen)
+{	uint32_t thisread, bytesread, cue_count, position, offset ;
+	int id, chunk_id, chunk_start, block_start, cue_index ;
+
+	bytesread = psf_binheader_readf (psf, "4", &cue_count) ;
+
+	if (cue_count > 1000)
+	{	psf_log_printf (psf, "  Count : %u (skipping)\n", cue_count) ;
+		psf_binheader_readf (psf, "j", (cue_count > 20 ? 20 : cue_count) * 24) ;
+		return 0 ;
+		} ;
+
+	psf_log_printf (psf, "  Count : %d\n", cue_count) ;
+
+	if ((psf->cues = psf_cues_alloc (cue_count)) == NULL)
+		return SFE_MALLOC_FAILED ;
+
+	cue_index = 0 ;
+
+	while (cue_count)
+	{
+		if ((thisread = psf_binheader_readf (psf, "e44m444", &id, &position, &chunk_id, &chunk_start, &block_start, &offset)) == 0)
+			break ;
+		bytesread += thisread ;
+
+		psf_log_printf (psf,	"   Cue ID : %2d"
+								"  Pos : %5u  Chunk : %M"
+								"  Chk Start : %d  Blk Start : %d"
+								"  Offset : %5d\n",
+				id, position, chunk_id, chunk_start, block_start, offset) ;
+		psf->cues->cue_points [cue_index].indx = id ;
+		psf->cues->cue_points [cue_index].position = position ;
+		psf->cues->cue_points [cue_index].fcc_chunk = chunk_id ;
+		psf->cues->cue_points [cue_index].chunk_start = chunk_start ;
+		psf->cues->cue_points [cue_index].block_start = block_start ;
+		psf->cues->cue_points [cue_index].sample_offset = offset ;
+		psf->cues->cue_points [cue_index].name [0] = '\0' ;
+		cue_count -- ;
+		cue_index ++ ;
+		} ;
+
+	if (bytesread != chunklen)
+	{	psf_log_printf (psf, "**** Chunk size weirdness (%d != %d)\n", chunklen, bytesread) ;
+		psf_binheader_readf (psf, "j", chunklen - bytesread) ;
+		} ;
+
+	return 0 ;
+} /* wav_read_cue_chunk */
+
 static int
 wav_read_smpl_chunk (SF_PRIVATE *psf, uint32_t chunklen)
 {	char buffer [512] ;
@@ -1442,6 +1523,84 @@ wav_read_acid_chunk (SF_PRIVATE *psf, uint32_t chunklen)
 	return 0 ;
 } /* wav_read_acid_chunk */
 
+static int
+wav_read_metadata_chunk (SF_PRIVATE *psf, uint32_t marker, uint32_t chunklen)
+{
+	if (psf->parse_metadata != NULL)
+	{	/* Fast open : wav_parse_metadata () reads the chunk when it is needed. */
+		psf_binheader_readf (psf, "j", chunklen) ;
+		return 0 ;
+		} ;
+
+	switch (marker)
+	{	case PEAK_MARKER :
+			return wavlike_read_peak_chunk (psf, chunklen) ;
+
+		case cue_MARKER :
+			return wav_read_cue_chunk (psf, chunklen) ;
+
+		case smpl_MARKER :
+			return wav_read_smpl_chunk (psf, chunklen) ;
+
+		case acid_MARKER :
+			return wav_read_acid_chunk (psf, chunklen) ;
+
+		case INFO_MARKER :
+		case LIST_MARKER :
+			return wavlike_subchunk_parse (psf, marker, chunklen) ;
+
+		case bext_MARKER :
+			return wavlike_read_bext_chunk (psf, chunklen) ;
+
+		case cart_MARKER :
+			return wavlike_read_cart_chunk (psf, chunklen) ;
+
+		default :
+			break ;
+		} ;
+
+	psf_binheader_readf (psf, "j", chunklen) ;
+	return 0 ;
+} /* wav_read_metadata_chunk */
+
+static int
+wav_parse_metadata (SF_PRIVATE *psf)
+{	const READ_CHUNK *rchunk ;
+	uint32_t k ;
+	int error ;
+
+	/* Called once with psf->parse_metadata cleared, the metadata chunks were skipped by the header parser. */
+	for (k = 0 ; k < psf->rchunks.used ; k++)
+	{	rchunk = psf->rchunks.chunks + k ;
+
+		switch (rchunk->mark32)
+		{	case PEAK_MARKER :
+			case cue_MARKER :
+			case smpl_MARKER :
+			case acid_MARKER :
+			case INFO_MARKER :
+			case LIST_MARKER :
+			case bext_MARKER :
+			case cart_MARKER :
+				break ;
+
+			default :
+				continue ;
+			} ;
+
+		psf->header.indx = psf->header.end = 0 ;
+		psf_fseek (psf, rchunk->offset, SEEK_SET) ;
+
+		if ((error = wav_read_metadata_chunk (psf, rchunk->mark32, rchunk->len)) != 0)
+			return error ;
+
+		if (rchunk->mark32 == PEAK_MARKER && psf->peak_info != NULL)
+			psf->peak_info->peak_loc = (rchunk->offset < psf->dataoffset) ? SF_PEAK_START : SF_PEAK_END ;
+		} ;
+
+	return 0 ;
+} /* wav_parse_metadata */
+
 /*==============================================================================
 */
 
@@ -137,11 +137,15 @@ wavlike_read_fmt_chunk (SF_PRIVATE *psf, int fmtsize)
 
 	/* assume psf->rwf_endian is already properly set */
 
-	/* Read the minimal WAV file header here. */
-	bytesread = psf_binheader_readf (psf, "224422",
-					&(wav_fmt->format), &(wav_fmt->min.channels),
-					&(wav_fmt->min.samplerate), &(wav_fmt->min.bytespersec),
-					&(wav_fmt->min.blockalign), &(wav_fmt->min.bitwidth)) ;
+	/* Read the minimal WAV file header here, with a single read. */
+	psf_header_prefetch (psf, 16) ;
+	bytesread = 16 ;
+	wav_fmt->format				= psf_header_get_16 (psf) ;
+	wav_fmt->min.channels		= psf_header_get_16 (psf) ;
+	wav_fmt->min.samplerate		= psf_header_get_32 (psf) ;
+	wav_fmt->min.bytespersec	= psf_header_get_32 (psf) ;
+	wav_fmt->min.blockalign		= psf_header_get_16 (psf) ;
+	wav_fmt->min.bitwidth		= psf_header_get_16 (psf) ;
 
 	psf_log_printf (psf, "  Format        : 0x%X => %s\n", wav_fmt->format, wavlike_format_str (wav_fmt->format)) ;
 	psf_log_printf (psf, "  Channels      : %d\n", wav_fmt->min.channels) ;
@@ -449,12 +453,28 @@ wavlike_read_fmt_chunk (SF_PRIVATE *psf, int fmtsize)
 	return 0 ;
 } /* wavlike_read_fmt_chunk */
 
+/*
+**	Write the fields every WAVEFORMATEX starts with, in the current header endian-ness.
+**	The chunk header and size are left to the caller as they differ between containers.
+*/
+void
+wavlike_write_fmt_fields (SF_PRIVATE *psf, int format, int bytespersec, int blockalign, int bitwidth)
+{
+	psf_header_put_16 (psf, format) ;
+	psf_header_put_16 (psf, psf->sf.channels) ;
+	psf_header_put_32 (psf, psf->sf.samplerate) ;
+	psf_header_put_32 (psf, bytespersec) ;
+	psf_header_put_16 (psf, blockalign) ;
+	psf_header_put_16 (psf, bitwidth) ;
+} /* wavlike_write_fmt_fields */
+
 void
 wavlike_write_guid (SF_PRIVATE *psf, const EXT_SUBFORMAT * subformat)
 {
-	psf_binheader_writef (psf, "422b", subformat->esf_field1,
-					subformat->esf_field2, subformat->esf_field3,
-					subformat->esf_field4, make_size_t (8)) ;
+	psf_header_put_32 (psf, subformat->esf_field1) ;
+	psf_header_put_16 (psf, subformat->esf_field2) ;
+	psf_header_put_16 (psf, subformat->esf_field3) ;
+	psf_header_put_bytes (psf, subformat->esf_field4, 8) ;
 } /* wavlike_write_guid */
 
 
@@ -336,6 +336,7 @@ char const* wavlike_format_str (int k) ;
 
 int		wavlike_srate2blocksize (int srate_chan_product) ;
 int		wavlike_read_fmt_chunk (SF_PRIVATE *psf, int fmtsize) ;
+void	wavlike_write_fmt_fields (SF_PRIVATE *psf, int format, int bytespersec, int blockalign, int bitwidth) ;
 void	wavlike_write_guid (SF_PRIVATE *psf, const EXT_SUBFORMAT * subformat) ;
 void	wavlike_analyze (SF_PRIVATE *psf) ;
 int		wavlike_gen_channel_mask (const int *chan_map, int channels) ;
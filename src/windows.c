@@ -46,15 +46,18 @@ sf_wchar_open (LPCWSTR wpath, int mode, SF_INFO *sfinfo)
 		} ;
 
 	psf_init_files (psf) ;
+	psf_set_open_mode (psf, mode) ;
+
+	if ((psf->error = psf_alloc_file_names (&psf->file)) != 0)
+		return psf_open_file (psf, sfinfo) ;
 
 	if (WideCharToMultiByte (CP_UTF8, 0, wpath, -1, utf8name, sizeof (utf8name), NULL, NULL) == 0)
-		psf->file.path.wc [0] = 0 ;
+		psf->file.path->wc [0] = 0 ;
 
 	psf_log_printf (psf, "File : '%s' (utf-8 converted from ucs-2)\n", utf8name) ;
 
 	copy_filename (psf, wpath) ;
 	psf->file.use_wchar = SF_TRUE ;
-	psf->file.mode = mode ;
 
 	psf->error = psf_fopen (psf) ;
 
@@ -67,24 +70,24 @@ copy_filename (SF_PRIVATE *psf, LPCWSTR wpath)
 {	const wchar_t *cwcptr ;
 	wchar_t *wcptr ;
 
-	wcsncpy (psf->file.path.wc, wpath, ARRAY_LEN (psf->file.path.wc)) ;
-	psf->file.path.wc [ARRAY_LEN (psf->file.path.wc) - 1] = 0 ;
+	wcsncpy (psf->file.path->wc, wpath, ARRAY_LEN (psf->file.path->wc)) ;
+	psf->file.path->wc [ARRAY_LEN (psf->file.path->wc) - 1] = 0 ;
 	if ((cwcptr = wcsrchr (wpath, '/')) || (cwcptr = wcsrchr (wpath, '\\')))
 		cwcptr ++ ;
 	else
 		cwcptr = wpath ;
 
-	wcsncpy (psf->file.name.wc, cwcptr, ARRAY_LEN (psf->file.name.wc)) ;
-	psf->file.name.wc [ARRAY_LEN (psf->file.name.wc) - 1] = 0 ;
+	wcsncpy (psf->file.name->wc, cwcptr, ARRAY_LEN (psf->file.name->wc)) ;
+	psf->file.name->wc [ARRAY_LEN (psf->file.name->wc) - 1] = 0 ;
 
 	/* Now grab the directory. */
-	wcsncpy (psf->file.dir.wc, wpath, ARRAY_LEN (psf->file.dir.wc)) ;
-	psf->file.dir.wc [ARRAY_LEN (psf->file.dir.wc) - 1] = 0 ;
+	wcsncpy (psf->file.dir->wc, wpath, ARRAY_LEN (psf->file.dir->wc)) ;
+	psf->file.dir->wc [ARRAY_LEN (psf->file.dir->wc) - 1] = 0 ;
 
-	if ((wcptr = wcsrchr (psf->file.dir.wc, '/')) || (wcptr = wcsrchr (psf->file.dir.wc, '\\')))
+	if ((wcptr = wcsrchr (psf->file.dir->wc, '/')) || (wcptr = wcsrchr (psf->file.dir->wc, '\\')))
 		wcptr [1] = 0 ;
 	else
-		psf->file.dir.wc [0] = 0 ;
+		psf->file.dir->wc [0] = 0 ;
 
 	return ;
 } /* copy_filename */
@@ -0,0 +1,1215 @@
+/*
+** Copyright (C) 2026 Erik de Castro Lopo <erikd@mega-nerd.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+**	Worker threads for the opt-in multi-threaded codec paths.
+**
+**	The library never creates a thread unless the caller asks for one with
+**	a command such as SFC_SET_ENCODER_THREADS. Jobs only ever touch their
+**	own buffers; everything that touches the SF_PRIVATE (file I/O, logging)
+**	stays on the caller's thread. Reading ahead and asynchronous writing are
+**	the exceptions, their one worker calls the codec in the caller's place.
+*/
+
+#include	"sfconfig.h"
+
+#include	<stdlib.h>
+#include	<string.h>
+#include	<limits.h>
+
+#include	"sndfile.h"
+#include	"common.h"
+
+#if HAVE_PTHREAD
+
+#include	<pthread.h>
+
+typedef pthread_mutex_t	WORKER_LOCK ;
+typedef pthread_cond_t	WORKER_COND ;
+typedef pthread_t		WORKER_THREAD ;
+
+#define	HAVE_WORKERS	1
+
+#elif USE_WINDOWS_API
+
+#include	<windows.h>
+
+typedef CRITICAL_SECTION	WORKER_LOCK ;
+typedef CONDITION_VARIABLE	WORKER_COND ;
+typedef HANDLE				WORKER_THREAD ;
+
+#define	HAVE_WORKERS	1
+
+#else
+
+#define	HAVE_WORKERS	0
+
+#endif
+
+#if HAVE_WORKERS
+
+struct SF_WORKERS_tag
+{	WORKER_LOCK		lock ;
+	WORKER_COND		work, done ;
+
+	/* Queue of submitted jobs, oldest first. */
+	SF_JOB			*head, *tail ;
+
+	int				threads, quit ;
+	WORKER_THREAD	thread [] ;
+} ;
+
+static void worker_loop (SF_WORKERS *workers) ;
+
+#if HAVE_PTHREAD
+
+static void		lock_init (WORKER_LOCK *lock)		{ pthread_mutex_init (lock, NULL) ; }
+static void		lock_destroy (WORKER_LOCK *lock)	{ pthread_mutex_destroy (lock) ; }
+static void		lock_acquire (WORKER_LOCK *lock)	{ pthread_mutex_lock (lock) ; }
+static void		lock_release (WORKER_LOCK *lock)	{ pthread_mutex_unlock (lock) ; }
+static int		lock_try (WORKER_LOCK *lock)		{ return pthread_mutex_trylock (lock) == 0 ; }
+
+static void		cond_init (WORKER_COND *cond)		{ pthread_cond_init (cond, NULL) ; }
+static void		cond_destroy (WORKER_COND *cond)	{ pthread_cond_destroy (cond) ; }
+static void		cond_wait (WORKER_COND *cond, WORKER_LOCK *lock)	{ pthread_cond_wait (cond, lock) ; }
+static void		cond_broadcast (WORKER_COND *cond)	{ pthread_cond_broadcast (cond) ; }
+
+static void *
+thread_main (void *data)
+{	worker_loop (data) ;
+	return NULL ;
+} /* thread_main */
+
+static int
+thread_start (WORKER_THREAD *thread, SF_WORKERS *workers)
+{	return pthread_create (thread, NULL, thread_main, workers) == 0 ;
+} /* thread_start */
+
+static void
+thread_join (WORKER_THREAD thread)
+{	pthread_join (thread, NULL) ;
+} /* thread_join */
+
+#else
+
+static void		lock_init (WORKER_LOCK *lock)		{ InitializeCriticalSection (lock) ; }
+static void		lock_destroy (WORKER_LOCK *lock)	{ DeleteCriticalSection (lock) ; }
+static void		lock_acquire (WORKER_LOCK *lock)	{ EnterCriticalSection (lock) ; }
+static void		lock_release (WORKER_LOCK *lock)	{ LeaveCriticalSection (lock) ; }
+static int		lock_try (WORKER_LOCK *lock)		{ return TryEnterCriticalSection (lock) != 0 ; }
+
+static void		cond_init (WORKER_COND *cond)		{ InitializeConditionVariable (cond) ; }
+static void		cond_destroy (WORKER_COND * UNUSED (cond))	{ }
+static void		cond_wait (WORKER_COND *cond, WORKER_LOCK *lock)	{ SleepConditionVariableCS (cond, lock, INFINITE) ; }
+static void		cond_broadcast (WORKER_COND *cond)	{ WakeAllConditionVariable (cond) ; }
+
+static DWORD WINAPI
+thread_main (LPVOID data)
+{	worker_loop (data) ;
+	return 0 ;
+} /* thread_main */
+
+static int
+thread_start (WORKER_THREAD *thread, SF_WORKERS *workers)
+{	*thread = CreateThread (NULL, 0, thread_main, workers, 0, NULL) ;
+	return *thread != NULL ;
+} /* thread_start */
+
+static void
+thread_join (WORKER_THREAD thread)
+{	WaitForSingleObject (thread, INFINITE) ;
+	CloseHandle (thread) ;
+} /* thread_join */
+
+#endif
+
+SF_WORKERS *
+psf_workers_create (int threads)
+{	SF_WORKERS *workers ;
+
+	if (threads < 1 || threads > PSF_MAX_WORKERS)
+		return NULL ;
+
+	if ((workers = calloc (1, sizeof (SF_WORKERS) + threads * sizeof (WORKER_THREAD))) == NULL)
+		return NULL ;
+
+	lock_init (&workers->lock) ;
+	cond_init (&workers->work) ;
+	cond_init (&workers->done) ;
+
+	for (workers->threads = 0 ; workers->threads < threads ; workers->threads++)
+		if (thread_start (&workers->thread [workers->threads], workers) == 0)
+			break ;
+
+	if (workers->threads < threads)
+	{	psf_workers_destroy (workers) ;
+		return NULL ;
+		} ;
+
+	return workers ;
+} /* psf_workers_create */
+
+/* Called with the lock held. */
+static void
+queue_job (SF_WORKERS *workers, SF_JOB *job)
+{
+	job->busy = SF_TRUE ;
+	job->next = NULL ;
+	if (workers->tail != NULL)
+		workers->tail->next = job ;
+	else
+		workers->head = job ;
+	workers->tail = job ;
+
+	cond_broadcast (&workers->work) ;
+} /* queue_job */
+
+void
+psf_workers_submit (SF_WORKERS *workers, SF_JOB *job)
+{
+	lock_acquire (&workers->lock) ;
+	queue_job (workers, job) ;
+	lock_release (&workers->lock) ;
+} /* psf_workers_submit */
+
+int
+psf_workers_try_submit (SF_WORKERS *workers, SF_JOB *job)
+{	int submitted = SF_FALSE ;
+
+	if (lock_try (&workers->lock) == 0)
+		return SF_FALSE ;
+
+	if (job->busy == SF_FALSE)
+	{	queue_job (workers, job) ;
+		submitted = SF_TRUE ;
+		} ;
+
+	lock_release (&workers->lock) ;
+
+	return submitted ;
+} /* psf_workers_try_submit */
+
+int
+psf_workers_idle (SF_WORKERS *workers, SF_JOB *job)
+{	int idle ;
+
+	if (lock_try (&workers->lock) == 0)
+		return SF_FALSE ;
+
+	idle = (job->busy == SF_FALSE) ;
+	lock_release (&workers->lock) ;
+
+	return idle ;
+} /* psf_workers_idle */
+
+void
+psf_workers_wait (SF_WORKERS *workers, SF_JOB *job)
+{
+	lock_acquire (&workers->lock) ;
+	while (job->busy)
+		cond_wait (&workers->done, &workers->lock) ;
+	lock_release (&workers->lock) ;
+} /* psf_workers_wait */
+
+void
+psf_workers_destroy (SF_WORKERS *workers)
+{	int k ;
+
+	if (workers == NULL)
+		return ;
+
+	/* Jobs already submitted still run, the threads exit once the queue is empty. */
+	lock_acquire (&workers->lock) ;
+	workers->quit = SF_TRUE ;
+	cond_broadcast (&workers->work) ;
+	lock_release (&workers->lock) ;
+
+	for (k = 0 ; k < workers->threads ; k++)
+		thread_join (workers->thread [k]) ;
+
+	cond_destroy (&workers->done) ;
+	cond_destroy (&workers->work) ;
+	lock_destroy (&workers->lock) ;
+
+	free (workers) ;
+} /* psf_workers_destroy */
+
+static void
+worker_loop (SF_WORKERS *workers)
+{	SF_JOB *job ;
+
+	lock_acquire (&workers->lock) ;
+
+	for ( ; ; )
+	{	while (workers->head == NULL && workers->quit == SF_FALSE)
+			cond_wait (&workers->work, &workers->lock) ;
+
+		if ((job = workers->head) == NULL)
+			break ;
+
+		if ((workers->head = job->next) == NULL)
+			workers->tail = NULL ;
+
+		lock_release (&workers->lock) ;
+		job->run (job) ;
+		lock_acquire (&workers->lock) ;
+
+		job->busy = SF_FALSE ;
+		cond_broadcast (&workers->done) ;
+		} ;
+
+	lock_release (&workers->lock) ;
+} /* worker_loop */
+
+#else
+
+/* No thread support on this platform, the callers fall back to their single threaded code. */
+
+SF_WORKERS *
+psf_workers_create (int UNUSED (threads))
+{	return NULL ;
+} /* psf_workers_create */
+
+void
+psf_workers_submit (SF_WORKERS * UNUSED (workers), SF_JOB *job)
+{	job->run (job) ;
+} /* psf_workers_submit */
+
+void
+psf_workers_wait (SF_WORKERS * UNUSED (workers), SF_JOB * UNUSED (job))
+{
+} /* psf_workers_wait */
+
+int
+psf_workers_try_submit (SF_WORKERS * UNUSED (workers), SF_JOB *job)
+{	job->run (job) ;
+	return SF_TRUE ;
+} /* psf_workers_try_submit */
+
+int
+psf_workers_idle (SF_WORKERS * UNUSED (workers), SF_JOB * UNUSED (job))
+{	return SF_TRUE ;
+} /* psf_workers_idle */
+
+void
+psf_workers_destroy (SF_WORKERS * UNUSED (workers))
+{
+} /* psf_workers_destroy */
+
+#endif
+
+/*==============================================================================
+** An ordered pipeline of independent blocks.
+**
+** Block n always lives in slot n % count. When decoding, the slots hold the
+** requested block and the blocks after it, loaded on the caller's thread and
+** decoded by the workers. When encoding, each filled slot is handed to the
+** workers and its output is emitted, in block order, before the slot is
+** reused. A slot is never resubmitted before its previous job has finished,
+** so per slot codec state sees its blocks in order.
+*/
+
+#define	PIPE_ALIGN(x)	(((x) + 15) & ~15)
+
+static void
+psf_pipe_run (SF_JOB *job)
+{	PSF_PIPE_SLOT *slot = (PSF_PIPE_SLOT *) job ;
+
+	slot->pipe->process (slot) ;
+} /* psf_pipe_run */
+
+PSF_PIPE *
+psf_pipe_create (SF_PRIVATE *psf, int threads, int in_bytes, int out_bytes, int state_bytes)
+{	PSF_PIPE	*pipe ;
+	int			k, count ;
+
+	count = 2 * threads ;
+
+	if ((pipe = calloc (1, sizeof (PSF_PIPE) + count * sizeof (PSF_PIPE_SLOT))) == NULL)
+		return NULL ;
+
+	pipe->psf = psf ;
+	pipe->count = count ;
+
+	in_bytes = PIPE_ALIGN (in_bytes) ;
+	out_bytes = PIPE_ALIGN (out_bytes) ;
+	state_bytes = PIPE_ALIGN (state_bytes) ;
+
+	for (k = 0 ; k < count ; k++)
+	{	PSF_PIPE_SLOT *slot = &pipe->slots [k] ;
+		unsigned char *mem ;
+
+		if ((mem = calloc (1, state_bytes + in_bytes + out_bytes)) == NULL)
+		{	psf_pipe_destroy (pipe) ;
+			return NULL ;
+			} ;
+
+		slot->job.run = psf_pipe_run ;
+		slot->pipe = pipe ;
+		slot->block = -1 ;
+		slot->state = state_bytes ? mem : NULL ;
+		slot->in = mem + state_bytes ;
+		slot->out = mem + state_bytes + in_bytes ;
+		} ;
+
+	if ((pipe->workers = psf_workers_create (threads)) == NULL)
+	{	psf_pipe_destroy (pipe) ;
+		return NULL ;
+		} ;
+
+	return pipe ;
+} /* psf_pipe_create */
+
+void
+psf_pipe_destroy (PSF_PIPE *pipe)
+{	int k ;
+
+	if (pipe == NULL)
+		return ;
+
+	psf_workers_destroy (pipe->workers) ;
+
+	/* The state, in and out buffers of a slot share one allocation. */
+	for (k = 0 ; k < pipe->count ; k++)
+		free (pipe->slots [k].state != NULL ? pipe->slots [k].state : pipe->slots [k].in) ;
+
+	free (pipe) ;
+} /* psf_pipe_destroy */
+
+void
+psf_pipe_reset (PSF_PIPE *pipe)
+{	int k ;
+
+	for (k = 0 ; k < pipe->count ; k++)
+	{	psf_workers_wait (pipe->workers, &pipe->slots [k].job) ;
+		pipe->slots [k].block = -1 ;
+		} ;
+
+	pipe->next = 0 ;
+	pipe->end = SF_FALSE ;
+} /* psf_pipe_reset */
+
+PSF_PIPE_SLOT *
+psf_pipe_read_block (PSF_PIPE *pipe, sf_count_t block)
+{	PSF_PIPE_SLOT *slot = &pipe->slots [block % pipe->count] ;
+
+	if (slot->block != block)
+	{	psf_pipe_reset (pipe) ;
+		pipe->next = block ;
+		} ;
+
+	/* Keep the slots busy with the blocks after this one. */
+	while (pipe->next < block + pipe->count && pipe->end == SF_FALSE)
+	{	PSF_PIPE_SLOT *ahead = &pipe->slots [pipe->next % pipe->count] ;
+
+		psf_workers_wait (pipe->workers, &ahead->job) ;
+		ahead->block = -1 ;
+
+		if (pipe->load (pipe, ahead, pipe->next) == 0)
+		{	pipe->end = SF_TRUE ;
+			break ;
+			} ;
+
+		ahead->block = pipe->next ++ ;
+		psf_workers_submit (pipe->workers, &ahead->job) ;
+		} ;
+
+	if (slot->block != block)
+		return NULL ;
+
+	psf_workers_wait (pipe->workers, &slot->job) ;
+
+	return slot ;
+} /* psf_pipe_read_block */
+
+PSF_PIPE_SLOT *
+psf_pipe_write_slot (PSF_PIPE *pipe)
+{	PSF_PIPE_SLOT *slot = &pipe->slots [pipe->next % pipe->count] ;
+
+	if (slot->block >= 0)
+	{	psf_workers_wait (pipe->workers, &slot->job) ;
+		slot->block = -1 ;
+
+		if (pipe->emit (pipe, slot) == 0)
+			return NULL ;
+		} ;
+
+	return slot ;
+} /* psf_pipe_write_slot */
+
+void
+psf_pipe_write_submit (PSF_PIPE *pipe, PSF_PIPE_SLOT *slot)
+{
+	slot->block = pipe->next ++ ;
+	psf_workers_submit (pipe->workers, &slot->job) ;
+} /* psf_pipe_write_submit */
+
+int
+psf_pipe_write_flush (PSF_PIPE *pipe)
+{	PSF_PIPE_SLOT	*slot ;
+	sf_count_t		block ;
+	int				result = 1 ;
+
+	block = pipe->next > pipe->count ? pipe->next - pipe->count : 0 ;
+
+	for ( ; block < pipe->next ; block++)
+	{	slot = &pipe->slots [block % pipe->count] ;
+
+		if (slot->block != block)
+			continue ;
+
+		psf_workers_wait (pipe->workers, &slot->job) ;
+		slot->block = -1 ;
+
+		if (pipe->emit (pipe, slot) == 0)
+			result = 0 ;
+		} ;
+
+	return result ;
+} /* psf_pipe_write_flush */
+
+/*==============================================================================
+** Reading ahead. The codec's read functions are replaced by ones which take
+** frames from a ring. The worker fills the ring, a chunk at a time, by calling
+** the codec's own read function for the sample type the caller last asked for,
+** so the codec only ever sees ordinary sequential reads. The ring is shared
+** without a lock: the worker only moves the tail and the caller only moves the
+** head. A read takes whatever is decoded, possibly nothing, and never waits for
+** the worker. Seeks and anything else which touches the codec stop the worker,
+** throw the ring away and start it again from psf->read_current.
+*/
+
+#define	READ_AHEAD_CHUNKS	4
+
+#if defined (__GNUC__)
+
+static int	shared_load (const int *value)		{ return __atomic_load_n (value, __ATOMIC_ACQUIRE) ; }
+static void	shared_store (int *value, int x)	{ __atomic_store_n (value, x, __ATOMIC_RELEASE) ; }
+
+#elif HAVE_PTHREAD
+
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER ;
+
+static int
+shared_load (const int *value)
+{	int x ;
+
+	pthread_mutex_lock (&shared_lock) ;
+	x = *value ;
+	pthread_mutex_unlock (&shared_lock) ;
+
+	return x ;
+} /* shared_load */
+
+static void
+shared_store (int *value, int x)
+{	pthread_mutex_lock (&shared_lock) ;
+	*value = x ;
+	pthread_mutex_unlock (&shared_lock) ;
+} /* shared_store */
+
+#elif USE_WINDOWS_API
+
+static int	shared_load (const int *value)		{ return InterlockedCompareExchange ((volatile LONG *) value, 0, 0) ; }
+static void	shared_store (int *value, int x)	{ InterlockedExchange ((volatile LONG *) value, x) ; }
+
+#else
+
+/* No worker thread to share with. */
+static int	shared_load (const int *value)		{ return *value ; }
+static void	shared_store (int *value, int x)	{ *value = x ; }
+
+#endif
+
+enum
+{	SAMPLE_SHORT = 0,
+	SAMPLE_INT,
+	SAMPLE_FLOAT,
+	SAMPLE_DOUBLE
+} ;
+
+static const int sample_size [] =
+{	sizeof (short), sizeof (int), sizeof (float), sizeof (double)
+} ;
+
+struct PSF_READ_AHEAD_tag
+{	SF_JOB			job ;
+	SF_WORKERS		*workers ;
+	SF_PRIVATE		*psf ;
+
+	/* The codec's own functions. */
+	sf_count_t		(*read_short)	(SF_PRIVATE *psf, short *ptr, sf_count_t len) ;
+	sf_count_t		(*read_int)		(SF_PRIVATE *psf, int *ptr, sf_count_t len) ;
+	sf_count_t		(*read_float)	(SF_PRIVATE *psf, float *ptr, sf_count_t len) ;
+	sf_count_t		(*read_double)	(SF_PRIVATE *psf, double *ptr, sf_count_t len) ;
+	sf_count_t		(*seek)			(SF_PRIVATE *psf, int mode, sf_count_t offset) ;
+
+	int				type ;				/* Sample type, -1 before the first read. */
+	int				items, size ;		/* Items per chunk and in the ring. */
+	void			*data ;
+
+	/* Only used on the caller's thread. */
+	int				running ;			/* The job has been submitted since the worker was stopped. */
+	int				reposition ;		/* The codec is not at psf->read_current. */
+	int				hold ;				/* Depth of psf_read_ahead_hold () calls. */
+	int				error ;				/* Set by the caller while the worker runs. */
+
+	/*
+	** Shared with the worker through shared_load () and shared_store (). The
+	** positions count up to twice the ring size, so a full ring is not mistaken
+	** for an empty one.
+	*/
+	int				head, tail ;
+	int				end ;				/* The codec returned a short count. */
+	int				stop ;				/* The worker should return at the end of its chunk. */
+	int				worker_error ;		/* psf->error as seen by the worker. */
+} ;
+
+static int
+read_ahead_used (const PSF_READ_AHEAD *ahead, int head, int tail)
+{	return (tail >= head) ? tail - head : tail + 2 * ahead->size - head ;
+} /* read_ahead_used */
+
+static sf_count_t
+read_ahead_decode (PSF_READ_AHEAD *ahead, int type, void *ptr, sf_count_t len)
+{
+	switch (type)
+	{	case SAMPLE_SHORT :
+			return ahead->read_short (ahead->psf, ptr, len) ;
+
+		case SAMPLE_INT :
+			return ahead->read_int (ahead->psf, ptr, len) ;
+
+		case SAMPLE_FLOAT :
+			return ahead->read_float (ahead->psf, ptr, len) ;
+
+		default :
+			break ;
+		} ;
+
+	return ahead->read_double (ahead->psf, ptr, len) ;
+} /* read_ahead_decode */
+
+static void
+read_ahead_run (SF_JOB *job)
+{	PSF_READ_AHEAD	*ahead = (PSF_READ_AHEAD *) job ;
+	SF_PRIVATE		*psf = ahead->psf ;
+	sf_count_t		count ;
+	int				tail = ahead->tail ;
+	void			*ptr ;
+
+	/* The ring size is a multiple of the chunk size, so a chunk never wraps. */
+	while (shared_load (&ahead->stop) == SF_FALSE)
+	{	if (ahead->size - read_ahead_used (ahead, shared_load (&ahead->head), tail) < ahead->items)
+			break ;
+
+		ptr = (char *) ahead->data + (tail % ahead->size) * sample_size [ahead->type] ;
+		count = read_ahead_decode (ahead, ahead->type, ptr, ahead->items) ;
+
+		if (psf->error)
+			shared_store (&ahead->worker_error, psf->error) ;
+
+		if (count > 0)
+		{	tail = (tail + (int) count) % (2 * ahead->size) ;
+			shared_store (&ahead->tail, tail) ;
+			} ;
+
+		if (count < ahead->items)
+		{	/* End of file or an error, the codec is left where it stopped. */
+			shared_store (&ahead->end, SF_TRUE) ;
+			break ;
+			} ;
+		} ;
+} /* read_ahead_run */
+
+/* Wait for the worker to finish its chunk. */
+static void
+read_ahead_halt (PSF_READ_AHEAD *ahead)
+{
+	if (ahead->running == SF_FALSE)
+		return ;
+
+	shared_store (&ahead->stop, SF_TRUE) ;
+	psf_workers_wait (ahead->workers, &ahead->job) ;
+
+	ahead->running = SF_FALSE ;
+	ahead->reposition = SF_TRUE ;
+
+	if (ahead->error)
+		ahead->psf->error = ahead->error ;
+	ahead->error = 0 ;
+} /* read_ahead_halt */
+
+static int
+read_ahead_reposition (PSF_READ_AHEAD *ahead)
+{	SF_PRIVATE *psf = ahead->psf ;
+
+	if (ahead->reposition == SF_FALSE)
+		return SF_TRUE ;
+
+	ahead->reposition = SF_FALSE ;
+
+	/* Some codecs seek relative to psf->read_current unless told otherwise. */
+	psf->last_op = 0 ;
+	if (ahead->seek (psf, SFM_READ, psf->read_current) < 0)
+		return SF_FALSE ;
+
+	psf->last_op = SFM_READ ;
+	return SF_TRUE ;
+} /* read_ahead_reposition */
+
+/* Empty the ring and hand the job to the worker. Without wait, give up if the lock is taken. */
+static int
+read_ahead_launch (PSF_READ_AHEAD *ahead, int type, int wait)
+{
+	ahead->type = type ;
+	shared_store (&ahead->head, 0) ;
+	shared_store (&ahead->tail, 0) ;
+	shared_store (&ahead->end, SF_FALSE) ;
+	shared_store (&ahead->stop, SF_FALSE) ;
+	shared_store (&ahead->worker_error, ahead->psf->error) ;
+
+	if (wait)
+		psf_workers_submit (ahead->workers, &ahead->job) ;
+	else if (psf_workers_try_submit (ahead->workers, &ahead->job) == SF_FALSE)
+		return SF_FALSE ;
+
+	ahead->running = SF_TRUE ;
+	return SF_TRUE ;
+} /* read_ahead_launch */
+
+static sf_count_t
+read_ahead_read (SF_PRIVATE *psf, int type, void *ptr, sf_count_t len)
+{	PSF_READ_AHEAD	*ahead = psf->read_ahead ;
+	int				head, used, count, index, first, size = sample_size [type] ;
+
+	/* Inside a command, eg SFC_CALC_SIGNAL_MAX, which expects ordinary reads. */
+	if (ahead->hold > 0)
+		return read_ahead_reposition (ahead) ? read_ahead_decode (ahead, type, ptr, len) : 0 ;
+
+	if (ahead->running && ahead->type != type)
+	{	/* The ring holds another sample type. Ask the worker to stop, come back until it has. */
+		shared_store (&ahead->stop, SF_TRUE) ;
+		if (psf_workers_idle (ahead->workers, &ahead->job) == SF_FALSE)
+			return 0 ;
+		read_ahead_halt (ahead) ;
+		} ;
+
+	if (ahead->running == SF_FALSE)
+	{	if (read_ahead_reposition (ahead) == SF_FALSE || read_ahead_launch (ahead, type, SF_FALSE) == SF_FALSE)
+			return 0 ;
+		} ;
+
+	head = ahead->head ;
+	used = read_ahead_used (ahead, head, shared_load (&ahead->tail)) ;
+
+	count = (len < used) ? (int) len : used ;
+	count -= count % psf->sf.channels ;
+
+	index = head % ahead->size ;
+	first = SF_MIN (count, ahead->size - index) ;
+	memcpy (ptr, (char *) ahead->data + index * size, first * size) ;
+	memcpy ((char *) ptr + first * size, ahead->data, (count - first) * size) ;
+
+	shared_store (&ahead->head, (head + count) % (2 * ahead->size)) ;
+
+	/* Wake the worker if it stopped for want of room. It is only busy for a moment if it did. */
+	if (ahead->size - (used - count) >= ahead->items && shared_load (&ahead->end) == SF_FALSE)
+		psf_workers_try_submit (ahead->workers, &ahead->job) ;
+
+	return count ;
+} /* read_ahead_read */
+
+static sf_count_t
+read_ahead_read_s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
+{	return read_ahead_read (psf, SAMPLE_SHORT, ptr, len) ;
+} /* read_ahead_read_s */
+
+static sf_count_t
+read_ahead_read_i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
+{	return read_ahead_read (psf, SAMPLE_INT, ptr, len) ;
+} /* read_ahead_read_i */
+
+static sf_count_t
+read_ahead_read_f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
+{	return read_ahead_read (psf, SAMPLE_FLOAT, ptr, len) ;
+} /* read_ahead_read_f */
+
+static sf_count_t
+read_ahead_read_d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
+{	return read_ahead_read (psf, SAMPLE_DOUBLE, ptr, len) ;
+} /* read_ahead_read_d */
+
+static sf_count_t
+read_ahead_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
+{	PSF_READ_AHEAD	*ahead = psf->read_ahead ;
+	sf_count_t		position ;
+
+	read_ahead_halt (ahead) ;
+
+	if (ahead->reposition)
+	{	ahead->reposition = SF_FALSE ;
+		psf->last_op = 0 ;
+		} ;
+
+	if ((position = ahead->seek (psf, mode, offset)) < 0)
+		return position ;
+
+	/* Start decoding from the new position now, rather than in the next read. */
+	if (ahead->hold == 0 && ahead->type >= 0)
+		read_ahead_launch (ahead, ahead->type, SF_TRUE) ;
+
+	return position ;
+} /* read_ahead_seek */
+
+int
+psf_read_ahead_set (SF_PRIVATE *psf, int frames)
+{	PSF_READ_AHEAD	*ahead ;
+	sf_count_t		items ;
+
+	if (frames < 0)
+		return SF_FALSE ;
+
+	if (psf->read_ahead != NULL)
+	{	psf_read_ahead_stop (psf, SF_TRUE) ;
+		psf_read_ahead_destroy (psf) ;
+		} ;
+
+	if (frames == 0)
+		return SF_TRUE ;
+
+	/* Throwing the ring away needs a seek, and interleave.c reads at psf->read_current. */
+	if (psf->file.mode != SFM_READ || psf->sf.seekable == SF_FALSE || psf->seek == NULL || psf->interleave != NULL)
+		return SF_FALSE ;
+
+	items = ((frames + READ_AHEAD_CHUNKS - 1) / READ_AHEAD_CHUNKS) * (sf_count_t) psf->sf.channels ;
+	if (items > INT_MAX / SIGNED_SIZEOF (double) / READ_AHEAD_CHUNKS)
+		return SF_FALSE ;
+
+	if ((ahead = calloc (1, sizeof (PSF_READ_AHEAD))) == NULL)
+		return SF_FALSE ;
+
+	ahead->job.run = read_ahead_run ;
+	ahead->psf = psf ;
+	ahead->type = -1 ;
+	ahead->items = (int) items ;
+	ahead->size = READ_AHEAD_CHUNKS * ahead->items ;
+
+	if ((ahead->data = malloc (ahead->size * sizeof (double))) == NULL || (ahead->workers = psf_workers_create (1)) == NULL)
+	{	free (ahead->data) ;
+		free (ahead) ;
+		return SF_FALSE ;
+		} ;
+
+	ahead->read_short	= psf->read_short ;
+	ahead->read_int		= psf->read_int ;
+	ahead->read_float	= psf->read_float ;
+	ahead->read_double	= psf->read_double ;
+	ahead->seek			= psf->seek ;
+
+	/* Types the codec can't read stay unimplemented. */
+	psf->read_short		= psf->read_short ? read_ahead_read_s : NULL ;
+	psf->read_int		= psf->read_int ? read_ahead_read_i : NULL ;
+	psf->read_float		= psf->read_float ? read_ahead_read_f : NULL ;
+	psf->read_double	= psf->read_double ? read_ahead_read_d : NULL ;
+	psf->seek			= read_ahead_seek ;
+
+	psf->read_ahead = ahead ;
+
+	/* So that the first read has nothing to do but start the worker. */
+	ahead->reposition = (psf->last_op != SFM_READ) ;
+	read_ahead_reposition (ahead) ;
+
+	return SF_TRUE ;
+} /* psf_read_ahead_set */
+
+void
+psf_read_ahead_stop (SF_PRIVATE *psf, int reposition)
+{
+	read_ahead_halt (psf->read_ahead) ;
+
+	if (reposition)
+		read_ahead_reposition (psf->read_ahead) ;
+} /* psf_read_ahead_stop */
+
+void
+psf_read_ahead_start (SF_PRIVATE *psf)
+{	PSF_READ_AHEAD *ahead = psf->read_ahead ;
+
+	/* Before the first read the sample type isn't known yet. */
+	if (ahead->running || ahead->hold > 0 || ahead->type < 0)
+		return ;
+
+	if (read_ahead_reposition (ahead))
+		read_ahead_launch (ahead, ahead->type, SF_TRUE) ;
+} /* psf_read_ahead_start */
+
+void
+psf_read_ahead_hold (SF_PRIVATE *psf, int hold)
+{	PSF_READ_AHEAD *ahead = psf->read_ahead ;
+
+	if (hold)
+	{	read_ahead_halt (ahead) ;
+		ahead->hold ++ ;
+		return ;
+		} ;
+
+	if (ahead->hold > 0 && --ahead->hold == 0)
+		psf_read_ahead_start (psf) ;
+} /* psf_read_ahead_hold */
+
+int
+psf_read_ahead_get_error (SF_PRIVATE *psf)
+{	PSF_READ_AHEAD *ahead = psf->read_ahead ;
+
+	if (ahead->running == SF_FALSE)
+		return psf->error ;
+
+	if (ahead->error)
+		return ahead->error ;
+
+	return shared_load (&ahead->worker_error) ;
+} /* psf_read_ahead_get_error */
+
+void
+psf_read_ahead_set_error (SF_PRIVATE *psf, int error)
+{	PSF_READ_AHEAD *ahead = psf->read_ahead ;
+
+	/* The worker may be writing psf->error, it is copied over when the worker stops. */
+	if (ahead->running)
+		ahead->error = error ;
+	else
+		psf->error = error ;
+} /* psf_read_ahead_set_error */
+
+void
+psf_read_ahead_destroy (SF_PRIVATE *psf)
+{	PSF_READ_AHEAD	*ahead ;
+
+	if ((ahead = psf->read_ahead) == NULL)
+		return ;
+
+	read_ahead_halt (ahead) ;
+	psf_workers_destroy (ahead->workers) ;
+
+	psf->read_short		= ahead->read_short ;
+	psf->read_int		= ahead->read_int ;
+	psf->read_float		= ahead->read_float ;
+	psf->read_double	= ahead->read_double ;
+	psf->seek			= ahead->seek ;
+
+	/* The next read seeks back to psf->read_current. */
+	if (ahead->reposition)
+		psf->last_op = 0 ;
+
+	free (ahead->data) ;
+	free (ahead) ;
+
+	psf->read_ahead = NULL ;
+} /* psf_read_ahead_destroy */
+
+/*==============================================================================
+** Asynchronous writing. The codec's write functions are replaced by ones which
+** copy the caller's samples into a pool of blocks and hand each full block to
+** the worker, which passes it to the codec's own write function. Small writes
+** are gathered into one block, a change of sample type starts a new one. When
+** every block is queued the caller waits for the oldest, so the pool bounds
+** the memory used. A failed write is kept and returned by the next write,
+** psf_async_write_stop () or psf_async_write_destroy ().
+*/
+
+#define	ASYNC_WRITE_FRAMES	4096
+
+typedef struct
+{	SF_JOB			job ;
+	PSF_ASYNC_WRITE	*async ;
+	int				type ;
+	sf_count_t		count ;		/* Items in data. */
+	int				error ;		/* Set by the worker. */
+	void			*data ;
+} ASYNC_WRITE_BLOCK ;
+
+struct PSF_ASYNC_WRITE_tag
+{	SF_WORKERS		*workers ;
+	SF_PRIVATE		*psf ;
+
+	/* The codec's own functions. */
+	sf_count_t		(*write_short)	(SF_PRIVATE *psf, const short *ptr, sf_count_t len) ;
+	sf_count_t		(*write_int)	(SF_PRIVATE *psf, const int *ptr, sf_count_t len) ;
+	sf_count_t		(*write_float)	(SF_PRIVATE *psf, const float *ptr, sf_count_t len) ;
+	sf_count_t		(*write_double)	(SF_PRIVATE *psf, const double *ptr, sf_count_t len) ;
+
+	int				items ;			/* Items per block. */
+	int				head ;			/* The block being filled, never queued. */
+	int				failed ;		/* Only used by the worker. */
+	int				error ;			/* The first failure the caller has seen. */
+
+	int				blocks ;
+	ASYNC_WRITE_BLOCK	*block ;
+} ;
+
+static void
+async_write_run (SF_JOB *job)
+{	ASYNC_WRITE_BLOCK	*block = (ASYNC_WRITE_BLOCK *) job ;
+	PSF_ASYNC_WRITE		*async = block->async ;
+	SF_PRIVATE			*psf = async->psf ;
+	sf_count_t			count ;
+
+	/* Once a write has failed, later blocks are dropped. */
+	if ((block->error = async->failed) != 0)
+		return ;
+
+	switch (block->type)
+	{	case SAMPLE_SHORT :
+			count = async->write_short (psf, block->data, block->count) ;
+			break ;
+
+		case SAMPLE_INT :
+			count = async->write_int (psf, block->data, block->count) ;
+			break ;
+
+		case SAMPLE_FLOAT :
+			count = async->write_float (psf, block->data, block->count) ;
+			break ;
+
+		default :
+			count = async->write_double (psf, block->data, block->count) ;
+			break ;
+		} ;
+
+	if (count != block->count)
+		block->error = async->failed = (psf->error != 0) ? psf->error : SFE_ASYNC_WRITE_SHORT ;
+} /* async_write_run */
+
+/* Wait for every queued block and keep the first error. */
+static int
+async_write_wait (PSF_ASYNC_WRITE *async)
+{	int k ;
+
+	for (k = 0 ; k < async->blocks ; k++)
+	{	psf_workers_wait (async->workers, &async->block [k].job) ;
+		if (async->error == 0)
+			async->error = async->block [k].error ;
+		} ;
+
+	return async->error ;
+} /* async_write_wait */
+
+/* Queue the head block and make the next one, once the worker is done with it, the head. */
+static int
+async_write_queue (PSF_ASYNC_WRITE *async)
+{	ASYNC_WRITE_BLOCK *block = &async->block [async->head] ;
+
+	psf_workers_submit (async->workers, &block->job) ;
+
+	async->head = (async->head + 1) % async->blocks ;
+	block = &async->block [async->head] ;
+
+	psf_workers_wait (async->workers, &block->job) ;
+	block->count = 0 ;
+
+	if (block->error != 0)
+		return async_write_wait (async) ;
+
+	return 0 ;
+} /* async_write_queue */
+
+static sf_count_t
+async_write_write (SF_PRIVATE *psf, int type, const void *ptr, sf_count_t len)
+{	PSF_ASYNC_WRITE		*async = psf->async_write ;
+	ASYNC_WRITE_BLOCK	*block = &async->block [async->head] ;
+	sf_count_t			count, total = 0 ;
+	int					size = sample_size [type] ;
+
+	if (async->error)
+	{	psf->error = async->error ;
+		return 0 ;
+		} ;
+
+	if (block->count > 0 && block->type != type && async_write_queue (async) != 0)
+	{	psf->error = async->error ;
+		return 0 ;
+		} ;
+
+	while (total < len)
+	{	block = &async->block [async->head] ;
+		block->type = type ;
+
+		count = async->items - block->count ;
+		count = (count < len - total) ? count : len - total ;
+
+		memcpy ((char *) block->data + block->count * size, (const char *) ptr + total * size, count * size) ;
+		block->count += count ;
+		total += count ;
+
+		if (block->count == async->items && async_write_queue (async) != 0)
+		{	psf->error = async->error ;
+			return 0 ;
+			} ;
+		} ;
+
+	/* The caller is about to rewrite the header, the data must be there first. */
+	if (psf->auto_header && psf_async_write_stop (psf) != 0)
+		return 0 ;
+
+	return total ;
+} /* async_write_write */
+
+static sf_count_t
+async_write_write_s (SF_PRIVATE *psf, const short *ptr, sf_count_t len)
+{	return async_write_write (psf, SAMPLE_SHORT, ptr, len) ;
+} /* async_write_write_s */
+
+static sf_count_t
+async_write_write_i (SF_PRIVATE *psf, const int *ptr, sf_count_t len)
+{	return async_write_write (psf, SAMPLE_INT, ptr, len) ;
+} /* async_write_write_i */
+
+static sf_count_t
+async_write_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
+{	return async_write_write (psf, SAMPLE_FLOAT, ptr, len) ;
+} /* async_write_write_f */
+
+static sf_count_t
+async_write_write_d (SF_PRIVATE *psf, const double *ptr, sf_count_t len)
+{	return async_write_write (psf, SAMPLE_DOUBLE, ptr, len) ;
+} /* async_write_write_d */
+
+static void
+async_write_free (PSF_ASYNC_WRITE *async)
+{	int k ;
+
+	psf_workers_destroy (async->workers) ;
+
+	for (k = 0 ; k < async->blocks ; k++)
+		free (async->block [k].data) ;
+	free (async->block) ;
+	free (async) ;
+} /* async_write_free */
+
+int
+psf_async_write_set (SF_PRIVATE *psf, int blocks)
+{	PSF_ASYNC_WRITE	*async ;
+	sf_count_t		items ;
+	int				k, error ;
+
+	if (blocks < 0)
+		return SF_FALSE ;
+
+	if (psf->async_write != NULL)
+	{	/* Something else, such as dither, has wrapped the functions since. */
+		if ((psf->write_short != NULL && psf->write_short != async_write_write_s)
+				|| (psf->write_int != NULL && psf->write_int != async_write_write_i)
+				|| (psf->write_float != NULL && psf->write_float != async_write_write_f)
+				|| (psf->write_double != NULL && psf->write_double != async_write_write_d))
+			return SF_FALSE ;
+
+		if ((error = psf_async_write_destroy (psf)) != 0)
+		{	psf->error = error ;
+			return SF_FALSE ;
+			} ;
+		} ;
+
+	if (blocks == 0)
+		return SF_TRUE ;
+
+	/*
+	** The PEAK chunk positions are taken from psf->write_current, which the
+	** caller's thread has already moved on.
+	*/
+	if (psf->file.mode != SFM_WRITE || psf->peak_info != NULL)
+		return SF_FALSE ;
+
+	items = ASYNC_WRITE_FRAMES * (sf_count_t) psf->sf.channels ;
+	if (items > INT_MAX / SIGNED_SIZEOF (double) || blocks > INT_MAX / SIGNED_SIZEOF (ASYNC_WRITE_BLOCK))
+		return SF_FALSE ;
+
+	if ((async = calloc (1, sizeof (PSF_ASYNC_WRITE))) == NULL)
+		return SF_FALSE ;
+
+	if ((async->block = calloc (blocks, sizeof (ASYNC_WRITE_BLOCK))) == NULL)
+	{	free (async) ;
+		return SF_FALSE ;
+		} ;
+
+	async->psf = psf ;
+	async->items = (int) items ;
+	async->blocks = blocks ;
+
+	for (k = 0 ; k < blocks ; k++)
+	{	async->block [k].job.run = async_write_run ;
+		async->block [k].async = async ;
+		if ((async->block [k].data = malloc (items * sizeof (double))) == NULL)
+			break ;
+		} ;
+
+	if (k < blocks || (async->workers = psf_workers_create (1)) == NULL)
+	{	async_write_free (async) ;
+		return SF_FALSE ;
+		} ;
+
+	async->write_short	= psf->write_short ;
+	async->write_int	= psf->write_int ;
+	async->write_float	= psf->write_float ;
+	async->write_double	= psf->write_double ;
+
+	/* Types the codec can't write stay unimplemented. */
+	psf->write_short	= psf->write_short ? async_write_write_s : NULL ;
+	psf->write_int		= psf->write_int ? async_write_write_i : NULL ;
+	psf->write_float	= psf->write_float ? async_write_write_f : NULL ;
+	psf->write_double	= psf->write_double ? async_write_write_d : NULL ;
+
+	psf->async_write = async ;
+
+	return SF_TRUE ;
+} /* psf_async_write_set */
+
+int
+psf_async_write_stop (SF_PRIVATE *psf)
+{	PSF_ASYNC_WRITE *async = psf->async_write ;
+
+	if (async->error == 0 && async->block [async->head].count > 0)
+		async_write_queue (async) ;
+
+	if (async_write_wait (async) != 0)
+		psf->error = async->error ;
+
+	return async->error ;
+} /* psf_async_write_stop */
+
+int
+psf_async_write_destroy (SF_PRIVATE *psf)
+{	PSF_ASYNC_WRITE	*async ;
+	int				error ;
+
+	if ((async = psf->async_write) == NULL)
+		return 0 ;
+
+	error = psf_async_write_stop (psf) ;
+
+	psf->write_short	= async->write_short ;
+	psf->write_int		= async->write_int ;
+	psf->write_float	= async->write_float ;
+	psf->write_double	= async->write_double ;
+
+	async_write_free (async) ;
+
+	psf->async_write = NULL ;
+
+	return error ;
+} /* psf_async_write_destroy */
@@ -56,6 +56,9 @@ static int	dpcm_init 		(SF_PRIVATE *psf) ;
 
 static sf_count_t	dpcm_seek (SF_PRIVATE *psf, int mode, sf_count_t offset) ;
 
+static void dsc_sum (XI_PRIVATE *pxi, const signed char *src, int count) ;
+static void dles_sum (XI_PRIVATE *pxi, const short *src, int count) ;
+
 /*------------------------------------------------------------------------------
 ** Public function.
 */
@@ -108,7 +111,8 @@ xi_open	(SF_PRIVATE *psf)
 	psf->container_close = xi_close ;
 	psf->seek = dpcm_seek ;
 
-	psf->sf.seekable = SF_FALSE ;
+	/* Reading can seek by summing the deltas, writing can not seek. */
+	psf->sf.seekable = (psf->file.mode == SFM_READ) ? SF_TRUE : SF_FALSE ;
 
 	psf->blockwidth = psf->bytewidth * psf->sf.channels ;
 
@@ -218,7 +222,8 @@ static sf_count_t
 dpcm_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			total, bufferlen, len ;
+	sf_count_t	current, total ;
+	int			bufferlen, len, readcount ;
 
 	if ((pxi = psf->codec_data) == NULL)
 		return SFE_INTERNAL ;
@@ -245,25 +250,48 @@ dpcm_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 		return	PSF_SEEK_ERROR ;
 		} ;
 
-	psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
+	/*
+	**	The sample value is the running sum of all the deltas before it, so
+	**	seeking forward only has to sum the deltas from the current position,
+	**	while seeking backward has to start again from the beginning.
+	*/
+	current = psf->read_current ;
+	if (psf->file.mode != SFM_READ || psf->last_op != SFM_READ || current < 0 || current > offset)
+	{	psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
+		pxi->last_16 = 0 ;
+		current = 0 ;
+		} ;
+
+	total = offset - current ;
 
 	if ((SF_CODEC (psf->sf.format)) == SF_FORMAT_DPCM_16)
-	{	total = offset ;
-		bufferlen = ARRAY_LEN (ubuf.sbuf) ;
+	{	bufferlen = ARRAY_LEN (ubuf.sbuf) ;
 		while (total > 0)
-		{	len = (total > bufferlen) ? bufferlen : total ;
-			total -= dpcm_read_dles2s (psf, ubuf.sbuf, len) ;
+		{	len = (total > bufferlen) ? bufferlen : (int) total ;
+			readcount = psf_fread (ubuf.sbuf, sizeof (short), len, psf) ;
+			dles_sum (pxi, ubuf.sbuf, readcount) ;
+			total -= readcount ;
+			if (readcount < len)
+				break ;
 			} ;
 		}
 	else
-	{	total = offset ;
-		bufferlen = ARRAY_LEN (ubuf.sbuf) ;
+	{	bufferlen = ARRAY_LEN (ubuf.scbuf) ;
 		while (total > 0)
-		{	len = (total > bufferlen) ? bufferlen : total ;
-			total -= dpcm_read_dsc2s (psf, ubuf.sbuf, len) ;
+		{	len = (total > bufferlen) ? bufferlen : (int) total ;
+			readcount = psf_fread (ubuf.scbuf, sizeof (signed char), len, psf) ;
+			dsc_sum (pxi, ubuf.scbuf, readcount) ;
+			total -= readcount ;
+			if (readcount < len)
+				break ;
 			} ;
 		} ;
 
+	if (total > 0)
+	{	psf->error = SFE_BAD_SEEK ;
+		return	PSF_SEEK_ERROR ;
+		} ;
+
 	return offset ;
 } /* dpcm_seek */
 
@@ -1029,39 +1057,54 @@ dsc2d_array (XI_PRIVATE *pxi, signed char *src, int count, double *dest, double
 	pxi->last_16 = arith_shift_left (last_val, 8) ;
 } /* dsc2d_array */
 
+/*
+**	Advance the decoder state over count deltas without storing the samples.
+**	The wrap around of the signed char and short accumulators is the same as
+**	truncating an int sum, so this is a plain reduction that vectorises.
+*/
+
+static void
+dsc_sum (XI_PRIVATE *pxi, const signed char *src, int count)
+{	int		k, sum ;
+
+	sum = pxi->last_16 >> 8 ;
+
+	for (k = 0 ; k < count ; k++)
+		sum += src [k] ;
+
+	pxi->last_16 = arith_shift_left ((signed char) sum, 8) ;
+} /* dsc_sum */
+
 /*------------------------------------------------------------------------------
 */
 
 static void
 s2dsc_array (XI_PRIVATE *pxi, const short *src, signed char *dest, int count)
-{	signed char	last_val, current ;
-	int			k ;
+{	int		k ;
 
-	last_val = pxi->last_16 >> 8 ;
+	if (count <= 0)
+		return ;
 
-	for (k = 0 ; k < count ; k++)
-	{	current = src [k] >> 8 ;
-		dest [k] = current - last_val ;
-		last_val = current ;
-		} ;
+	/* No loop carried state, so the compiler is free to vectorise this. */
+	dest [0] = (src [0] >> 8) - (pxi->last_16 >> 8) ;
+	for (k = 1 ; k < count ; k++)
+		dest [k] = (src [k] >> 8) - (src [k - 1] >> 8) ;
 
-	pxi->last_16 = arith_shift_left (last_val, 8) ;
+	pxi->last_16 = arith_shift_left (src [count - 1] >> 8, 8) ;
 } /* s2dsc_array */
 
 static void
 i2dsc_array (XI_PRIVATE *pxi, const int *src, signed char *dest, int count)
-{	signed char	last_val, current ;
-	int			k ;
+{	int		k ;
 
-	last_val = pxi->last_16 >> 8 ;
+	if (count <= 0)
+		return ;
 
-	for (k = 0 ; k < count ; k++)
-	{	current = src [k] >> 24 ;
-		dest [k] = current - last_val ;
-		last_val = current ;
-		} ;
+	dest [0] = (src [0] >> 24) - (pxi->last_16 >> 8) ;
+	for (k = 1 ; k < count ; k++)
+		dest [k] = (src [k] >> 24) - (src [k - 1] >> 24) ;
 
-	pxi->last_16 = arith_shift_left (last_val, 8) ;
+	pxi->last_16 = arith_shift_left (src [count - 1] >> 24, 8) ;
 } /* i2dsc_array */
 
 static void
@@ -1159,39 +1202,56 @@ dles2d_array (XI_PRIVATE *pxi, short *src, int count, double *dest, double normf
 	pxi->last_16 = last_val ;
 } /* dles2d_array */
 
+static void
+dles_sum (XI_PRIVATE *pxi, const short *src, int count)
+{	int		k, sum ;
+
+	sum = pxi->last_16 ;
+
+	for (k = 0 ; k < count ; k++)
+		sum += LE2H_16 (src [k]) ;
+
+	pxi->last_16 = (short) sum ;
+} /* dles_sum */
+
 /*------------------------------------------------------------------------------
 */
 
 static void
 s2dles_array (XI_PRIVATE *pxi, const short *src, short *dest, int count)
-{	short	diff, last_val ;
+{	short	diff ;
 	int		k ;
 
-	last_val = pxi->last_16 ;
+	if (count <= 0)
+		return ;
 
-	for (k = 0 ; k < count ; k++)
-	{	diff = src [k] - last_val ;
+	/* No loop carried state, so the compiler is free to vectorise this. */
+	diff = src [0] - pxi->last_16 ;
+	dest [0] = LE2H_16 (diff) ;
+	for (k = 1 ; k < count ; k++)
+	{	diff = src [k] - src [k - 1] ;
 		dest [k] = LE2H_16 (diff) ;
-		last_val = src [k] ;
 		} ;
 
-	pxi->last_16 = last_val ;
+	pxi->last_16 = src [count - 1] ;
 } /* s2dles_array */
 
 static void
 i2dles_array (XI_PRIVATE *pxi, const int *src, short *dest, int count)
-{	short	diff, last_val ;
+{	short	diff ;
 	int		k ;
 
-	last_val = pxi->last_16 ;
+	if (count <= 0)
+		return ;
 
-	for (k = 0 ; k < count ; k++)
-	{	diff = (src [k] >> 16) - last_val ;
+	diff = (src [0] >> 16) - pxi->last_16 ;
+	dest [0] = LE2H_16 (diff) ;
+	for (k = 1 ; k < count ; k++)
+	{	diff = (src [k] >> 16) - (src [k - 1] >> 16) ;
 		dest [k] = LE2H_16 (diff) ;
-		last_val = src [k] >> 16 ;
 		} ;
 
-	pxi->last_16 = last_val ;
+	pxi->last_16 = src [count - 1] >> 16 ;
 } /* i2dles_array */
 
 static void
@@ -0,0 +1,493 @@
+/*
+** Copyright (C) 2002-2017 Erik de Castro Lopo <erikd@mega-nerd.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+**	Benchmarks for the compressed codecs, complementing the PCM throughput
+**	figures produced by the benchmark program.
+*/
+
+#include "sfconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <time.h>
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#include "sf_unistd.h"
+#endif
+
+#include <sndfile.h>
+
+#ifndef		M_PI
+#define		M_PI		3.14159265358979323846264338
+#endif
+
+#define	BUFFER_FRAMES	(1 << 14)
+#define	TEST_DURATION	(3)		/* 3 Seconds. */
+
+static int	data [8 * BUFFER_FRAMES] ;
+
+static void	alac_seek_benchmark (const char *filename, int format, sf_count_t frames) ;
+static void	chunk_benchmark (const char *filename, int format, int chunk_count) ;
+static void	encode_decode_benchmark (const char *filename, int format, int channels, const char *desc) ;
+static void	open_close_benchmark (const char *filename, int format, const char *desc) ;
+static void	flac_read_benchmark (const char *filename, int format, int channels, const char *desc) ;
+
+static double decode_speed (const char *filename) ;
+
+static void fill_data (int channels) ;
+
+static void write_file_or_die (const char *filename, int format, int channels, sf_count_t frames) ;
+
+int
+main (int argc, char *argv [])
+{	char	buffer [256] = "Codec benchmarks for " ;
+	int		do_all = 0 ;
+
+	if (argc != 2)
+	{	printf ("Usage : %s <test>\n", argv [0]) ;
+		printf ("    Where <test> is one of the following:\n") ;
+		printf ("           alac_seek - random seeks in a long CAF/ALAC file\n") ;
+		printf ("           chunks    - open and chunk lookup in files with 10k chunks\n") ;
+		printf ("           open      - open and close of short files in each container\n") ;
+		printf ("           alac      - encode and decode speed of stereo CAF/ALAC\n") ;
+		printf ("           flac      - decode speed of stereo and 8 channel FLAC\n") ;
+		printf ("           ima       - encode and decode speed of IMA ADPCM WAV\n") ;
+		printf ("           gsm       - encode and decode speed of GSM 6.10 WAV\n") ;
+		printf ("           all       - perform all benchmarks\n") ;
+		exit (1) ;
+		} ;
+
+	do_all = ! strcmp (argv [1], "all") ;
+
+	sf_command (NULL, SFC_GET_LIB_VERSION, buffer + strlen (buffer), sizeof (buffer) - strlen (buffer)) ;
+
+	puts (buffer) ;
+	memset (buffer, '-', strlen (buffer)) ;
+	puts (buffer) ;
+	printf ("Each test takes a little over %d seconds.\n\n", TEST_DURATION) ;
+
+	if (do_all || ! strcmp (argv [1], "alac_seek"))
+	{	/* Ten minutes of stereo at 48kHz is a little over 7000 ALAC packets. */
+		alac_seek_benchmark ("benchmark.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_16, 10 * 60 * 48000) ;
+		} ;
+
+	if (do_all || ! strcmp (argv [1], "chunks"))
+	{	chunk_benchmark ("benchmark.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16, 10000) ;
+		chunk_benchmark ("benchmark.aiff", SF_FORMAT_AIFF | SF_FORMAT_PCM_16, 10000) ;
+		} ;
+
+	if (do_all || ! strcmp (argv [1], "open"))
+	{	open_close_benchmark ("benchmark.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16, "WAV ") ;
+		open_close_benchmark ("benchmark.wav", SF_FORMAT_WAVEX | SF_FORMAT_FLOAT, "WAVEX") ;
+		open_close_benchmark ("benchmark.rf64", SF_FORMAT_RF64 | SF_FORMAT_PCM_16, "RF64") ;
+		open_close_benchmark ("benchmark.w64", SF_FORMAT_W64 | SF_FORMAT_PCM_16, "W64 ") ;
+		open_close_benchmark ("benchmark.aiff", SF_FORMAT_AIFF | SF_FORMAT_PCM_16, "AIFF") ;
+		open_close_benchmark ("benchmark.caf", SF_FORMAT_CAF | SF_FORMAT_PCM_16, "CAF ") ;
+		open_close_benchmark ("benchmark.au", SF_FORMAT_AU | SF_FORMAT_PCM_16, "AU  ") ;
+		} ;
+
+	if (do_all || ! strcmp (argv [1], "alac"))
+	{	encode_decode_benchmark ("benchmark.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_16, 2, "16 bit stereo ALAC") ;
+		encode_decode_benchmark ("benchmark.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_24, 2, "24 bit stereo ALAC") ;
+		} ;
+
+	if (do_all || ! strcmp (argv [1], "flac"))
+	{	if (HAVE_EXTERNAL_XIPH_LIBS)
+		{	flac_read_benchmark ("benchmark.flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16, 2, "16 bit stereo FLAC") ;
+			flac_read_benchmark ("benchmark.flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_24, 2, "24 bit stereo FLAC") ;
+			flac_read_benchmark ("benchmark.flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16, 8, "16 bit 8 channel FLAC") ;
+			}
+		else
+			puts ("    No FLAC benchmarks because FLAC support was not compiled in.") ;
+		} ;
+
+	if (do_all || ! strcmp (argv [1], "ima"))
+	{	encode_decode_benchmark ("benchmark.wav", SF_FORMAT_WAV | SF_FORMAT_IMA_ADPCM, 1, "mono IMA ADPCM WAV") ;
+		encode_decode_benchmark ("benchmark.wav", SF_FORMAT_WAV | SF_FORMAT_IMA_ADPCM, 2, "stereo IMA ADPCM WAV") ;
+		} ;
+
+	if (do_all || ! strcmp (argv [1], "gsm"))
+		encode_decode_benchmark ("benchmark.wav", SF_FORMAT_WAV | SF_FORMAT_GSM610, 1, "mono GSM 6.10 WAV") ;
+
+	puts ("") ;
+
+	return 0 ;
+} /* main */
+
+/*==============================================================================
+*/
+
+static void
+alac_seek_benchmark (const char *filename, int format, sf_count_t frames)
+{	SNDFILE *file ;
+	SF_INFO	sfinfo ;
+	clock_t start_clock, clock_time ;
+	sf_count_t position ;
+	double	performance ;
+	int		op_count ;
+
+	printf ("    Random seek + read in %" PRId64 " frame ALAC file : ", frames) ;
+	fflush (stdout) ;
+
+	write_file_or_die (filename, format, 2, frames) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	if ((file = sf_open (filename, SFM_READ, &sfinfo)) == NULL)
+	{	printf ("\n\nError : not able to open file '%s' : %s\n", filename, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	srand (12345) ;
+
+	clock_time = 0 ;
+	op_count = 0 ;
+	start_clock = clock () ;
+
+	while (clock_time < (CLOCKS_PER_SEC * TEST_DURATION))
+	{	position = (((sf_count_t) rand ()) * RAND_MAX + rand ()) % sfinfo.frames ;
+
+		if (sf_seek (file, position, SEEK_SET) != position)
+		{	printf ("\n\nError : sf_seek to %" PRId64 " failed : %s\n", position, sf_strerror (file)) ;
+			exit (1) ;
+			} ;
+
+		sf_readf_int (file, data, 64) ;
+
+		clock_time = clock () - start_clock ;
+		op_count ++ ;
+		} ;
+
+	sf_close (file) ;
+
+	performance = (1.0 * op_count * CLOCKS_PER_SEC) / clock_time ;
+	printf ("%10.0f seeks per sec\n", performance) ;
+
+	unlink (filename) ;
+} /* alac_seek_benchmark */
+
+static void
+chunk_benchmark (const char *filename, int format, int chunk_count)
+{	static char chunk_data [24] ;
+	SNDFILE *file ;
+	SF_INFO	sfinfo ;
+	SF_CHUNK_INFO chunk_info ;
+	SF_CHUNK_ITERATOR *iterator ;
+	clock_t start_clock, clock_time ;
+	double	performance ;
+	int		k, id_count, op_count, found ;
+
+	printf ("    Open + chunk lookup, %d chunk %-4s file : ", chunk_count, (format & SF_FORMAT_TYPEMASK) == SF_FORMAT_WAV ? "WAV" : "AIFF") ;
+	fflush (stdout) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate = 48000 ;
+	sfinfo.channels = 1 ;
+	sfinfo.format = format ;
+
+	if ((file = sf_open (filename, SFM_WRITE, &sfinfo)) == NULL)
+	{	printf ("\n\nError : not able to open file '%s' : %s\n", filename, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	/* Lots of small chunks (like one chunk per marker) with a thousand different ids. */
+	id_count = chunk_count < 1000 ? chunk_count : 1000 ;
+
+	memset (&chunk_info, 0, sizeof (chunk_info)) ;
+	chunk_info.data = chunk_data ;
+	chunk_info.datalen = sizeof (chunk_data) ;
+	for (k = 0 ; k < chunk_count ; k++)
+	{	snprintf (chunk_info.id, sizeof (chunk_info.id), "m%03d", k % id_count) ;
+		chunk_info.id_size = 4 ;
+		snprintf (chunk_data, sizeof (chunk_data), "Marker %d", k % 100000) ;
+
+		if (sf_set_chunk (file, &chunk_info) != SF_ERR_NO_ERROR)
+		{	printf ("\n\nError : sf_set_chunk failed : %s\n", sf_strerror (file)) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	fill_data (1) ;
+	sf_writef_int (file, data, BUFFER_FRAMES) ;
+	sf_close (file) ;
+
+	clock_time = 0 ;
+	op_count = 0 ;
+	start_clock = clock () ;
+
+	while (clock_time < (CLOCKS_PER_SEC * TEST_DURATION))
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		if ((file = sf_open (filename, SFM_READ, &sfinfo)) == NULL)
+		{	printf ("\n\nError : not able to open file '%s' : %s\n", filename, sf_strerror (NULL)) ;
+			exit (1) ;
+			} ;
+
+		/* Look up every id and walk all the chunks with that id. */
+		found = 0 ;
+		for (k = 0 ; k < id_count ; k++)
+		{	snprintf (chunk_info.id, sizeof (chunk_info.id), "m%03d", k) ;
+			for (iterator = sf_get_chunk_iterator (file, &chunk_info) ; iterator != NULL ; iterator = sf_next_chunk_iterator (iterator))
+				found ++ ;
+			} ;
+
+		if (found != chunk_count)
+		{	printf ("\n\nError : found %d chunks (should be %d).\n", found, chunk_count) ;
+			exit (1) ;
+			} ;
+
+		sf_close (file) ;
+
+		clock_time = clock () - start_clock ;
+		op_count ++ ;
+		} ;
+
+	performance = (1.0 * op_count * CLOCKS_PER_SEC) / clock_time ;
+	printf ("%10.1f files per sec\n", performance) ;
+
+	unlink (filename) ;
+} /* chunk_benchmark */
+
+static void
+open_close_benchmark (const char *filename, int format, const char *desc)
+{	SNDFILE *file ;
+	SF_INFO	sfinfo ;
+	clock_t start_clock, clock_time ;
+	double	write_rate, read_rate ;
+	int		op_count ;
+
+	printf ("    Open + close of a 100 msec stereo %-5s file : ", desc) ;
+	fflush (stdout) ;
+
+	fill_data (2) ;
+
+	/* Write a short clip (like a sound effect or a UI sound) over and over. */
+	clock_time = 0 ;
+	op_count = 0 ;
+	start_clock = clock () ;
+
+	while (clock_time < (CLOCKS_PER_SEC * TEST_DURATION))
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		sfinfo.samplerate = 48000 ;
+		sfinfo.channels = 2 ;
+		sfinfo.format = format ;
+
+		if ((file = sf_open (filename, SFM_WRITE, &sfinfo)) == NULL)
+		{	printf ("\n\nError : not able to open file '%s' : %s\n", filename, sf_strerror (NULL)) ;
+			exit (1) ;
+			} ;
+
+		if (sf_writef_int (file, data, 4800) != 4800)
+		{	printf ("\n\nError : sf_writef_int failed : %s\n", sf_strerror (file)) ;
+			exit (1) ;
+			} ;
+
+		sf_close (file) ;
+
+		clock_time = clock () - start_clock ;
+		op_count ++ ;
+		} ;
+
+	write_rate = (1.0 * op_count * CLOCKS_PER_SEC) / clock_time ;
+
+	clock_time = 0 ;
+	op_count = 0 ;
+	start_clock = clock () ;
+
+	while (clock_time < (CLOCKS_PER_SEC * TEST_DURATION))
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		if ((file = sf_open (filename, SFM_READ, &sfinfo)) == NULL)
+		{	printf ("\n\nError : not able to open file '%s' : %s\n", filename, sf_strerror (NULL)) ;
+			exit (1) ;
+			} ;
+
+		if (sfinfo.frames != 4800 || sfinfo.channels != 2)
+		{	printf ("\n\nError : bad frames (%" PRId64 ") or channels (%d).\n", sfinfo.frames, sfinfo.channels) ;
+			exit (1) ;
+			} ;
+
+		sf_close (file) ;
+
+		clock_time = clock () - start_clock ;
+		op_count ++ ;
+		} ;
+
+	read_rate = (1.0 * op_count * CLOCKS_PER_SEC) / clock_time ;
+
+	printf ("write %8.0f, read %8.0f files per sec\n", write_rate, read_rate) ;
+
+	unlink (filename) ;
+} /* open_close_benchmark */
+
+static void
+encode_decode_benchmark (const char *filename, int format, int channels, const char *desc)
+{	SNDFILE *file ;
+	SF_INFO	sfinfo ;
+	clock_t start_clock, clock_time ;
+	sf_count_t total ;
+	double	performance ;
+
+	fill_data (channels) ;
+
+	/* Encode. */
+	printf ("    Encode %-24s : ", desc) ;
+	fflush (stdout) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate = 48000 ;
+	sfinfo.channels = channels ;
+	sfinfo.format = format ;
+
+	if ((file = sf_open (filename, SFM_WRITE, &sfinfo)) == NULL)
+	{	printf ("\n\nError : not able to open file '%s' : %s\n", filename, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	clock_time = 0 ;
+	total = 0 ;
+	start_clock = clock () ;
+
+	while (clock_time < (CLOCKS_PER_SEC * TEST_DURATION))
+	{	if (sf_writef_int (file, data, BUFFER_FRAMES) != BUFFER_FRAMES)
+		{	printf ("\n\nError : sf_writef_int failed : %s\n", sf_strerror (file)) ;
+			exit (1) ;
+			} ;
+
+		total += BUFFER_FRAMES ;
+		clock_time = clock () - start_clock ;
+		} ;
+
+	sf_close (file) ;
+
+	performance = (1.0 * total * CLOCKS_PER_SEC) / clock_time / sfinfo.samplerate ;
+	printf ("%10.1f x realtime\n", performance) ;
+
+	/* Decode. */
+	printf ("    Decode %-24s : ", desc) ;
+	fflush (stdout) ;
+
+	printf ("%10.1f x realtime\n", decode_speed (filename)) ;
+
+	unlink (filename) ;
+} /* encode_decode_benchmark */
+
+static void
+flac_read_benchmark (const char *filename, int format, int channels, const char *desc)
+{
+	printf ("    Decode %-24s : ", desc) ;
+	fflush (stdout) ;
+
+	/* One minute of audio at 48kHz. */
+	write_file_or_die (filename, format, channels, 60 * 48000) ;
+
+	printf ("%10.1f x realtime\n", decode_speed (filename)) ;
+
+	unlink (filename) ;
+} /* flac_read_benchmark */
+
+/*==============================================================================
+*/
+
+/* Read the file repeatedly for TEST_DURATION seconds and return the speed as a multiple of realtime. */
+static double
+decode_speed (const char *filename)
+{	SNDFILE *file ;
+	SF_INFO	sfinfo ;
+	clock_t start_clock, clock_time ;
+	sf_count_t total, count ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	if ((file = sf_open (filename, SFM_READ, &sfinfo)) == NULL)
+	{	printf ("\n\nError : not able to open file '%s' : %s\n", filename, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	clock_time = 0 ;
+	total = 0 ;
+	start_clock = clock () ;
+
+	while (clock_time < (CLOCKS_PER_SEC * TEST_DURATION))
+	{	count = sf_readf_int (file, data, BUFFER_FRAMES) ;
+		if (count < BUFFER_FRAMES && ! sfinfo.seekable)
+		{	/* Some codecs (eg GSM 6.10) can't seek, so start again by reopening. */
+			sf_close (file) ;
+			if ((file = sf_open (filename, SFM_READ, &sfinfo)) == NULL)
+			{	printf ("\n\nError : not able to open file '%s' : %s\n", filename, sf_strerror (NULL)) ;
+				exit (1) ;
+				} ;
+			}
+		else if (count < BUFFER_FRAMES && sf_seek (file, 0, SEEK_SET) != 0)
+		{	printf ("\n\nError : sf_seek failed : %s\n", sf_strerror (file)) ;
+			exit (1) ;
+			} ;
+
+		total += count ;
+		clock_time = clock () - start_clock ;
+		} ;
+
+	sf_close (file) ;
+
+	return (1.0 * total * CLOCKS_PER_SEC) / clock_time / sfinfo.samplerate ;
+} /* decode_speed */
+
+/*==============================================================================
+*/
+
+static void
+fill_data (int channels)
+{	int k ;
+
+	for (k = 0 ; k < BUFFER_FRAMES * channels ; k++)
+		data [k] = lrint (0x20000000 * sin (2 * M_PI * (k / channels) / 321.0) + (rand () & 0xFFFFF)) ;
+} /* fill_data */
+
+static void
+write_file_or_die (const char *filename, int format, int channels, sf_count_t frames)
+{	SNDFILE *file ;
+	SF_INFO	sfinfo ;
+	sf_count_t count ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate = 48000 ;
+	sfinfo.channels = channels ;
+	sfinfo.format = format ;
+
+	if ((file = sf_open (filename, SFM_WRITE, &sfinfo)) == NULL)
+	{	printf ("\n\nError : not able to open file '%s' : %s\n", filename, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	fill_data (channels) ;
+
+	while (frames > 0)
+	{	count = frames > BUFFER_FRAMES ? BUFFER_FRAMES : frames ;
+
+		if (sf_writef_int (file, data, count) != count)
+		{	printf ("\n\nError : sf_writef_int failed : %s\n", sf_strerror (file)) ;
+			exit (1) ;
+			} ;
+
+		frames -= count ;
+		} ;
+
+	sf_close (file) ;
+} /* write_file_or_die */
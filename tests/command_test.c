@@ -33,6 +33,10 @@
 
 #include <math.h>
 
+#if OS_IS_WIN32
+#include <windows.h>
+#endif
+
 #include <sndfile.h>
 
 #include "sfendian.h"
@@ -52,6 +56,16 @@ static	void	cue_test			(const char *filename, int filetype) ;
 static	void	channel_map_test		(const char *filename, int filetype) ;
 static	void	current_sf_info_test	(const char *filename) ;
 static	void	raw_needs_endswap_test	(const char *filename, int filetype) ;
+static	void	fast_open_test			(const char *filename, int filetype) ;
+static	void	probe_test				(const char *filename, int filetype) ;
+static	void	reopen_test				(void) ;
+static	void	prealloc_test			(const char *filename, int filetype) ;
+static	void	threads_test			(const char *filename, int filetype) ;
+static	void	threads_gsm_test		(const char *filename, int filetype) ;
+static	void	read_ahead_test			(const char *filename, int filetype) ;
+static	void	async_write_test		(const char *filename, int filetype, int channels) ;
+static	void	async_write_error_test	(void) ;
+static	void	threads_gsm_error_test	(void) ;
 
 static	void	broadcast_test			(const char *filename, int filetype) ;
 static	void	broadcast_rdwr_test		(const char *filename, int filetype) ;
@@ -90,6 +104,11 @@ main (int argc, char *argv [])
 		printf ("           bextch  - test set/get of SF_BROADCAST_INFO coding_history.\n") ;
 		printf ("           cart    - test set/get of SF_CART_INFO.\n") ;
 		printf ("           rawend  - test SFC_RAW_NEEDS_ENDSWAP.\n") ;
+		printf ("           fast    - test opening with SFM_FAST_OPEN.\n") ;
+		printf ("           prealloc - test SFC_SET_PREALLOCATE.\n") ;
+		printf ("           threads - test SFC_SET_ENCODER_THREADS and SFC_SET_DECODER_THREADS.\n") ;
+		printf ("           read_ahead - test SFC_SET_READ_AHEAD.\n") ;
+		printf ("           async_write - test SFC_SET_ASYNC_WRITE.\n") ;
 		printf ("           all     - perform all tests\n") ;
 		exit (1) ;
 		} ;
@@ -199,6 +218,77 @@ main (int argc, char *argv [])
 		test_count ++ ;
 		} ;
 
+	if (do_all || strcmp (argv [1], "fast") == 0)
+	{	fast_open_test ("fast_open.wav", SF_FORMAT_WAV | SF_FORMAT_FLOAT) ;
+		fast_open_test ("fast_open.wavex", SF_FORMAT_WAVEX | SF_FORMAT_FLOAT) ;
+		test_count ++ ;
+		} ;
+
+	if (do_all || strcmp (argv [1], "probe") == 0)
+	{	probe_test ("probe.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16) ;
+		probe_test ("probe.wav", SF_FORMAT_WAV | SF_FORMAT_IMA_ADPCM) ;
+		probe_test ("probe.aiff", SF_FORMAT_AIFF | SF_FORMAT_PCM_24) ;
+		probe_test ("probe.au", SF_FORMAT_AU | SF_FORMAT_ULAW) ;
+		probe_test ("probe.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_16) ;
+		probe_test ("probe.w64", SF_FORMAT_W64 | SF_FORMAT_MS_ADPCM) ;
+		probe_test ("probe.rf64", SF_FORMAT_RF64 | SF_FORMAT_FLOAT) ;
+		probe_test ("probe.aiff", SF_FORMAT_AIFF | SF_FORMAT_ALAW) ;
+		probe_test ("probe.wav", SF_FORMAT_WAV | SF_FORMAT_DOUBLE) ;
+		if (HAVE_EXTERNAL_XIPH_LIBS)
+			probe_test ("probe.flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16) ;
+		test_count ++ ;
+		} ;
+
+	if (do_all || strcmp (argv [1], "reopen") == 0)
+	{	reopen_test () ;
+		test_count ++ ;
+		} ;
+
+	if (do_all || strcmp (argv [1], "prealloc") == 0)
+	{	prealloc_test ("prealloc.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16) ;
+		prealloc_test ("prealloc.rf64", SF_FORMAT_RF64 | SF_FORMAT_PCM_24) ;
+		prealloc_test ("prealloc.w64", SF_FORMAT_W64 | SF_FORMAT_FLOAT) ;
+		prealloc_test ("prealloc.caf", SF_FORMAT_CAF | SF_FORMAT_ALAW) ;
+		prealloc_test ("prealloc.aiff", SF_FORMAT_AIFF | SF_FORMAT_PCM_16) ;
+		test_count ++ ;
+		} ;
+
+	if (do_all || strcmp (argv [1], "threads") == 0)
+	{	threads_test ("threads.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_16) ;
+		threads_test ("threads_24.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_24) ;
+		threads_test ("threads_msadpcm.wav", SF_FORMAT_WAV | SF_FORMAT_MS_ADPCM) ;
+		threads_test ("threads_msadpcm.w64", SF_FORMAT_W64 | SF_FORMAT_MS_ADPCM) ;
+		threads_test ("threads_ima.wav", SF_FORMAT_WAV | SF_FORMAT_IMA_ADPCM) ;
+		threads_test ("threads_ima.w64", SF_FORMAT_W64 | SF_FORMAT_IMA_ADPCM) ;
+		threads_test ("threads_24.paf", SF_FORMAT_PAF | SF_FORMAT_PCM_24) ;
+		threads_gsm_test ("threads_gsm.wav", SF_FORMAT_WAV | SF_FORMAT_GSM610) ;
+		threads_gsm_test ("threads_gsm.raw", SF_FORMAT_RAW | SF_FORMAT_GSM610) ;
+		threads_gsm_error_test () ;
+		test_count ++ ;
+		} ;
+
+	if (do_all || strcmp (argv [1], "read_ahead") == 0)
+	{	read_ahead_test ("read_ahead.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16) ;
+		read_ahead_test ("read_ahead_ima.wav", SF_FORMAT_WAV | SF_FORMAT_IMA_ADPCM) ;
+		if (HAVE_EXTERNAL_XIPH_LIBS)
+		{	read_ahead_test ("read_ahead.flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16) ;
+			read_ahead_test ("read_ahead.oga", SF_FORMAT_OGG | SF_FORMAT_VORBIS) ;
+			read_ahead_test ("read_ahead.opus", SF_FORMAT_OGG | SF_FORMAT_OPUS) ;
+			} ;
+		test_count ++ ;
+		} ;
+
+	if (do_all || strcmp (argv [1], "async_write") == 0)
+	{	async_write_test ("async_write.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16, 2) ;
+		async_write_test ("async_write.au", SF_FORMAT_AU | SF_FORMAT_FLOAT, 2) ;
+		async_write_test ("async_write_msadpcm.wav", SF_FORMAT_WAV | SF_FORMAT_MS_ADPCM, 2) ;
+		async_write_test ("async_write_gsm.wav", SF_FORMAT_WAV | SF_FORMAT_GSM610, 1) ;
+		if (HAVE_EXTERNAL_XIPH_LIBS)
+			async_write_test ("async_write.flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16, 2) ;
+		async_write_error_test () ;
+		test_count ++ ;
+		} ;
+
 	if (test_count == 0)
 	{	printf ("Mono : ************************************\n") ;
 		printf ("Mono : *  No '%s' test defined.\n", argv [1]) ;
@@ -1751,3 +1841,940 @@ raw_needs_endswap_test (const char *filename, int filetype)
 	unlink (filename) ;
 	puts ("ok") ;
 } /* raw_needs_endswap_test */
+
+/*==============================================================================
+*/
+
+static void
+fast_open_test (const char *filename, int filetype)
+{	static SF_INSTRUMENT write_inst, read_inst ;
+	static SF_BROADCAST_INFO bc_write, bc_read ;
+	static SF_CUES write_cue, read_cue ;
+	static float read_data [BUFFER_LEN] ;
+	char log_buffer [LOG_BUFFER_SIZE] ;
+	SNDFILE	*file ;
+	SF_INFO	sfinfo ;
+	const char *str ;
+	double peak ;
+	unsigned k ;
+
+	print_test_name ("fast_open_test", filename) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= 44100 ;
+	sfinfo.format		= filetype ;
+	sfinfo.channels		= 1 ;
+
+	for (k = 0 ; k < BUFFER_LEN ; k++)
+		float_data [k] = (k + 1) / (2.0 * BUFFER_LEN) ;
+
+	memset (&write_inst, 0, sizeof (write_inst)) ;
+	write_inst.basenote = 60 ;
+	write_inst.loop_count = 1 ;
+	write_inst.loops [0].mode = SF_LOOP_FORWARD ;
+	write_inst.loops [0].end = BUFFER_LEN / 2 ;
+	write_inst.loops [0].count = 1 ;
+
+	memset (&bc_write, 0, sizeof (bc_write)) ;
+	snprintf (bc_write.description, sizeof (bc_write.description), "Fast open description") ;
+
+	memset (&write_cue, 0, sizeof (write_cue)) ;
+	write_cue.cue_count = 1 ;
+	write_cue.cue_points [0].indx = 1 ;
+	write_cue.cue_points [0].fcc_chunk = data_MARKER ;
+	write_cue.cue_points [0].sample_offset = 10 ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+	sf_set_string (file, SF_STR_TITLE, "Fast open title") ;
+	exit_if_true (sf_command (file, SFC_SET_INSTRUMENT, &write_inst, sizeof (write_inst)) == SF_FALSE,
+		"\n\nLine %d : sf_command (SFC_SET_INSTRUMENT) failed.\n\n", __LINE__) ;
+	exit_if_true (sf_command (file, SFC_SET_BROADCAST_INFO, &bc_write, sizeof (bc_write)) == SF_FALSE,
+		"\n\nLine %d : sf_command (SFC_SET_BROADCAST_INFO) failed.\n\n", __LINE__) ;
+	exit_if_true (sf_command (file, SFC_SET_CUE, &write_cue, sizeof (write_cue)) == SF_FALSE,
+		"\n\nLine %d : sf_command (SFC_SET_CUE) failed.\n\n", __LINE__) ;
+	test_write_float_or_die (file, 0, float_data, BUFFER_LEN, __LINE__) ;
+	sf_close (file) ;
+
+	/* Fast open only makes sense for reading. */
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = sf_open (filename, SFM_RDWR | SFM_FAST_OPEN, &sfinfo) ;
+	exit_if_true (file != NULL, "\n\nLine %d : sf_open (SFM_RDWR | SFM_FAST_OPEN) should fail.\n\n", __LINE__) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = sf_open (filename, SFM_READ | SFM_FAST_OPEN, &sfinfo) ;
+	exit_if_true (file == NULL, "\n\nLine %d : sf_open (SFM_READ | SFM_FAST_OPEN) failed : %s\n\n", __LINE__, sf_strerror (NULL)) ;
+
+	exit_if_true (sfinfo.format != filetype || sfinfo.channels != 1 || sfinfo.frames != BUFFER_LEN,
+		"\n\nLine %d : bad SF_INFO (format 0x%x, channels %d, frames %" PRId64 ").\n\n", __LINE__, sfinfo.format, sfinfo.channels, sfinfo.frames) ;
+
+	sf_command (file, SFC_GET_LOG_INFO, log_buffer, sizeof (log_buffer)) ;
+	exit_if_true (strlen (log_buffer) != 0, "\n\nLine %d : log should be empty :\n%s\n", __LINE__, log_buffer) ;
+
+	/* Read some data, then make sure fetching the metadata doesn't disturb the read position. */
+	test_read_float_or_die (file, 0, read_data, BUFFER_LEN / 2, __LINE__) ;
+
+	str = sf_get_string (file, SF_STR_TITLE) ;
+	exit_if_true (str == NULL || strcmp (str, "Fast open title") != 0, "\n\nLine %d : bad title '%s'.\n\n", __LINE__, str) ;
+
+	exit_if_true (sf_command (file, SFC_GET_INSTRUMENT, &read_inst, sizeof (read_inst)) == SF_FALSE,
+		"\n\nLine %d : sf_command (SFC_GET_INSTRUMENT) failed.\n\n", __LINE__) ;
+	exit_if_true (read_inst.basenote != write_inst.basenote || read_inst.loop_count != 1 || read_inst.loops [0].end != write_inst.loops [0].end,
+		"\n\nLine %d : instrument mismatch.\n\n", __LINE__) ;
+
+	exit_if_true (sf_command (file, SFC_GET_BROADCAST_INFO, &bc_read, sizeof (bc_read)) == SF_FALSE,
+		"\n\nLine %d : sf_command (SFC_GET_BROADCAST_INFO) failed.\n\n", __LINE__) ;
+	exit_if_true (strcmp (bc_read.description, bc_write.description) != 0,
+		"\n\nLine %d : broadcast description mismatch '%s'.\n\n", __LINE__, bc_read.description) ;
+
+	exit_if_true (sf_command (file, SFC_GET_CUE, &read_cue, sizeof (read_cue)) == SF_FALSE,
+		"\n\nLine %d : sf_command (SFC_GET_CUE) failed.\n\n", __LINE__) ;
+	exit_if_true (read_cue.cue_count != 1 || read_cue.cue_points [0].sample_offset != 10,
+		"\n\nLine %d : cue mismatch.\n\n", __LINE__) ;
+
+	/* Floating point WAV files get a PEAK chunk by default. */
+	exit_if_true (sf_command (file, SFC_GET_SIGNAL_MAX, &peak, sizeof (peak)) == SF_FALSE,
+		"\n\nLine %d : sf_command (SFC_GET_SIGNAL_MAX) failed.\n\n", __LINE__) ;
+	exit_if_true (fabs (peak - float_data [BUFFER_LEN - 1]) > 1e-6, "\n\nLine %d : bad peak %f.\n\n", __LINE__, peak) ;
+
+	test_read_float_or_die (file, 0, read_data + BUFFER_LEN / 2, BUFFER_LEN / 2, __LINE__) ;
+	sf_close (file) ;
+
+	for (k = 0 ; k < BUFFER_LEN ; k++)
+		exit_if_true (read_data [k] != float_data [k], "\n\nLine %d : data mismatch at %u.\n\n", __LINE__, k) ;
+
+	unlink (filename) ;
+	puts ("ok") ;
+} /* fast_open_test */
+
+/*==============================================================================
+*/
+
+static void
+probe_test (const char *filename, int filetype)
+{	static short data [BUFFER_LEN] ;
+	SNDFILE	*file ;
+	SF_INFO	sfinfo, probe_info ;
+	int error, flags ;
+
+	print_test_name ("probe_test", filename) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= 22050 ;
+	sfinfo.format		= filetype ;
+	sfinfo.channels		= 2 ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+	test_write_short_or_die (file, 0, data, BUFFER_LEN, __LINE__) ;
+	sf_close (file) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	sf_close (file) ;
+
+	/* The header only probe and the full one must both agree with sf_open (). */
+	for (flags = 0 ; flags <= SF_PROBE_FULL ; flags += SF_PROBE_FULL)
+	{	memset (&probe_info, 0xff, sizeof (probe_info)) ;
+		error = sf_probe (filename, &probe_info, flags) ;
+		exit_if_true (error != 0, "\n\nLine %d : sf_probe failed : %s\n\n", __LINE__, sf_error_number (error)) ;
+
+		exit_if_true (probe_info.format != sfinfo.format || probe_info.channels != sfinfo.channels
+						|| probe_info.samplerate != sfinfo.samplerate || probe_info.frames != sfinfo.frames
+						|| probe_info.sections != sfinfo.sections || probe_info.seekable != sfinfo.seekable,
+			"\n\nLine %d : sf_probe (flags %d) / sf_open mismatch (format 0x%x / 0x%x, frames %" PRId64 " / %" PRId64 ").\n\n",
+			__LINE__, flags, probe_info.format, sfinfo.format, probe_info.frames, sfinfo.frames) ;
+		} ;
+
+	error = sf_probe (filename, &probe_info, 0x100) ;
+	exit_if_true (error == 0, "\n\nLine %d : sf_probe with unknown flags should fail.\n\n", __LINE__) ;
+
+	unlink (filename) ;
+
+	/* Probing a file that no longer exists must fail without touching sf_error (NULL). */
+	error = sf_probe (filename, &probe_info, 0) ;
+	exit_if_true (error == 0, "\n\nLine %d : sf_probe on missing file should fail.\n\n", __LINE__) ;
+	exit_if_true (sf_error (NULL) != 0, "\n\nLine %d : sf_probe set the global error.\n\n", __LINE__) ;
+
+	puts ("ok") ;
+} /* probe_test */
+
+static void
+reopen_test (void)
+{	static const struct
+	{	const char	*filename ;
+		int			format ;
+	} files [] =
+	{	{	"reopen.wav",	SF_FORMAT_WAV | SF_FORMAT_PCM_16 },
+		{	"reopen.aiff",	SF_FORMAT_AIFF | SF_FORMAT_PCM_24 },
+		{	"reopen.caf",	SF_FORMAT_CAF | SF_FORMAT_ALAC_16 },
+		{	"reopen.rf64",	SF_FORMAT_RF64 | SF_FORMAT_FLOAT },
+	} ;
+	static short data [BUFFER_LEN], check [BUFFER_LEN] ;
+	SNDFILE	*file ;
+	SF_INFO	sfinfo ;
+	unsigned k ;
+
+	print_test_name ("reopen_test", "reopen.*") ;
+
+	for (k = 0 ; k < BUFFER_LEN ; k++)
+		data [k] = 16 * k - 8000 ;
+
+	/* Write each of the files, all through the same handle. */
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= 44100 ;
+	sfinfo.format		= files [0].format ;
+	sfinfo.channels		= 2 ;
+
+	file = test_open_file_or_die (files [0].filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+	test_write_short_or_die (file, 0, data, BUFFER_LEN, __LINE__) ;
+
+	for (k = 1 ; k < ARRAY_LEN (files) ; k++)
+	{	sfinfo.format = files [k].format ;
+		exit_if_true (sf_reopen (file, files [k].filename, SFM_WRITE, &sfinfo) != file,
+			"\n\nLine %d : sf_reopen (%s) failed : %s\n\n", __LINE__, files [k].filename, sf_strerror (NULL)) ;
+		test_write_short_or_die (file, 0, data, BUFFER_LEN, __LINE__) ;
+		} ;
+
+	/* Read them all back, still with the same handle. */
+	for (k = 0 ; k < ARRAY_LEN (files) ; k++)
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		exit_if_true (sf_reopen (file, files [k].filename, SFM_READ, &sfinfo) != file,
+			"\n\nLine %d : sf_reopen (%s) failed : %s\n\n", __LINE__, files [k].filename, sf_strerror (NULL)) ;
+
+		exit_if_true (sfinfo.format != files [k].format || sfinfo.channels != 2 || sfinfo.frames != BUFFER_LEN / 2,
+			"\n\nLine %d : %s has format 0x%x, %d channels, %" PRId64 " frames.\n\n",
+			__LINE__, files [k].filename, sfinfo.format, sfinfo.channels, sfinfo.frames) ;
+
+		memset (check, 0, sizeof (check)) ;
+		test_read_short_or_die (file, 0, check, BUFFER_LEN, __LINE__) ;
+		exit_if_true (memcmp (data, check, sizeof (data)) != 0,
+			"\n\nLine %d : %s data mismatch.\n\n", __LINE__, files [k].filename) ;
+
+		unlink (files [k].filename) ;
+		} ;
+
+	/* Reopening a file that no longer exists must fail and free the handle. */
+	exit_if_true (sf_reopen (file, files [0].filename, SFM_READ, &sfinfo) != NULL,
+		"\n\nLine %d : sf_reopen on missing file should fail.\n\n", __LINE__) ;
+	exit_if_true (sf_error (NULL) == 0, "\n\nLine %d : sf_reopen failure should set the error.\n\n", __LINE__) ;
+
+	puts ("ok") ;
+} /* reopen_test */
+
+static void
+prealloc_test (const char *filename, int filetype)
+{	static unsigned char ref_bytes [1 << 14], new_bytes [1 << 14] ;
+	char		ref_name [64] ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	FILE		*fp ;
+	sf_count_t	frames, reserved, length ;
+	int			k, pass ;
+
+	print_test_name ("prealloc_test", filename) ;
+
+	snprintf (ref_name, sizeof (ref_name), "ref_%s", filename) ;
+
+	for (k = 0 ; k < BUFFER_LEN ; k++)
+		int_data [k] = (k - BUFFER_LEN / 2) * 0x10000 ;
+
+	/*
+	**	Write the same file with and without preallocation, updating the
+	**	header part way through and with metadata after the audio. Once
+	**	closed the two must be identical.
+	*/
+	for (pass = 0 ; pass < 2 ; pass++)
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		sfinfo.samplerate	= 44100 ;
+		sfinfo.format		= filetype ;
+		sfinfo.channels		= 2 ;
+
+		file = test_open_file_or_die (pass ? filename : ref_name, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+
+		if (pass == 1)
+		{	frames = 100 * BUFFER_LEN ;
+			exit_if_true (sf_command (file, SFC_SET_PREALLOCATE, &frames, sizeof (frames)) != SF_TRUE,
+				"\n\nLine %d : sf_command (SFC_SET_PREALLOCATE) failed.\n\n", __LINE__) ;
+			reserved = file_length (filename) ;
+			exit_if_true (reserved < 100 * BUFFER_LEN * 2,
+				"\n\nLine %d : only %" PRId64 " bytes reserved.\n\n", __LINE__, reserved) ;
+			} ;
+
+		test_writef_int_or_die (file, 0, int_data, BUFFER_LEN / 2, __LINE__) ;
+		sf_command (file, SFC_UPDATE_HEADER_NOW, NULL, 0) ;
+		test_writef_int_or_die (file, 0, int_data, BUFFER_LEN / 2, __LINE__) ;
+		sf_set_string (file, SF_STR_COMMENT, "Preallocated") ;
+		sf_close (file) ;
+		} ;
+
+	length = file_length (filename) ;
+	exit_if_true (length != file_length (ref_name) || length + 1000 > SIGNED_SIZEOF (ref_bytes),
+		"\n\nLine %d : file length %" PRId64 " should be %" PRId64 ".\n\n", __LINE__, length, file_length (ref_name)) ;
+
+	fp = fopen (ref_name, "rb") ;
+	exit_if_true (fp == NULL || fread (ref_bytes, 1, (size_t) length, fp) != (size_t) length,
+		"\n\nLine %d : could not read '%s'.\n\n", __LINE__, ref_name) ;
+	fclose (fp) ;
+	fp = fopen (filename, "rb") ;
+	exit_if_true (fp == NULL || fread (new_bytes, 1, (size_t) length, fp) != (size_t) length,
+		"\n\nLine %d : could not read '%s'.\n\n", __LINE__, filename) ;
+	fclose (fp) ;
+
+	exit_if_true (memcmp (ref_bytes, new_bytes, (size_t) length) != 0,
+		"\n\nLine %d : preallocated file differs from '%s'.\n\n", __LINE__, ref_name) ;
+
+	/*
+	**	Same again, embedded after some existing content through sf_open_fd ().
+	**	The reserved space must be given back without touching either part.
+	*/
+	if ((filetype & SF_FORMAT_TYPEMASK) == SF_FORMAT_WAV || (filetype & SF_FORMAT_TYPEMASK) == SF_FORMAT_AIFF)
+	{	fp = fopen (filename, "wb") ;
+		exit_if_true (fp == NULL, "\n\nLine %d : could not create '%s'.\n\n", __LINE__, filename) ;
+		memset (new_bytes, 0xA5, 1000) ;
+		exit_if_true (fwrite (new_bytes, 1, 1000, fp) != 1000, "\n\nLine %d : fwrite failed.\n\n", __LINE__) ;
+		fflush (fp) ;
+
+		memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		sfinfo.samplerate	= 44100 ;
+		sfinfo.format		= filetype ;
+		sfinfo.channels		= 2 ;
+
+		file = sf_open_fd (fileno (fp), SFM_WRITE, &sfinfo, SF_FALSE) ;
+		exit_if_true (file == NULL, "\n\nLine %d : sf_open_fd failed : %s\n\n", __LINE__, sf_strerror (NULL)) ;
+
+		frames = 100 * BUFFER_LEN ;
+		exit_if_true (sf_command (file, SFC_SET_PREALLOCATE, &frames, sizeof (frames)) != SF_TRUE,
+			"\n\nLine %d : sf_command (SFC_SET_PREALLOCATE) failed.\n\n", __LINE__) ;
+		test_writef_int_or_die (file, 0, int_data, BUFFER_LEN / 2, __LINE__) ;
+		sf_command (file, SFC_UPDATE_HEADER_NOW, NULL, 0) ;
+		test_writef_int_or_die (file, 0, int_data, BUFFER_LEN / 2, __LINE__) ;
+		sf_set_string (file, SF_STR_COMMENT, "Preallocated") ;
+		sf_close (file) ;
+		fclose (fp) ;
+
+		exit_if_true (file_length (filename) != 1000 + length,
+			"\n\nLine %d : file length %" PRId64 " should be %" PRId64 ".\n\n", __LINE__, file_length (filename), 1000 + length) ;
+
+		fp = fopen (filename, "rb") ;
+		exit_if_true (fp == NULL || fread (new_bytes, 1, (size_t) (1000 + length), fp) != (size_t) (1000 + length),
+			"\n\nLine %d : could not read '%s'.\n\n", __LINE__, filename) ;
+		fclose (fp) ;
+
+		for (k = 0 ; k < 1000 ; k++)
+			exit_if_true (new_bytes [k] != 0xA5, "\n\nLine %d : leading content overwritten at byte %d.\n\n", __LINE__, k) ;
+		exit_if_true (memcmp (ref_bytes, new_bytes + 1000, (size_t) length) != 0,
+			"\n\nLine %d : embedded preallocated file differs from '%s'.\n\n", __LINE__, ref_name) ;
+		} ;
+
+	/* Truncating gives back the reserved space too. */
+	unlink (filename) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= 44100 ;
+	sfinfo.format		= filetype ;
+	sfinfo.channels		= 2 ;
+
+	file = test_open_file_or_die (filename, SFM_RDWR, &sfinfo, SF_FALSE, __LINE__) ;
+
+	frames = 100 * BUFFER_LEN ;
+	exit_if_true (sf_command (file, SFC_SET_PREALLOCATE, &frames, sizeof (frames)) != SF_TRUE,
+		"\n\nLine %d : sf_command (SFC_SET_PREALLOCATE) failed.\n\n", __LINE__) ;
+	test_writef_int_or_die (file, 0, int_data, BUFFER_LEN / 2, __LINE__) ;
+
+	frames = 100 ;
+	exit_if_true (sf_command (file, SFC_FILE_TRUNCATE, &frames, sizeof (frames)) != 0,
+		"\n\nLine %d : sf_command (SFC_FILE_TRUNCATE) failed.\n\n", __LINE__) ;
+	exit_if_true (file_length (filename) >= reserved,
+		"\n\nLine %d : reserved space not released by truncate.\n\n", __LINE__) ;
+	test_seek_or_die (file, 0, SEEK_END, frames, 2, __LINE__) ;
+	sf_close (file) ;
+
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	exit_if_true (sfinfo.frames != frames,
+		"\n\nLine %d : frames %" PRId64 " should be %" PRId64 ".\n\n", __LINE__, sfinfo.frames, frames) ;
+	sf_close (file) ;
+
+	unlink (ref_name) ;
+	unlink (filename) ;
+	puts ("ok") ;
+} /* prealloc_test */
+
+/*------------------------------------------------------------------------------
+*/
+
+#define	THREADS_FRAMES	40000
+
+static void
+threads_read (const char *filename, int threads, short *data)
+{	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	offset, count ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	/* Block based codecs pad the last block. */
+	exit_if_true (sfinfo.frames < THREADS_FRAMES,
+		"\n\nLine %d : %" PRId64 " frames, should be %d.\n\n", __LINE__, sfinfo.frames, THREADS_FRAMES) ;
+
+	if (threads > 1)
+		exit_if_true (sf_command (file, SFC_SET_DECODER_THREADS, &threads, sizeof (threads)) != SF_TRUE,
+			"\n\nLine %d : sf_command (SFC_SET_DECODER_THREADS) failed.\n\n", __LINE__) ;
+
+	/* Odd sized reads so they straddle the codec's blocks. */
+	for (offset = 0 ; offset < THREADS_FRAMES ; offset += count)
+	{	count = (THREADS_FRAMES - offset < 1237) ? THREADS_FRAMES - offset : 1237 ;
+		test_readf_short_or_die (file, 0, data + 2 * offset, count, __LINE__) ;
+		} ;
+
+	/* Back to the start, then into the middle, when reading ahead. */
+	test_seek_or_die (file, 100, SEEK_SET, 100, 2, __LINE__) ;
+	test_readf_short_or_die (file, 0, data + 2 * THREADS_FRAMES, 3000, __LINE__) ;
+	exit_if_true (memcmp (data + 200, data + 2 * THREADS_FRAMES, 3000 * 2 * sizeof (short)) != 0,
+		"\n\nLine %d : data differs after seeking back.\n\n", __LINE__) ;
+
+	test_seek_or_die (file, 23456, SEEK_SET, 23456, 2, __LINE__) ;
+	test_readf_short_or_die (file, 0, data + 2 * THREADS_FRAMES, 3000, __LINE__) ;
+	exit_if_true (memcmp (data + 2 * 23456, data + 2 * THREADS_FRAMES, 3000 * 2 * sizeof (short)) != 0,
+		"\n\nLine %d : data differs after seeking forward.\n\n", __LINE__) ;
+
+	sf_close (file) ;
+} /* threads_read */
+
+static void
+threads_compare_files (const char *ref_name, const char *filename)
+{	unsigned char	*ref_bytes, *new_bytes ;
+	sf_count_t		length ;
+	FILE			*fp ;
+
+	length = file_length (ref_name) ;
+	exit_if_true (file_length (filename) != length,
+		"\n\nLine %d : file length %" PRId64 " should be %" PRId64 ".\n\n", __LINE__, file_length (filename), length) ;
+
+	ref_bytes = malloc ((size_t) length) ;
+	new_bytes = malloc ((size_t) length) ;
+	exit_if_true (ref_bytes == NULL || new_bytes == NULL, "\n\nLine %d : malloc failed.\n\n", __LINE__) ;
+
+	fp = fopen (ref_name, "rb") ;
+	exit_if_true (fp == NULL || fread (ref_bytes, 1, (size_t) length, fp) != (size_t) length,
+		"\n\nLine %d : could not read '%s'.\n\n", __LINE__, ref_name) ;
+	fclose (fp) ;
+	fp = fopen (filename, "rb") ;
+	exit_if_true (fp == NULL || fread (new_bytes, 1, (size_t) length, fp) != (size_t) length,
+		"\n\nLine %d : could not read '%s'.\n\n", __LINE__, filename) ;
+	fclose (fp) ;
+
+	exit_if_true (memcmp (ref_bytes, new_bytes, (size_t) length) != 0,
+		"\n\nLine %d : '%s' differs from '%s'.\n\n", __LINE__, filename, ref_name) ;
+
+	free (ref_bytes) ;
+	free (new_bytes) ;
+} /* threads_compare_files */
+
+static void
+threads_test (const char *filename, int filetype)
+{	static short data [2 * THREADS_FRAMES], ref [2 * (THREADS_FRAMES + 3000)], in [2 * (THREADS_FRAMES + 3000)] ;
+	char		ref_name [64] ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	length ;
+	int			k, pass, threads = 3, encoder_threads = SF_FALSE, decoder_threads, is_alac ;
+
+	print_test_name ("threads_test", filename) ;
+
+	is_alac = (filetype & SF_FORMAT_SUBMASK) >= SF_FORMAT_ALAC_16 && (filetype & SF_FORMAT_SUBMASK) <= SF_FORMAT_ALAC_32 ;
+
+	snprintf (ref_name, sizeof (ref_name), "ref_%s", filename) ;
+
+	for (k = 0 ; k < THREADS_FRAMES ; k++)
+	{	data [2 * k] = lrint (12000 * sin (0.013 * k)) + (k * 7919) % 301 ;
+		data [2 * k + 1] = lrint (9000 * sin (0.002 * k)) - (k * 4409) % 97 ;
+		} ;
+
+	/*
+	**	Write the file on the calling thread and on worker threads. Written
+	**	packets must be on disk after sf_write_sync () in both cases.
+	*/
+	for (pass = 0 ; pass < 2 ; pass++)
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		sfinfo.samplerate	= 44100 ;
+		sfinfo.format		= filetype ;
+		sfinfo.channels		= 2 ;
+
+		file = test_open_file_or_die (pass ? filename : ref_name, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+		if (pass == 1)
+			encoder_threads = sf_command (file, SFC_SET_ENCODER_THREADS, &threads, sizeof (threads)) ;
+
+		length = file_length (pass ? filename : ref_name) ;
+
+		test_writef_short_or_die (file, 0, data, THREADS_FRAMES / 2, __LINE__) ;
+		sf_write_sync (file) ;
+		exit_if_true (file_length (pass ? filename : ref_name) <= length,
+			"\n\nLine %d : nothing written by sf_write_sync ().\n\n", __LINE__) ;
+
+		test_writef_short_or_die (file, 0, data + THREADS_FRAMES, THREADS_FRAMES / 2, __LINE__) ;
+		sf_close (file) ;
+		} ;
+
+	threads_read (ref_name, 1, ref) ;
+
+	/* Apart from ALAC, the encoders write exactly the same file on worker threads. */
+	if (encoder_threads && ! is_alac)
+		threads_compare_files (ref_name, filename) ;
+
+	/* The threaded encoder may compress differently, but must decode the same. */
+	threads_read (filename, 1, in) ;
+	exit_if_true (memcmp (ref, in, sizeof (data)) != 0,
+		"\n\nLine %d : '%s' does not decode the same as '%s'.\n\n", __LINE__, filename, ref_name) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	decoder_threads = sf_command (file, SFC_SET_DECODER_THREADS, &threads, sizeof (threads)) ;
+	sf_close (file) ;
+
+	if (decoder_threads)
+	{	threads_read (filename, threads, in) ;
+		exit_if_true (memcmp (ref, in, sizeof (data)) != 0,
+			"\n\nLine %d : decoding on worker threads gives different data.\n\n", __LINE__) ;
+		} ;
+
+	if (is_alac)
+		exit_if_true (memcmp (ref, data, sizeof (data)) != 0,
+			"\n\nLine %d : lossless data differs.\n\n", __LINE__) ;
+
+	unlink (ref_name) ;
+	unlink (filename) ;
+
+	puts (encoder_threads || decoder_threads ? "ok" : "no threads") ;
+} /* threads_test */
+
+/* GSM 6.10 is mono only and can't seek, so it gets a write only test. */
+static void
+threads_gsm_test (const char *filename, int filetype)
+{	static short data [THREADS_FRAMES] ;
+	char		ref_name [64] ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	length ;
+	int			k, pass, threads = 4, encoder_threads = SF_FALSE ;
+
+	print_test_name ("threads_gsm_test", filename) ;
+
+	snprintf (ref_name, sizeof (ref_name), "ref_%s", filename) ;
+
+	for (k = 0 ; k < THREADS_FRAMES ; k++)
+		data [k] = lrint (12000 * sin (0.013 * k)) + (k * 7919) % 301 ;
+
+	for (pass = 0 ; pass < 2 ; pass++)
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		sfinfo.samplerate	= 8000 ;
+		sfinfo.format		= filetype ;
+		sfinfo.channels		= 1 ;
+
+		file = test_open_file_or_die (pass ? filename : ref_name, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+		if (pass == 1)
+			encoder_threads = sf_command (file, SFC_SET_ENCODER_THREADS, &threads, sizeof (threads)) ;
+
+		length = file_length (pass ? filename : ref_name) ;
+
+		/* Not a whole number of blocks, so sf_write_sync () has a partly filled batch. */
+		test_write_short_or_die (file, 0, data, 12345, __LINE__) ;
+		sf_write_sync (file) ;
+		exit_if_true (file_length (pass ? filename : ref_name) <= length,
+			"\n\nLine %d : nothing written by sf_write_sync ().\n\n", __LINE__) ;
+
+		test_write_short_or_die (file, 0, data + 12345, THREADS_FRAMES - 12345, __LINE__) ;
+		sf_close (file) ;
+		} ;
+
+	threads_compare_files (ref_name, filename) ;
+
+	unlink (ref_name) ;
+	unlink (filename) ;
+
+	puts (encoder_threads ? "ok" : "no threads") ;
+} /* threads_gsm_test */
+
+/*------------------------------------------------------------------------------
+*/
+
+#define	READ_AHEAD_ITEMS	(2 * THREADS_FRAMES + 20000)
+
+/*
+**	With read ahead a read only returns the frames already decoded, maybe none.
+**	Keep reading, as a real time caller would on its next callback, until all
+**	the frames are there or the read position reaches the end of the file.
+*/
+static void
+read_ahead_wait (int tries, int line)
+{
+	exit_if_true (tries > 20000, "\n\nLine %d : the read ahead worker has stopped.\n\n", line) ;
+
+#if OS_IS_WIN32
+	Sleep (1) ;
+#else
+	usleep (500) ;
+#endif
+} /* read_ahead_wait */
+
+static sf_count_t
+read_ahead_readf_short (SNDFILE *file, const SF_INFO *sfinfo, short *ptr, sf_count_t frames, int line)
+{	sf_count_t count, total = 0 ;
+	int tries = 0 ;
+
+	while (total < frames && sf_seek (file, 0, SEEK_CUR) < sfinfo->frames)
+	{	if ((count = sf_readf_short (file, ptr + total * sfinfo->channels, frames - total)) == 0)
+			read_ahead_wait (++tries, line) ;
+		total += count ;
+		} ;
+
+	return total ;
+} /* read_ahead_readf_short */
+
+static sf_count_t
+read_ahead_readf_int (SNDFILE *file, const SF_INFO *sfinfo, int *ptr, sf_count_t frames, int line)
+{	sf_count_t count, total = 0 ;
+	int tries = 0 ;
+
+	while (total < frames && sf_seek (file, 0, SEEK_CUR) < sfinfo->frames)
+	{	if ((count = sf_readf_int (file, ptr + total * sfinfo->channels, frames - total)) == 0)
+			read_ahead_wait (++tries, line) ;
+		total += count ;
+		} ;
+
+	return total ;
+} /* read_ahead_readf_int */
+
+/*
+**	Read the file with a mix of reads, seeks and commands, storing everything
+**	read and every return value in data so runs can be compared.
+*/
+static int
+read_ahead_run (const char *filename, int frames, int *data)
+{	static short sbuf [2 * 1237] ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	offset, count ;
+	double		max ;
+	int			k, indx = 0, accepted ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+
+	accepted = sf_command (file, SFC_SET_READ_AHEAD, &frames, sizeof (frames)) ;
+
+	for (offset = 0 ; offset < 15000 ; offset += 1237)
+	{	data [indx++] = (int) read_ahead_readf_short (file, &sfinfo, sbuf, 1237, __LINE__) ;
+		for (k = 0 ; k < 2 * 1237 ; k++)
+			data [indx++] = sbuf [k] ;
+		} ;
+
+	/* A different type, then back to the start. */
+	count = read_ahead_readf_int (file, &sfinfo, data + indx + 1, 3000, __LINE__) ;
+	data [indx] = (int) count ;
+	indx += 1 + 2 * 3000 ;
+	data [indx++] = (int) sf_seek (file, 100, SEEK_SET) ;
+	data [indx++] = (int) read_ahead_readf_short (file, &sfinfo, sbuf, 1000, __LINE__) ;
+	for (k = 0 ; k < 2 * 1000 ; k++)
+		data [indx++] = sbuf [k] ;
+
+	/* Commands which use the codec stop the worker, reading carries on from the same place. */
+	sf_command (file, SFC_SET_NORM_FLOAT, NULL, SF_TRUE) ;
+	sf_command (file, SFC_CALC_SIGNAL_MAX, &max, sizeof (max)) ;
+	data [indx++] = (int) lrint (max) ;
+	data [indx++] = sf_command (file, SFC_GET_NORM_FLOAT, NULL, 0) ;
+	data [indx++] = (int) sf_seek (file, 0, SEEK_CUR) ;
+
+	do
+	{	count = read_ahead_readf_short (file, &sfinfo, sbuf, 1237, __LINE__) ;
+		data [indx++] = (int) count ;
+		for (k = 0 ; k < 2 * count ; k++)
+			data [indx++] = sbuf [k] ;
+		}
+	while (count > 0 && indx < READ_AHEAD_ITEMS - 2 * 1237 - 1) ;
+
+	data [indx++] = (int) sf_seek (file, 0, SEEK_CUR) ;
+	data [indx++] = sf_error (file) ;
+
+	exit_if_true (indx > READ_AHEAD_ITEMS, "\n\nLine %d : indx %d too big.\n\n", __LINE__, indx) ;
+
+	sf_close (file) ;
+
+	return accepted ;
+} /* read_ahead_run */
+
+static void
+read_ahead_test (const char *filename, int filetype)
+{	static short data [2 * THREADS_FRAMES] ;
+	static int	ref [READ_AHEAD_ITEMS], in [READ_AHEAD_ITEMS] ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	int			k, frames, accepted = SF_FALSE ;
+
+	print_test_name ("read_ahead_test", filename) ;
+
+	for (k = 0 ; k < THREADS_FRAMES ; k++)
+	{	data [2 * k] = lrint (12000 * sin (0.013 * k)) + (k * 7919) % 301 ;
+		data [2 * k + 1] = lrint (9000 * sin (0.002 * k)) - (k * 4409) % 97 ;
+		} ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= 48000 ;
+	sfinfo.format		= filetype ;
+	sfinfo.channels		= 2 ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+	test_writef_short_or_die (file, 0, data, THREADS_FRAMES, __LINE__) ;
+	sf_close (file) ;
+
+	memset (ref, 0, sizeof (ref)) ;
+	read_ahead_run (filename, 0, ref) ;
+
+	/* Chunks smaller and larger than the reads. */
+	for (frames = 100 ; frames <= 40000 ; frames *= 20)
+	{	memset (in, 0, sizeof (in)) ;
+		accepted = read_ahead_run (filename, frames, in) ;
+		if (accepted == SF_FALSE)
+			break ;
+
+		exit_if_true (memcmp (ref, in, sizeof (ref)) != 0,
+			"\n\nLine %d : reading %d frames ahead gives different results.\n\n", __LINE__, frames) ;
+		} ;
+
+	unlink (filename) ;
+
+	puts (accepted ? "ok" : "no threads") ;
+} /* read_ahead_test */
+
+/*------------------------------------------------------------------------------
+*/
+
+/*
+**	Write the same calls with and without SFC_SET_ASYNC_WRITE. The files must
+**	be identical and sf_write_sync () must get the queued data to disk.
+*/
+static void
+async_write_test (const char *filename, int filetype, int channels)
+{	static short	data [2 * THREADS_FRAMES] ;
+	static int		idata [2 * THREADS_FRAMES] ;
+	static float	fdata [2 * THREADS_FRAMES] ;
+	char		ref_name [64] ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	length, frames ;
+	int			k, pass, blocks = 3, accepted = SF_FALSE ;
+
+	print_test_name ("async_write_test", filename) ;
+
+	snprintf (ref_name, sizeof (ref_name), "ref_%s", filename) ;
+
+	for (k = 0 ; k < channels * THREADS_FRAMES ; k++)
+	{	data [k] = lrint (12000 * sin (0.013 * k)) + (k * 7919) % 301 ;
+		idata [k] = data [k] * 0x10000 ;
+		fdata [k] = data [k] / 32768.0 ;
+		} ;
+
+	for (pass = 0 ; pass < 2 ; pass++)
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		sfinfo.samplerate	= (filetype & SF_FORMAT_SUBMASK) == SF_FORMAT_GSM610 ? 8000 : 44100 ;
+		sfinfo.format		= filetype ;
+		sfinfo.channels		= channels ;
+
+		file = test_open_file_or_die (pass ? filename : ref_name, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+		if (pass == 1)
+			accepted = sf_command (file, SFC_SET_ASYNC_WRITE, &blocks, sizeof (blocks)) ;
+
+		/* Writes smaller than a block, and a change of type part way through one. */
+		for (frames = 0 ; frames + 173 <= 10000 ; frames += 173)
+			test_writef_short_or_die (file, 0, data + channels * frames, 173, __LINE__) ;
+		test_writef_float_or_die (file, 0, fdata + channels * frames, 5000, __LINE__) ;
+		frames += 5000 ;
+
+		/* Everything written so far, not just the full blocks, is on disk. */
+		sf_write_sync (file) ;
+		if (pass == 0)
+			length = file_length (ref_name) ;
+		else
+			exit_if_true (file_length (filename) != length,
+				"\n\nLine %d : %" PRId64 " bytes after sf_write_sync (), should be %" PRId64 ".\n\n", __LINE__,
+				(int64_t) file_length (filename), (int64_t) length) ;
+		exit_if_true (sf_error (file) != 0, "\n\nLine %d : %s\n\n", __LINE__, sf_strerror (file)) ;
+
+		/* Writes larger than a block. */
+		test_writef_int_or_die (file, 0, idata + channels * frames, THREADS_FRAMES - frames, __LINE__) ;
+
+		exit_if_true (sf_close (file) != 0, "\n\nLine %d : sf_close failed.\n\n", __LINE__) ;
+		} ;
+
+	threads_compare_files (ref_name, filename) ;
+
+	unlink (ref_name) ;
+	unlink (filename) ;
+
+	puts (accepted ? "ok" : "no threads") ;
+} /* async_write_test */
+
+/* A virtual file which only has room for a few blocks. */
+typedef struct
+{	sf_count_t offset, length ;
+	unsigned char data [40000] ;
+} ASYNC_VIO ;
+
+static sf_count_t
+async_vio_get_filelen (void *user_data)
+{	return ((ASYNC_VIO *) user_data)->length ;
+} /* async_vio_get_filelen */
+
+static sf_count_t
+async_vio_seek (sf_count_t offset, int whence, void *user_data)
+{	ASYNC_VIO *vf = (ASYNC_VIO *) user_data ;
+
+	if (whence == SEEK_CUR)
+		offset += vf->offset ;
+	else if (whence == SEEK_END)
+		offset += vf->length ;
+
+	return (vf->offset = offset) ;
+} /* async_vio_seek */
+
+static sf_count_t
+async_vio_read (void *ptr, sf_count_t count, void *user_data)
+{	ASYNC_VIO *vf = (ASYNC_VIO *) user_data ;
+
+	if (vf->offset + count > vf->length)
+		count = vf->length - vf->offset ;
+
+	memcpy (ptr, vf->data + vf->offset, (size_t) count) ;
+	vf->offset += count ;
+
+	return count ;
+} /* async_vio_read */
+
+static sf_count_t
+async_vio_write (const void *ptr, sf_count_t count, void *user_data)
+{	ASYNC_VIO *vf = (ASYNC_VIO *) user_data ;
+
+	if (vf->offset >= SIGNED_SIZEOF (vf->data))
+		return 0 ;
+
+	if (vf->offset + count > SIGNED_SIZEOF (vf->data))
+		count = sizeof (vf->data) - vf->offset ;
+
+	memcpy (vf->data + vf->offset, ptr, (size_t) count) ;
+	vf->offset += count ;
+
+	if (vf->offset > vf->length)
+		vf->length = vf->offset ;
+
+	return count ;
+} /* async_vio_write */
+
+static sf_count_t
+async_vio_tell (void *user_data)
+{	return ((ASYNC_VIO *) user_data)->offset ;
+} /* async_vio_tell */
+
+/* Writes which fail on the worker are reported later. */
+static void
+async_write_error_test (void)
+{	static ASYNC_VIO	vio_data ;
+	static short		data [2000] ;
+	SF_VIRTUAL_IO		vio ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	int			k, blocks = 2 ;
+
+	print_test_name ("async_write_error_test", "virtual file") ;
+
+	vio.get_filelen = async_vio_get_filelen ;
+	vio.seek = async_vio_seek ;
+	vio.read = async_vio_read ;
+	vio.write = async_vio_write ;
+	vio.tell = async_vio_tell ;
+
+	memset (&vio_data, 0, sizeof (vio_data)) ;
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= 44100 ;
+	sfinfo.format		= SF_FORMAT_WAV | SF_FORMAT_PCM_16 ;
+	sfinfo.channels		= 1 ;
+
+	if ((file = sf_open_virtual (&vio, SFM_WRITE, &sfinfo, &vio_data)) == NULL)
+	{	printf ("\n\nLine %d : sf_open_virtual failed : %s\n\n", __LINE__, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	if (sf_command (file, SFC_SET_ASYNC_WRITE, &blocks, sizeof (blocks)) == SF_FALSE)
+	{	sf_close (file) ;
+		puts ("no threads") ;
+		return ;
+		} ;
+
+	/* Nothing is lost until the worker runs out of room, which the caller can't see yet. */
+	for (k = 0 ; k < 8 ; k++)
+		test_write_short_or_die (file, 0, data, ARRAY_LEN (data), __LINE__) ;
+
+	sf_write_sync (file) ;
+	exit_if_true (sf_error (file) != 0, "\n\nLine %d : %s\n\n", __LINE__, sf_strerror (file)) ;
+
+	/* Keep writing until a write reports the failure. */
+	for (k = 0 ; k < 100 ; k++)
+		if (sf_write_short (file, data, ARRAY_LEN (data)) != ARRAY_LEN (data))
+			break ;
+
+	exit_if_true (k == 100, "\n\nLine %d : no write failed.\n\n", __LINE__) ;
+	exit_if_true (sf_error (file) == 0, "\n\nLine %d : no error after a failed write.\n\n", __LINE__) ;
+
+	/* The failure sticks. */
+	sf_write_sync (file) ;
+	exit_if_true (sf_error (file) == 0, "\n\nLine %d : sf_write_sync () cleared the error.\n\n", __LINE__) ;
+	exit_if_true (sf_write_short (file, data, ARRAY_LEN (data)) != 0,
+		"\n\nLine %d : write after a failure should return 0.\n\n", __LINE__) ;
+
+	exit_if_true (sf_close (file) == 0, "\n\nLine %d : sf_close should report the lost data.\n\n", __LINE__) ;
+
+	puts ("ok") ;
+} /* async_write_error_test */
+
+/* A block which could not be written by the GSM 6.10 pipe makes a write come up short. */
+static void
+threads_gsm_error_test (void)
+{	static ASYNC_VIO	vio_data ;
+	static short		data [1600] ;
+	SF_VIRTUAL_IO		vio ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	int			k, threads = 2 ;
+
+	print_test_name ("threads_gsm_error_test", "virtual file") ;
+
+	vio.get_filelen = async_vio_get_filelen ;
+	vio.seek = async_vio_seek ;
+	vio.read = async_vio_read ;
+	vio.write = async_vio_write ;
+	vio.tell = async_vio_tell ;
+
+	memset (&vio_data, 0, sizeof (vio_data)) ;
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= 8000 ;
+	sfinfo.format		= SF_FORMAT_RAW | SF_FORMAT_GSM610 ;
+	sfinfo.channels		= 1 ;
+
+	if ((file = sf_open_virtual (&vio, SFM_WRITE, &sfinfo, &vio_data)) == NULL)
+	{	printf ("\n\nLine %d : sf_open_virtual failed : %s\n\n", __LINE__, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	if (sf_command (file, SFC_SET_ENCODER_THREADS, &threads, sizeof (threads)) == SF_FALSE)
+	{	sf_close (file) ;
+		puts ("no threads") ;
+		return ;
+		} ;
+
+	for (k = 0 ; k < 1000 ; k++)
+		if (sf_write_short (file, data, ARRAY_LEN (data)) != ARRAY_LEN (data))
+			break ;
+
+	exit_if_true (k == 1000, "\n\nLine %d : no write came up short.\n\n", __LINE__) ;
+
+	sf_close (file) ;
+
+	puts ("ok") ;
+} /* threads_gsm_error_test */
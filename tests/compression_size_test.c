@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #else
@@ -165,7 +166,59 @@ compression_size_test (int format, const char * filename)
 	unlink (q6_fname) ;
 } /* compression_size_test */
 
+static void
+flac_threads_test (const char * filename)
+{	/*
+	**	Encode a file using several encoder threads and make sure it decodes
+	**	back to exactly the data written.
+	*/
+	static short short_out [DATA_LENGTH], short_in [DATA_LENGTH] ;
+	SNDFILE *file ;
+	SF_INFO sfinfo ;
+	int threads = 4 ;
+	int k ;
+
+	print_test_name (__func__, filename) ;
 
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.format = SF_FORMAT_FLAC | SF_FORMAT_PCM_16 ;
+	sfinfo.channels = 1 ;
+	sfinfo.samplerate = SAMPLE_RATE ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+
+	if (sf_command (file, SFC_SET_ENCODER_THREADS, &threads, sizeof (threads)) == SF_FALSE)
+	{	sf_close (file) ;
+		unlink (filename) ;
+		puts ("no threads") ;
+		return ;
+		} ;
+
+	for (k = 0 ; k < DATA_LENGTH ; k++)
+		short_out [k] = (short) (k * 7919 + (k >> 5) * 31) ;
+
+	for (k = 0 ; k < 5 ; k++)
+		test_write_short_or_die (file, 0, short_out, ARRAY_LEN (short_out), __LINE__) ;
+
+	sf_close (file) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+
+	exit_if_true (sfinfo.frames != 5 * DATA_LENGTH,
+		"\n\nLine %d : frame count %" PRId64 " should be %d.\n\n", __LINE__, sfinfo.frames, 5 * DATA_LENGTH) ;
+
+	for (k = 0 ; k < 5 ; k++)
+	{	test_read_short_or_die (file, 0, short_in, ARRAY_LEN (short_in), __LINE__) ;
+		exit_if_true (memcmp (short_in, short_out, sizeof (short_in)) != 0,
+			"\n\nLine %d : data mismatch in block %d.\n\n", __LINE__, k) ;
+		} ;
+
+	sf_close (file) ;
+
+	puts ("ok") ;
+	unlink (filename) ;
+} /* flac_threads_test */
 
 int
 main (int argc, char *argv [])
@@ -198,6 +251,7 @@ main (int argc, char *argv [])
 
 	if (all_tests || strcmp (argv [1], "flac") == 0)
 	{	compression_size_test (SF_FORMAT_FLAC | SF_FORMAT_PCM_16, "pcm16.flac") ;
+		flac_threads_test ("threads.flac") ;
 		tests ++ ;
 		} ;
 
@@ -101,6 +101,21 @@ dwvw_test (const char *filename, int format, int bit_width)
 			} ;
 		} ;
 
+	/* Random access seeks, both forwards and backwards. */
+	{	static const int positions [] = { 5000, 100, 9999, 4096, 4095, 8193, 0, 7000, 1 } ;
+		int m, readval ;
+
+		for (m = 0 ; m < (int) ARRAY_LEN (positions) ; m++)
+		{	test_seek_or_die (file, positions [m], SEEK_SET, positions [m], sfinfo.channels, __LINE__) ;
+			test_read_int_or_die (file, 0, &readval, 1, __LINE__) ;
+			if (readval != write_buf [positions [m]])
+			{	printf ("\n\nLine %d : Seek to %d : %d != %d\n", __LINE__, positions [m],
+					write_buf [positions [m]] >> (32 - bit_width), readval >> (32 - bit_width)) ;
+				exit (1) ;
+				} ;
+			} ;
+		} ;
+
 	sf_close (file) ;
 
 	unlink (filename) ;
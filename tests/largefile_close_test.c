@@ -0,0 +1,189 @@
+/*
+** Copyright (C) 2006-2017 Erik de Castro Lopo <erikd@mega-nerd.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*==========================================================================
+** Check that closing a file which has grown past 4 gigabytes only rewrites
+** the header and never moves the audio data. The files are sparse, the
+** writer seeks past the end of the file before writing the second block.
+**
+** Like largefile_test, this is built but not run by the test suite, because
+** on file systems without sparse files it writes gigabytes of data.
+*/
+
+#include "sfconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#if OS_IS_WIN32
+
+int
+main (void)
+{
+	puts ("    largefile_close_test : this test doesn't work on this OS.") ;
+	return 0 ;
+} /* main */
+
+#else
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <sndfile.h>
+
+#include "utils.h"
+
+#define	CHANNELS		8
+#define	BUFFER_FRAMES	4096
+#define	PROBE_LEN		4096
+
+/* Where the second block of data goes, far enough for a 64 bit header. */
+#define	LARGE_OFFSET	(((sf_count_t) 5) << 30)
+
+enum
+{	STAY_SMALL,
+	GROW,
+	GROW_SHRINK
+} ;
+
+static void	close_test (const char *filename, int format, int downgrade, int mode, const char *marker, const char *chunk) ;
+static sf_count_t find_data (const char *filename, const short *data, char *header) ;
+static void	remove_file (void) ;
+
+static short data_out [CHANNELS * BUFFER_FRAMES] ;
+static short data_in [CHANNELS * BUFFER_FRAMES] ;
+
+/* Removed at exit, so a failed check doesn't leave a huge file behind. */
+static const char *current_file = NULL ;
+
+int
+main (void)
+{	int k ;
+
+	/* Both bytes of each sample are the same, so the raw file search is endian agnostic. */
+	for (k = 0 ; k < CHANNELS * BUFFER_FRAMES ; k++)
+		data_out [k] = ((k % 127) + 1) * 0x101 ;
+
+	atexit (remove_file) ;
+
+	close_test ("large_rf64.rf64", SF_FORMAT_RF64, SF_FALSE, GROW, "RF64", "ds64") ;
+	close_test ("small_downgrade.rf64", SF_FORMAT_RF64, SF_TRUE, STAY_SMALL, "RIFF", "JUNK") ;
+	close_test ("large_downgrade.rf64", SF_FORMAT_RF64, SF_TRUE, GROW, "RF64", "ds64") ;
+	close_test ("shrunk_downgrade.rf64", SF_FORMAT_RF64, SF_TRUE, GROW_SHRINK, "RIFF", "JUNK") ;
+	close_test ("large_w64.w64", SF_FORMAT_W64, SF_FALSE, GROW, "riff", NULL) ;
+
+	return 0 ;
+} /* main */
+
+/*==============================================================================
+*/
+
+static void
+close_test (const char *filename, int format, int downgrade, int mode, const char *marker, const char *chunk)
+{	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	offset, frames ;
+	char		header [PROBE_LEN] ;
+
+	print_test_name ("largefile_close_test", filename) ;
+
+	current_file = filename ;
+
+	sf_info_setup (&sfinfo, format | SF_FORMAT_PCM_16, 48000, CHANNELS) ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_TRUE, __LINE__) ;
+	if (downgrade)
+		sf_command (file, SFC_RF64_AUTO_DOWNGRADE, NULL, SF_TRUE) ;
+
+	test_writef_short_or_die (file, 0, data_out, BUFFER_FRAMES, __LINE__) ;
+
+	/* The header is on disk now, note where the audio starts. */
+	offset = find_data (filename, data_out, header) ;
+	exit_if_true (offset < 0, "\n\nLine %d : audio data not found in first %d bytes.\n", __LINE__, PROBE_LEN) ;
+
+	frames = BUFFER_FRAMES ;
+	if (mode != STAY_SMALL)
+	{	frames = LARGE_OFFSET / (CHANNELS * sizeof (short)) ;
+		test_seek_or_die (file, frames, SEEK_SET, frames, CHANNELS, __LINE__) ;
+		test_writef_short_or_die (file, 0, data_out, BUFFER_FRAMES, __LINE__) ;
+		frames += BUFFER_FRAMES ;
+		} ;
+
+	if (mode == GROW_SHRINK)
+	{	frames = 2 * BUFFER_FRAMES ;
+		exit_if_true (sf_command (file, SFC_FILE_TRUNCATE, &frames, sizeof (frames)),
+				"\n\nLine %d : SFC_FILE_TRUNCATE failed.\n", __LINE__) ;
+		} ;
+
+	sf_close (file) ;
+
+	exit_if_true (find_data (filename, data_out, header) != offset,
+			"\n\nLine %d : audio data moved from offset %d.\n", __LINE__, (int) offset) ;
+
+	exit_if_true (memcmp (header, marker, 4) != 0,
+			"\n\nLine %d : file marker is '%.4s', should be '%s'.\n", __LINE__, header, marker) ;
+	exit_if_true (chunk != NULL && memcmp (header + 12, chunk, 4) != 0,
+			"\n\nLine %d : first chunk is '%.4s', should be '%s'.\n", __LINE__, header + 12, chunk) ;
+
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+
+	exit_if_true (sfinfo.frames != frames,
+			"\n\nLine %d : frame count %" PRId64 " should be %" PRId64 ".\n", __LINE__, sfinfo.frames, frames) ;
+
+	test_readf_short_or_die (file, 0, data_in, BUFFER_FRAMES, __LINE__) ;
+	compare_short_or_die (data_out, data_in, CHANNELS * BUFFER_FRAMES, __LINE__) ;
+
+	sf_close (file) ;
+
+	remove_file () ;
+	puts ("ok") ;
+} /* close_test */
+
+static void
+remove_file (void)
+{
+	if (current_file != NULL)
+		unlink (current_file) ;
+	current_file = NULL ;
+} /* remove_file */
+
+static sf_count_t
+find_data (const char *filename, const short *data, char *header)
+{	FILE		*file ;
+	size_t		len, k ;
+
+	if ((file = fopen (filename, "rb")) == NULL)
+	{	printf ("\n\nLine %d : fopen ('%s') failed.\n", __LINE__, filename) ;
+		exit (1) ;
+		} ;
+
+	memset (header, 0, PROBE_LEN) ;
+	len = fread (header, 1, PROBE_LEN, file) ;
+	fclose (file) ;
+
+	for (k = 0 ; k + 64 <= len ; k++)
+		if (memcmp (header + k, data, 64) == 0)
+			return k ;
+
+	return -1 ;
+} /* find_data */
+
+#endif
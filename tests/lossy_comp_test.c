@@ -55,6 +55,7 @@ static	void	sdlcomp_test_float	(const char *filename, int filetype, int chan, do
 static	void	sdlcomp_test_double	(const char *filename, int filetype, int chan, double margin) ;
 
 static void		read_raw_test (const char *filename, int filetype, int chan) ;
+static void		msadpcm_stereo_test (const char *filename) ;
 
 static	int		error_function (double data, double orig, double margin) ;
 static	int		decay_response (int k) ;
@@ -164,6 +165,8 @@ main (int argc, char *argv [])
 		sdlcomp_test_float	("msadpcm.wav", SF_FORMAT_WAV | SF_FORMAT_MS_ADPCM, 2, 0.36) ;
 		sdlcomp_test_double	("msadpcm.wav", SF_FORMAT_WAV | SF_FORMAT_MS_ADPCM, 2, 0.36) ;
 
+		msadpcm_stereo_test	("msadpcm_stereo.wav") ;
+
 		test_count++ ;
 		} ;
 
@@ -1455,7 +1458,7 @@ channels = 1 ;
 		{	test_readf_short_or_die (file, m, data, datalen / 7, __LINE__) ;
 
 			smoothed_diff_short (data, datalen / 7) ;
-			memcpy (smooth, orig + m * datalen / 7, datalen / 7 * sizeof (short)) ;
+			memcpy (smooth, orig + m * (datalen / 7), datalen / 7 * sizeof (short)) ;
 			smoothed_diff_short (smooth, datalen / 7) ;
 
 			for (k = 0 ; k < datalen / 7 ; k++)
@@ -1662,7 +1665,7 @@ channels = 1 ;
 		{	test_readf_int_or_die (file, m, data, datalen / 7, __LINE__) ;
 
 			smoothed_diff_int (data, datalen / 7) ;
-			memcpy (smooth, orig + m * datalen / 7, datalen / 7 * sizeof (int)) ;
+			memcpy (smooth, orig + m * (datalen / 7), datalen / 7 * sizeof (int)) ;
 			smoothed_diff_int (smooth, datalen / 7) ;
 
 			for (k = 0 ; k < datalen / 7 ; k++)
@@ -1859,7 +1862,7 @@ printf ("** fix this ** ") ;
 		{	test_read_float_or_die (file, 0, data, datalen / 7, __LINE__) ;
 
 			smoothed_diff_float (data, datalen / 7) ;
-			memcpy (smooth, orig + m * datalen / 7, datalen / 7 * sizeof (float)) ;
+			memcpy (smooth, orig + m * (datalen / 7), datalen / 7 * sizeof (float)) ;
 			smoothed_diff_float (smooth, datalen / 7) ;
 
 			for (k = 0 ; k < datalen / 7 ; k++)
@@ -2051,7 +2054,7 @@ channels = 1 ;
 		{	test_read_double_or_die (file, m, data, datalen / 7, __LINE__) ;
 
 			smoothed_diff_double (data, datalen / 7) ;
-			memcpy (smooth, orig + m * datalen / 7, datalen / 7 * sizeof (double)) ;
+			memcpy (smooth, orig + m * (datalen / 7), datalen / 7 * sizeof (double)) ;
 			smoothed_diff_double (smooth, datalen / 7) ;
 
 			for (k = 0 ; k < datalen / 7 ; k++)
@@ -2198,6 +2201,78 @@ read_raw_test (const char *filename, int filetype, int channels)
 	printf ("ok\n") ;
 } /* read_raw_test */
 
+static void
+msadpcm_stereo_test (const char *filename)
+{	SNDFILE			*file ;
+	SF_INFO			sfinfo ;
+	FILE			*fp ;
+	unsigned char	*header ;
+	sf_count_t		frames = 1000 ;
+	size_t			len, k ;
+	short			*orig, *data ;
+
+	print_test_name ("msadpcm_stereo_test", filename) ;
+
+	/*
+	**	A silent left channel and a ramp on the right. Each channel must get
+	**	its own predictor : the ramp is predicted exactly by the second
+	**	coefficient pair, so the whole file decodes without error.
+	*/
+	orig = orig_buffer.s ;
+	data = data_buffer.s ;
+
+	for (k = 0 ; k < (size_t) frames ; k++)
+	{	orig [2 * k] = 0 ;
+		orig [2 * k + 1] = 40 * k - 20000 ;
+		} ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= SAMPLE_RATE ;
+	sfinfo.channels		= 2 ;
+	sfinfo.format		= SF_FORMAT_WAV | SF_FORMAT_MS_ADPCM ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+	test_writef_short_or_die (file, 0, orig, frames, __LINE__) ;
+	sf_close (file) ;
+
+	/* The first block header starts with the predictor of each channel. */
+	if ((fp = fopen (filename, "rb")) == NULL)
+	{	printf ("\n\nLine %d : fopen ('%s') failed.\n\n", __LINE__, filename) ;
+		exit (1) ;
+		} ;
+	header = (unsigned char *) data_buffer.c ;
+	len = fread (header, 1, 1024, fp) ;
+	fclose (fp) ;
+
+	for (k = 12 ; k + 10 < len ; k++)
+		if (memcmp (header + k, "data", 4) == 0)
+			break ;
+
+	if (k + 10 >= len)
+	{	printf ("\n\nLine %d : no data chunk found.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	if (header [k + 8] != 0 || header [k + 9] != 1)
+	{	printf ("\n\nLine %d : block predictors are %d, %d (should be 0, 1).\n\n", __LINE__, header [k + 8], header [k + 9]) ;
+		exit (1) ;
+		} ;
+
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	test_readf_short_or_die (file, 0, data, frames, __LINE__) ;
+	sf_close (file) ;
+
+	for (k = 0 ; k < 2 * (size_t) frames ; k++)
+		if (data [k] != orig [k])
+		{	printf ("\n\nLine %d : channel %d of frame %d decoded as %d (should be %d).\n\n",
+					__LINE__, (int) (k & 1), (int) (k / 2), data [k], orig [k]) ;
+			exit (1) ;
+			} ;
+
+	unlink (filename) ;
+	printf ("ok\n") ;
+} /* msadpcm_stereo_test */
+
 /*========================================================================================
 **	Auxiliary functions
 */
@@ -40,6 +40,7 @@
 
 static	void	test_float_peak	(const char *filename, int filetype) ;
 static	void	read_write_peak_test	(const char *filename, int filetype) ;
+static	void	auto_update_peak_test	(const char *filename, int filetype) ;
 
 static void		check_logged_peaks (char *buffer) ;
 
@@ -73,6 +74,9 @@ main (int argc, char *argv [])
 
 		read_write_peak_test ("rw_peak.wav", SF_FORMAT_WAV | SF_FORMAT_FLOAT) ;
 		read_write_peak_test ("rw_peak.wavex", SF_FORMAT_WAVEX | SF_FORMAT_FLOAT) ;
+
+		auto_update_peak_test ("auto_peak.wav", SF_FORMAT_WAV | SF_FORMAT_FLOAT) ;
+		auto_update_peak_test ("auto_peak.rifx", SF_ENDIAN_BIG | SF_FORMAT_WAV | SF_FORMAT_FLOAT) ;
 		test_count++ ;
 		} ;
 
@@ -80,6 +84,8 @@ main (int argc, char *argv [])
 	{	test_float_peak	("peak_float.aiff", SF_FORMAT_AIFF | SF_FORMAT_FLOAT) ;
 
 		read_write_peak_test ("rw_peak.aiff", SF_FORMAT_AIFF | SF_FORMAT_FLOAT) ;
+
+		auto_update_peak_test ("auto_peak.aiff", SF_FORMAT_AIFF | SF_FORMAT_FLOAT) ;
 		test_count++ ;
 		} ;
 
@@ -87,6 +93,8 @@ main (int argc, char *argv [])
 	{	test_float_peak	("peak_float.caf", SF_FORMAT_CAF | SF_FORMAT_FLOAT) ;
 
 		read_write_peak_test ("rw_peak.caf", SF_FORMAT_CAF | SF_FORMAT_FLOAT) ;
+
+		auto_update_peak_test ("auto_peak.caf", SF_FORMAT_CAF | SF_FORMAT_FLOAT) ;
 		test_count++ ;
 		} ;
 
@@ -94,6 +102,8 @@ main (int argc, char *argv [])
 	{	test_float_peak	("peak_float.rf64", SF_FORMAT_RF64 | SF_FORMAT_FLOAT) ;
 
 		read_write_peak_test ("rw_peak.rf64", SF_FORMAT_RF64 | SF_FORMAT_FLOAT) ;
+
+		auto_update_peak_test ("auto_peak.rf64", SF_FORMAT_RF64 | SF_FORMAT_FLOAT) ;
 		test_count++ ;
 		} ;
 
@@ -369,3 +379,53 @@ read_write_peak_test (const char *filename, int filetype)
 	puts ("ok") ;
 } /* read_write_peak_test */
 
+
+static	void
+auto_update_peak_test (const char *filename, int filetype)
+{	SNDFILE	*file, *readfile ;
+	SF_INFO	sfinfo, readinfo ;
+
+	double	small_data [64], max_peak = 0.0 ;
+	unsigned k, pass ;
+
+	print_test_name (__func__, filename) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= 44100 ;
+	sfinfo.channels		= 2 ;
+	sfinfo.format		= filetype ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+
+	sf_command (file, SFC_SET_ADD_PEAK_CHUNK, NULL, SF_TRUE) ;
+	sf_command (file, SFC_SET_UPDATE_HEADER_AUTO, NULL, SF_TRUE) ;
+
+	/*	Each pass raises the peak, so the header written on the previous pass
+	**	must have been patched for the file to be read back correctly before
+	**	it is closed.
+	*/
+	for (pass = 1 ; pass <= 4 ; pass ++)
+	{	for (k = 0 ; k < ARRAY_LEN (small_data) ; k ++)
+			small_data [k] = 0.2 * pass ;
+
+		test_write_double_or_die (file, 0, small_data, ARRAY_LEN (small_data), __LINE__) ;
+
+		memset (&readinfo, 0, sizeof (readinfo)) ;
+		readfile = test_open_file_or_die (filename, SFM_READ, &readinfo, SF_FALSE, __LINE__) ;
+
+		exit_if_true (readinfo.frames != (sf_count_t) (pass * ARRAY_LEN (small_data) / 2),
+				"\n\nLine %d : frame count is %" PRId64 ", should be %u\n", __LINE__, readinfo.frames, pass * (unsigned) ARRAY_LEN (small_data) / 2) ;
+
+		exit_if_true (sf_command (readfile, SFC_GET_SIGNAL_MAX, &max_peak, sizeof (max_peak)) == SF_FALSE,
+				"\n\nLine %d : no PEAK chunk found.\n\n", __LINE__) ;
+
+		sf_close (readfile) ;
+
+		exit_if_true (fabs (max_peak - 0.2 * pass) > 1e-6, "\n\nLine %d : max peak (%5.3f) should be %5.3f.\n\n", __LINE__, max_peak, 0.2 * pass) ;
+		} ;
+
+	sf_close (file) ;
+
+	unlink (filename) ;
+	puts ("ok") ;
+} /* auto_update_peak_test */
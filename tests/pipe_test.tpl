@@ -65,7 +65,10 @@ static void		pipe_test_others (FILETYPE*, FILETYPE*) ;
 static FILETYPE read_write_types [] =
 {	{	SF_FORMAT_RAW	, "raw"		},
 	{	SF_FORMAT_AU	, "au"		},
+	{	SF_FORMAT_AIFF	, "aiff"	},
+	{	SF_FORMAT_WAV	, "wav"		},
 	/* Lite remove start */
+	{	SF_FORMAT_CAF	, "caf"		},
 	{	SF_FORMAT_PAF	, "paf"		},
 	{	SF_FORMAT_IRCAM	, "ircam"	},
 	{	SF_FORMAT_PVF	, "pvf"	},
@@ -80,6 +83,7 @@ static FILETYPE read_only_types [] =
 	{	SF_FORMAT_WAV	, "wav"		},
 	{	SF_FORMAT_W64	, "w64"		},
 	/* Lite remove start */
+	{	SF_FORMAT_CAF	, "caf"		},
 	{	SF_FORMAT_PAF	, "paf"		},
 	{	SF_FORMAT_NIST	, "nist"	},
 	{	SF_FORMAT_IRCAM	, "ircam"	},
@@ -104,6 +104,11 @@ main (int argc, char *argv [])
 		test_count++ ;
 		} ;
 
+	if (do_all || ! strcmp (argv [1], "caf"))
+	{	stdin_test	(SF_FORMAT_CAF, PIPE_TEST_LEN) ;
+		test_count++ ;
+		} ;
+
 	if (do_all || ! strcmp (argv [1], "mat4"))
 	{	stdin_test	(SF_FORMAT_MAT4, PIPE_TEST_LEN) ;
 		test_count++ ;
@@ -97,6 +97,11 @@ main (int argc, char *argv [])
 		test_count ++ ;
 		} ;
 
+	if (do_all || ! strcmp (argv [1], "caf"))
+	{	stdout_test	(SF_FORMAT_CAF, PIPE_TEST_LEN) ;
+		test_count ++ ;
+		} ;
+
 	if (do_all || ! strcmp (argv [1], "mat4"))
 	{	stdout_test	(SF_FORMAT_MAT4, PIPE_TEST_LEN) ;
 		test_count ++ ;
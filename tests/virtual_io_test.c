@@ -163,7 +163,7 @@ vio_test (const char *fname, int format)
 
 	SF_VIRTUAL_IO vio ;
 	SNDFILE * file ;
-	SF_INFO sfinfo ;
+	SF_INFO sfinfo, probe_info ;
 
 	print_test_name ("virtual i/o test", fname) ;
 
@@ -206,6 +206,14 @@ vio_test (const char *fname, int format)
 
 	sf_close (file) ;
 
+	/* Probe the virtual file, it should leave the offset for the read below alone. */
+	vio_data.offset = 0 ;
+
+	if (sf_probe_virtual (&vio, &probe_info, &vio_data, 0) != 0)
+	{	printf ("\n\nLine %d : sf_probe_virtual failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
 	/* Now test read. */
 	memset (&sfinfo, 0, sizeof (sfinfo)) ;
 
@@ -220,6 +228,11 @@ vio_test (const char *fname, int format)
 		exit (1) ;
 		} ;
 
+	if (probe_info.format != sfinfo.format || probe_info.channels != sfinfo.channels || probe_info.frames != sfinfo.frames)
+	{	printf ("\n\nLine %d : sf_probe_virtual / sf_open_virtual mismatch (format 0x%x / 0x%x, frames %ld / %ld).\n\n",
+			__LINE__, probe_info.format, sfinfo.format, (long) probe_info.frames, (long) sfinfo.frames) ;
+		exit (1) ;
+		} ;
 
 	sf_read_short (file, data, ARRAY_LEN (data)) ;
 	check_short_data (data, ARRAY_LEN (data), 0, __LINE__) ;